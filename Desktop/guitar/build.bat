@@ -11,7 +11,31 @@ g++ -std=c++17 -O2 ^
     ../src/main.cpp ^
     ../src/Guitar.cpp ^
     ../src/AudioManager.cpp ^
-    -lSDL2 -lSDL2_mixer -lSDL2main ^
+    ../src/SynthEngine.cpp ^
+    ../src/ToneKernel.cpp ^
+    ../src/WorkerPool.cpp ^
+    ../src/NoteBankCache.cpp ^
+    ../src/OfflineRenderer.cpp ^
+    ../src/WavFile.cpp ^
+    ../src/MidiFile.cpp ^
+    ../src/Sequencer.cpp ^
+    ../src/EffectChain.cpp ^
+    ../src/Benchmark.cpp ^
+    ../src/Fft.cpp ^
+    ../src/Convolver.cpp ^
+    ../src/LatencyProbe.cpp ^
+    ../src/AdaptiveBuffer.cpp ^
+    ../src/Resampler.cpp ^
+    ../src/FlacFile.cpp ^
+    ../src/SampleLibrary.cpp ^
+    ../src/DiskStreamer.cpp ^
+    ../src/SampleClock.cpp ^
+    ../src/DspLoadMeter.cpp ^
+    ../src/PitchTracker.cpp ^
+    ../src/Transcriber.cpp ^
+    ../src/JamSession.cpp ^
+    ../src/GuitarSynth.cpp ^
+    -lSDL2 -lSDL2_mixer -lSDL2main -lws2_32 ^
     -o ElectricGuitar.exe
 
 if %errorlevel% equ 0 (
@@ -6,11 +6,35 @@ mkdir -p build
 cd build
 
 # Compile with g++
-g++ -std=c++17 -O2 \
+g++ -std=c++17 -O2 -pthread \
     -I../src \
     ../src/main.cpp \
     ../src/Guitar.cpp \
     ../src/AudioManager.cpp \
+    ../src/SynthEngine.cpp \
+    ../src/ToneKernel.cpp \
+    ../src/WorkerPool.cpp \
+    ../src/NoteBankCache.cpp \
+    ../src/OfflineRenderer.cpp \
+    ../src/WavFile.cpp \
+    ../src/MidiFile.cpp \
+    ../src/Sequencer.cpp \
+    ../src/EffectChain.cpp \
+    ../src/Benchmark.cpp \
+    ../src/Fft.cpp \
+    ../src/Convolver.cpp \
+    ../src/LatencyProbe.cpp \
+    ../src/AdaptiveBuffer.cpp \
+    ../src/Resampler.cpp \
+    ../src/FlacFile.cpp \
+    ../src/SampleLibrary.cpp \
+    ../src/DiskStreamer.cpp \
+    ../src/SampleClock.cpp \
+    ../src/DspLoadMeter.cpp \
+    ../src/PitchTracker.cpp \
+    ../src/Transcriber.cpp \
+    ../src/JamSession.cpp \
+    ../src/GuitarSynth.cpp \
     $(pkg-config --cflags --libs sdl2 SDL2_mixer) \
     -o ElectricGuitar
 
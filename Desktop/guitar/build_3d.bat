@@ -23,9 +23,33 @@ g++ -std=c++17 -O2 ^
     ../src/main.cpp ^
     ../src/Guitar3D.cpp ^
     ../src/AudioManager.cpp ^
+    ../src/SynthEngine.cpp ^
+    ../src/ToneKernel.cpp ^
+    ../src/WorkerPool.cpp ^
+    ../src/NoteBankCache.cpp ^
+    ../src/OfflineRenderer.cpp ^
+    ../src/WavFile.cpp ^
+    ../src/MidiFile.cpp ^
+    ../src/Sequencer.cpp ^
+    ../src/EffectChain.cpp ^
+    ../src/Benchmark.cpp ^
+    ../src/Fft.cpp ^
+    ../src/Convolver.cpp ^
+    ../src/LatencyProbe.cpp ^
+    ../src/AdaptiveBuffer.cpp ^
+    ../src/Resampler.cpp ^
+    ../src/FlacFile.cpp ^
+    ../src/SampleLibrary.cpp ^
+    ../src/DiskStreamer.cpp ^
+    ../src/SampleClock.cpp ^
+    ../src/DspLoadMeter.cpp ^
+    ../src/PitchTracker.cpp ^
+    ../src/Transcriber.cpp ^
+    ../src/JamSession.cpp ^
+    ../src/GuitarSynth.cpp ^
     ../src/GLBLoader.cpp ^
     ../src/Camera.cpp ^
-    -lmingw32 -lSDL2main -lSDL2 -lSDL2_mixer ^
+    -lmingw32 -lSDL2main -lSDL2 -lSDL2_mixer -lws2_32 ^
     -lglew32 -lopengl32 -lglu32 ^
     -mconsole ^
     -o ElectricGuitar3D.exe
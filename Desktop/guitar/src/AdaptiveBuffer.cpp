@@ -0,0 +1,124 @@
+#include "AdaptiveBuffer.h"
+#include <algorithm>
+#include <iostream>
+
+AdaptiveBuffer::AdaptiveBuffer(int sampleRate, int initialFrames)
+    : sampleRate_(sampleRate), clockStart_(0), framesDelivered_(0), resync_(true), deadlineMisses_(0),
+      underruns_(0), peakLoad_(0), deviceFrames_(0), frames_(clampFrames(initialFrames)), windowStart_(0),
+      cleanSince_(0), hold_(MIN_HOLD_NS), lastShrink_(0), totalMisses_(0), totalUnderruns_(0), changes_(0)
+{
+}
+
+int AdaptiveBuffer::clampFrames(int frames)
+{
+    // Devices want power-of-two buffers
+    int size = MIN_FRAMES;
+    while (size < frames && size < MAX_FRAMES)
+        size *= 2;
+    return size;
+}
+
+void AdaptiveBuffer::recordCallback(int frames, int64_t start, int64_t end)
+{
+    const int64_t period = (int64_t)frames * 1000000000 / sampleRate_;
+    deviceFrames_.store(frames, std::memory_order_relaxed);
+
+    if (resync_.exchange(false, std::memory_order_acquire))
+    {
+        clockStart_ = start;
+        framesDelivered_ = 0;
+    }
+    else
+    {
+        // The device still holds at least the buffer it is playing when it asks for the next one.
+        // A callback later than that means it ran out and played silence.
+        int64_t played = clockStart_ + framesDelivered_ * 1000000000 / sampleRate_;
+        int64_t late = start - played;
+        if (late > period)
+        {
+            underruns_.fetch_add(1, std::memory_order_relaxed);
+            clockStart_ = start;
+            framesDelivered_ = 0;
+        }
+        else
+        {
+            // Follow a device clock that runs a little slow or fast without mistaking jitter for it;
+            // a fast one left alone would move the expected time ahead and hide real underruns
+            clockStart_ += late / 256;
+        }
+    }
+    framesDelivered_ += frames;
+
+    int64_t busy = end - start;
+    if (busy > period)
+        deadlineMisses_.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t load = (uint32_t)std::min<int64_t>(busy * 1000 / std::max<int64_t>(period, 1), 100000);
+    uint32_t peak = peakLoad_.load(std::memory_order_relaxed);
+    if (load > peak)
+        peakLoad_.store(load, std::memory_order_relaxed);
+}
+
+void AdaptiveBuffer::restart(int64_t now)
+{
+    resync_.store(true, std::memory_order_release);
+    deadlineMisses_.store(0, std::memory_order_relaxed);
+    underruns_.store(0, std::memory_order_relaxed);
+    peakLoad_.store(0, std::memory_order_relaxed);
+    windowStart_ = now;
+}
+
+int AdaptiveBuffer::update(int64_t now)
+{
+    if (windowStart_ == 0)
+    {
+        windowStart_ = now;
+        cleanSince_ = now;
+        return 0;
+    }
+    if (now - windowStart_ < WINDOW_NS)
+        return 0;
+
+    uint32_t misses = deadlineMisses_.exchange(0, std::memory_order_relaxed);
+    uint32_t underruns = underruns_.exchange(0, std::memory_order_relaxed);
+    uint32_t peak = peakLoad_.exchange(0, std::memory_order_relaxed);
+    totalMisses_ += misses;
+    totalUnderruns_ += underruns;
+    windowStart_ = now;
+
+    int previous = frames_;
+    if (misses + underruns > 0)
+    {
+        cleanSince_ = now;
+
+        // A smaller size that fails soon after is not worth retrying as often
+        if (lastShrink_ != 0 && now - lastShrink_ < 2 * hold_)
+            hold_ = std::min(hold_ * 2, MAX_HOLD_NS);
+        lastShrink_ = 0;
+
+        if (frames_ >= MAX_FRAMES)
+            return 0;
+        frames_ *= 2;
+
+        std::cout << "Audio buffer " << previous << " -> " << frames_ << " frames ("
+                  << 1000.0 * frames_ / sampleRate_ << " ms): " << underruns << " underruns, " << misses
+                  << " deadline misses, peak load " << peak / 10 << "%" << std::endl;
+    }
+    else if (frames_ > MIN_FRAMES && now - cleanSince_ >= hold_ && peak < SHRINK_LOAD)
+    {
+        frames_ /= 2;
+        cleanSince_ = now;
+        lastShrink_ = now;
+
+        std::cout << "Audio buffer " << previous << " -> " << frames_ << " frames ("
+                  << 1000.0 * frames_ / sampleRate_ << " ms): clean for " << hold_ / 1000000000
+                  << " s, peak load " << peak / 10 << "%" << std::endl;
+    }
+    else
+    {
+        return 0;
+    }
+
+    changes_++;
+    return frames_;
+}
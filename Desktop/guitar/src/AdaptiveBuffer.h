@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Watches the audio callback for deadline misses and underruns and decides when the
+// device buffer should grow or shrink. The callback side only touches atomics; the
+// decision runs on the main thread, which reopens the device at the new size.
+class AdaptiveBuffer
+{
+public:
+    static constexpr int MIN_FRAMES = 64;
+    static constexpr int MAX_FRAMES = 2048;
+
+private:
+    static constexpr int64_t WINDOW_NS = 1000000000;     // stats are judged once per second
+    static constexpr int64_t MIN_HOLD_NS = 5000000000;   // clean time needed before trying smaller
+    static constexpr int64_t MAX_HOLD_NS = 300000000000; // the hold doubles each time a smaller size fails
+    static constexpr uint32_t SHRINK_LOAD = 400;         // per mille: only shrink while peak load is below this
+
+    int sampleRate_;
+
+    // Audio thread: where the device should be if it played exactly what was delivered
+    int64_t clockStart_;
+    int64_t framesDelivered_;
+    std::atomic<bool> resync_;
+
+    // Written by the audio thread, collected once per window by the main thread
+    std::atomic<uint32_t> deadlineMisses_;
+    std::atomic<uint32_t> underruns_;
+    std::atomic<uint32_t> peakLoad_; // callback time over the buffer period, per mille
+    std::atomic<int> deviceFrames_;  // what the device actually asks for per callback
+
+    // Main thread
+    int frames_;
+    int64_t windowStart_;
+    int64_t cleanSince_;
+    int64_t hold_;
+    int64_t lastShrink_; // when the buffer was last made smaller, 0 = never
+    uint32_t totalMisses_;
+    uint32_t totalUnderruns_;
+    int changes_;
+
+public:
+    AdaptiveBuffer(int sampleRate, int initialFrames);
+
+    static int clampFrames(int frames);
+
+    // Main thread: the size the device was opened with
+    void setFrames(int frames) { frames_ = clampFrames(frames); }
+
+    // Audio thread, once per callback with its start and end time in steady-clock nanoseconds
+    void recordCallback(int frames, int64_t start, int64_t end);
+
+    // Main thread: returns the new buffer size when it should change, otherwise 0.
+    // The reason is logged to the console.
+    int update(int64_t now);
+
+    // Main thread, after the device was reopened: drop the gap the reopen caused
+    void restart(int64_t now);
+
+    int getFrames() const { return frames_; }
+    int getDeviceFrames() const { return deviceFrames_.load(std::memory_order_relaxed); }
+    uint32_t getTotalMisses() const { return totalMisses_; }
+    uint32_t getTotalUnderruns() const { return totalUnderruns_; }
+    int getChangeCount() const { return changes_; }
+};
@@ -1,14 +1,35 @@
 #include "AudioManager.h"
+#include "DiskStreamer.h"
+#include "SampleLibrary.h"
+#include "Sequencer.h"
+#include "ToneKernel.h"
+#include "WorkerPool.h"
 #include <cmath>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-AudioManager::AudioManager() : sampleRate(44100), channels(2)
+AudioManager::AudioManager(int engineRate)
+    : sampleRate(engineRate > 0 ? engineRate : 44100), deviceRate(0), fixedEngineRate(engineRate > 0), channels(2),
+      format(AUDIO_S16SYS), fretCount(12), oldestSlot(-1), newestSlot(-1), noteBankPublished(0),
+      noteBankListed(0), noteBankBudget(0), noteBankHeapBytes(0), noteBankEvictions(0), prewarmRemaining(0),
+      prewarmSkipped(0), noteBankReady(false), noteBankSaving(false), mode(SynthMode::Streaming),
+      musicHooked(false), cabinet(nullptr), onsetDelay(DEFAULT_ONSET_DELAY), onsetsScheduled(0), onsetsLate(0),
+      lastOverloadLog(0), pendingOverloads(0), worstOverload(), adaptiveBuffer(false), deviceBlockFrames(BLOCK_FRAMES)
 {
+    static_assert(BANK_SLOTS <= NoteBankCache::MAX_SLOTS, "note bank cache can't hold every layer");
+    for (int i = 0; i < BANK_SLOTS; i++)
+    {
+        noteSlots[i].chunk.store(nullptr);
+        noteSlots[i].listed = false;
+        noteSlots[i].older = -1;
+        noteSlots[i].newer = -1;
+        mappedChunks[i] = {};
+    }
+
     initialize();
 }
 
@@ -19,63 +40,885 @@ AudioManager::~AudioManager()
 
 bool AudioManager::initialize()
 {
-    // SDL_mixer is already initialized in main.cpp
+    // SDL_mixer is already initialized in main.cpp, so adopt whatever it opened
+    int openedRate = 0;
+    int openedChannels = 0;
+    Uint16 openedFormat = 0;
+    if (Mix_QuerySpec(&openedRate, &openedFormat, &openedChannels) == 0)
+    {
+        std::cerr << "AudioManager: mixer is not open, streaming synth disabled" << std::endl;
+        mode = SynthMode::NoteBank;
+        return false;
+    }
+
+    deviceRate = openedRate;
+    channels = openedChannels;
+    format = openedFormat;
+    if (!fixedEngineRate)
+        sampleRate = deviceRate;
+
+    if ((format != AUDIO_S16SYS && format != AUDIO_F32SYS) || channels < 1)
+    {
+        std::cerr << "AudioManager: unsupported output format, streaming synth disabled" << std::endl;
+        mode = SynthMode::NoteBank;
+        sampleRate = deviceRate; // mixer channels play the tones at the device rate
+        return false;
+    }
+
+    if (sampleRate != deviceRate)
+    {
+        // A block of n device frames needs fewer than 1 + n * sampleRate / deviceRate engine frames
+        deviceBlockFrames = (int)std::min<long long>(BLOCK_FRAMES, (long long)(BLOCK_FRAMES - 1) * deviceRate / sampleRate);
+        resampler = std::make_unique<Resampler>(sampleRate, deviceRate, 2, deviceBlockFrames);
+        if (deviceBlockFrames < 1 || !resampler->isValid())
+        {
+            std::cerr << "AudioManager: can't convert " << sampleRate << " Hz to " << deviceRate
+                      << " Hz, running the engine at the device rate" << std::endl;
+            resampler.reset();
+            sampleRate = deviceRate;
+            deviceBlockFrames = BLOCK_FRAMES;
+        }
+        else
+        {
+            std::cout << "Engine at " << sampleRate << " Hz, resampled to " << deviceRate << " Hz ("
+                      << resampler->getTaps() << " taps, " << 1000.0 * resampler->getLatencyFrames() / sampleRate
+                      << " ms)" << std::endl;
+        }
+    }
+
+    // A jam partner plays strings of their own, placed like ours, so neither chokes the other's notes
+    engine = std::make_unique<SynthEngine>(sampleRate, STRING_COUNT * 2);
+    for (int s = 0; s < STRING_COUNT; s++)
+    {
+        float pan = 0.3f * (2.0f * s / (STRING_COUNT - 1) - 1.0f);
+        engine->setStringPan(s, pan);
+        engine->setStringPan(REMOTE_STRING + s, pan);
+    }
+    engine->setLoadMeter(&loadMeter);
+    effects = std::make_unique<EffectChain>(sampleRate);
+    bufferMonitor = std::make_unique<AdaptiveBuffer>(deviceRate, AdaptiveBuffer::MAX_FRAMES);
+    sampleClock.setSampleRate(sampleRate);
+
+    // The music hook becomes our synth stream; SDL_mixer channels still mix on top of it
+    Mix_HookMusic(audioCallback, this);
+    musicHooked = true;
     return true;
 }
 
-void AudioManager::playNote(float frequency)
+void AudioManager::setTuning(const std::vector<float> &baseFrequencies, int frets)
 {
-    int key = getKeyFromFrequency(frequency);
+    tuning = baseFrequencies;
+    fretCount = frets;
+}
+
+void AudioManager::prewarmNoteBank(const std::string &cachePath)
+{
+    if (prewarmPool || noteBankReady.load())
+        return;
 
-    // Check if we already have this note cached
-    if (noteChunks.find(key) == noteChunks.end())
+    noteCachePath = cachePath;
+    if (!noteCachePath.empty() && loadNoteBankCache())
+        return;
+
+    if (tuning.empty())
     {
-        // Generate new note
-        noteChunks[key] = generateSineWave(frequency, 0.8f, 0.5f); // 0.8 seconds, 50% volume
+        std::cerr << "AudioManager: no tuning set, nothing to pre-warm" << std::endl;
+        return;
     }
 
-    if (noteChunks[key])
+    // Collect each distinct note once; different strings share many pitches. A slot holds its key's
+    // equal-tempered pitch and playback detunes it, so a tuning off that grid doesn't claim the slot.
+    std::map<int, float> notes;
+    for (float baseFrequency : tuning)
+    {
+        for (int fret = 0; fret <= fretCount; fret++)
+        {
+            float frequency = baseFrequency * std::pow(2.0f, fret / 12.0f);
+            int key = getKeyFromFrequency(frequency);
+            if (key >= 0 && key < NOTE_SLOTS)
+                notes.emplace(key, SynthEngine::noteToFrequency((float)key));
+        }
+    }
+
+    prewarmPool = std::make_unique<WorkerPool>();
+    prewarmRemaining.store((int)notes.size() * VELOCITY_LAYERS);
+    prewarmSkipped.store(0);
+    prewarmStart = std::chrono::steady_clock::now();
+
+    std::cout << "Pre-warming " << notes.size() << " notes x " << VELOCITY_LAYERS << " velocity layers on "
+              << prewarmPool->getThreadCount() << " worker threads" << std::endl;
+
+    for (const auto &note : notes)
     {
-        // Play the note
-        Mix_PlayChannel(-1, noteChunks[key], 0);
+        for (int layer = 0; layer < VELOCITY_LAYERS; layer++)
+        {
+            int slot = bankSlot(note.first, layer);
+            float frequency = note.second;
+            prewarmPool->submit([this, slot, frequency, layer]
+                                {
+                // A full budget stops the pre-warm; eviction is the main thread's, on demand
+                size_t budget = noteBankBudget.load();
+                if (budget == 0 || noteBankHeapBytes.load() < budget)
+                    publishChunk(slot, generateSineWave(frequency, NOTE_DURATION, NOTE_VOLUME * layerVelocity(layer)), true);
+                if (!noteSlots[slot].chunk.load())
+                    prewarmSkipped.fetch_add(1);
+
+                if (prewarmRemaining.fetch_sub(1) == 1)
+                {
+                    auto elapsed = std::chrono::steady_clock::now() - prewarmStart;
+                    std::ostringstream message;
+                    message << "Note bank ready in "
+                            << std::chrono::duration<double, std::milli>(elapsed).count() << " ms, "
+                            << noteBankHeapBytes.load() / 1024 << " KiB of samples (" << noteBankChannels()
+                            << " channel)";
+                    if (prewarmSkipped.load() > 0)
+                        message << ", " << prewarmSkipped.load() << " layers over the budget left for later";
+                    message << "\n";
+                    std::cout << message.str() << std::flush;
+
+                    noteBankReady.store(true);
+                    saveNoteBankCache();
+                } });
+        }
     }
 }
 
-Mix_Chunk *AudioManager::generateSineWave(float frequency, float duration, float volume)
+int AudioManager::velocityLayer(float velocity)
 {
-    int samples = (int)(sampleRate * duration);
-    int bytes = samples * channels * sizeof(Sint16);
+    int layer = (int)std::ceil(std::max(0.0f, std::min(1.0f, velocity)) * VELOCITY_LAYERS) - 1;
+    return std::max(0, layer);
+}
 
-    Sint16 *buffer = new Sint16[samples * channels];
+bool AudioManager::publishChunk(int slot, Mix_Chunk *chunk, bool withinBudget)
+{
+    if (!chunk)
+        return false;
+
+    // Claim the bytes first, so racing workers can't all squeeze in under the budget
+    size_t bytes = chunk->allocated ? chunk->alen : 0;
+    size_t budget = withinBudget ? noteBankBudget.load() : 0;
+    size_t held = noteBankHeapBytes.load();
+    do
+    {
+        if (budget > 0 && held + bytes > budget)
+        {
+            freeChunk(chunk);
+            return false;
+        }
+    } while (!noteBankHeapBytes.compare_exchange_weak(held, held + bytes));
 
-    for (int i = 0; i < samples; i++)
+    // First renderer wins; a duplicate from a racing thread is dropped
+    Mix_Chunk *expected = nullptr;
+    if (!noteSlots[slot].chunk.compare_exchange_strong(expected, chunk, std::memory_order_acq_rel))
     {
-        // Generate sine wave with envelope (fade out)
-        float time = (float)i / sampleRate;
-        float envelope = 1.0f;
+        noteBankHeapBytes.fetch_sub(bytes);
+        freeChunk(chunk);
+        return false;
+    }
+    if (bytes > 0)
+        noteBankPublished.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void AudioManager::setNoteBankBudget(size_t bytes)
+{
+    noteBankBudget.store(bytes);
+    trimNoteBank(-1);
+}
+
+void AudioManager::linkSlot(int slot, bool newest)
+{
+    NoteSlot &node = noteSlots[slot];
+    node.listed = true;
+    node.older = newest ? newestSlot : -1;
+    node.newer = newest ? -1 : oldestSlot;
+
+    if (node.older >= 0)
+        noteSlots[node.older].newer = slot;
+    else
+        oldestSlot = slot;
+    if (node.newer >= 0)
+        noteSlots[node.newer].older = slot;
+    else
+        newestSlot = slot;
+}
+
+void AudioManager::unlinkSlot(int slot)
+{
+    NoteSlot &node = noteSlots[slot];
+    if (!node.listed)
+        return;
+    if (node.older >= 0)
+        noteSlots[node.older].newer = node.newer;
+    else
+        oldestSlot = node.newer;
+    if (node.newer >= 0)
+        noteSlots[node.newer].older = node.older;
+    else
+        newestSlot = node.older;
+    node.listed = false;
+    node.older = -1;
+    node.newer = -1;
+}
+
+void AudioManager::listPublishedSlots()
+{
+    // Only when a worker published something since the last look: one pass, not one per eviction
+    uint32_t published = noteBankPublished.load(std::memory_order_acquire);
+    if (published == noteBankListed)
+        return;
+    noteBankListed = published;
+
+    for (int slot = 0; slot < BANK_SLOTS; slot++)
+    {
+        Mix_Chunk *chunk = noteSlots[slot].chunk.load(std::memory_order_acquire);
+        if (chunk && chunk->allocated && !noteSlots[slot].listed)
+            linkSlot(slot, false);
+    }
+}
+
+void AudioManager::trimNoteBank(int keepSlot)
+{
+    if (noteBankBudget.load() == 0)
+        return;
+
+    listPublishedSlots();
+    auto now = std::chrono::steady_clock::now();
+    while (noteBankHeapBytes.load() > noteBankBudget.load())
+    {
+        // The least recently played layer, never the one just asked for
+        int victim = oldestSlot;
+        if (victim == keepSlot && victim >= 0)
+            victim = noteSlots[victim].newer;
+        if (victim < 0)
+            break;
+
+        unlinkSlot(victim);
+        Mix_Chunk *chunk = noteSlots[victim].chunk.exchange(nullptr);
+        if (!chunk)
+            continue;
+        noteBankHeapBytes.fetch_sub(chunk->alen);
+        noteBankEvictions++;
+
+        // A voice started just before the eviction reads the samples until the tone ends, as slowly
+        // as the lowest whammy and bend together can pitch it
+        double chunkSeconds = (double)chunk->alen / (noteBankChannels() * sizeof(Sint16)) / sampleRate;
+        double seconds = chunkSeconds / SynthEngine::MIN_PITCH_RATIO + 1.0;
+        auto freeAfter = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<double>(seconds));
+        retiredChunks.push_back({chunk, freeAfter});
+    }
+}
+
+void AudioManager::freeRetiredChunks(bool all)
+{
+    // A cache write in progress may have taken any of them before they were evicted; shutdown
+    // stops the pre-warm pool, and with it the write, before freeing them all
+    if (retiredChunks.empty() || (!all && noteBankSaving.load()))
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    auto end = std::remove_if(retiredChunks.begin(), retiredChunks.end(), [all, now](const RetiredChunk &retired)
+                              {
+        if (!all && retired.freeAfter > now)
+            return false;
+        freeChunk(retired.chunk);
+        return true; });
+    retiredChunks.erase(end, retiredChunks.end());
+}
+
+void AudioManager::freeChunk(Mix_Chunk *chunk)
+{
+    // Chunks that borrow the mapped cache are not ours to free
+    if (chunk && chunk->allocated)
+    {
+        delete[] chunk->abuf;
+        delete chunk;
+    }
+}
+
+void AudioManager::makeNoteBankParams(NoteBankParams &params) const
+{
+    std::memset(&params, 0, sizeof(params));
+    params.sampleRate = (uint32_t)sampleRate;
+    params.channels = (uint32_t)noteBankChannels();
+    params.velocityLayers = VELOCITY_LAYERS;
+    params.kernelRevision = ToneKernel::REVISION;
+    params.duration = NOTE_DURATION;
+    params.volume = NOTE_VOLUME;
+    params.fadeStart = ToneKernel::FADE_START;
+    for (int h = 0; h < ToneKernel::HARMONIC_COUNT; h++)
+    {
+        params.harmonicWeights[h] = ToneKernel::HARMONIC_WEIGHTS[h];
+    }
+    params.stringCount = (uint32_t)std::min((int)tuning.size(), NoteBankParams::MAX_STRINGS);
+    params.fretCount = (uint32_t)fretCount;
+    for (uint32_t i = 0; i < params.stringCount; i++)
+    {
+        params.tuning[i] = tuning[i];
+    }
+}
 
-        // Add fade out to prevent clicking
-        if (time > duration * 0.7f)
+bool AudioManager::loadNoteBankCache()
+{
+    // Warm start: no synthesis and no allocation, the chunks borrow the mapped samples
+    auto start = std::chrono::steady_clock::now();
+
+    NoteBankParams params;
+    makeNoteBankParams(params);
+    if (!noteCache.open(noteCachePath, params))
+        return false;
+
+    for (int slot = 0; slot < BANK_SLOTS; slot++)
+    {
+        int frames = 0;
+        const int16_t *samples = noteCache.getSamples(slot, frames);
+        if (!samples)
+            continue;
+
+        Mix_Chunk &chunk = mappedChunks[slot];
+        chunk.allocated = 0; // owned by the mapping, never freed or evicted
+        chunk.abuf = (Uint8 *)samples;
+        chunk.alen = (Uint32)(frames * noteBankChannels() * sizeof(Sint16));
+        chunk.volume = MIX_MAX_VOLUME;
+        publishChunk(slot, &chunk);
+    }
+
+    noteBankReady.store(true);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Note bank mapped from " << noteCachePath << " (" << noteCache.getNoteCount() << " notes) in "
+              << std::chrono::duration<double, std::milli>(elapsed).count() << " ms" << std::endl;
+    return true;
+}
+
+void AudioManager::saveNoteBankCache()
+{
+    if (noteCachePath.empty())
+        return;
+
+    NoteBankParams params;
+    makeNoteBankParams(params);
+
+    // Layers evicted meanwhile are not freed until the write has finished. The flag goes up before
+    // any slot is read: an eviction that beats a read leaves nothing to read, and one that follows
+    // it sees the flag (all sequentially consistent, so neither side can miss the other).
+    noteBankSaving.store(true);
+    std::vector<NoteBankNote> notes;
+    for (int slot = 0; slot < BANK_SLOTS; slot++)
+    {
+        Mix_Chunk *chunk = noteSlots[slot].chunk.load();
+        if (chunk)
         {
-            envelope = 1.0f - (time - duration * 0.7f) / (duration * 0.3f);
+            int frames = (int)(chunk->alen / (noteBankChannels() * sizeof(Sint16)));
+            notes.push_back({slot, reinterpret_cast<const int16_t *>(chunk->abuf), frames});
         }
+    }
+
+    bool written = NoteBankCache::write(noteCachePath, params, notes.data(), (int)notes.size());
+    noteBankSaving.store(false);
+    if (written)
+    {
+        std::cout << "Note bank cache written to " << noteCachePath << std::endl;
+    }
+}
+
+void AudioManager::setMaxVoices(int maxVoices)
+{
+    if (engine)
+        engine->setMaxVoices(maxVoices);
+}
+
+void AudioManager::setStealPolicy(VoiceStealPolicy policy)
+{
+    if (engine)
+        engine->setStealPolicy(policy);
+}
+
+void AudioManager::setEnvelope(VoiceKind kind, const EnvelopeSettings &settings)
+{
+    if (engine)
+        engine->setEnvelope(kind, settings);
+}
+
+void AudioManager::setBend(int stringIndex, float cents)
+{
+    if (engine)
+        engine->setBend(stringIndex, cents);
+    sendJam(JamEventType::Bend, stringIndex, cents, 0.0f, 0);
+}
+
+void AudioManager::setVibrato(int stringIndex, float depthCents, float rateHz)
+{
+    if (engine)
+        engine->setVibrato(stringIndex, depthCents, rateHz);
+    sendJam(JamEventType::Vibrato, stringIndex, depthCents, 0.0f, 0, rateHz);
+}
+
+void AudioManager::setWhammy(float cents)
+{
+    if (engine)
+        engine->setWhammy(cents);
+    sendJam(JamEventType::Whammy, 0, cents, 0.0f, 0);
+}
+
+int AudioManager::getMaxVoices() const
+{
+    return engine ? engine->getMaxVoices() : 0;
+}
+
+void AudioManager::enableAdaptiveBuffer(int bufferFrames)
+{
+    if (!engine)
+        return;
 
-        // Add some harmonics for more guitar-like sound
-        float sample = sin(2.0f * M_PI * frequency * time) * 0.6f;    // Fundamental
-        sample += sin(2.0f * M_PI * frequency * 2.0f * time) * 0.2f;  // 2nd harmonic
-        sample += sin(2.0f * M_PI * frequency * 3.0f * time) * 0.1f;  // 3rd harmonic
-        sample += sin(2.0f * M_PI * frequency * 4.0f * time) * 0.05f; // 4th harmonic
+    adaptiveBuffer = true;
+    bufferMonitor->setFrames(bufferFrames);
+    if (bufferMonitor->getFrames() != bufferFrames)
+        reopenDevice(bufferMonitor->getFrames());
+    bufferMonitor->restart(LatencyProbe::now());
+}
+
+void AudioManager::updateBufferSize()
+{
+    if (!adaptiveBuffer)
+        return;
+
+    int frames = bufferMonitor->update(LatencyProbe::now());
+    if (frames > 0 && !reopenDevice(frames))
+        adaptiveBuffer = false;
+}
+
+bool AudioManager::reopenDevice(int bufferFrames)
+{
+    // The engine, effects and voices live on in this object, so only the device restarts
+    int mixChannels = Mix_AllocateChannels(-1);
+    Mix_HookMusic(nullptr, nullptr);
+    Mix_CloseAudio();
+
+    if (Mix_OpenAudio(deviceRate, format, channels, bufferFrames) < 0)
+    {
+        std::cerr << "AudioManager: could not reopen audio with " << bufferFrames
+                  << " frames: " << Mix_GetError() << std::endl;
+        musicHooked = false;
+        return false;
+    }
+    Mix_AllocateChannels(mixChannels);
+
+    int openedRate = 0;
+    int openedChannels = 0;
+    Uint16 openedFormat = 0;
+    Mix_QuerySpec(&openedRate, &openedFormat, &openedChannels);
+    if (openedRate != deviceRate || openedFormat != format || openedChannels != channels)
+    {
+        // Every buffer and filter was set up for the old format
+        std::cerr << "AudioManager: device changed format on reopen, streaming synth stopped" << std::endl;
+        musicHooked = false;
+        return false;
+    }
 
-        sample *= volume * envelope;
+    sampleClock.restart();
+    Mix_HookMusic(audioCallback, this);
+    bufferMonitor->restart(LatencyProbe::now());
+    return true;
+}
 
-        // Convert to 16-bit integer
-        Sint16 sampleValue = (Sint16)(sample * 32767);
+void AudioManager::printBufferStats() const
+{
+    if (!adaptiveBuffer)
+        return;
 
-        // Stereo - same value for both channels
-        buffer[i * channels] = sampleValue;     // Left
-        buffer[i * channels + 1] = sampleValue; // Right
+    std::cout << "Low-latency mode: " << bufferMonitor->getFrames() << " frames ("
+              << 1000.0 * bufferMonitor->getFrames() / deviceRate << " ms) at exit, device asked for "
+              << bufferMonitor->getDeviceFrames() << ", " << bufferMonitor->getChangeCount() << " changes, "
+              << bufferMonitor->getTotalUnderruns() << " underruns, " << bufferMonitor->getTotalMisses()
+              << " deadline misses" << std::endl;
+}
+
+bool AudioManager::loadSampleLibrary(const std::string &manifestPath, float headSeconds)
+{
+    if (!engine)
+    {
+        std::cerr << "AudioManager: sample libraries need the streaming synth" << std::endl;
+        return false;
     }
 
+    auto library = std::make_unique<SampleLibrary>();
+    if (!library->load(manifestPath, tuning, sampleRate, headSeconds))
+        return false;
+
+    // Set up once, before any zone reaches the audio thread
+    if (!streamer)
+    {
+        streamer = std::make_unique<DiskStreamer>(sampleRate);
+        engine->setDiskStreamer(streamer.get());
+    }
+    sampleLibrary = std::move(library);
+    mode = SynthMode::Multisample;
+    return true;
+}
+
+void AudioManager::printLatencyReport() const
+{
+    latencyProbe.report(std::cout);
+    if (onsetsScheduled > 0)
+    {
+        std::cout << "Onsets: " << onsetsScheduled << " events started " << 1000.0f * onsetDelay
+                  << " ms past one buffer after their input, " << onsetsLate
+                  << " arrived too late and started at the next block" << std::endl;
+    }
+}
+
+uint64_t AudioManager::stageDone(DspStage stage, uint64_t started)
+{
+    uint64_t now = DspLoadMeter::ticks();
+    loadMeter.addStage(stage, now - started);
+    return now;
+}
+
+void AudioManager::pollLoadMeter()
+{
+    DspOverload overload;
+    while (loadMeter.popOverload(overload))
+    {
+        if (pendingOverloads == 0 || overload.load > worstOverload.load)
+            worstOverload = overload;
+        pendingOverloads++;
+    }
+
+    int64_t now = LatencyProbe::now();
+    if (pendingOverloads == 0 || now - lastOverloadLog < DspLoadMeter::WINDOW_NS)
+        return;
+
+    std::cout << "DSP overload: " << pendingOverloads << (pendingOverloads == 1 ? " callback" : " callbacks")
+              << " over " << (int)(100.0f * loadMeter.getThreshold()) << "%, worst "
+              << (int)(100.0f * worstOverload.load) << "% of a " << worstOverload.frames << "-frame buffer with "
+              << worstOverload.voices << " voices, " << (now - worstOverload.time) / 1000000 << " ms ago" << std::endl;
+    pendingOverloads = 0;
+    lastOverloadLog = now;
+}
+
+void AudioManager::printVoiceStats() const
+{
+    if (noteBankEvictions > 0 || noteBankBudget > 0)
+    {
+        std::cout << "Note bank: " << noteBankHeapBytes.load() / 1024 << " KiB in memory";
+        if (noteBankBudget > 0)
+            std::cout << " of a " << noteBankBudget / 1024 << " KiB budget";
+        std::cout << ", " << noteBankEvictions << " layers evicted" << std::endl;
+    }
+
+    if (!engine)
+        return;
+
+    std::cout << "Voice pool: " << engine->getMaxVoices() << " voices, "
+              << engine->getVoicesStolen() << " stolen, "
+              << engine->getVoicesDropped() << " dropped, "
+              << engine->getDroppedEvents() << " events lost to a full queue" << std::endl;
+
+    if (streamer)
+    {
+        std::cout << "Disk streaming: " << streamer->getStreamsStarted() << " streams, "
+                  << streamer->getUnderruns() << " underruns (" << streamer->getStarvedFrames()
+                  << " frames of silence), " << streamer->getNoFreeSlot() << " played from the head only, "
+                  << streamer->getOpenFailures() << " failed to open, "
+                  << streamer->getFramesDecoded() * 1.0 / sampleRate << " s decoded" << std::endl;
+    }
+}
+
+void AudioManager::audioCallback(void *userdata, Uint8 *stream, int len)
+{
+    AudioManager *manager = static_cast<AudioManager *>(userdata);
+    int64_t start = LatencyProbe::now();
+    manager->loadMeter.beginCallback(manager->sampleRate);
+    manager->fillStream(stream, len);
+
+    int bytesPerSample = (manager->format == AUDIO_F32SYS) ? (int)sizeof(float) : (int)sizeof(Sint16);
+    int frames = len / (bytesPerSample * manager->channels);
+    int64_t end = LatencyProbe::now();
+    manager->bufferMonitor->recordCallback(frames, start, end);
+    manager->loadMeter.endCallback(start, end, frames, manager->deviceRate, manager->engine->getActiveVoices());
+}
+
+void AudioManager::fillStream(Uint8 *stream, int len)
+{
+    int bytesPerSample = (format == AUDIO_F32SYS) ? (int)sizeof(float) : (int)sizeof(Sint16);
+    int frames = len / (bytesPerSample * channels);
+    int offset = 0;
+
+    // Probed clicks whose first sample lands in this buffer, with its frame in the buffer
+    const int MAX_PROBED = 8;
+    uint32_t probedTags[MAX_PROBED];
+    int probedFrames[MAX_PROBED];
+    int probedCount = 0;
+    const uint64_t bufferStart = engine->getSampleTime();
+    sampleClock.update(LatencyProbe::now(), bufferStart);
+
+    // Take the newest cabinet; the one it replaces goes back to be freed. Only this thread
+    // pushes retired ones, so a free slot seen here is still free at the push.
+    PartitionedConvolver *incoming = nullptr;
+    while (cabinetRetired.size() < cabinetRetired.capacity() && cabinetIncoming.pop(incoming))
+    {
+        if (cabinet)
+            cabinetRetired.push(cabinet);
+        cabinet = incoming;
+    }
+
+    while (offset < frames)
+    {
+        // count is in device frames; the engine renders whatever the resampler needs for them
+        int count = std::min(deviceBlockFrames, frames - offset);
+        int engineFrames = resampler ? resampler->inputNeeded(count) : count;
+        uint64_t ticks = DspLoadMeter::ticks();
+        engine->render(mixBuffer, engineFrames);
+        ticks = stageDone(DspStage::Synth, ticks);
+        loadMeter.addEngineFrames(engineFrames);
+        effects->processStereo(mixBuffer, engineFrames);
+        ticks = stageDone(DspStage::Amp, ticks);
+        if (cabinet)
+        {
+            cabinet->processStereo(mixBuffer, engineFrames);
+            ticks = stageDone(DspStage::Cabinet, ticks);
+        }
+
+        if (engine->getStartedTagCount() > 0)
+        {
+            int64_t mixed = LatencyProbe::now();
+            for (int i = 0; i < engine->getStartedTagCount() && probedCount < MAX_PROBED; i++)
+            {
+                const StartedTag &started = engine->getStartedTag(i);
+                latencyProbe.mark(started.tag, LatencyStage::Mixed, mixed);
+                probedTags[probedCount] = started.tag;
+                probedFrames[probedCount] = (int)(started.sampleTime - bufferStart);
+                probedCount++;
+            }
+        }
+
+        if (resampler)
+        {
+            resampler->process(mixBuffer, deviceBuffer, count);
+            ticks = stageDone(DspStage::Resample, ticks);
+            writeOutput(deviceBuffer, count, stream, offset, channels, format);
+        }
+        else
+        {
+            writeOutput(mixBuffer, count, stream, offset, channels, format);
+        }
+        stageDone(DspStage::Output, ticks);
+        offset += count;
+    }
+
+    if (probedCount > 0)
+    {
+        // SDL_mixer only adds its channels on top before the buffer goes to the device. The device
+        // is still playing the previous buffer, so the new one starts roughly one buffer later.
+        // Probed frames count engine time, which the resampler delays by its group delay.
+        int64_t handedOff = LatencyProbe::now();
+        int64_t bufferAhead = (int64_t)frames * 1000000000 / deviceRate;
+        int delayFrames = resampler ? resampler->getLatencyFrames() : 0;
+        for (int i = 0; i < probedCount; i++)
+        {
+            int64_t output = handedOff + bufferAhead + (int64_t)(probedFrames[i] + delayFrames) * 1000000000 / sampleRate;
+            latencyProbe.mark(probedTags[i], LatencyStage::HandedOff, handedOff);
+            latencyProbe.mark(probedTags[i], LatencyStage::Output, output);
+        }
+    }
+}
+
+Mix_Chunk *AudioManager::getNoteChunk(float frequency, float velocity)
+{
+    int key = getKeyFromFrequency(frequency);
+    if (key < 0 || key >= NOTE_SLOTS)
+        return nullptr;
+
+    int layer = velocityLayer(velocity);
+    int slot = bankSlot(key, layer);
+
+    // Straight index into the bank; render on a miss unless a pre-warm worker beats us to it
+    Mix_Chunk *chunk = noteSlots[slot].chunk.load(std::memory_order_acquire);
+    if (!chunk)
+    {
+        float pitch = SynthEngine::noteToFrequency((float)key);
+        publishChunk(slot, generateSineWave(pitch, NOTE_DURATION, NOTE_VOLUME * layerVelocity(layer)));
+        chunk = noteSlots[slot].chunk.load(std::memory_order_acquire);
+    }
+    if (chunk && chunk->allocated)
+    {
+        unlinkSlot(slot);
+        linkSlot(slot, true);
+    }
+
+    freeRetiredChunks(false);
+    trimNoteBank(slot);
+    return chunk;
+}
+
+void AudioManager::writeOutput(const float *mix, int frames, Uint8 *stream, int first, int channels, Uint16 format)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            float value = mix[i * 2 + std::min(c, 1)];
+            int index = (first + i) * channels + c;
+
+            if (format == AUDIO_F32SYS)
+            {
+                reinterpret_cast<float *>(stream)[index] = value;
+            }
+            else
+            {
+                value = std::max(-1.0f, std::min(1.0f, value));
+                reinterpret_cast<Sint16 *>(stream)[index] = (Sint16)(value * 32767);
+            }
+        }
+    }
+}
+
+bool AudioManager::makeNoteEvent(float frequency, int stringIndex, float velocity, NoteEvent &event)
+{
+    event = {};
+    event.note = SynthEngine::frequencyToNote(frequency);
+    event.velocity = std::max(0.0f, std::min(1.0f, velocity));
+    event.stringIndex = stringIndex;
+
+    if (mode == SynthMode::NoteBank)
+    {
+        Mix_Chunk *chunk = getNoteChunk(frequency, event.velocity);
+        if (!chunk)
+            return false;
+
+        // The layer carries the level up to its own velocity; the engine scales the remainder
+        event.velocity /= layerVelocity(velocityLayer(event.velocity));
+
+        if (!engine)
+        {
+            // No synth stream (unsupported device format), fall back to a mixer channel
+            Mix_PlayChannel(-1, chunk, 0);
+            return false;
+        }
+
+        // The chunk is on the nearest semitone; the engine plays it the rest of the way
+        event.detune = 100.0f * (event.note - getKeyFromFrequency(frequency));
+        event.samples = reinterpret_cast<const int16_t *>(chunk->abuf);
+        event.sampleFrames = (int)(chunk->alen / (noteBankChannels() * sizeof(Sint16)));
+        event.sampleChannels = noteBankChannels();
+    }
+    else if (mode == SynthMode::Multisample && sampleLibrary)
+    {
+        // Notes the library doesn't have fall through to the string synth
+        event.zone = sampleLibrary->find(stringIndex, (int)std::lround(event.note), event.velocity);
+        if (event.zone)
+        {
+            event.velocity = std::min(1.0f, event.velocity / event.zone->velocity);
+            event.detune = 100.0f * (event.note - event.zone->note);
+        }
+    }
+    event.tone = mode == SynthMode::Tone;
+    return engine != nullptr;
+}
+
+uint64_t AudioManager::onsetTime(int64_t eventTime)
+{
+    uint64_t next = engine->getSampleTime();
+    uint64_t onset = 0;
+    if (onsetDelay < 0.0f)
+        return next;
+
+    // Until the first callback there is no schedule to map onto
+    if (!sampleClock.toSampleTime((eventTime != 0 ? eventTime : LatencyProbe::now()) + onsetDelayNs(), onset))
+        return next;
+
+    onsetsScheduled++;
+    if (onset < next)
+    {
+        onsetsLate++;
+        return next;
+    }
+    return onset;
+}
+
+int64_t AudioManager::onsetDelayNs() const
+{
+    if (onsetDelay < 0.0f)
+        return 0;
+    double bufferSeconds = (double)bufferMonitor->getDeviceFrames() / deviceRate;
+    return (int64_t)((onsetDelay + bufferSeconds) * 1e9);
+}
+
+void AudioManager::playNote(float frequency, int stringIndex, float velocity, int64_t eventTime)
+{
+    uint32_t tag = latencyProbe.takePending();
+    sendJam(JamEventType::NoteOn, stringIndex, SynthEngine::frequencyToNote(frequency), velocity, eventTime);
+    NoteEvent event;
+    if (!makeNoteEvent(frequency, stringIndex, velocity, event))
+        return;
+
+    // Wait-free hand-off; the audio thread starts the voice on its sample
+    event.tag = tag;
+    event.timestamp = onsetTime(eventTime);
+    if (engine->queueEvent(event))
+        latencyProbe.mark(event.tag, LatencyStage::Queued, LatencyProbe::now());
+}
+
+void AudioManager::releaseNote(int stringIndex, int64_t eventTime)
+{
+    if (!engine || stringIndex < 0)
+        return;
+    sendJam(JamEventType::NoteOff, stringIndex, 0.0f, 0.0f, eventTime);
+
+    NoteEvent event = {};
+    event.type = NoteEventType::NoteOff;
+    event.stringIndex = stringIndex;
+    event.timestamp = onsetTime(eventTime);
+    engine->queueEvent(event);
+}
+
+void AudioManager::strum(const ChordVoicing &chord, StrumDirection direction, float strumSeconds, float velocity,
+                         int64_t eventTime)
+{
+    int sounding = 0;
+    for (int note : chord.notes)
+        sounding += note >= 0 ? 1 : 0;
+    if (sounding == 0)
+        return;
+
+    // Every string is queued now with its own timestamp; the engine starts each one on its exact
+    // sample, so the spread doesn't depend on the buffer size or on when this thread runs next
+    double spacing = sounding > 1 ? std::max(0.0f, strumSeconds) * sampleRate / (sounding - 1) : 0.0;
+    uint64_t start = engine ? onsetTime(eventTime) : 0;
+    int onset = 0;
+    for (int i = 0; i < Tuning::STRING_COUNT; i++)
+    {
+        int s = direction == StrumDirection::Down ? i : Tuning::STRING_COUNT - 1 - i;
+        if (chord.notes[s] < 0)
+            continue;
+
+        // The partner gets each string with its own time and spreads it the same way
+        sendJam(JamEventType::NoteOn, s, (float)chord.notes[s], velocity,
+                (eventTime != 0 ? eventTime : LatencyProbe::now()) + (int64_t)(onset * spacing * 1e9 / sampleRate));
+
+        NoteEvent event;
+        if (makeNoteEvent(SynthEngine::noteToFrequency((float)chord.notes[s]), s, velocity, event))
+        {
+            event.timestamp = start + (uint64_t)std::lround(onset * spacing);
+            engine->queueEvent(event);
+        }
+        onset++;
+    }
+}
+
+Mix_Chunk *AudioManager::generateSineWave(float frequency, float duration, float volume) const
+{
+    int samples = (int)(sampleRate * duration);
+    int toneChannels = noteBankChannels();
+    int bytes = samples * toneChannels * sizeof(Sint16);
+
+    Sint16 *buffer = new Sint16[samples * toneChannels];
+
+    // Harmonic stack, fade-out and int16 interleave in a single SIMD pass
+    ToneKernel::render(buffer, samples, toneChannels, frequency, duration, volume, sampleRate);
+
     // Create Mix_Chunk
     Mix_Chunk *chunk = new Mix_Chunk;
     chunk->allocated = 1;
@@ -89,21 +932,193 @@ Mix_Chunk *AudioManager::generateSineWave(float frequency, float duration, float
 int AudioManager::getKeyFromFrequency(float frequency)
 {
     // Convert frequency to a key for caching
-    // We'll round to nearest semitone
+    // We'll round to nearest semitone; notes between keys carry the rest as detune
     float a4 = 440.0f;
     float noteNumber = 12 * log2(frequency / a4) + 69;
     return (int)round(noteNumber);
 }
 
+void AudioManager::setAmpSettings(const AmpSettings &settings)
+{
+    if (effects)
+        effects->setSettings(settings);
+}
+
+bool AudioManager::playMidiFile(const std::string &path)
+{
+    if (!engine)
+    {
+        std::cerr << "MIDI playback needs the synth engine" << std::endl;
+        return false;
+    }
+
+    if (!sequencer)
+        sequencer = std::make_unique<Sequencer>();
+
+    if (!sequencer->open(path) || !sequencer->start(engine.get()))
+        return false;
+
+    std::cout << "Playing MIDI file: " << path << std::endl;
+    return true;
+}
+
+void AudioManager::stopMidiFile()
+{
+    if (sequencer)
+        sequencer->stop();
+}
+
+bool AudioManager::isMidiPlaying() const
+{
+    return sequencer && sequencer->isPlaying();
+}
+
+void AudioManager::sendJam(JamEventType type, int stringIndex, float value, float velocity, int64_t eventTime,
+                           float rate)
+{
+    // Only the guitar's strings travel; the partner has nowhere to put a note without one
+    if (!jam || !jam->isRunning() || stringIndex < 0 || stringIndex >= STRING_COUNT)
+        return;
+
+    JamEvent event;
+    event.type = type;
+    event.stringIndex = stringIndex;
+    event.tone = mode == SynthMode::Tone || mode == SynthMode::NoteBank;
+    event.velocity = velocity;
+    event.value = value;
+    event.rate = rate;
+    event.time = eventTime;
+    jam->send(event);
+}
+
+bool AudioManager::startJam(uint16_t localPort, const std::string &peer, float lateTarget)
+{
+    if (!engine)
+    {
+        std::cerr << "Jam mode needs the synth engine" << std::endl;
+        return false;
+    }
+
+    if (!jam)
+        jam = std::make_unique<JamSession>();
+    jam->setLateTarget(lateTarget);
+    jam->setOutputDelay(onsetDelayNs());
+    return jam->start(localPort, peer, engine.get(), &sampleClock, REMOTE_STRING);
+}
+
+void AudioManager::stopJam()
+{
+    if (jam)
+        jam->stop();
+}
+
+void AudioManager::pollJam()
+{
+    // The device buffer can change size under adaptive buffering, and the onset delay with it
+    if (jam && jam->isRunning())
+        jam->setOutputDelay(onsetDelayNs());
+}
+
+void AudioManager::printJamReport() const
+{
+    if (jam)
+        jam->report(std::cout);
+}
+
+void AudioManager::freeRetiredCabinets()
+{
+    PartitionedConvolver *retired = nullptr;
+    while (cabinetRetired.pop(retired))
+        delete retired;
+}
+
+bool AudioManager::loadCabinetIR(const std::string &path, int partitionSize)
+{
+    if (!engine)
+        return false;
+
+    freeRetiredCabinets();
+
+    auto convolver = std::make_unique<PartitionedConvolver>(partitionSize);
+    if (!convolver->loadImpulseResponse(path, sampleRate))
+    {
+        std::cerr << "AudioManager: could not load cabinet IR " << path << std::endl;
+        return false;
+    }
+
+    int partition = convolver->getPartitionSize();
+    int length = convolver->getLength();
+    if (!cabinetIncoming.push(convolver.get()))
+    {
+        std::cerr << "AudioManager: cabinet change already pending, try again" << std::endl;
+        return false;
+    }
+    convolver.release();
+
+    std::cout << "Cabinet IR " << path << ": " << length << " taps, partition " << partition << ", latency "
+              << 1000.0 * partition / sampleRate << " ms" << std::endl;
+    return true;
+}
+
+void AudioManager::clearCabinetIR()
+{
+    if (!engine)
+        return;
+
+    freeRetiredCabinets();
+
+    // An empty convolver passes the signal through untouched
+    PartitionedConvolver *bypass = new PartitionedConvolver();
+    if (!cabinetIncoming.push(bypass))
+        delete bypass;
+}
+
 void AudioManager::cleanup()
 {
-    for (auto &pair : noteChunks)
+    // The sequencer and jam threads queue into the engine, so they have to stop first
+    sequencer.reset();
+    jam.reset();
+
+    if (musicHooked)
     {
-        if (pair.second)
-        {
-            delete[] pair.second->abuf;
-            delete pair.second;
-        }
+        // Blocks until the callback has finished, so the engine can be released safely
+        Mix_HookMusic(nullptr, nullptr);
+        musicHooked = false;
+    }
+    engine.reset();
+    effects.reset();
+
+    // No voice is left to read a ring or point at a zone
+    streamer.reset();
+    sampleLibrary.reset();
+
+    // With the hook gone, the cabinet and anything still in flight belong to us again
+    delete cabinet;
+    cabinet = nullptr;
+    PartitionedConvolver *pending = nullptr;
+    while (cabinetIncoming.pop(pending))
+        delete pending;
+    freeRetiredCabinets();
+
+    // Stop the pre-warm before freeing anything it might still be writing
+    if (prewarmPool)
+    {
+        prewarmPool->cancelPending();
+        prewarmPool.reset();
+    }
+    for (auto &slot : noteSlots)
+    {
+        freeChunk(slot.chunk.exchange(nullptr));
+        slot.listed = false;
+        slot.older = -1;
+        slot.newer = -1;
     }
-    noteChunks.clear();
+    oldestSlot = -1;
+    newestSlot = -1;
+    noteBankPublished.store(0);
+    noteBankListed = 0;
+    freeRetiredChunks(true);
+    noteBankHeapBytes.store(0);
+    noteCache.close();
+    noteBankReady.store(false);
 }
\ No newline at end of file
@@ -1,23 +1,298 @@
 #pragma once
 #include <SDL2/SDL_mixer.h>
-#include <map>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <iostream>
+#include "SynthEngine.h"
+#include "EffectChain.h"
+#include "Convolver.h"
+#include "NoteBankCache.h"
+#include "LatencyProbe.h"
+#include "AdaptiveBuffer.h"
+#include "SampleClock.h"
+#include "DspLoadMeter.h"
+#include "Resampler.h"
+#include "Chords.h"
+#include "JamSession.h"
+
+class WorkerPool;
+class Sequencer;
+class SampleLibrary;
+class DiskStreamer;
+
+enum class SynthMode
+{
+    Streaming, // Karplus-Strong strings rendered in the audio callback
+    NoteBank,  // Pre-rendered harmonic tones mixed into the same callback
+    Tone,      // The note-bank tone synthesized per voice with an ADSR; held notes sustain
+    Multisample // Recorded zones from a sample library, streamed from disk; strings where it has none
+};
 
 class AudioManager
 {
 private:
-    std::map<int, Mix_Chunk *> noteChunks;
-    int sampleRate;
+    int sampleRate; // the engine's rate; differs from the device's only with a fixed engine rate
+    int deviceRate;
+    bool fixedEngineRate;
     int channels;
+    Uint16 format;
+
+    // Tuning used to work out which notes the fretboard can reach
+    std::vector<float> tuning;
+    int fretCount;
+
+    // Flat note bank: one slot per MIDI note and velocity layer, indexed directly.
+    // Chunks are published by whichever thread rendered them first (pre-warm worker or
+    // playNote); recency and eviction belong to the main thread.
+    static const int NOTE_SLOTS = 128;
+    static const int VELOCITY_LAYERS = 4;
+    static const int BANK_SLOTS = NOTE_SLOTS * VELOCITY_LAYERS;
+    struct NoteSlot
+    {
+        std::atomic<Mix_Chunk *> chunk;
+        bool listed; // in the recency list below
+        int older;   // neighbours in the recency list, -1 at either end
+        int newer;
+    };
+    NoteSlot noteSlots[BANK_SLOTS];
+
+    // Rendered layers from least to most recently played; never-played ones join at the old end
+    // the first time eviction looks, so they go first. Mapped cache layers are never listed.
+    int oldestSlot;
+    int newestSlot;
+    std::atomic<uint32_t> noteBankPublished; // rendered layers published so far, by any thread
+    uint32_t noteBankListed;                 // noteBankPublished when the list last took them in
+
+    // Optional footprint limit; the least recently played layers are evicted past it.
+    // An evicted chunk may still be sounding or being written to the cache, so it is only freed once
+    // both have surely finished.
+    struct RetiredChunk
+    {
+        Mix_Chunk *chunk;
+        std::chrono::steady_clock::time_point freeAfter;
+    };
+    std::atomic<size_t> noteBankBudget; // bytes, 0 = unlimited
+    std::atomic<size_t> noteBankHeapBytes;
+    std::vector<RetiredChunk> retiredChunks;
+    uint32_t noteBankEvictions;
+
+    static int bankSlot(int key, int layer) { return key * VELOCITY_LAYERS + layer; }
+    static int velocityLayer(float velocity);
+    static float layerVelocity(int layer) { return (layer + 1) / (float)VELOCITY_LAYERS; }
+    // withinBudget: refuse a rendered chunk that would take the bank past its budget
+    bool publishChunk(int slot, Mix_Chunk *chunk, bool withinBudget = false);
+    void linkSlot(int slot, bool newest);
+    void unlinkSlot(int slot);
+    void listPublishedSlots();
+    void trimNoteBank(int keepSlot);
+    void freeRetiredChunks(bool all);
+    static void freeChunk(Mix_Chunk *chunk);
+
+    // Background pre-warm of every layer of every reachable note
+    std::unique_ptr<WorkerPool> prewarmPool;
+    std::atomic<int> prewarmRemaining;
+    std::atomic<int> prewarmSkipped; // layers left to render on demand because the budget was full
+    std::atomic<bool> noteBankReady;
+    std::atomic<bool> noteBankSaving; // a worker is writing the cache from the chunks; retired ones wait
+    std::chrono::steady_clock::time_point prewarmStart;
+
+    // Memory-mapped note bank from a previous run; chunks point straight into the mapping
+    NoteBankCache noteCache;
+    Mix_Chunk mappedChunks[BANK_SLOTS];
+    std::string noteCachePath;
+
+    // Tones are stored mono for the synth, which pans them at mix; only the mixer-channel
+    // fallback needs them in the device layout
+    int noteBankChannels() const { return engine ? 1 : channels; }
+
+    void makeNoteBankParams(NoteBankParams &params) const;
+    bool loadNoteBankCache();
+    void saveNoteBankCache();
+
+    SynthMode mode;
+    std::unique_ptr<SynthEngine> engine;
+    std::unique_ptr<EffectChain> effects; // amp after the voice mix
+    bool musicHooked;
+
+    // Multisample library; zones are shared with the voices and the disk thread until cleanup
+    std::unique_ptr<SampleLibrary> sampleLibrary;
+    std::unique_ptr<DiskStreamer> streamer;
+
+    // Cabinet IR after the amp. A loaded convolver is handed to the audio thread, and the one
+    // it replaces comes back on the second queue to be freed off the audio thread.
+    PartitionedConvolver *cabinet; // owned by the audio thread while the hook is active
+    SpscQueue<PartitionedConvolver *, 8> cabinetIncoming;
+    SpscQueue<PartitionedConvolver *, 8> cabinetRetired;
+    void freeRetiredCabinets();
+
+    // Click-to-sound timing; stamped by the main thread and finished in the callback
+    LatencyProbe latencyProbe;
+
+    // Input events start their notes a fixed delay after they happened, on the matching sample,
+    // so the spacing of fast clicks survives polling and buffering. The delay is one device
+    // buffer plus onsetDelay; events that still arrive too late start at the next block.
+    SampleClock sampleClock;
+    float onsetDelay; // seconds; negative starts every note at the next block
+    uint32_t onsetsScheduled;
+    uint32_t onsetsLate;
+    uint64_t onsetTime(int64_t eventTime);
+    int64_t onsetDelayNs() const; // from the event to its sample, 0 when notes start at the next block
+
+    // Callback time against its budget, per stage and per voice kind. Overloads are logged by
+    // pollLoadMeter, at most once a second, so a struggling machine isn't also flooding the console.
+    DspLoadMeter loadMeter;
+    int64_t lastOverloadLog;
+    uint32_t pendingOverloads;
+    DspOverload worstOverload;
+
+    // Low-latency mode: the callback is timed and the device reopened with a bigger or
+    // smaller buffer when it glitches or has been clean for long enough
+    std::unique_ptr<AdaptiveBuffer> bufferMonitor;
+    bool adaptiveBuffer;
+    bool reopenDevice(int bufferFrames);
+
+    // Standard MIDI File playback, fed to the engine from its own thread
+    std::unique_ptr<Sequencer> sequencer;
+
+    // Jam partner over UDP: local notes go out as they are played, theirs come in on strings of their own
+    std::unique_ptr<JamSession> jam;
+    void sendJam(JamEventType type, int stringIndex, float value, float velocity, int64_t eventTime, float rate = 0.0f);
+
+    // Callback renders in small fixed blocks so no allocation happens on the audio thread
+    static const int BLOCK_FRAMES = 256;
+    float mixBuffer[BLOCK_FRAMES * 2];
+
+    // Engine rate to device rate when they differ. A block is then fewer device frames, so the
+    // engine frames the resampler needs for it still fit in BLOCK_FRAMES.
+    std::unique_ptr<Resampler> resampler;
+    float deviceBuffer[BLOCK_FRAMES * 2];
+    int deviceBlockFrames;
+
+    // Fills in a note for the engine; false when there is nothing to queue (no engine, or the
+    // note-bank tone went straight to a mixer channel)
+    bool makeNoteEvent(float frequency, int stringIndex, float velocity, NoteEvent &event);
 
-    Mix_Chunk *generateSineWave(float frequency, float duration, float volume = 0.5f);
+    Mix_Chunk *generateSineWave(float frequency, float duration, float volume = 0.5f) const;
     int getKeyFromFrequency(float frequency);
 
+    static void audioCallback(void *userdata, Uint8 *stream, int len);
+    uint64_t stageDone(DspStage stage, uint64_t started); // audio thread; returns the stage's end
+    void fillStream(Uint8 *stream, int len);
+
 public:
-    AudioManager();
+    static const int STRING_COUNT = 6;
+    static const int REMOTE_STRING = STRING_COUNT; // the jam partner's strings follow ours in the engine
+    static constexpr float NOTE_DURATION = 0.8f; // seconds per note-bank tone
+    static constexpr float NOTE_VOLUME = 0.5f;
+    static constexpr float DEFAULT_STRUM_SECONDS = 0.03f; // first to last string of a strum
+    static constexpr float DEFAULT_ONSET_DELAY = 0.02f;   // past one buffer; covers a display frame of polling
+
+    // engineRate 0 runs the engine at whatever rate the device opened with; any other rate is
+    // kept and converted to the device's in the callback
+    explicit AudioManager(int engineRate = 0);
     ~AudioManager();
 
     bool initialize();
-    void playNote(float frequency);
+    // Velocity picks the nearest layer at or above it; the engine scales the rest of the way.
+    // eventTime is when the input happened (LatencyProbe::now() clock), 0 for now.
+    void playNote(float frequency, int stringIndex = -1, float velocity = 1.0f, int64_t eventTime = 0);
+
+    // Note-off for whatever the string is playing; it fades out over its envelope's release
+    void releaseNote(int stringIndex, int64_t eventTime = 0);
+
+    // Every string of a chord in one batch, each onset offset by a sample-exact share of strumSeconds
+    void strum(const ChordVoicing &chord, StrumDirection direction, float strumSeconds = DEFAULT_STRUM_SECONDS,
+               float velocity = 1.0f, int64_t eventTime = 0);
+
+    void setOnsetDelay(float seconds) { onsetDelay = seconds; }
+    float getOnsetDelay() const { return onsetDelay; }
+
+    // Main thread: the bank tone for a note and velocity, rendered on a miss and marked as just played
+    Mix_Chunk *getNoteChunk(float frequency, float velocity);
+
+    // Base frequency of each string (low to high) and the number of frets
+    void setTuning(const std::vector<float> &baseFrequencies, int frets);
+
+    // Render every note reachable from the tuning on a worker pool without blocking the caller.
+    // With a cache path, a matching bank file is mapped instead and a stale one is rebuilt.
+    void prewarmNoteBank(const std::string &cachePath = "");
+    bool isNoteBankReady() const { return noteBankReady.load(); }
+
+    // Cap on rendered (heap) note-bank memory; 0 removes the cap. Mapped cache files don't count.
+    // Pre-warm stops filling the bank at the cap; the rest renders on demand, evicting as it goes.
+    void setNoteBankBudget(size_t bytes);
+    size_t getNoteBankBytes() const { return noteBankHeapBytes.load(); }
+    uint32_t getNoteBankEvictions() const { return noteBankEvictions; }
+    void setSynthMode(SynthMode newMode) { mode = newMode; }
+    SynthMode getSynthMode() const { return mode; }
+
+    // Reads a multisample manifest against the current tuning and switches to Multisample mode.
+    // Call after initialize() and before playing; headSeconds of every zone stay in memory.
+    bool loadSampleLibrary(const std::string &manifestPath, float headSeconds);
+
+    // Envelope shape for new voices of a kind (strings, note-bank buffers or live tones)
+    void setEnvelope(VoiceKind kind, const EnvelopeSettings &settings);
+
+    // Pitch modulation in cents of notes already playing; cheap enough to call on every mouse move.
+    // Bend and vibrato follow the string, the whammy bends everything that sounds.
+    void setBend(int stringIndex, float cents);
+    void setVibrato(int stringIndex, float depthCents, float rateHz = SynthEngine::DEFAULT_VIBRATO_RATE);
+    void setWhammy(float cents);
+
+    // Voice pool sizing; each string is monophonic on top of this limit
+    void setMaxVoices(int maxVoices);
+    void setStealPolicy(VoiceStealPolicy policy);
+    int getMaxVoices() const;
+    uint32_t getVoicesStolen() const { return engine ? engine->getVoicesStolen() : 0; }
+    uint32_t getVoicesDropped() const { return engine ? engine->getVoicesDropped() : 0; }
+    void printVoiceStats() const;
+
+    int getSampleRate() const { return sampleRate; }
+    int getDeviceRate() const { return deviceRate; }
+    bool isResampling() const { return resampler != nullptr; }
+
+    LatencyProbe &getLatencyProbe() { return latencyProbe; }
+
+    // Start resizing the device buffer at runtime; bufferFrames is what main opened it with
+    void enableAdaptiveBuffer(int bufferFrames);
+    // Main thread, once per frame: applies a pending buffer size change
+    void updateBufferSize();
+    void printBufferStats() const;
+    void printLatencyReport() const;
+
+    // Main thread, once per frame: logs callbacks that went over the load threshold
+    void pollLoadMeter();
+    const DspLoadMeter &getLoadMeter() const { return loadMeter; }
+    void setLoadThreshold(float load) { loadMeter.setThreshold(load); }
+    void printLoadReport() const { loadMeter.report(std::cout); }
+
+    // Interleaved stereo float mix to the device layout and sample format, from frame `first` of the stream
+    static void writeOutput(const float *mix, int frames, Uint8 *stream, int first, int channels, Uint16 format);
+
+    // Amp/overdrive chain on the synth output; safe to change while playing
+    void setAmpSettings(const AmpSettings &settings);
+    AmpSettings getAmpSettings() const { return effects ? effects->getSettings() : AmpSettings(); }
+
+    // Speaker cabinet impulse response (WAV); loads on the calling thread and swaps in glitch-free.
+    // Output is delayed by one partition, so smaller partitions trade CPU for latency.
+    bool loadCabinetIR(const std::string &path, int partitionSize = PartitionedConvolver::DEFAULT_PARTITION);
+    void clearCabinetIR();
+
+    // Play a Standard MIDI File on the strings alongside live input
+    bool playMidiFile(const std::string &path);
+    void stopMidiFile();
+    bool isMidiPlaying() const;
+
+    // Jam with another instance: listen on localPort and exchange notes with peer ("host:port").
+    // lateTarget is the share of the partner's notes allowed to miss the jitter buffer.
+    bool startJam(uint16_t localPort, const std::string &peer, float lateTarget = JamSession::DEFAULT_LATE_TARGET);
+    void stopJam();
+    // Main thread, once per frame: keeps the partner's notes on the same delay as ours
+    void pollJam();
+    void printJamReport() const;
+
     void cleanup();
-};
\ No newline at end of file
+};
@@ -0,0 +1,91 @@
+#include "Benchmark.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Every allocation in GuitarBench goes through here, so the embed suite can show that rendering
+// never touches the heap
+static std::atomic<long> allocations(0);
+
+static long countAllocations()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// Headless benchmark runner: no window, OpenGL or audio device. Besides the DSP micro-benchmarks
+// and the voice stress test it runs the suites ElectricGuitar3D has behind its --bench-* flags.
+// With --json, dsp and stress print one JSON object for tracking results between builds.
+int main(int argc, char *argv[])
+{
+    benchAllocationCount = countAllocations;
+
+    std::string suite = argc > 1 ? argv[1] : "";
+    if (suite == "dsp")
+    {
+        return runDspBenchmark(argc, argv);
+    }
+    if (suite == "stress")
+    {
+        return runVoiceStressTest(argc, argv);
+    }
+    if (suite == "fx")
+    {
+        return runEffectBenchmark(argc, argv);
+    }
+    if (suite == "conv")
+    {
+        return runConvolutionBenchmark(argc, argv);
+    }
+    if (suite == "notes")
+    {
+        return runNoteBankBenchmark(argc, argv);
+    }
+    if (suite == "resample")
+    {
+        return runResamplerBenchmark(argc, argv);
+    }
+    if (suite == "onset")
+    {
+        return runOnsetJitterTest(argc, argv);
+    }
+    if (suite == "embed")
+    {
+        return runEmbedTest(argc, argv);
+    }
+    if (suite == "jam")
+    {
+        return runJamTest(argc, argv);
+    }
+    if (suite == "stream")
+    {
+        return runStreamTest(argc, argv);
+    }
+    if (suite == "transcribe")
+    {
+        return runTranscribeTest(argc, argv);
+    }
+
+    std::cerr << "Usage: " << (argc > 0 ? argv[0] : "GuitarBench") << " dsp|stress|fx|conv|notes|resample|onset|embed|jam|stream|transcribe [options]"
+              << std::endl;
+    return 1;
+}
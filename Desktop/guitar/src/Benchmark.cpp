@@ -0,0 +1,3041 @@
+#include "Benchmark.h"
+#include "AudioManager.h"
+#include "Convolver.h"
+#include "CpuFeatures.h"
+#include "DiskStreamer.h"
+#include "EffectChain.h"
+#include "FlacFile.h"
+#include "GuitarSynth.h"
+#include "JamSession.h"
+#include "Resampler.h"
+#include "SampleClock.h"
+#include "SampleLibrary.h"
+#include "SynthEngine.h"
+#include "ToneKernel.h"
+#include "Transcriber.h"
+#include "Tuning.h"
+#include "WavFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+long (*benchAllocationCount)() = nullptr;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Driven amp settings used by every test, so the shaper is working hard
+static AmpSettings benchAmpSettings(int oversampling)
+{
+    AmpSettings settings;
+    settings.enabled = true;
+    settings.drive = 30.0f;
+    settings.oversampling = oversampling;
+    return settings;
+}
+
+// A few seconds of strummed strings, as interleaved stereo
+static std::vector<float> renderStringMix(int sampleRate, double seconds)
+{
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT);
+    int frames = (int)(seconds * sampleRate);
+    std::vector<float> mix(frames * 2);
+
+    const int block = 256;
+    for (int offset = 0; offset < frames; offset += block)
+    {
+        if (offset % (sampleRate / 2) < block)
+        {
+            for (int s = 0; s < Tuning::STRING_COUNT; s++)
+                engine.noteOn(s, Tuning::STANDARD_FREQUENCIES[s] * std::pow(2.0f, (offset / block % 5) / 12.0f));
+        }
+        engine.render(mix.data() + offset * 2, std::min(block, frames - offset));
+    }
+    return mix;
+}
+
+static bool checkPathParity(int sampleRate)
+{
+    std::vector<float> input = renderStringMix(sampleRate, 2.0);
+    std::vector<float> reference = input;
+
+    EffectChain scalar(sampleRate);
+    scalar.setPath(EffectChain::Path::Scalar);
+    scalar.setSettings(benchAmpSettings(8));
+    scalar.processStereo(reference.data(), (int)reference.size() / 2);
+
+    bool passed = true;
+    const EffectChain::Path paths[] = {EffectChain::Path::SSE2, EffectChain::Path::AVX2};
+    for (EffectChain::Path path : paths)
+    {
+        if (!EffectChain::isPathSupported(path))
+        {
+            std::cout << "  " << EffectChain::pathName(path) << ": not supported on this CPU, skipped" << std::endl;
+            continue;
+        }
+
+        std::vector<float> output = input;
+        EffectChain chain(sampleRate);
+        chain.setPath(path);
+        chain.setSettings(benchAmpSettings(8));
+        chain.processStereo(output.data(), (int)output.size() / 2);
+
+        float worst = 0.0f;
+        for (size_t i = 0; i < output.size(); i++)
+            worst = std::max(worst, std::fabs(output[i] - reference[i]));
+
+        // Only summation order differs, so the paths agree to well below 16-bit resolution
+        bool ok = worst < 1e-4f;
+        passed = passed && ok;
+        std::cout << "  " << EffectChain::pathName(path) << " vs scalar: max diff " << worst
+                  << (ok ? " OK" : " FAILED") << std::endl;
+    }
+    return passed;
+}
+
+// Energy that is not at a harmonic of the test tone, relative to the total, in dB
+static double measureAliasing(int sampleRate, int oversampling)
+{
+    const double frequency = 4500.0; // whole number of cycles per second, so harmonics land on exact bins
+    const int warmup = sampleRate / 2;
+    const int frames = sampleRate; // one-second window: 1 Hz bins
+
+    std::vector<float> signal(warmup + frames);
+    for (size_t i = 0; i < signal.size(); i++)
+        signal[i] = 0.5f * (float)std::sin(2.0 * M_PI * frequency * i / sampleRate);
+
+    EffectChain chain(sampleRate);
+    chain.setSettings(benchAmpSettings(oversampling));
+    chain.process(signal.data(), (int)signal.size());
+    const float *x = signal.data() + warmup;
+
+    double total = 0.0;
+    for (int i = 0; i < frames; i++)
+        total += (double)x[i] * x[i];
+
+    // Goertzel at DC and every harmonic below Nyquist
+    double harmonic = 0.0;
+    for (double f = 0.0; f < sampleRate * 0.5; f += frequency)
+    {
+        double coeff = 2.0 * std::cos(2.0 * M_PI * f / sampleRate);
+        double s1 = 0.0, s2 = 0.0;
+        for (int i = 0; i < frames; i++)
+        {
+            double s0 = x[i] + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        double power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+        harmonic += (f == 0.0 ? 1.0 : 2.0) * power / frames;
+    }
+
+    double alias = std::max(total - harmonic, total * 1e-12);
+    return 10.0 * std::log10(alias / total);
+}
+
+struct BlockTimes
+{
+    double min;
+    double mean;
+    double p99;
+    double p999;
+    double max;
+    double averageVoices;
+};
+
+static BlockTimes summarizeTimes(std::vector<double> &times)
+{
+    BlockTimes result = {};
+    double sum = 0.0;
+    for (double t : times)
+        sum += t;
+    result.mean = sum / times.size();
+
+    std::sort(times.begin(), times.end());
+    result.min = times.front();
+    result.p99 = times[(size_t)(times.size() * 0.99)];
+    result.p999 = times[(size_t)(times.size() * 0.999)];
+    result.max = times.back();
+    return result;
+}
+
+// Synth + amp exactly as the audio callback runs them, with the voice pool kept full
+static BlockTimes timeCallback(int sampleRate, int blockFrames, int voices, double seconds,
+                               EffectChain::Path path, int oversampling)
+{
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT, voices);
+    EffectChain chain(sampleRate);
+    chain.setPath(path);
+    chain.setSettings(benchAmpSettings(oversampling));
+
+    std::vector<float> buffer(blockFrames * 2);
+    int blocks = (int)(seconds * sampleRate / blockFrames);
+    int warmupBlocks = sampleRate / 2 / blockFrames;
+    std::vector<double> times;
+    times.reserve(blocks);
+    double voiceSum = 0.0;
+    int note = 0;
+
+    for (int b = 0; b < warmupBlocks + blocks; b++)
+    {
+        // Unowned voices (string -1) so the pool, not string monophony, is the limit
+        for (int active = engine.getActiveVoices(); active < voices; active++)
+        {
+            engine.noteOn(-1, Tuning::STANDARD_FREQUENCIES[0] * std::pow(2.0f, (note % 24) / 12.0f), 0.8f);
+            note += 7;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        engine.render(buffer.data(), blockFrames);
+        chain.processStereo(buffer.data(), blockFrames);
+        auto end = std::chrono::steady_clock::now();
+
+        if (b >= warmupBlocks)
+        {
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            voiceSum += engine.getActiveVoices();
+        }
+    }
+
+    BlockTimes result = summarizeTimes(times);
+    result.averageVoices = voiceSum / times.size();
+    return result;
+}
+
+int runEffectBenchmark(int argc, char *argv[])
+{
+    int sampleRate = 44100;
+    int blockFrames = 128;
+    int voices = 16;
+    double seconds = 10.0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--voices" && i + 1 < argc)
+            voices = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+    }
+
+    if (blockFrames < 16 || voices < 1 || voices > SynthEngine::VOICE_CAPACITY || seconds <= 0.0 || sampleRate < 8000)
+    {
+        std::cerr << "Usage: " << argv[0] << " --bench-fx [--frames N] [--voices 1-"
+                  << SynthEngine::VOICE_CAPACITY << "] [--seconds S] [--rate N]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Amp chain path parity (8x oversampling):" << std::endl;
+    bool passed = checkPathParity(sampleRate);
+
+    std::cout << "Aliasing, 4.5 kHz sine at +30 dB drive (energy off the harmonics):" << std::endl;
+    const int factors[] = {1, 4, 8};
+    for (int factor : factors)
+        std::cout << "  " << factor << "x: " << measureAliasing(sampleRate, factor) << " dB" << std::endl;
+
+    const double deadline = 1e6 * blockFrames / sampleRate;
+    std::cout << "Callback time, " << blockFrames << " frames (" << deadline << " us deadline), "
+              << voices << " voices:" << std::endl;
+
+    const EffectChain::Path paths[] = {EffectChain::Path::Scalar, EffectChain::Path::SSE2, EffectChain::Path::AVX2};
+    const EffectChain::Path best = EffectChain::bestPath();
+    for (EffectChain::Path path : paths)
+    {
+        if (!EffectChain::isPathSupported(path))
+            continue;
+
+        for (int factor : {4, 8})
+        {
+            BlockTimes t = timeCallback(sampleRate, blockFrames, voices, seconds, path, factor);
+
+            // Judge on the 99.9th percentile: the max also catches scheduler noise from the rest of the system
+            bool ok = t.p999 < deadline;
+            if (path == best)
+                passed = passed && ok;
+
+            std::cout << "  " << EffectChain::pathName(path) << " " << factor << "x: mean " << t.mean
+                      << " us, p99 " << t.p99 << " us, p99.9 " << t.p999 << " us, max " << t.max
+                      << " us, load " << 100.0 * t.mean / deadline << "%, voices " << t.averageVoices
+                      << (ok ? " OK" : " OVER DEADLINE") << std::endl;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
+
+// Exponentially decaying noise, the rough shape of a cabinet or room response
+static std::vector<float> syntheticImpulse(int length)
+{
+    std::mt19937 random(1234u);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    std::vector<float> ir(length);
+    const double decay = 6.9 / length; // -60 dB by the last tap
+    for (int i = 0; i < length; i++)
+        ir[i] = noise(random) * (float)std::exp(-decay * i);
+    ir[0] = 1.0f;
+    return ir;
+}
+
+static std::vector<float> noiseSignal(int frames, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    std::vector<float> signal(frames);
+    for (float &value : signal)
+        value = noise(random);
+    return signal;
+}
+
+// Worst error against a direct convolution of the same input, after removing the partition delay
+static float checkConvolver(const std::vector<float> &ir, int partition, int frames)
+{
+    PartitionedConvolver convolver(partition);
+    convolver.setImpulseResponse(ir.data(), (int)ir.size());
+    const int latency = convolver.getLatencyFrames();
+
+    std::vector<float> input = noiseSignal(frames, 99u);
+    std::vector<float> output(frames + latency, 0.0f);
+    std::copy(input.begin(), input.end(), output.begin());
+
+    // Uneven callback sizes, so the FIFO is exercised across partition boundaries
+    int offset = 0;
+    for (int block = 37; offset < (int)output.size(); block = block * 7 % 509 + 1)
+    {
+        int count = std::min(block, (int)output.size() - offset);
+        convolver.process(output.data() + offset, count);
+        offset += count;
+    }
+
+    float worst = 0.0f;
+    for (int n = 0; n < frames; n++)
+    {
+        double expected = 0.0;
+        int taps = std::min(n + 1, (int)ir.size());
+        for (int k = 0; k < taps; k++)
+            expected += (double)ir[k] * input[n - k];
+        worst = std::max(worst, (float)std::fabs(expected - output[n + latency]));
+    }
+    return worst;
+}
+
+// Convolver alone, called exactly like the audio callback does
+static BlockTimes timeConvolver(const std::vector<float> &ir, int partition, int blockFrames, int sampleRate,
+                                double seconds)
+{
+    PartitionedConvolver convolver(partition);
+    convolver.setImpulseResponse(ir.data(), (int)ir.size());
+
+    std::vector<float> source = noiseSignal(sampleRate * 2, 7u);
+    std::vector<float> buffer(blockFrames * 2);
+    int blocks = (int)(seconds * sampleRate / blockFrames);
+    int warmupBlocks = std::max(sampleRate / 2, 2 * partition) / blockFrames;
+    std::vector<double> times;
+    times.reserve(blocks);
+    size_t position = 0;
+
+    for (int b = 0; b < warmupBlocks + blocks; b++)
+    {
+        for (int i = 0; i < blockFrames; i++)
+        {
+            buffer[i * 2] = buffer[i * 2 + 1] = source[position];
+            position = (position + 1) % source.size();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        convolver.processStereo(buffer.data(), blockFrames);
+        auto end = std::chrono::steady_clock::now();
+
+        if (b >= warmupBlocks)
+            times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    return summarizeTimes(times);
+}
+
+// Time-domain convolution cost per callback, measured on a short run and scaled
+static double timeDirectConvolution(const std::vector<float> &ir, int blockFrames)
+{
+    const int frames = 2048;
+    std::vector<float> input = noiseSignal(frames + (int)ir.size(), 5u);
+    volatile float sink = 0.0f;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < frames; n++)
+    {
+        const float *x = input.data() + ir.size() + n;
+        float sum = 0.0f;
+        for (size_t k = 0; k < ir.size(); k++)
+            sum += ir[k] * x[-(ptrdiff_t)k];
+        sink = sink + sum;
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() * blockFrames / frames;
+}
+
+int runConvolutionBenchmark(int argc, char *argv[])
+{
+    int sampleRate = 44100;
+    int blockFrames = 128;
+    double seconds = 5.0;
+    std::string irPath;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--ir" && i + 1 < argc)
+            irPath = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+    }
+
+    if (blockFrames < 16 || seconds <= 0.0 || sampleRate < 8000)
+    {
+        std::cerr << "Usage: " << argv[0] << " --bench-conv [--ir cabinet.wav] [--frames N] [--seconds S] [--rate N]"
+                  << std::endl;
+        return 1;
+    }
+
+    struct Impulse
+    {
+        std::string name;
+        std::vector<float> taps;
+    };
+    std::vector<Impulse> impulses;
+
+    if (!irPath.empty())
+    {
+        // Go through the same loader the app uses, then take its taps back out
+        PartitionedConvolver loader(PartitionedConvolver::MIN_PARTITION);
+        if (!loader.loadImpulseResponse(irPath, sampleRate))
+            return 1;
+
+        std::vector<float> taps(loader.getLength() + loader.getLatencyFrames(), 0.0f);
+        taps[0] = 1.0f;
+        loader.process(taps.data(), (int)taps.size());
+        taps.erase(taps.begin(), taps.begin() + loader.getLatencyFrames());
+        impulses.push_back({irPath, taps});
+    }
+    else
+    {
+        impulses.push_back({"synthetic 200 ms", syntheticImpulse(sampleRate / 5)});
+        impulses.push_back({"synthetic 2 s", syntheticImpulse(sampleRate * 2)});
+    }
+
+    const int partitions[] = {64, 128, 256, 512, 1024, 2048, 4096};
+    const double deadline = 1e6 * blockFrames / sampleRate;
+    bool passed = true;
+
+    std::cout << "Partitioned convolution vs direct (" << impulses[0].name << ", "
+              << impulses[0].taps.size() << " taps):" << std::endl;
+    for (int partition : partitions)
+    {
+        float worst = checkConvolver(impulses[0].taps, partition, sampleRate / 2);
+        bool ok = worst < 1e-4f;
+        passed = passed && ok;
+        std::cout << "  partition " << partition << ": max diff " << worst << (ok ? " OK" : " FAILED") << std::endl;
+    }
+
+    for (const Impulse &impulse : impulses)
+    {
+        std::cout << "Callback time, " << impulse.name << " (" << impulse.taps.size() << " taps), " << blockFrames
+                  << " frames (" << deadline << " us deadline):" << std::endl;
+
+        double direct = timeDirectConvolution(impulse.taps, blockFrames);
+        std::cout << "  direct: " << direct << " us, load " << 100.0 * direct / deadline << "%" << std::endl;
+
+        for (int partition : partitions)
+        {
+            BlockTimes t = timeConvolver(impulse.taps, partition, blockFrames, sampleRate, seconds);
+
+            // A partition longer than the callback does all its work in one callback out of several,
+            // so the max, not the mean, decides whether it fits
+            std::cout << "  partition " << partition << ": latency " << 1000.0 * partition / sampleRate
+                      << " ms, mean " << t.mean << " us, p99.9 " << t.p999 << " us, max " << t.max << " us, load "
+                      << 100.0 * t.mean / deadline << "%, peak " << 100.0 * t.p999 / deadline << "%"
+                      << (t.p999 < deadline ? "" : " OVER DEADLINE") << std::endl;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
+
+// Every note the fretboard can reach, rendered in one channel layout
+static std::map<int, std::vector<int16_t>> renderNoteBank(int sampleRate, int channels)
+{
+    const float duration = 0.8f;
+    const int frames = (int)(sampleRate * duration);
+    std::map<int, std::vector<int16_t>> bank;
+    for (float base : Tuning::STANDARD_FREQUENCIES)
+    {
+        for (int fret = 0; fret <= 12; fret++)
+        {
+            float frequency = base * std::pow(2.0f, fret / 12.0f);
+            int key = (int)std::lround(SynthEngine::frequencyToNote(frequency));
+            if (bank.count(key))
+                continue;
+
+            std::vector<int16_t> &samples = bank[key];
+            samples.resize((size_t)frames * channels);
+            ToneKernel::render(samples.data(), frames, channels, frequency, duration, 0.5f, sampleRate);
+        }
+    }
+    return bank;
+}
+
+static size_t bankBytes(const std::map<int, std::vector<int16_t>> &bank)
+{
+    size_t bytes = 0;
+    for (const auto &note : bank)
+        bytes += note.second.size() * sizeof(int16_t);
+    return bytes;
+}
+
+static void startBankNote(SynthEngine &engine, const std::vector<int16_t> &samples, int channels, int stringIndex)
+{
+    NoteEvent event = {};
+    event.velocity = 1.0f;
+    event.stringIndex = stringIndex;
+    event.timestamp = engine.getSampleTime();
+    event.samples = samples.data();
+    event.sampleFrames = (int)samples.size() / channels;
+    event.sampleChannels = channels;
+    engine.queueEvent(event);
+}
+
+// Engine mix of the same notes from both layouts, with every string centred so they must agree
+static float checkNoteBankParity(int sampleRate, const std::map<int, std::vector<int16_t>> &stereo,
+                                 const std::map<int, std::vector<int16_t>> &mono)
+{
+    SynthEngine stereoEngine(sampleRate, Tuning::STRING_COUNT);
+    SynthEngine monoEngine(sampleRate, Tuning::STRING_COUNT);
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        stereoEngine.setStringPan(s, 0.0f);
+        monoEngine.setStringPan(s, 0.0f);
+    }
+
+    auto stereoNote = stereo.begin();
+    auto monoNote = mono.begin();
+    for (int s = 0; s < Tuning::STRING_COUNT && stereoNote != stereo.end(); s++, stereoNote++, monoNote++)
+    {
+        startBankNote(stereoEngine, stereoNote->second, 2, s);
+        startBankNote(monoEngine, monoNote->second, 1, s);
+    }
+
+    const int frames = sampleRate;
+    std::vector<float> a(frames * 2), b(frames * 2);
+    stereoEngine.render(a.data(), frames);
+    monoEngine.render(b.data(), frames);
+
+    float worst = 0.0f;
+    for (size_t i = 0; i < a.size(); i++)
+        worst = std::max(worst, std::fabs(a[i] - b[i]));
+    return worst;
+}
+
+// Engine mix per callback with `voices` bank notes always playing
+static BlockTimes timeBankMix(int sampleRate, int blockFrames, int voices, double seconds,
+                              const std::map<int, std::vector<int16_t>> &bank, int channels)
+{
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT, voices);
+    std::vector<float> buffer(blockFrames * 2);
+    int blocks = (int)(seconds * sampleRate / blockFrames);
+    std::vector<double> times;
+    times.reserve(blocks);
+    auto note = bank.begin();
+
+    for (int b = 0; b < blocks; b++)
+    {
+        for (int active = engine.getActiveVoices(); active < voices; active++)
+        {
+            // Unowned voices, so string monophony doesn't cap the count
+            startBankNote(engine, note->second, channels, -1);
+            if (++note == bank.end())
+                note = bank.begin();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        engine.render(buffer.data(), blockFrames);
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    return summarizeTimes(times);
+}
+
+// What SDL_mixer did with the old chunks: each channel added into int16 with a clamp per add
+static BlockTimes timeMixerChannels(int sampleRate, int blockFrames, int voices, double seconds,
+                                    const std::map<int, std::vector<int16_t>> &bank)
+{
+    std::vector<int16_t> output(blockFrames * 2);
+    std::vector<const std::vector<int16_t> *> playing(voices);
+    std::vector<size_t> positions(voices, 0);
+    auto note = bank.begin();
+    for (int v = 0; v < voices; v++)
+    {
+        playing[v] = &note->second;
+        if (++note == bank.end())
+            note = bank.begin();
+    }
+
+    int blocks = (int)(seconds * sampleRate / blockFrames);
+    std::vector<double> times;
+    times.reserve(blocks);
+    for (int b = 0; b < blocks; b++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::fill(output.begin(), output.end(), 0);
+        for (int v = 0; v < voices; v++)
+        {
+            const std::vector<int16_t> &samples = *playing[v];
+            size_t count = std::min<size_t>(output.size(), samples.size() - positions[v]);
+            const int16_t *source = samples.data() + positions[v];
+            for (size_t i = 0; i < count; i++)
+            {
+                int mixed = output[i] + source[i];
+                output[i] = (int16_t)std::max(-32768, std::min(32767, mixed));
+            }
+            positions[v] += count;
+            if (positions[v] >= samples.size())
+            {
+                positions[v] = 0;
+                playing[v] = &note->second;
+                if (++note == bank.end())
+                    note = bank.begin();
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    return summarizeTimes(times);
+}
+
+int runNoteBankBenchmark(int argc, char *argv[])
+{
+    int sampleRate = 44100;
+    int blockFrames = 256;
+    int voices = 16;
+    double seconds = 5.0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--voices" && i + 1 < argc)
+            voices = std::atoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+    }
+
+    if (blockFrames < 16 || voices < 1 || voices > SynthEngine::VOICE_CAPACITY || seconds <= 0.0 || sampleRate < 8000)
+    {
+        std::cerr << "Usage: " << argv[0] << " --bench-notes [--voices 1-" << SynthEngine::VOICE_CAPACITY
+                  << "] [--frames N] [--seconds S] [--rate N]" << std::endl;
+        return 1;
+    }
+
+    auto stereo = renderNoteBank(sampleRate, 2);
+    auto mono = renderNoteBank(sampleRate, 1);
+    size_t stereoBytes = bankBytes(stereo);
+    size_t monoBytes = bankBytes(mono);
+
+    std::cout << "Note bank, " << mono.size() << " notes of 0.8 s at " << sampleRate << " Hz:" << std::endl;
+    std::cout << "  stereo int16 chunks: " << stereoBytes / 1024 << " KiB" << std::endl;
+    std::cout << "  mono int16, panned at mix: " << monoBytes / 1024 << " KiB ("
+              << 100.0 * (stereoBytes - monoBytes) / stereoBytes << "% saved)" << std::endl;
+
+    float worst = checkNoteBankParity(sampleRate, stereo, mono);
+    bool passed = worst < 1e-5f;
+    std::cout << "  engine output, mono vs stereo with strings centred: max diff " << worst
+              << (passed ? " OK" : " FAILED") << std::endl;
+
+    const double deadline = 1e6 * blockFrames / sampleRate;
+    std::cout << "Mix cost, " << voices << " notes, " << blockFrames << " frames (" << deadline
+              << " us deadline):" << std::endl;
+
+    struct Row
+    {
+        const char *name;
+        BlockTimes times;
+    };
+    const Row rows[] = {
+        {"mixer channels, stereo int16 (old)", timeMixerChannels(sampleRate, blockFrames, voices, seconds, stereo)},
+        {"engine, stereo int16", timeBankMix(sampleRate, blockFrames, voices, seconds, stereo, 2)},
+        {"engine, mono int16 + pan", timeBankMix(sampleRate, blockFrames, voices, seconds, mono, 1)},
+    };
+    for (const Row &row : rows)
+    {
+        double perVoiceFrame = 1000.0 * row.times.mean / ((double)voices * blockFrames);
+        std::cout << "  " << row.name << ": mean " << row.times.mean << " us, p99 " << row.times.p99 << " us, "
+                  << perVoiceFrame << " ns per note-frame, load " << 100.0 * row.times.mean / deadline << "%"
+                  << std::endl;
+    }
+
+    return passed ? 0 : 1;
+}
+
+// One row of the DSP micro-benchmarks, in nanoseconds per unit of work
+struct KernelResult
+{
+    std::string name;
+    const char *unit;
+    BlockTimes times;
+};
+
+static BlockTimes scaleTimes(BlockTimes times, double factor)
+{
+    times.min *= factor;
+    times.mean *= factor;
+    times.p99 *= factor;
+    times.p999 *= factor;
+    times.max *= factor;
+    return times;
+}
+
+static double elapsedMicros(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One note-bank tone per run, as the pre-warm workers render them
+static BlockTimes timeToneKernel(ToneKernel::Path path, int sampleRate, int repeats)
+{
+    const int frames = (int)(sampleRate * AudioManager::NOTE_DURATION);
+    std::vector<int16_t> samples(frames);
+    std::vector<double> times;
+    times.reserve(repeats);
+    for (int r = 0; r < repeats; r++)
+    {
+        float frequency = Tuning::STANDARD_FREQUENCIES[0] * std::pow(2.0f, (r % 24) / 12.0f);
+        auto start = std::chrono::steady_clock::now();
+        ToneKernel::renderWithPath(path, samples.data(), frames, 1, frequency, AudioManager::NOTE_DURATION,
+                                   AudioManager::NOTE_VOLUME, sampleRate);
+        times.push_back(elapsedMicros(start));
+    }
+    return scaleTimes(summarizeTimes(times), 1000.0 / frames);
+}
+
+// A new whammy position every block, so every voice glides all the time
+static float whammySweep(int block)
+{
+    return 100.0f * (float)std::sin(block * 0.2);
+}
+
+// Karplus-Strong strings per block. Sustained keeps the pool full of ringing voices; replucked
+// plucks all six strings every block, so each block also runs the note-on and the choke fade.
+static BlockTimes timeStringVoices(int sampleRate, int blockFrames, int voices, double seconds, bool replucked,
+                                   bool whammy = false)
+{
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT, voices);
+    std::vector<float> buffer(blockFrames * 2);
+    int blocks = std::max(1, (int)(seconds * sampleRate / blockFrames));
+    int warmupBlocks = sampleRate / 10 / blockFrames;
+    std::vector<double> times;
+    times.reserve(blocks);
+    double voiceSum = 0.0;
+    int note = 0;
+
+    for (int b = 0; b < warmupBlocks + blocks; b++)
+    {
+        if (replucked)
+        {
+            for (int s = 0; s < Tuning::STRING_COUNT; s++)
+                engine.noteOn(s, Tuning::STANDARD_FREQUENCIES[s] * std::pow(2.0f, (b % 5) / 12.0f), 0.8f);
+        }
+        else
+        {
+            for (int active = engine.getActiveVoices(); active < voices; active++)
+            {
+                engine.noteOn(-1, Tuning::STANDARD_FREQUENCIES[0] * std::pow(2.0f, (note % 24) / 12.0f), 0.8f);
+                note += 7;
+            }
+        }
+        if (whammy)
+            engine.setWhammy(whammySweep(b));
+
+        auto start = std::chrono::steady_clock::now();
+        engine.render(buffer.data(), blockFrames);
+        double elapsed = elapsedMicros(start);
+
+        // The first blocks pluck the whole pool at once
+        if (b >= warmupBlocks)
+        {
+            times.push_back(elapsed);
+            voiceSum += engine.getActiveVoices();
+        }
+    }
+
+    double averageVoices = std::max(1.0, voiceSum / blocks);
+    return scaleTimes(summarizeTimes(times), 1000.0 / (averageVoices * blockFrames));
+}
+
+// Live harmonic tones held at their sustain level, oscillator and envelope per sample
+static BlockTimes timeToneVoices(int sampleRate, int blockFrames, int voices, double seconds, bool whammy = false)
+{
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT, voices);
+    for (int v = 0; v < voices; v++)
+    {
+        NoteEvent event = {};
+        event.note = (float)(Tuning::STANDARD_NOTES[0] + (v * 7) % 24);
+        event.velocity = 0.8f;
+        event.stringIndex = -1;
+        event.tone = true;
+        engine.queueEvent(event);
+    }
+
+    std::vector<float> buffer(blockFrames * 2);
+    int blocks = std::max(1, (int)(seconds * sampleRate / blockFrames));
+    std::vector<double> times;
+    times.reserve(blocks);
+    for (int b = 0; b < blocks; b++)
+    {
+        if (whammy)
+            engine.setWhammy(whammySweep(b));
+        auto start = std::chrono::steady_clock::now();
+        engine.render(buffer.data(), blockFrames);
+        times.push_back(elapsedMicros(start));
+    }
+    return scaleTimes(summarizeTimes(times), 1000.0 / ((double)voices * blockFrames));
+}
+
+// The callback's last step, float mix to the device buffer; batched because one block is too quick to time
+static BlockTimes timeOutputConversion(int blockFrames, Uint16 format, int repeats)
+{
+    const int channels = 2;
+    const int batch = 64;
+    std::vector<float> mix = noiseSignal(blockFrames * 2, 7);
+    for (float &value : mix)
+        value *= 1.5f; // some samples past full scale, so the clamp is exercised
+    std::vector<Uint8> stream((size_t)blockFrames * channels * sizeof(float));
+
+    std::vector<double> times;
+    times.reserve(repeats);
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < batch; i++)
+            AudioManager::writeOutput(mix.data(), blockFrames, stream.data(), 0, channels, format);
+        times.push_back(elapsedMicros(start));
+    }
+    return scaleTimes(summarizeTimes(times), 1000.0 / ((double)batch * blockFrames));
+}
+
+// AudioManager::getNoteChunk over every fret and velocity layer: the first pass renders each
+// tone, later passes are the bank lookup playNote does on every click
+static void timeNoteBankLookup(int repeats, BlockTimes &miss, BlockTimes &hit)
+{
+    AudioManager audio; // no mixer is open here, so nothing is hooked and tones stay in the bank
+    audio.setSynthMode(SynthMode::NoteBank);
+
+    std::vector<float> frequencies;
+    for (float base : Tuning::STANDARD_FREQUENCIES)
+    {
+        for (int fret = 0; fret <= 12; fret++)
+            frequencies.push_back(base * std::pow(2.0f, fret / 12.0f));
+    }
+    const float velocities[] = {0.2f, 0.45f, 0.7f, 1.0f};
+    const int lookups = (int)frequencies.size() * 4;
+
+    // Strings share pitches, so only calls that grew the bank were misses
+    std::vector<double> times;
+    for (float frequency : frequencies)
+    {
+        for (float velocity : velocities)
+        {
+            size_t before = audio.getNoteBankBytes();
+            auto start = std::chrono::steady_clock::now();
+            audio.getNoteChunk(frequency, velocity);
+            double elapsed = elapsedMicros(start);
+            if (audio.getNoteBankBytes() != before)
+                times.push_back(elapsed);
+        }
+    }
+    miss = scaleTimes(summarizeTimes(times), 1000.0);
+
+    times.clear();
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (float frequency : frequencies)
+        {
+            for (float velocity : velocities)
+                audio.getNoteChunk(frequency, velocity);
+        }
+        times.push_back(elapsedMicros(start));
+    }
+    hit = scaleTimes(summarizeTimes(times), 1000.0 / lookups);
+}
+
+static bool wantsJson(int argc, char *argv[])
+{
+    for (int i = 2; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--json")
+            return true;
+    }
+    return false;
+}
+
+int runDspBenchmark(int argc, char *argv[])
+{
+    int sampleRate = 44100;
+    int blockFrames = 256;
+    int voices = 16;
+    double seconds = 2.0;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--voices" && i + 1 < argc)
+            voices = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+    }
+
+    if (blockFrames < 16 || voices < 1 || voices > SynthEngine::VOICE_CAPACITY || seconds <= 0.0 || sampleRate < 8000)
+    {
+        std::cerr << "Usage: " << argv[0] << " dsp [--frames N] [--voices 1-" << SynthEngine::VOICE_CAPACITY
+                  << "] [--seconds S] [--rate N] [--json]" << std::endl;
+        return 1;
+    }
+
+    // Iterations for the kernels that are timed per call rather than per block
+    const int repeats = std::max(20, (int)(seconds * 100));
+
+    std::vector<KernelResult> results;
+    const ToneKernel::Path tonePaths[] = {ToneKernel::Path::Scalar, ToneKernel::Path::SSE2, ToneKernel::Path::AVX2};
+    for (ToneKernel::Path path : tonePaths)
+    {
+        if (!ToneKernel::isPathSupported(path))
+            continue;
+        std::string name = std::string("tone_kernel.") + ToneKernel::pathName(path);
+        std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)std::tolower(c); });
+        results.push_back({name, "ns/frame", timeToneKernel(path, sampleRate, repeats)});
+    }
+
+    results.push_back({"voice.string_sustained", "ns/voice-frame",
+                       timeStringVoices(sampleRate, blockFrames, voices, seconds, false)});
+    results.push_back({"voice.string_pluck_fade", "ns/voice-frame",
+                       timeStringVoices(sampleRate, blockFrames, voices, seconds, true)});
+
+    results.push_back({"voice.string_whammy", "ns/voice-frame",
+                       timeStringVoices(sampleRate, blockFrames, voices, seconds, false, true)});
+
+    results.push_back({"voice.tone_adsr", "ns/voice-frame", timeToneVoices(sampleRate, blockFrames, voices, seconds)});
+    results.push_back({"voice.tone_whammy", "ns/voice-frame",
+                       timeToneVoices(sampleRate, blockFrames, voices, seconds, true)});
+
+    auto bank = renderNoteBank(sampleRate, 1);
+    results.push_back({"mix.sample_mono_pan", "ns/voice-frame",
+                       scaleTimes(timeBankMix(sampleRate, blockFrames, voices, seconds, bank, 1),
+                                  1000.0 / ((double)voices * blockFrames))});
+
+    results.push_back({"output.s16", "ns/frame", timeOutputConversion(blockFrames, AUDIO_S16SYS, repeats)});
+    results.push_back({"output.f32", "ns/frame", timeOutputConversion(blockFrames, AUDIO_F32SYS, repeats)});
+
+    BlockTimes miss, hit;
+    timeNoteBankLookup(repeats, miss, hit);
+    results.push_back({"note_bank.render_miss", "ns/call", miss});
+    results.push_back({"note_bank.lookup", "ns/call", hit});
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"dsp\",\"sample_rate\":" << sampleRate << ",\"block_frames\":" << blockFrames
+                  << ",\"voices\":" << voices << ",\"sse2\":" << (cpuHasSSE2() ? "true" : "false")
+                  << ",\"avx2\":" << (cpuHasAVX2() ? "true" : "false") << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BlockTimes &t = results[i].times;
+            std::cout << (i ? "," : "") << "{\"name\":\"" << results[i].name << "\",\"unit\":\"" << results[i].unit
+                      << "\",\"min\":" << t.min << ",\"mean\":" << t.mean << ",\"p99\":" << t.p99
+                      << ",\"max\":" << t.max << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return 0;
+    }
+
+    std::cout << "DSP kernels, " << sampleRate << " Hz, " << blockFrames << "-frame blocks, " << voices
+              << " voices:" << std::endl;
+    for (const KernelResult &result : results)
+    {
+        const BlockTimes &t = result.times;
+        std::cout << "  " << std::left << std::setw(26) << result.name << std::right << " min " << std::setw(9)
+                  << t.min << "  mean " << std::setw(9) << t.mean << "  p99 " << std::setw(9) << t.p99 << "  "
+                  << result.unit << std::endl;
+    }
+    return 0;
+}
+
+// Mono bank note with its start staggered, so notes started together don't all end in the same block
+static void startStaggeredNote(SynthEngine &engine, const std::vector<int16_t> &samples, int skip)
+{
+    NoteEvent event = {};
+    event.velocity = 0.8f;
+    event.stringIndex = -1;
+    event.timestamp = engine.getSampleTime();
+    event.samples = samples.data() + skip;
+    event.sampleFrames = (int)samples.size() - skip;
+    event.sampleChannels = 1;
+    engine.queueEvent(event);
+}
+
+// One voice count for the stress test: every callback renders one engine, whose pool holds
+// VOICE_CAPACITY voices at most, and writes int16 like fillStream does. Voices that ended are
+// replaced before the clock starts, so only the render is timed. Fails as soon as a block after
+// the warm-up takes longer than the buffer lasts.
+static bool runStressTrial(bool strings, int sampleRate, int blockFrames, int voices, double seconds,
+                           const std::map<int, std::vector<int16_t>> &bank, BlockTimes &result)
+{
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT, voices);
+
+    // Pitches worked out once; the timed loop never calls pow
+    float frequencies[24];
+    for (int p = 0; p < 24; p++)
+        frequencies[p] = Tuning::STANDARD_FREQUENCIES[0] * std::pow(2.0f, p / 12.0f);
+
+    std::vector<float> mix(blockFrames * 2);
+    std::vector<Sint16> device(blockFrames * 2);
+    const double deadline = 1e6 * blockFrames / sampleRate;
+    const int warmupBlocks = std::max(1, sampleRate / 10 / blockFrames);
+    const int blocks = std::max(1, (int)(seconds * sampleRate / blockFrames));
+    std::vector<double> times;
+    times.reserve(blocks);
+    auto note = bank.begin();
+    int pitch = 0;
+
+    for (int b = 0; b < warmupBlocks + blocks; b++)
+    {
+        for (int active = engine.getActiveVoices(); active < engine.getMaxVoices(); active++)
+        {
+            if (strings)
+            {
+                engine.noteOn(-1, frequencies[pitch % 24], 0.8f);
+            }
+            else
+            {
+                int skip = (int)((pitch * 7919u) % (note->second.size() / 2));
+                startStaggeredNote(engine, note->second, skip);
+                if (++note == bank.end())
+                    note = bank.begin();
+            }
+            pitch += 7;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        engine.render(mix.data(), blockFrames);
+        AudioManager::writeOutput(mix.data(), blockFrames, reinterpret_cast<Uint8 *>(device.data()), 0, 2,
+                                  AUDIO_S16SYS);
+        double elapsed = elapsedMicros(start);
+
+        if (b < warmupBlocks)
+            continue;
+        if (elapsed > deadline)
+            return false;
+        times.push_back(elapsed);
+    }
+
+    result = summarizeTimes(times);
+    return true;
+}
+
+struct StressResult
+{
+    const char *kind;
+    int frames;
+    double deadline;
+    int maxVoices;
+    bool capped;      // the whole pool fit: the limit is VOICE_CAPACITY, not the CPU
+    BlockTimes times; // at maxVoices
+    double voiceMicros; // mean block time per voice
+    double headroom;    // how many full pools the deadline would fit at that cost
+};
+
+// Doubles the voice count until a block misses its deadline or the pool is full, then bisects to
+// within 2%. A failed trial is repeated, so one preempted block doesn't count as the synth running
+// out of time.
+static StressResult findMaxVoices(bool strings, int sampleRate, int blockFrames, double seconds, int retries,
+                                  int cap, const std::map<int, std::vector<int16_t>> &bank)
+{
+    auto passes = [&](int voices, BlockTimes &times)
+    {
+        for (int attempt = 0; attempt <= retries; attempt++)
+        {
+            if (runStressTrial(strings, sampleRate, blockFrames, voices, seconds, bank, times))
+                return true;
+        }
+        return false;
+    };
+
+    StressResult result = {strings ? "string" : "sample", blockFrames, 1e6 * blockFrames / sampleRate, 0, false, {},
+                           0.0, 0.0};
+    BlockTimes times = {};
+    int failed = 0;
+    for (int voices = std::min(8, cap);; voices = std::min(voices * 2, cap))
+    {
+        if (!passes(voices, times))
+        {
+            failed = voices;
+            break;
+        }
+        result.maxVoices = voices;
+        result.times = times;
+        if (voices == cap)
+        {
+            result.capped = true;
+            break;
+        }
+    }
+
+    while (!result.capped && failed - result.maxVoices > std::max(1, result.maxVoices / 50))
+    {
+        int voices = (result.maxVoices + failed) / 2;
+        if (passes(voices, times))
+        {
+            result.maxVoices = voices;
+            result.times = times;
+        }
+        else
+        {
+            failed = voices;
+        }
+    }
+
+    if (result.maxVoices > 0)
+    {
+        result.voiceMicros = result.times.mean / result.maxVoices;
+        result.headroom = result.deadline / (result.voiceMicros * SynthEngine::VOICE_CAPACITY);
+    }
+    return result;
+}
+
+int runVoiceStressTest(int argc, char *argv[])
+{
+    int sampleRate = 44100;
+    double seconds = 0.25;
+    int retries = 2;
+    int cap = SynthEngine::VOICE_CAPACITY;
+    std::vector<int> sizes;
+    std::string kind = "both";
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            sizes.push_back(std::atoi(argv[++i]));
+        else if (arg == "--kind" && i + 1 < argc)
+            kind = argv[++i];
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--retries" && i + 1 < argc)
+            retries = std::atoi(argv[++i]);
+        else if (arg == "--max-voices" && i + 1 < argc)
+            cap = std::atoi(argv[++i]);
+        else if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+    }
+    if (sizes.empty())
+        sizes = {64, 128, 256, 512, 1024};
+
+    bool sizesValid = std::all_of(sizes.begin(), sizes.end(), [](int frames) { return frames >= 16; });
+    if (!sizesValid || (kind != "both" && kind != "string" && kind != "sample") || seconds <= 0.0 || retries < 0 ||
+        cap < 1 || cap > SynthEngine::VOICE_CAPACITY || sampleRate < 8000)
+    {
+        std::cerr << "Usage: " << argv[0] << " stress [--frames N]... [--kind string|sample|both] [--seconds S]"
+                  << " [--retries N] [--max-voices N] [--rate N] [--json]" << std::endl;
+        return 1;
+    }
+
+    auto bank = renderNoteBank(sampleRate, 1);
+    std::vector<StressResult> results;
+    if (!json)
+        std::cout << "Voice scaling, engine + int16 output at " << sampleRate << " Hz (most voices, up to the "
+                  << cap << " an engine can play, with no block over the deadline):" << std::endl;
+    for (int frames : sizes)
+    {
+        if (kind != "sample")
+            results.push_back(findMaxVoices(true, sampleRate, frames, seconds, retries, cap, bank));
+        if (kind != "string")
+            results.push_back(findMaxVoices(false, sampleRate, frames, seconds, retries, cap, bank));
+
+        if (!json)
+        {
+            for (size_t i = results.size() - (kind == "both" ? 2 : 1); i < results.size(); i++)
+            {
+                const StressResult &r = results[i];
+                std::cout << "  " << std::left << std::setw(7) << r.kind << std::right << std::setw(5) << r.frames
+                          << " frames (" << std::setw(6) << r.deadline << " us): " << r.maxVoices
+                          << (r.capped ? " voices (full pool)" : " voices") << ", mean " << r.times.mean
+                          << " us, worst " << r.times.max << " us, " << r.voiceMicros << " us per voice, "
+                          << r.headroom << "x headroom for " << SynthEngine::VOICE_CAPACITY << std::endl;
+            }
+        }
+    }
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"stress\",\"sample_rate\":" << sampleRate << ",\"seconds\":" << seconds
+                  << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const StressResult &r = results[i];
+            std::cout << (i ? "," : "") << "{\"kind\":\"" << r.kind << "\",\"frames\":" << r.frames
+                      << ",\"deadline_us\":" << r.deadline << ",\"max_voices\":" << r.maxVoices
+                      << ",\"capped\":" << (r.capped ? "true" : "false") << ",\"mean_us\":" << r.times.mean
+                      << ",\"max_us\":" << r.times.max << ",\"us_per_voice\":" << r.voiceMicros
+                      << ",\"headroom\":" << r.headroom << "}";
+        }
+        std::cout << "]}" << std::endl;
+    }
+    return 0;
+}
+
+// Stereo test tone, both sides the same, at 0.5 amplitude
+static std::vector<float> stereoTone(double frequency, int sampleRate, int frames)
+{
+    std::vector<float> signal((size_t)frames * 2);
+    for (int i = 0; i < frames; i++)
+        signal[i * 2] = signal[i * 2 + 1] = 0.5f * (float)std::sin(2.0 * M_PI * frequency * i / sampleRate);
+    return signal;
+}
+
+// Left channel against the best-fitting sine at the test frequency (any phase, so either converter's
+// delay doesn't matter); what the fit can't explain is noise, aliasing and imaging. The first and last
+// 10% are skipped to stay clear of filter ramp-up and tail.
+static double measureToneSnr(const std::vector<float> &output, double frequency, int sampleRate)
+{
+    const int frames = (int)(output.size() / 2);
+    const int first = frames / 10;
+    const int last = frames - frames / 10;
+    if (last - first < 64)
+        return 0.0;
+
+    double ss = 0.0, sc = 0.0, cc = 0.0, xs = 0.0, xc = 0.0;
+    for (int i = first; i < last; i++)
+    {
+        double w = 2.0 * M_PI * frequency * i / sampleRate;
+        double sine = std::sin(w), cosine = std::cos(w), x = output[i * 2];
+        ss += sine * sine;
+        sc += sine * cosine;
+        cc += cosine * cosine;
+        xs += x * sine;
+        xc += x * cosine;
+    }
+    double determinant = ss * cc - sc * sc;
+    double a = (xs * cc - xc * sc) / determinant;
+    double b = (xc * ss - xs * sc) / determinant;
+
+    double signal = 0.0, noise = 0.0;
+    for (int i = first; i < last; i++)
+    {
+        double w = 2.0 * M_PI * frequency * i / sampleRate;
+        double fit = a * std::sin(w) + b * std::cos(w);
+        double error = output[i * 2] - fit;
+        signal += fit * fit;
+        noise += error * error;
+    }
+    return 10.0 * std::log10(signal / std::max(noise, signal * 1e-20));
+}
+
+// Left-channel level relative to the 0.5 amplitude input, in dB, away from the ends
+static double measureToneLevel(const std::vector<float> &output)
+{
+    const int frames = (int)(output.size() / 2);
+    double sum = 0.0;
+    int count = 0;
+    for (int i = frames / 10; i < frames - frames / 10; i++, count++)
+        sum += (double)output[i * 2] * output[i * 2];
+    double rms = std::sqrt(sum / std::max(1, count));
+    return 20.0 * std::log10(std::max(rms, 1e-12) / (0.5 / std::sqrt(2.0)));
+}
+
+// One way of converting the stereo stream: ours, or SDL's own when this SDL has one
+struct RateConverter
+{
+    virtual ~RateConverter() = default;
+    // Whole signal at once, as convert() does
+    virtual bool convertAll(const std::vector<float> &input, int inputRate, int outputRate,
+                            std::vector<float> &output) = 0;
+    // Per-block cost of streaming `seconds` of input at the device block size, in ns per output frame
+    virtual BlockTimes timeStream(int inputRate, int outputRate, int blockFrames, double seconds) = 0;
+};
+
+struct SincConverter : RateConverter
+{
+    bool convertAll(const std::vector<float> &input, int inputRate, int outputRate, std::vector<float> &output) override
+    {
+        return Resampler::convert(input, 2, inputRate, outputRate, output);
+    }
+
+    BlockTimes timeStream(int inputRate, int outputRate, int blockFrames, double seconds) override
+    {
+        Resampler resampler(inputRate, outputRate, 2, blockFrames);
+        const int inputFrames = (int)(inputRate * seconds);
+        std::vector<float> input = noiseSignal(inputFrames * 2, 7);
+        std::vector<float> output((size_t)blockFrames * 2);
+        std::vector<double> times;
+
+        int position = 0;
+        while (position + resampler.inputNeeded(blockFrames) <= inputFrames)
+        {
+            int needed = resampler.inputNeeded(blockFrames);
+            auto start = std::chrono::steady_clock::now();
+            resampler.process(input.data() + (size_t)position * 2, output.data(), blockFrames);
+            times.push_back(elapsedMicros(start) * 1000.0 / blockFrames);
+            position += needed;
+        }
+        return summarizeTimes(times);
+    }
+};
+
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+struct SdlStreamConverter : RateConverter
+{
+    bool convertAll(const std::vector<float> &input, int inputRate, int outputRate, std::vector<float> &output) override
+    {
+        SDL_AudioStream *stream = SDL_NewAudioStream(AUDIO_F32SYS, 2, inputRate, AUDIO_F32SYS, 2, outputRate);
+        if (!stream)
+            return false;
+        SDL_AudioStreamPut(stream, input.data(), (int)(input.size() * sizeof(float)));
+        SDL_AudioStreamFlush(stream);
+        output.resize((size_t)SDL_AudioStreamAvailable(stream) / sizeof(float));
+        int got = SDL_AudioStreamGet(stream, output.data(), (int)(output.size() * sizeof(float)));
+        output.resize((size_t)std::max(0, got) / sizeof(float));
+        SDL_FreeAudioStream(stream);
+        return true;
+    }
+
+    BlockTimes timeStream(int inputRate, int outputRate, int blockFrames, double seconds) override
+    {
+        SDL_AudioStream *stream = SDL_NewAudioStream(AUDIO_F32SYS, 2, inputRate, AUDIO_F32SYS, 2, outputRate);
+        if (!stream)
+            return {};
+        const int inputFrames = (int)(inputRate * seconds);
+        std::vector<float> input = noiseSignal(inputFrames * 2, 7);
+        std::vector<float> output((size_t)blockFrames * 2);
+        std::vector<double> times;
+
+        // Feed what one device block needs, rounded up, then take the block out as the callback would
+        const int blockInput = (int)(((long long)blockFrames * inputRate + outputRate - 1) / outputRate) + 1;
+        for (int position = 0; position + blockInput <= inputFrames; position += blockInput)
+        {
+            auto start = std::chrono::steady_clock::now();
+            SDL_AudioStreamPut(stream, input.data() + (size_t)position * 2, blockInput * 2 * (int)sizeof(float));
+            int got = SDL_AudioStreamGet(stream, output.data(), blockFrames * 2 * (int)sizeof(float));
+            double micros = elapsedMicros(start);
+            int frames = got / (2 * (int)sizeof(float));
+            if (frames > 0)
+                times.push_back(micros * 1000.0 / frames);
+        }
+        SDL_FreeAudioStream(stream);
+        if (times.empty())
+            return {};
+        return summarizeTimes(times);
+    }
+};
+#endif
+
+struct ResampleResult
+{
+    const char *converter;
+    int inputRate;
+    int outputRate;
+    BlockTimes times;            // ns per output frame
+    std::vector<double> snr;     // dB, one per test tone
+    double alias;                // dB level of a tone above the output's Nyquist; 0 when upsampling
+};
+
+int runResamplerBenchmark(int argc, char *argv[])
+{
+    int blockFrames = 256;
+    double seconds = 2.0;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+    }
+
+    if (blockFrames < 16 || seconds <= 0.0)
+    {
+        std::cerr << "Usage: " << argv[0] << " resample [--frames N] [--seconds S] [--json]" << std::endl;
+        return 1;
+    }
+
+    const int pairs[][2] = {{44100, 48000}, {48000, 44100}, {44100, 96000}, {96000, 48000}};
+    const double tones[] = {1000.0, 10000.0, 18000.0};
+
+    std::vector<std::pair<const char *, std::unique_ptr<RateConverter>>> converters;
+    converters.emplace_back("sinc", std::make_unique<SincConverter>());
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+    converters.emplace_back("sdl", std::make_unique<SdlStreamConverter>());
+#else
+    if (!json)
+        std::cout << "SDL_AudioStream needs SDL 2.0.7, comparing against nothing" << std::endl;
+#endif
+
+    std::vector<ResampleResult> results;
+    for (const auto &pair : pairs)
+    {
+        const int inputRate = pair[0];
+        const int outputRate = pair[1];
+        for (const auto &converter : converters)
+        {
+            ResampleResult result = {converter.first, inputRate, outputRate, {}, {}, 0.0};
+            std::vector<float> output;
+            for (double frequency : tones)
+            {
+                bool converted = converter.second->convertAll(stereoTone(frequency, inputRate, inputRate), inputRate,
+                                                              outputRate, output);
+                result.snr.push_back(converted ? measureToneSnr(output, frequency, outputRate) : 0.0);
+            }
+
+            // Halfway between the two Nyquist frequencies: everything there should be filtered out
+            if (outputRate < inputRate)
+            {
+                double frequency = 0.25 * (inputRate + outputRate);
+                if (converter.second->convertAll(stereoTone(frequency, inputRate, inputRate), inputRate, outputRate,
+                                                 output))
+                    result.alias = measureToneLevel(output);
+            }
+
+            result.times = converter.second->timeStream(inputRate, outputRate, blockFrames, seconds);
+            results.push_back(result);
+        }
+    }
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"resample\",\"block_frames\":" << blockFrames << ",\"seconds\":" << seconds
+                  << ",\"taps\":" << Resampler(44100, 48000).getTaps() << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const ResampleResult &r = results[i];
+            std::cout << (i ? "," : "") << "{\"converter\":\"" << r.converter << "\",\"from\":" << r.inputRate
+                      << ",\"to\":" << r.outputRate << ",\"mean_ns\":" << r.times.mean << ",\"p99_ns\":"
+                      << r.times.p99 << ",\"snr_db\":[";
+            for (size_t t = 0; t < r.snr.size(); t++)
+                std::cout << (t ? "," : "") << r.snr[t];
+            std::cout << "],\"alias_db\":" << r.alias << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return 0;
+    }
+
+    std::cout << "Sample rate conversion, stereo, " << blockFrames << "-frame output blocks (ns/frame; SNR at "
+              << "1k/10k/18k Hz; level of a tone between the two Nyquists):" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const ResampleResult &r : results)
+    {
+        std::cout << "  " << std::setw(5) << r.inputRate << " -> " << std::setw(5) << r.outputRate << "  "
+                  << std::left << std::setw(5) << r.converter << std::right << " mean " << std::setw(6)
+                  << r.times.mean << "  p99 " << std::setw(6) << r.times.p99 << "  SNR";
+        for (double snr : r.snr)
+            std::cout << " " << std::setw(6) << snr;
+        std::cout << " dB";
+        if (r.outputRate < r.inputRate)
+            std::cout << "  alias " << std::setw(6) << r.alias << " dB";
+        std::cout << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    return 0;
+}
+
+struct OnsetResult
+{
+    const char *mode;
+    double errorP50; // ms, |onset spacing - click spacing|
+    double errorP99;
+    double errorMax;
+    double latencyMean; // ms from click to the onset's place in the device schedule
+    double latencyMax;
+    int late;
+    int missing;
+};
+
+// Simulated time: a device asking for blocks on a jittery schedule, a 60 Hz main loop polling
+// millisecond-stamped clicks, and the real engine starting the notes. Tags report each onset sample.
+static OnsetResult simulateOnsets(bool scheduled, int sampleRate, int blockFrames, int clicks, double intervalMs,
+                                  double jitterMs)
+{
+    const int64_t MS = 1000000;
+    const int64_t framePeriod = 1000000000LL / 60;
+    const int64_t clickStart = 500 * MS; // long enough for the clock to settle
+    const int64_t delay = (int64_t)((AudioManager::DEFAULT_ONSET_DELAY + (double)blockFrames / sampleRate) * 1e9);
+
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT);
+    SampleClock clock(sampleRate);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const int block = 256; // AudioManager's render block
+    std::vector<float> scratch(block * 2);
+    std::vector<int64_t> clickTimes(clicks);
+    std::vector<int64_t> onsets(clicks, -1);
+    for (int k = 0; k < clicks; k++)
+        clickTimes[k] = clickStart + (int64_t)(k * intervalMs * MS);
+
+    OnsetResult result = {scheduled ? "scheduled" : "next block", 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0};
+    int64_t callbackCount = 0;
+    int64_t lastCallback = 0;
+    int64_t nextFrame = (int64_t)(unit(random) * framePeriod);
+    int64_t picked = nextFrame + (int64_t)(unit(random) * 2 * MS); // when this frame's clicks reach the engine
+    int queued = 0;
+    const int64_t end = clickTimes.back() + 500 * MS;
+    while (true)
+    {
+        // The device never calls back before its buffer is due, often a little after
+        int64_t due = (int64_t)(callbackCount * (double)blockFrames * 1e9 / sampleRate);
+        int64_t callback = std::max(lastCallback, due + (int64_t)(unit(random) * jitterMs * MS));
+        if (std::min(callback, picked) > end)
+            break;
+
+        if (callback <= picked)
+        {
+            clock.update(callback, engine.getSampleTime());
+            for (int offset = 0; offset < blockFrames; offset += block)
+            {
+                engine.render(scratch.data(), std::min(block, blockFrames - offset));
+                for (int i = 0; i < engine.getStartedTagCount(); i++)
+                    onsets[engine.getStartedTag(i).tag - 1] = (int64_t)engine.getStartedTag(i).sampleTime;
+            }
+            lastCallback = callback;
+            callbackCount++;
+            continue;
+        }
+
+        // Main loop: every click stamped before the poll, queued once picking is done
+        while (queued < clicks && clickTimes[queued] <= nextFrame)
+        {
+            NoteEvent event = {};
+            event.type = NoteEventType::NoteOn;
+            event.note = 52.0f + queued % 12;
+            event.velocity = 0.8f;
+            event.stringIndex = queued % Tuning::STRING_COUNT;
+            event.tag = (uint32_t)queued + 1;
+
+            uint64_t next = engine.getSampleTime();
+            uint64_t onset = next;
+            int64_t stamped = clickTimes[queued] / MS * MS; // SDL's millisecond stamps
+            if (scheduled && clock.toSampleTime(stamped + delay, onset) && onset < next)
+            {
+                result.late++;
+                onset = next;
+            }
+            event.timestamp = onset;
+            engine.queueEvent(event);
+            queued++;
+        }
+        nextFrame += framePeriod;
+        picked = nextFrame + (int64_t)(unit(random) * 2 * MS);
+    }
+
+    std::vector<double> errors;
+    std::vector<double> latencies;
+    for (int k = 0; k < clicks; k++)
+    {
+        if (onsets[k] < 0)
+        {
+            result.missing++;
+            continue;
+        }
+        latencies.push_back(onsets[k] * 1000.0 / sampleRate - clickTimes[k] / 1e6);
+        if (k > 0 && onsets[k - 1] >= 0)
+            errors.push_back(std::fabs((onsets[k] - onsets[k - 1]) * 1000.0 / sampleRate - intervalMs));
+    }
+    if (errors.empty())
+        return result;
+
+    std::sort(errors.begin(), errors.end());
+    result.errorP50 = errors[errors.size() / 2];
+    result.errorP99 = errors[std::min(errors.size() - 1, errors.size() * 99 / 100)];
+    result.errorMax = errors.back();
+    for (double latency : latencies)
+    {
+        result.latencyMean += latency / latencies.size();
+        result.latencyMax = std::max(result.latencyMax, latency);
+    }
+    return result;
+}
+
+int runOnsetJitterTest(int argc, char *argv[])
+{
+    int sampleRate = 48000;
+    int blockFrames = 512;
+    int clicks = 200;
+    double intervalMs = 73.3;
+    double jitterMs = 2.0;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--clicks" && i + 1 < argc)
+            clicks = std::atoi(argv[++i]);
+        else if (arg == "--interval" && i + 1 < argc)
+            intervalMs = std::atof(argv[++i]);
+        else if (arg == "--jitter" && i + 1 < argc)
+            jitterMs = std::atof(argv[++i]);
+    }
+
+    if (sampleRate < 8000 || blockFrames < 16 || clicks < 2 || intervalMs <= 0.0 || jitterMs < 0.0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " onset [--frames N] [--clicks N] [--interval MS] [--jitter MS] [--rate N] [--json]" << std::endl;
+        return 1;
+    }
+
+    OnsetResult results[] = {simulateOnsets(false, sampleRate, blockFrames, clicks, intervalMs, jitterMs),
+                             simulateOnsets(true, sampleRate, blockFrames, clicks, intervalMs, jitterMs)};
+
+    // Scheduled onsets may only be off by SDL's millisecond stamps and the sample they round to
+    const double tolerance = 1.0 + 2000.0 / sampleRate;
+    const OnsetResult &scheduled = results[1];
+    bool passed = scheduled.errorMax <= tolerance && scheduled.late == 0 && scheduled.missing == 0;
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"onset\",\"rate\":" << sampleRate << ",\"block_frames\":" << blockFrames
+                  << ",\"clicks\":" << clicks << ",\"interval_ms\":" << intervalMs << ",\"jitter_ms\":" << jitterMs
+                  << ",\"passed\":" << (passed ? "true" : "false") << ",\"results\":[";
+        for (size_t i = 0; i < 2; i++)
+        {
+            const OnsetResult &r = results[i];
+            std::cout << (i ? "," : "") << "{\"mode\":\"" << r.mode << "\",\"error_p50_ms\":" << r.errorP50
+                      << ",\"error_p99_ms\":" << r.errorP99 << ",\"error_max_ms\":" << r.errorMax
+                      << ",\"latency_mean_ms\":" << r.latencyMean << ",\"latency_max_ms\":" << r.latencyMax
+                      << ",\"late\":" << r.late << ",\"missing\":" << r.missing << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    std::cout << "Onset jitter, " << clicks << " clicks " << intervalMs << " ms apart, " << blockFrames
+              << "-frame buffers at " << sampleRate << " Hz, callbacks up to " << jitterMs
+              << " ms late, 60 Hz polling (ms; spacing error against the clicks):" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const OnsetResult &r : results)
+    {
+        std::cout << "  " << std::left << std::setw(10) << r.mode << std::right << "  error p50 " << std::setw(6)
+                  << r.errorP50 << "  p99 " << std::setw(6) << r.errorP99 << "  max " << std::setw(6) << r.errorMax
+                  << "  latency mean " << std::setw(6) << r.latencyMean << "  max " << std::setw(6) << r.latencyMax
+                  << "  late " << r.late << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << (passed ? "PASS" : "FAIL") << ": scheduled onsets within " << tolerance << " ms of the click spacing"
+              << std::endl;
+    return passed ? 0 : 1;
+}
+
+// A song for the embed test: a strum every quarter second, a 5 ms spread between strings, the top
+// string as a live tone on every other strum and the low one released halfway through some
+struct EmbedNote
+{
+    uint64_t time;
+    int stringIndex;
+    float note;
+    bool tone;
+    bool off;
+};
+
+static std::vector<EmbedNote> embedSong(int sampleRate, uint64_t frames)
+{
+    std::vector<EmbedNote> song;
+    const uint64_t strumFrames = sampleRate / 4;
+    for (uint64_t start = 0, strum = 0; start < frames; start += strumFrames, strum++)
+    {
+        for (int s = 0; s < Tuning::STRING_COUNT; s++)
+        {
+            float note = (float)(Tuning::STANDARD_NOTES[s] + strum % 5);
+            song.push_back({start + (uint64_t)(s * sampleRate / 200), s, note, s == 5 && strum % 2 == 1, false});
+        }
+        if (strum % 4 == 3)
+            song.push_back({start + strumFrames / 2, 0, 0.0f, false, true});
+    }
+    std::stable_sort(song.begin(), song.end(), [](const EmbedNote &a, const EmbedNote &b) { return a.time < b.time; });
+    return song;
+}
+
+// Host block sizes that never line up with the engine's own
+static const int EMBED_BLOCKS[] = {1, 7, 64, 333, 1024, 128, 480};
+
+int runEmbedTest(int argc, char *argv[])
+{
+    int sampleRate = 48000;
+    double seconds = 10.0;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+    }
+
+    if (sampleRate < 8000 || seconds <= 0.0)
+    {
+        std::cerr << "Usage: " << argv[0] << " embed [--seconds S] [--rate N] [--json]" << std::endl;
+        return 1;
+    }
+
+    const uint64_t total = (uint64_t)(seconds * sampleRate);
+    const std::vector<EmbedNote> song = embedSong(sampleRate, total);
+    std::vector<float> direct(total * 2), interleaved(total * 2), planar(total * 2);
+    std::vector<float> left(1024), right(1024), live(1024 * 2);
+
+    GuitarSynth *synths[3] = {guitar_synth_create(sampleRate, Tuning::STRING_COUNT, 16),
+                              guitar_synth_create(sampleRate, Tuning::STRING_COUNT, 16),
+                              guitar_synth_create(sampleRate, Tuning::STRING_COUNT, 16)};
+    if (!synths[0] || !synths[1] || !synths[2])
+    {
+        std::cerr << "guitar_synth_create failed" << std::endl;
+        return 1;
+    }
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT, 16);
+
+    // The engine itself in its own blocks, for reference
+    size_t next = 0;
+    for (uint64_t time = 0; time < total; time += 256)
+    {
+        int frames = (int)std::min<uint64_t>(256, total - time);
+        for (; next < song.size() && song[next].time < time + frames; next++)
+        {
+            NoteEvent event = {};
+            event.type = song[next].off ? NoteEventType::NoteOff : NoteEventType::NoteOn;
+            event.note = song[next].note;
+            event.velocity = 0.8f;
+            event.stringIndex = song[next].stringIndex;
+            event.timestamp = song[next].time;
+            event.tone = song[next].tone;
+            engine.queueEvent(event);
+        }
+        engine.render(direct.data() + time * 2, frames);
+    }
+
+    // The same song through the C API in uneven host blocks: interleaved, planar, and a third copy
+    // with the whammy and a bend moving every block. Nothing after create may touch the heap.
+    std::vector<double> times;
+    times.reserve(total / 64);
+    const long allocationsBefore = benchAllocationCount ? benchAllocationCount() : 0;
+    next = 0;
+    int block = 0;
+    for (uint64_t time = 0; time < total; block++)
+    {
+        int frames = (int)std::min<uint64_t>(EMBED_BLOCKS[block % 7], total - time);
+        for (; next < song.size() && song[next].time < time + frames; next++)
+        {
+            const EmbedNote &note = song[next];
+            GuitarSynthVoice voice = note.tone ? GUITAR_SYNTH_VOICE_TONE : GUITAR_SYNTH_VOICE_STRING;
+            for (GuitarSynth *synth : synths)
+            {
+                if (note.off)
+                    guitar_synth_note_off(synth, note.stringIndex, note.time);
+                else
+                    guitar_synth_note_on(synth, note.stringIndex, note.note, 0.8f, voice, note.time);
+            }
+        }
+
+        guitar_synth_process(synths[0], interleaved.data() + time * 2, frames);
+        guitar_synth_process_planar(synths[1], left.data(), right.data(), frames);
+        for (int i = 0; i < frames; i++)
+        {
+            planar[(time + i) * 2] = left[i];
+            planar[(time + i) * 2 + 1] = right[i];
+        }
+
+        guitar_synth_set_whammy(synths[2], 60.0f * (float)std::sin(time * 12.0 / sampleRate));
+        guitar_synth_set_bend(synths[2], 2, (block / 50) % 2 ? 200.0f : 0.0f);
+        auto start = std::chrono::steady_clock::now();
+        guitar_synth_process(synths[2], live.data(), frames);
+        times.push_back(elapsedMicros(start) * 1000.0 / frames);
+        time += frames;
+    }
+    const long allocations = benchAllocationCount ? benchAllocationCount() - allocationsBefore : -1;
+    const uint32_t dropped = guitar_synth_dropped_events(synths[0]);
+    for (GuitarSynth *synth : synths)
+        guitar_synth_destroy(synth);
+
+    // Sample-accurate events make the output independent of how the host cuts its blocks
+    float directDiff = 0.0f, planarDiff = 0.0f;
+    for (size_t i = 0; i < direct.size(); i++)
+    {
+        directDiff = std::max(directDiff, std::fabs(interleaved[i] - direct[i]));
+        planarDiff = std::max(planarDiff, std::fabs(planar[i] - interleaved[i]));
+    }
+    BlockTimes cost = summarizeTimes(times);
+    bool passed = directDiff == 0.0f && planarDiff == 0.0f && allocations <= 0 && dropped == 0;
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"embed\",\"rate\":" << sampleRate << ",\"seconds\":" << seconds
+                  << ",\"passed\":" << (passed ? "true" : "false") << ",\"direct_difference\":" << directDiff
+                  << ",\"planar_difference\":" << planarDiff << ",\"allocations\":" << allocations
+                  << ",\"dropped\":" << dropped << ",\"ns_per_frame_mean\":" << cost.mean
+                  << ",\"ns_per_frame_p99\":" << cost.p99 << "}" << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    std::cout << "C API (GuitarSynth.h), " << seconds << " s of strums at " << sampleRate << " Hz in host blocks of 1 to "
+              << left.size() << " frames:" << std::endl;
+    std::cout << "  against SynthEngine::render: max difference " << directDiff << std::endl;
+    std::cout << "  planar against interleaved:  max difference " << planarDiff << std::endl;
+    std::cout << "  heap allocations after create: "
+              << (allocations < 0 ? std::string("not counted in this build") : std::to_string(allocations)) << std::endl;
+    std::cout << "  dropped events: " << dropped << std::endl;
+    std::cout << "  process with whammy and bends: mean " << cost.mean << " ns/frame, p99 " << cost.p99
+              << " ns/frame" << std::endl;
+    std::cout << (passed ? "PASS" : "FAIL") << ": the C API renders the engine's output without allocating" << std::endl;
+    return passed ? 0 : 1;
+}
+
+// Stands in for the network between two jam sessions on loopback: each end takes what its session
+// sends and hands it to the other session after a random delay, or drops it
+class JamRelay
+{
+private:
+    struct Held
+    {
+        int64_t due;
+        std::vector<uint8_t> packet;
+    };
+
+    UdpSocket ends_[2];
+    uint16_t targets_[2]; // session port each end's packets go on to
+    std::thread threads_[2];
+    std::atomic<bool> running_;
+    double baseMs_;
+    double jitterMs_;
+    double loss_;
+
+    void forward(int end, unsigned int seed)
+    {
+        std::mt19937 random(seed);
+        std::exponential_distribution<double> jitter(1.0);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        std::vector<Held> held;
+        uint8_t packet[512];
+        while (running_.load())
+        {
+            int64_t wait = 1000000;
+            for (const Held &h : held)
+                wait = std::min(wait, h.due - LatencyProbe::now());
+
+            int size = ends_[end].receive(packet, sizeof(packet), wait);
+            if (size > 0 && chance(random) >= loss_)
+            {
+                double delayMs = baseMs_ + jitterMs_ * std::min(8.0, jitter(random));
+                held.push_back({LatencyProbe::now() + (int64_t)(delayMs * 1e6), std::vector<uint8_t>(packet, packet + size)});
+            }
+
+            // Out of the other end, so the receiver sees its partner's relay address
+            int64_t now = LatencyProbe::now();
+            for (size_t i = 0; i < held.size();)
+            {
+                if (held[i].due <= now)
+                {
+                    ends_[1 - end].sendTo(held[i].packet.data(), (int)held[i].packet.size(), 0x7F000001, targets_[end]);
+                    held.erase(held.begin() + i);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+    }
+
+public:
+    JamRelay(double baseMs, double jitterMs, double loss) : targets_(), running_(false), baseMs_(baseMs), jitterMs_(jitterMs), loss_(loss) {}
+    ~JamRelay() { stop(); }
+
+    bool open() { return ends_[0].open(0) && ends_[1].open(0); }
+    uint16_t getPort(int end) const { return ends_[end].getPort(); }
+
+    // Packets arriving at end 0 go to port b, those at end 1 to port a
+    void start(uint16_t a, uint16_t b)
+    {
+        targets_[0] = b;
+        targets_[1] = a;
+        running_.store(true);
+        threads_[0] = std::thread(&JamRelay::forward, this, 0, 1u);
+        threads_[1] = std::thread(&JamRelay::forward, this, 1, 2u);
+    }
+
+    void stop()
+    {
+        running_.store(false);
+        for (std::thread &thread : threads_)
+            if (thread.joinable())
+                thread.join();
+    }
+};
+
+// One side of the jam test: an engine rendering in real time as a device would drive it
+struct JamSide
+{
+    SynthEngine engine;
+    SampleClock clock;
+    JamSession session;
+    std::thread audio;
+    std::atomic<bool> running;
+    int peakVoices;
+
+    explicit JamSide(int sampleRate) : engine(sampleRate, Tuning::STRING_COUNT * 2), clock(sampleRate), running(false), peakVoices(0) {}
+
+    void start(int blockFrames)
+    {
+        running.store(true);
+        audio = std::thread([this, blockFrames]
+        {
+            std::vector<float> block(blockFrames * 2);
+            const int64_t period = (int64_t)blockFrames * 1000000000 / engine.getSampleRate();
+            int64_t next = LatencyProbe::now();
+            while (running.load())
+            {
+                clock.update(LatencyProbe::now(), engine.getSampleTime());
+                engine.render(block.data(), blockFrames);
+                peakVoices = std::max(peakVoices, engine.getActiveVoices());
+                next += period;
+                std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<int64_t>(0, next - LatencyProbe::now())));
+            }
+        });
+    }
+
+    void stop()
+    {
+        running.store(false);
+        if (audio.joinable())
+            audio.join();
+    }
+};
+
+// Shorter runs don't have enough pings to pin the drift within 50 ppm through the default
+// 3 ms of jitter: the fit needs about this long, whatever the estimator
+static constexpr double JAM_SETTLE_SECONDS = 8.0;
+
+int runJamTest(int argc, char *argv[])
+{
+    int sampleRate = 48000;
+    int blockFrames = 256;
+    double seconds = 20.0;
+    double baseMs = 0.5;
+    double jitterMs = 3.0;
+    double lossPercent = 2.0;
+    double driftPpm = 200.0;
+    double latePercent = 100.0 * JamSession::DEFAULT_LATE_TARGET;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--delay" && i + 1 < argc)
+            baseMs = std::atof(argv[++i]);
+        else if (arg == "--jitter" && i + 1 < argc)
+            jitterMs = std::atof(argv[++i]);
+        else if (arg == "--loss" && i + 1 < argc)
+            lossPercent = std::atof(argv[++i]);
+        else if (arg == "--drift" && i + 1 < argc)
+            driftPpm = std::atof(argv[++i]);
+        else if (arg == "--late" && i + 1 < argc)
+            latePercent = std::atof(argv[++i]);
+    }
+
+    if (seconds < JAM_SETTLE_SECONDS)
+    {
+        std::cerr << "--seconds must be at least " << JAM_SETTLE_SECONDS
+                  << ": the clock drift fit needs that long to settle before it can be checked" << std::endl;
+        return 1;
+    }
+    if (sampleRate < 8000 || blockFrames < 16 || baseMs < 0.0 || jitterMs < 0.0 || lossPercent < 0.0 ||
+        lossPercent >= 50.0 || latePercent < 0.0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " jam [--seconds S] [--delay MS] [--jitter MS] [--loss PCT] [--drift PPM] [--late PCT] [--frames N]"
+                     " [--rate N] [--json]"
+                  << std::endl;
+        return 1;
+    }
+
+    // A's clock is seconds away from B's and gains driftPpm, as another machine's would
+    JamRelay relay(baseMs, jitterMs, lossPercent / 100.0);
+    std::unique_ptr<JamSide> sides[2] = {std::make_unique<JamSide>(sampleRate), std::make_unique<JamSide>(sampleRate)};
+    sides[0]->session.setClockSkew(3700000000LL, driftPpm);
+    if (!relay.open())
+    {
+        std::cerr << "Can't open loopback UDP sockets" << std::endl;
+        return 1;
+    }
+    for (int s = 0; s < 2; s++)
+    {
+        sides[s]->session.setLateTarget((float)(latePercent / 100.0));
+        sides[s]->session.setOutputDelay(20000000);
+        std::string peer = "127.0.0.1:" + std::to_string(relay.getPort(s));
+        if (!sides[s]->session.start(0, peer, &sides[s]->engine, &sides[s]->clock, Tuning::STRING_COUNT))
+            return 1;
+        sides[s]->start(blockFrames);
+    }
+    relay.start(sides[0]->session.getPort(), sides[1]->session.getPort());
+
+    // Both play: a strum every 200 ms (5 ms between strings), B a beat behind A, and a bend on
+    // every fourth strum, swept in ten steps
+    struct Played
+    {
+        int64_t time;
+        int side;
+        JamEvent event;
+    };
+    std::vector<Played> song;
+    const int64_t start = LatencyProbe::now() + 200000000;
+    for (int64_t beat = 0; beat * 100000000 < (int64_t)(seconds * 1e9) - 500000000; beat++)
+    {
+        int side = (int)(beat % 2);
+        int64_t strum = start + beat * 100000000;
+        for (int s = 0; s < Tuning::STRING_COUNT; s++)
+        {
+            JamEvent event = {JamEventType::NoteOn, s, beat % 6 == 5, 0.8f,
+                              (float)(Tuning::STANDARD_NOTES[s] + beat % 5), 0.0f, 0};
+            song.push_back({strum + s * 5000000, side, event});
+        }
+        if (beat % 8 < 2)
+        {
+            for (int step = 1; step <= 10; step++)
+            {
+                JamEvent event = {JamEventType::Bend, 3, false, 0.0f, step * 20.0f, 0.0f, 0};
+                song.push_back({strum + 40000000 + step * 4000000, side, event});
+            }
+        }
+    }
+    std::stable_sort(song.begin(), song.end(), [](const Played &a, const Played &b) { return a.time < b.time; });
+
+    for (Played &played : song)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::max<int64_t>(0, played.time - LatencyProbe::now())));
+        played.event.time = played.time;
+        sides[played.side]->session.send(played.event);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    JamStats stats[2] = {sides[1]->session.getStats(), sides[0]->session.getStats()}; // A -> B, B -> A
+    int64_t sessionAt[2] = {sides[1]->session.sessionTime(stats[0].time), sides[0]->session.sessionTime(stats[1].time)};
+    double offsetError[2] = {
+        stats[0].clockOffset - (sides[0]->session.sessionTime(stats[0].time) - sessionAt[0]) / 1e6,
+        stats[1].clockOffset - (sides[1]->session.sessionTime(stats[1].time) - sessionAt[1]) / 1e6};
+    const double trueDrift[2] = {driftPpm, -driftPpm / (1.0 + driftPpm * 1e-6)};
+    relay.stop();
+    uint32_t droppedEvents = 0;
+    int peakVoices[2];
+    for (int s = 0; s < 2; s++)
+    {
+        sides[s]->session.stop();
+        sides[s]->stop();
+        droppedEvents += sides[s]->engine.getDroppedEvents();
+        peakVoices[s] = sides[s]->peakVoices;
+    }
+
+    // Repeats cover lone drops; a burst of REDUNDANCY lost packets in a row should be rare at this loss.
+    // Late notes may run over the target while the buffer first learns the spread.
+    bool passed = droppedEvents == 0;
+    for (int d = 0; d < 2; d++)
+    {
+        const JamStats &s = stats[d];
+        double played = (double)std::max<uint64_t>(1, s.eventsReceived);
+        passed = passed && s.synced && s.eventsReceived > 0 && peakVoices[1 - d] > 0;
+        passed = passed && s.lost <= 1 + s.eventsReceived / 100;
+        passed = passed && s.late / played <= 3.0 * latePercent / 100.0 + 0.01;
+        passed = passed && std::fabs(offsetError[d]) <= 1.0 + baseMs;
+        passed = passed && std::fabs(s.driftPpm - trueDrift[d]) <= 50.0;
+    }
+
+    const char *names[2] = {"A -> B", "B -> A"};
+    if (json)
+    {
+        std::cout << "{\"suite\":\"jam\",\"seconds\":" << seconds << ",\"delay_ms\":" << baseMs << ",\"jitter_ms\":"
+                  << jitterMs << ",\"loss_percent\":" << lossPercent << ",\"drift_ppm\":" << driftPpm
+                  << ",\"passed\":" << (passed ? "true" : "false") << ",\"directions\":[";
+        for (int d = 0; d < 2; d++)
+        {
+            const JamStats &s = stats[d];
+            std::cout << (d ? "," : "") << "{\"direction\":\"" << names[d] << "\",\"events\":" << s.eventsReceived
+                      << ",\"late\":" << s.late << ",\"lost\":" << s.lost << ",\"latency_p50_ms\":" << s.latencyP50
+                      << ",\"latency_p99_ms\":" << s.latencyP99 << ",\"latency_max_ms\":" << s.latencyMax
+                      << ",\"playout_ms\":" << s.playoutDelay << ",\"offset_error_ms\":" << offsetError[d]
+                      << ",\"drift_ppm\":" << s.driftPpm << ",\"true_drift_ppm\":" << trueDrift[d] << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    std::cout << "Jam over loopback, " << seconds << " s, " << baseMs << " ms + ~" << jitterMs << " ms jitter, "
+              << lossPercent << "% loss, A's clock gaining " << driftPpm << " ppm:" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int d = 0; d < 2; d++)
+    {
+        const JamStats &s = stats[d];
+        std::cout << "  " << names[d] << "  events " << s.eventsReceived << "  late " << s.late << "  lost " << s.lost
+                  << "  one-way p50 " << s.latencyP50 << "  p99 " << s.latencyP99 << "  max " << s.latencyMax
+                  << " ms  playout " << s.playoutDelay << " ms" << std::endl;
+        std::cout << "          clock offset error " << offsetError[d] << " ms  drift " << s.driftPpm << " ppm (true "
+                  << trueDrift[d] << ")  followed " << s.driftFollowed << " ms" << std::endl;
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << (passed ? "PASS" : "FAIL") << ": notes cross with few late, none lost to single drops, clocks synced"
+              << std::endl;
+    return passed ? 0 : 1;
+}
+
+// MSB-first bit writer for the FLAC fixtures; whole bytes go to `bytes` as soon as they fill
+struct FlacBitWriter
+{
+    std::vector<uint8_t> bytes;
+    uint64_t pending = 0;
+    int pendingBits = 0;
+
+    void put(uint32_t value, int count)
+    {
+        if (count == 0)
+            return;
+        pending = (pending << count) | (count < 32 ? value & ((1u << count) - 1) : value);
+        pendingBits += count;
+        while (pendingBits >= 8)
+        {
+            pendingBits -= 8;
+            bytes.push_back((uint8_t)(pending >> pendingBits));
+        }
+    }
+
+    void putSigned(int32_t value, int count) { put((uint32_t)value, count); }
+
+    void putUnary(uint32_t zeros)
+    {
+        for (; zeros >= 32; zeros -= 32)
+            put(0, 32);
+        put(1, (int)zeros + 1);
+    }
+
+    void putRice(int32_t value, int parameter)
+    {
+        uint32_t folded = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        putUnary(folded >> parameter);
+        put(folded, parameter);
+    }
+
+    void align()
+    {
+        if (pendingBits > 0)
+            put(0, 8 - pendingBits);
+    }
+};
+
+static uint8_t flacCrc8(const uint8_t *data, size_t size)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t flacCrc16(const uint8_t *data, size_t size)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (int b = 0; b < 8; b++)
+            crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+    }
+    return crc;
+}
+
+// Which parts of the format a fixture went through; the suite fails if any were missed
+struct FlacCoverage
+{
+    int subframes[5] = {}; // constant, verbatim, fixed, LPC, with wasted bits
+    int fixedOrders[5] = {};
+    int stereoModes[4] = {}; // independent, left/side, side/right, mid/side
+    int riceMethods[2] = {};
+    int escapes = 0;
+    int maxLpcOrder = 0;
+};
+
+// Partitioned Rice residual: the largest partition order up to 3 that divides the block, each
+// partition with its cheapest parameter, and the first one written raw when `escape` is set
+static void writeResidual(FlacBitWriter &writer, const std::vector<int32_t> &residual, int blockSize, int order,
+                          int method, bool escape, FlacCoverage &coverage)
+{
+    int partitionOrder = 3;
+    while (partitionOrder > 0 && ((blockSize % (1 << partitionOrder)) != 0 || (blockSize >> partitionOrder) < order))
+        partitionOrder--;
+    const int maxParameter = method == 0 ? 14 : 30;
+    writer.put((uint32_t)method, 2);
+    writer.put((uint32_t)partitionOrder, 4);
+    coverage.riceMethods[method]++;
+
+    size_t next = 0;
+    for (int p = 0; p < (1 << partitionOrder); p++)
+    {
+        int count = (blockSize >> partitionOrder) - (p == 0 ? order : 0);
+        const int32_t *values = residual.data() + next;
+        next += count;
+
+        if (escape && p == 0)
+        {
+            int raw = 1;
+            for (int i = 0; i < count; i++)
+            {
+                while (values[i] < -(1LL << (raw - 1)) || values[i] >= (1LL << (raw - 1)))
+                    raw++;
+            }
+            writer.put(method == 0 ? 15 : 31, method == 0 ? 4 : 5);
+            writer.put((uint32_t)raw, 5);
+            for (int i = 0; i < count; i++)
+                writer.putSigned(values[i], raw);
+            coverage.escapes++;
+            continue;
+        }
+
+        int best = 0;
+        uint64_t bestBits = UINT64_MAX;
+        for (int parameter = 0; parameter <= maxParameter; parameter++)
+        {
+            uint64_t bits = (uint64_t)count * (parameter + 1);
+            for (int i = 0; i < count; i++)
+                bits += (((uint32_t)values[i] << 1) ^ (uint32_t)(values[i] >> 31)) >> parameter;
+            if (bits < bestBits)
+            {
+                bestBits = bits;
+                best = parameter;
+            }
+        }
+        writer.put((uint32_t)best, method == 0 ? 4 : 5);
+        for (int i = 0; i < count; i++)
+            writer.putRice(values[i], best);
+    }
+}
+
+// Quantized linear predictor from the block's autocorrelation (Levinson-Durbin), or false when the
+// block is silent or the predictor would overflow the residual
+static bool lpcPredictor(const int32_t *samples, int blockSize, int order, int precision, int32_t *coefficients,
+                         int &shift)
+{
+    double r[33] = {};
+    for (int k = 0; k <= order; k++)
+        for (int i = k; i < blockSize; i++)
+            r[k] += (double)samples[i] * samples[i - k];
+    if (r[0] == 0.0)
+        return false;
+
+    double a[33] = {}, previous[33] = {};
+    double error = r[0] * (1.0 + 1e-9);
+    for (int i = 0; i < order; i++)
+    {
+        double k = r[i + 1];
+        for (int j = 0; j < i; j++)
+            k -= previous[j] * r[i - j];
+        k /= error;
+        a[i] = k;
+        for (int j = 0; j < i; j++)
+            a[j] = previous[j] - k * previous[i - 1 - j];
+        error *= 1.0 - k * k;
+        std::copy(a, a + order, previous);
+    }
+
+    double largest = 0.0;
+    for (int j = 0; j < order; j++)
+        largest = std::max(largest, std::fabs(a[j]));
+    shift = 15;
+    while (shift > 0 && largest * (1 << shift) >= (1 << (precision - 1)) - 1)
+        shift--;
+    for (int j = 0; j < order; j++)
+    {
+        long q = std::lround(a[j] * (1 << shift));
+        coefficients[j] = (int32_t)std::max(-(1L << (precision - 1)), std::min((1L << (precision - 1)) - 1, q));
+    }
+    return true;
+}
+
+// One channel's subframe: constant when the block is, otherwise `kind` (1 verbatim, 8-12 fixed,
+// 32+ LPC of order kind - 31), with any wasted low bits taken out first
+static void writeSubframe(FlacBitWriter &writer, const int32_t *block, int blockSize, int bps, int kind, int method,
+                          bool escape, FlacCoverage &coverage)
+{
+    std::vector<int32_t> samples(block, block + blockSize);
+    bool constant = std::all_of(samples.begin(), samples.end(), [&](int32_t s) { return s == samples[0]; });
+
+    int wasted = 0;
+    uint32_t bitsUsed = 0;
+    for (int32_t s : samples)
+        bitsUsed |= (uint32_t)s;
+    if (!constant && bitsUsed != 0)
+    {
+        while (!(bitsUsed & (1u << wasted)))
+            wasted++;
+        for (int32_t &s : samples)
+            s >>= wasted;
+        bps -= wasted;
+    }
+
+    std::vector<int32_t> residual;
+    int32_t coefficients[32];
+    int shift = 0;
+    const int precision = 14;
+    int order = 0;
+    if (constant)
+    {
+        kind = 0;
+    }
+    else if (kind >= 8 && kind <= 12)
+    {
+        order = kind - 8;
+    }
+    else if (kind >= 32)
+    {
+        order = kind - 31;
+        if (order > blockSize || !lpcPredictor(samples.data(), blockSize, order, precision, coefficients, shift))
+            kind = 1;
+    }
+
+    if (kind >= 8)
+    {
+        for (int i = order; i < blockSize; i++)
+        {
+            const int32_t *s = samples.data() + i;
+            int64_t prediction = 0;
+            if (kind >= 32)
+            {
+                for (int j = 0; j < order; j++)
+                    prediction += (int64_t)coefficients[j] * s[-1 - j];
+                prediction >>= shift;
+            }
+            else if (order == 1)
+                prediction = s[-1];
+            else if (order == 2)
+                prediction = 2 * (int64_t)s[-1] - s[-2];
+            else if (order == 3)
+                prediction = 3 * ((int64_t)s[-1] - s[-2]) + s[-3];
+            else if (order == 4)
+                prediction = 4 * ((int64_t)s[-1] + s[-3]) - 6 * (int64_t)s[-2] - s[-4];
+            int64_t value = *s - prediction;
+            if (value < -(1LL << 30) || value > (1LL << 30))
+            {
+                kind = 1; // this predictor doesn't fit the block; store it as it is
+                break;
+            }
+            residual.push_back((int32_t)value);
+        }
+    }
+
+    writer.put(0, 1);
+    writer.put((uint32_t)kind, 6);
+    if (wasted > 0)
+    {
+        writer.put(1, 1);
+        writer.putUnary((uint32_t)wasted - 1);
+        coverage.subframes[4]++;
+    }
+    else
+    {
+        writer.put(0, 1);
+    }
+
+    if (kind == 0)
+    {
+        writer.putSigned(samples[0], bps);
+        coverage.subframes[0]++;
+        return;
+    }
+    if (kind == 1)
+    {
+        for (int32_t s : samples)
+            writer.putSigned(s, bps);
+        coverage.subframes[1]++;
+        return;
+    }
+
+    for (int i = 0; i < order; i++)
+        writer.putSigned(samples[i], bps);
+    if (kind >= 32)
+    {
+        writer.put(precision - 1, 4);
+        writer.putSigned(shift, 5);
+        for (int j = 0; j < order; j++)
+            writer.putSigned(coefficients[j], precision);
+        coverage.subframes[3]++;
+        coverage.maxLpcOrder = std::max(coverage.maxLpcOrder, order);
+    }
+    else
+    {
+        coverage.subframes[2]++;
+        coverage.fixedOrders[order]++;
+    }
+    writeResidual(writer, residual, blockSize, order, method, escape, coverage);
+}
+
+struct FlacFixture
+{
+    const char *name;
+    int channels;
+    int bitsPerSample;
+    int sampleRate;
+};
+
+static const FlacFixture FLAC_FIXTURES[] = {
+    {"stereo16", 2, 16, 44100},
+    {"mono24", 1, 24, 44100},
+    {"stereo16_48k", 2, 16, 48000},
+};
+
+// Block sizes covering every way a frame header can give one: the 192, 576 and 256 families and
+// 8- and 16-bit explicit sizes, odd ones included
+static const int FIXTURE_BLOCKS[] = {4096, 1152, 192, 1000, 4608, 256, 333, 2304, 576, 17, 8192, 4000};
+static const int FIXTURE_KINDS[] = {1, 8, 9, 10, 11, 12, 32, 39, 43, 63};
+
+// Plucked-string-like test signal: decaying partials and a little noise, one channel slightly
+// detuned from the other. Some blocks are made constant and some lose their low bits.
+static std::vector<int32_t> fixtureSignal(const FlacFixture &fixture, int frames, std::vector<int> &blocks)
+{
+    std::vector<int32_t> pcm((size_t)frames * fixture.channels);
+    const double full = (double)((1 << (fixture.bitsPerSample - 1)) - 1);
+    uint32_t noise = 12345;
+    for (int i = 0; i < frames; i++)
+    {
+        double t = (double)i / fixture.sampleRate;
+        for (int c = 0; c < fixture.channels; c++)
+        {
+            double f = 110.0 * (1.0 + 0.002 * c);
+            double value = 0.0;
+            for (int h = 1; h <= 6; h++)
+                value += std::sin(2.0 * M_PI * f * h * t) * std::exp(-t * h * 1.5) / h;
+            noise = noise * 1664525u + 1013904223u;
+            value = 0.55 * value + 0.01 * ((int32_t)noise / 2147483648.0);
+            pcm[(size_t)i * fixture.channels + c] = (int32_t)std::lround(std::max(-1.0, std::min(1.0, value)) * full);
+        }
+    }
+
+    blocks.clear();
+    int wastedBits = fixture.bitsPerSample > 16 ? 8 : 3;
+    for (int start = 0, f = 0; start < frames; f++)
+    {
+        int size = std::min(FIXTURE_BLOCKS[f % (sizeof(FIXTURE_BLOCKS) / sizeof(FIXTURE_BLOCKS[0]))], frames - start);
+        blocks.push_back(size);
+        for (int i = start; i < start + size; i++)
+        {
+            for (int c = 0; c < fixture.channels; c++)
+            {
+                int32_t &s = pcm[(size_t)i * fixture.channels + c];
+                if (f % 11 == 6)
+                    s = c == 0 ? -77 : 300;
+                else if (f % 7 == 3)
+                    s = (int32_t)((uint32_t)s & ~((1u << wastedBits) - 1));
+            }
+        }
+        start += size;
+    }
+    return pcm;
+}
+
+// Encodes the fixture's signal frame by frame, cycling through subframe kinds, stereo modes, both
+// Rice codings and escaped partitions. Frames carry correct CRCs, so other decoders can check it.
+static bool writeFlacFixture(const std::string &path, const FlacFixture &fixture, const std::vector<int32_t> &pcm,
+                             const std::vector<int> &blocks, FlacCoverage &coverage, size_t &bytes)
+{
+    const int channels = fixture.channels;
+    const int bps = fixture.bitsPerSample;
+    const uint64_t frames = pcm.size() / channels;
+    int largest = *std::max_element(blocks.begin(), blocks.end());
+
+    FlacBitWriter out;
+    for (const char *magic = "fLaC"; *magic; magic++)
+        out.put((uint8_t)*magic, 8);
+    out.put(1, 1); // last metadata block
+    out.put(0, 7); // STREAMINFO
+    out.put(34, 24);
+    out.put(16, 16);
+    out.put((uint32_t)largest, 16);
+    out.put(0, 24); // frame sizes unknown
+    out.put(0, 24);
+    out.put((uint32_t)fixture.sampleRate, 20);
+    out.put((uint32_t)channels - 1, 3);
+    out.put((uint32_t)bps - 1, 5);
+    out.put((uint32_t)(frames >> 32), 4);
+    out.put((uint32_t)frames, 32);
+    for (int i = 0; i < 4; i++)
+        out.put(0, 32); // no MD5
+
+    std::vector<int32_t> sides[2];
+    uint64_t start = 0;
+    for (size_t f = 0; f < blocks.size(); f++)
+    {
+        const int size = blocks[f];
+        FlacBitWriter frame;
+        frame.put(0x3FFE, 14);
+        frame.put(0, 1);
+        frame.put(1, 1); // variable block sizes: the header carries the first sample's number
+
+        int blockCode = size == 192 ? 1 : size <= 256 ? 6 : 7;
+        for (int k = 0; k < 4; k++)
+            blockCode = size == (576 << k) ? 2 + k : blockCode;
+        for (int k = 0; k < 8; k++)
+            blockCode = size == (256 << k) ? 8 + k : blockCode;
+        int mode = channels == 2 ? (int)(f % 4) : 0;
+        static const int ASSIGNMENTS[4] = {1, 8, 9, 10};
+        frame.put((uint32_t)blockCode, 4);
+        frame.put(0, 4); // sample rate from STREAMINFO
+        frame.put((uint32_t)(channels == 2 ? ASSIGNMENTS[mode] : 0), 4);
+        frame.put(0, 3); // sample size from STREAMINFO
+        frame.put(0, 1);
+
+        // Sample number, UTF-8 style
+        if (start < 0x80)
+        {
+            frame.put((uint32_t)start, 8);
+        }
+        else
+        {
+            int extra = 1;
+            while (start >> (6 * extra + 6 - extra) != 0)
+                extra++;
+            frame.put(((0xFF00u >> (extra + 1)) & 0xFF) | (uint32_t)(start >> (6 * extra)), 8);
+            for (int i = extra - 1; i >= 0; i--)
+                frame.put(0x80 | (uint32_t)((start >> (6 * i)) & 0x3F), 8);
+        }
+        if (blockCode == 6)
+            frame.put((uint32_t)size - 1, 8);
+        else if (blockCode == 7)
+            frame.put((uint32_t)size - 1, 16);
+        frame.put(flacCrc8(frame.bytes.data(), frame.bytes.size()), 8);
+
+        // The channels as this frame's stereo mode stores them; side channels are a bit wider
+        for (int c = 0; c < channels; c++)
+        {
+            sides[c].resize(size);
+            for (int i = 0; i < size; i++)
+                sides[c][i] = pcm[(start + i) * channels + c];
+        }
+        int widths[2] = {bps, bps};
+        if (mode > 0)
+        {
+            std::vector<int32_t> left = sides[0], right = sides[1];
+            for (int i = 0; i < size; i++)
+            {
+                int32_t side = left[i] - right[i];
+                sides[0][i] = mode == 1 ? left[i] : mode == 2 ? side : (left[i] + right[i]) >> 1;
+                sides[1][i] = mode == 2 ? right[i] : side;
+            }
+            widths[mode == 2 ? 0 : 1]++;
+        }
+        coverage.stereoModes[mode] += channels == 2 ? 1 : 0;
+
+        for (int c = 0; c < channels; c++)
+        {
+            int kind = FIXTURE_KINDS[(f + c * 3) % (sizeof(FIXTURE_KINDS) / sizeof(FIXTURE_KINDS[0]))];
+            writeSubframe(frame, sides[c].data(), size, widths[c], kind, (int)(f % 2), f % 5 == 2, coverage);
+        }
+        frame.align();
+        uint16_t crc = flacCrc16(frame.bytes.data(), frame.bytes.size());
+        frame.put(crc, 16);
+
+        out.bytes.insert(out.bytes.end(), frame.bytes.begin(), frame.bytes.end());
+        start += size;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(out.bytes.data()), (std::streamsize)out.bytes.size());
+    bytes = out.bytes.size();
+    return (bool)file;
+}
+
+// A fixture played as a library zone: the head from memory, then the disk thread's ring, in
+// engine-sized blocks the way SynthEngine::readStream takes them
+struct StreamedZone
+{
+    const SampleZone *zone;
+    int slot;
+    uint64_t position;
+    bool ended;
+    std::vector<float> played; // every frame delivered, without the silence an underrun plays
+};
+
+int runStreamTest(int argc, char *argv[])
+{
+    int engineRate = 44100;
+    int blockFrames = 256;
+    double seconds = 2.0;
+    double headMs = 1000.0 * SampleLibrary::DEFAULT_HEAD_SECONDS;
+    double speed = 1.0;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            engineRate = std::atoi(argv[++i]);
+        else if (arg == "--frames" && i + 1 < argc)
+            blockFrames = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--head-ms" && i + 1 < argc)
+            headMs = std::atof(argv[++i]);
+        else if (arg == "--speed" && i + 1 < argc)
+            speed = std::atof(argv[++i]);
+    }
+
+    if (engineRate < 8000 || blockFrames < 16 || blockFrames > 4096 || seconds <= 0.0 || seconds > 60.0 ||
+        headMs <= 0.0 || speed <= 0.0)
+    {
+        std::cerr << "Usage: " << argv[0]
+                  << " stream [--seconds S] [--head-ms MS] [--frames N] [--speed X] [--rate N] [--json]" << std::endl;
+        return 1;
+    }
+
+    std::error_code error;
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path(error) /
+        ("guitarbench_stream_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    if (error || !std::filesystem::create_directories(directory, error))
+    {
+        std::cerr << "Can't create a directory for the FLAC fixtures" << std::endl;
+        return 1;
+    }
+
+    // Encode each fixture, then decode it and compare with the PCM it came from
+    const int fixtureCount = (int)(sizeof(FLAC_FIXTURES) / sizeof(FLAC_FIXTURES[0]));
+    FlacCoverage coverage;
+    std::vector<size_t> fileBytes(fixtureCount);
+    std::vector<uint64_t> fileFrames(fixtureCount), decodeMismatches(fixtureCount);
+    std::vector<double> decodeSpeed(fixtureCount);
+    std::vector<bool> seekOk(fixtureCount);
+    std::ofstream manifest(directory / "fixtures.txt");
+    bool written = (bool)manifest;
+    for (int f = 0; f < fixtureCount && written; f++)
+    {
+        const FlacFixture &fixture = FLAC_FIXTURES[f];
+        const std::string path = (directory / (std::string(fixture.name) + ".flac")).string();
+        std::vector<int> blocks;
+        std::vector<int32_t> pcm = fixtureSignal(fixture, (int)(seconds * fixture.sampleRate), blocks);
+        written = writeFlacFixture(path, fixture, pcm, blocks, coverage, fileBytes[f]);
+        manifest << f << " 0 1.0 " << fixture.name << ".flac" << std::endl;
+
+        const float scale = 1.0f / (float)(1u << (fixture.bitsPerSample - 1));
+        FlacReader reader;
+        if (!written || !reader.open(path) || reader.getChannels() != fixture.channels ||
+            reader.getBitsPerSample() != fixture.bitsPerSample || reader.getSampleRate() != fixture.sampleRate)
+        {
+            decodeMismatches[f] = pcm.size();
+            continue;
+        }
+
+        // Odd read sizes, so reads straddle frame boundaries
+        std::vector<float> decoded((size_t)1000 * fixture.channels);
+        size_t compared = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int got; (got = reader.read(decoded.data(), 1000)) > 0;)
+        {
+            for (size_t i = 0; i < (size_t)got * fixture.channels; i++, compared++)
+                decodeMismatches[f] += compared >= pcm.size() || decoded[i] != pcm[compared] * scale ? 1 : 0;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        decodeMismatches[f] += pcm.size() > compared ? pcm.size() - compared : 0;
+        fileFrames[f] = pcm.size() / fixture.channels;
+        decodeSpeed[f] = elapsed > 0.0 ? fileFrames[f] / (double)fixture.sampleRate / elapsed : 0.0;
+
+        // Seeking decodes forward from the start; it must land on the same samples
+        const uint64_t target = fileFrames[f] / 3;
+        int got = reader.seek(target) ? reader.read(decoded.data(), 500) : 0;
+        seekOk[f] = got == 500;
+        for (int i = 0; i < got * fixture.channels && seekOk[f]; i++)
+            seekOk[f] = decoded[i] == pcm[target * fixture.channels + i] * scale;
+    }
+    manifest.close();
+
+    // Then stream every fixture at once as a library zone through the disk thread, in real time
+    // (or `speed` times it), and check each against a plain decode at the engine rate
+    SampleLibrary library;
+    bool loaded = written && library.load((directory / "fixtures.txt").string(), {}, engineRate, (float)(headMs / 1000.0));
+    std::vector<StreamedZone> voices;
+    std::vector<std::vector<float>> references;
+    for (int f = 0; f < fixtureCount && loaded; f++)
+    {
+        const SampleZone *zone = library.find(f, Tuning::STANDARD_NOTES[f], 1.0f);
+        if (!zone || zone->stringIndex != f)
+            continue;
+        voices.push_back({zone, -1, 0, false, {}});
+        references.emplace_back(zone->frames * zone->channels);
+        SampleSource source;
+        if (!source.open(zone->path, engineRate) ||
+            source.read(references.back().data(), (int)zone->frames) != (int)zone->frames)
+            references.back().clear();
+    }
+
+    DiskStreamer streamer(engineRate);
+    std::vector<float> block((size_t)blockFrames * 2);
+    for (StreamedZone &voice : voices)
+    {
+        voice.slot = voice.zone->frames > (uint64_t)voice.zone->headFrames ? streamer.start(voice.zone) : -1;
+        voice.played.reserve(voice.zone->frames * voice.zone->channels);
+    }
+
+    const auto blockTime = std::chrono::duration<double>(blockFrames / (engineRate * speed));
+    const auto start = std::chrono::steady_clock::now();
+    const int maxBlocks = (int)(4.0 * seconds * engineRate / blockFrames) + 100;
+    bool playing = !voices.empty();
+    for (int b = 0; b < maxBlocks && playing; b++)
+    {
+        playing = false;
+        for (StreamedZone &voice : voices)
+        {
+            if (voice.ended)
+                continue;
+            const SampleZone &zone = *voice.zone;
+            const int channels = zone.channels;
+            int count = (int)std::min<uint64_t>(blockFrames, zone.frames - voice.position);
+            int got = 0;
+            if (voice.position < (uint64_t)zone.headFrames)
+            {
+                got = (int)std::min<uint64_t>(count, zone.headFrames - voice.position);
+                std::copy(zone.head.data() + voice.position * channels,
+                          zone.head.data() + (voice.position + got) * channels, block.data());
+            }
+            bool ended = got < count && voice.slot < 0;
+            if (got < count && voice.slot >= 0)
+                got += streamer.read(voice.slot, block.data() + got * channels, count - got, ended);
+            voice.played.insert(voice.played.end(), block.data(), block.data() + got * channels);
+            voice.position += got;
+            voice.ended = ended || voice.position == zone.frames;
+            playing = playing || !voice.ended;
+        }
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                  blockTime * (b + 1)));
+    }
+    for (StreamedZone &voice : voices)
+    {
+        if (voice.slot >= 0)
+            streamer.stop(voice.slot);
+    }
+
+    // The first frame that differs from the plain decode, or -1; the seam is at the head's end
+    std::vector<int64_t> firstGap(voices.size(), -1);
+    for (size_t v = 0; v < voices.size(); v++)
+    {
+        const StreamedZone &voice = voices[v];
+        const std::vector<float> &reference = references[v];
+        size_t length = std::min(voice.played.size(), reference.size());
+        size_t i = std::mismatch(voice.played.begin(), voice.played.begin() + length, reference.begin()).first -
+                   voice.played.begin();
+        if (i < length || voice.played.size() != reference.size() || reference.empty())
+            firstGap[v] = (int64_t)(i / voice.zone->channels);
+    }
+    std::filesystem::remove_all(directory, error);
+
+    bool covered = coverage.subframes[0] > 0 && coverage.subframes[1] > 0 && coverage.subframes[2] > 0 &&
+                   coverage.subframes[3] > 0 && coverage.subframes[4] > 0 && coverage.riceMethods[0] > 0 &&
+                   coverage.riceMethods[1] > 0 && coverage.escapes > 0 && coverage.maxLpcOrder == 32;
+    for (int i = 0; i < 5; i++)
+        covered = covered && coverage.fixedOrders[i] > 0;
+    for (int i = 0; i < 4; i++)
+        covered = covered && coverage.stereoModes[i] > 0;
+    bool passed = written && loaded && covered && (int)voices.size() == fixtureCount &&
+                  streamer.getOpenFailures() == 0 && streamer.getNoFreeSlot() == 0;
+    for (int f = 0; f < fixtureCount; f++)
+        passed = passed && decodeMismatches[f] == 0 && seekOk[f];
+    for (int64_t gap : firstGap)
+        passed = passed && gap < 0;
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"stream\",\"seconds\":" << seconds << ",\"engine_rate\":" << engineRate
+                  << ",\"head_ms\":" << headMs << ",\"speed\":" << speed << ",\"passed\":" << (passed ? "true" : "false")
+                  << ",\"underruns\":" << streamer.getUnderruns() << ",\"starved_frames\":"
+                  << streamer.getStarvedFrames() << ",\"fixtures\":[";
+        for (int f = 0; f < fixtureCount; f++)
+        {
+            std::cout << (f ? "," : "") << "{\"name\":\"" << FLAC_FIXTURES[f].name << "\",\"frames\":" << fileFrames[f]
+                      << ",\"bytes\":" << fileBytes[f] << ",\"mismatches\":" << decodeMismatches[f]
+                      << ",\"seek_ok\":" << (seekOk[f] ? "true" : "false") << ",\"decode_speed\":" << decodeSpeed[f]
+                      << ",\"stream_gap\":" << (f < (int)firstGap.size() ? firstGap[f] : -1) << "}";
+        }
+        std::cout << "]}" << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    std::cout << "FLAC decode against the PCM it was encoded from (constant, verbatim, fixed 0-4 and LPC up to order "
+              << coverage.maxLpcOrder << " subframes, " << coverage.subframes[4] << " with wasted bits, "
+              << (coverage.stereoModes[3] > 0 ? "all four" : "not all") << " stereo modes, both Rice codings, "
+              << coverage.escapes << " escaped partitions):" << std::endl;
+    for (int f = 0; f < fixtureCount; f++)
+    {
+        const FlacFixture &fixture = FLAC_FIXTURES[f];
+        std::cout << "  " << std::left << std::setw(13) << fixture.name << std::right << fixture.channels << " ch "
+                  << fixture.bitsPerSample << " bit " << fixture.sampleRate << " Hz, " << fileFrames[f] << " frames in "
+                  << fileBytes[f] / 1024 << " KiB: " << decodeMismatches[f] << " samples differ, seek "
+                  << (seekOk[f] ? "ok" : "wrong") << ", decoded at " << (int)decodeSpeed[f] << "x real time"
+                  << std::endl;
+    }
+    std::cout << "Streamed together as library zones at " << engineRate << " Hz (" << headMs << " ms heads, "
+              << blockFrames << "-frame blocks, " << speed << "x real time):" << std::endl;
+    for (size_t v = 0; v < voices.size(); v++)
+    {
+        const StreamedZone &voice = voices[v];
+        const size_t playedFrames = voice.played.size() / voice.zone->channels;
+        std::cout << "  " << std::left << std::setw(13) << FLAC_FIXTURES[voice.zone->stringIndex].name << std::right
+                  << voice.zone->headFrames << " head + "
+                  << playedFrames - std::min<size_t>(playedFrames, voice.zone->headFrames) << " streamed frames: ";
+        if (firstGap[v] < 0)
+            std::cout << "continuous across the seam" << std::endl;
+        else
+            std::cout << "differs from frame " << firstGap[v]
+                      << (std::llabs(firstGap[v] - voice.zone->headFrames) <= blockFrames ? ", at the seam" : "")
+                      << std::endl;
+    }
+    std::cout << "  underruns " << streamer.getUnderruns() << " (" << streamer.getStarvedFrames()
+              << " frames played as silence), " << streamer.getFramesDecoded() << " frames decoded by the disk thread"
+              << std::endl;
+    std::cout << (passed ? "PASS" : "FAIL")
+              << ": every fixture decodes to its PCM and streams without a gap or repeat at the head's end" << std::endl;
+    return passed ? 0 : 1;
+}
+
+// A 12-note melody over all six strings, in first position and then up at the sixth, each note
+// where the transcriber should place it: the hand position decides the last three. The opening F
+// only sits at the first fret, so every pass starts back in first position. Each note is let go
+// as the next one is picked and damped quickly, as a monophonic line is played.
+struct MelodyNote
+{
+    double time;
+    int stringIndex;
+    int fret;
+    float velocity;
+    double duration;
+};
+
+static const MelodyNote TEST_MELODY[] = {
+    {0.0, 0, 1, 1.0f, 0.5}, {0.5, 0, 3, 1.0f, 0.5}, {1.0, 1, 2, 1.0f, 0.5}, {1.5, 2, 2, 0.8f, 0.5},
+    {2.0, 3, 0, 1.0f, 0.4}, {2.4, 4, 1, 0.6f, 0.4}, {2.8, 5, 0, 1.0f, 0.4}, {3.2, 5, 9, 0.9f, 0.4},
+    {3.6, 5, 7, 1.0f, 0.4}, {4.0, 4, 9, 0.8f, 0.4}, {4.4, 4, 6, 1.0f, 0.4}, {4.8, 3, 7, 0.7f, 0.4},
+};
+static constexpr double MELODY_SECONDS = 5.5;          // one pass, the last note's release included
+static constexpr double ONSET_TOLERANCE_SECONDS = 0.02; // a few analysis hops
+static constexpr float MELODY_RELEASE_SECONDS = 0.05f;  // a string muted by the fretting hand
+
+int runTranscribeTest(int argc, char *argv[])
+{
+    int sampleRate = 44100;
+    double seconds = 66.0;
+    int threads = 0;
+    bool json = wantsJson(argc, argv);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+    }
+
+    if (sampleRate < 44100 || sampleRate > 192000 || seconds < MELODY_SECONDS || seconds > 3600.0 || threads < 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " transcribe [--seconds S] [--threads N] [--rate N] [--json]"
+                  << std::endl;
+        std::cerr << "  --seconds takes at least one pass of the melody, " << MELODY_SECONDS
+                  << " s; --rate 44100 to 192000" << std::endl;
+        return 1;
+    }
+    if (threads == 0)
+        threads = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    // The melody over and over, so the recording runs across the transcriber's chunk boundaries
+    const int melodyLength = (int)(sizeof(TEST_MELODY) / sizeof(TEST_MELODY[0]));
+    const int passes = (int)(seconds / MELODY_SECONDS);
+    const int frames = (int)(passes * MELODY_SECONDS * sampleRate);
+    std::vector<NoteEvent> events;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        for (const MelodyNote &note : TEST_MELODY)
+        {
+            NoteEvent event = {};
+            event.type = NoteEventType::NoteOn;
+            event.note = (float)(Tuning::STANDARD_NOTES[note.stringIndex] + note.fret);
+            event.velocity = note.velocity;
+            event.stringIndex = note.stringIndex;
+            event.timestamp = (uint64_t)((pass * MELODY_SECONDS + note.time) * sampleRate);
+            events.push_back(event);
+            event.type = NoteEventType::NoteOff;
+            event.timestamp += (uint64_t)(note.duration * sampleRate);
+            events.push_back(event);
+        }
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const NoteEvent &a, const NoteEvent &b) { return a.timestamp < b.timestamp; });
+
+    // Events go in a block ahead, so the queue never holds more than a few
+    SynthEngine engine(sampleRate, Tuning::STRING_COUNT);
+    EnvelopeSettings damped;
+    damped.release = MELODY_RELEASE_SECONDS;
+    engine.setEnvelope(VoiceKind::String, damped);
+    std::vector<float> audio((size_t)frames * 2);
+    const int blockFrames = 512;
+    size_t next = 0;
+    for (int done = 0; done < frames; done += blockFrames)
+    {
+        int count = std::min(blockFrames, frames - done);
+        for (; next < events.size() && events[next].timestamp < (uint64_t)(done + count); next++)
+            engine.queueEvent(events[next]);
+        engine.render(audio.data() + (size_t)done * 2, count);
+    }
+
+    std::error_code error;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path(error) /
+        ("guitarbench_transcribe_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) +
+         ".wav");
+    if (error || !WavFile::write16(path.string(), audio.data(), frames, 2, sampleRate))
+    {
+        std::cerr << "Can't write the rendered melody" << std::endl;
+        return 1;
+    }
+
+    // Once on every thread and once on one: chunks are analysed on their own, so both must agree
+    Transcriber transcriber(threads);
+    auto start = std::chrono::steady_clock::now();
+    bool transcribed = transcriber.transcribe(path.string());
+    double parallelSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Transcriber serial(1);
+    start = std::chrono::steady_clock::now();
+    transcribed = transcribed && serial.transcribe(path.string());
+    double serialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::filesystem::remove(path, error);
+
+    const std::vector<TranscribedNote> &notes = transcriber.getNotes();
+    const std::vector<TranscribedNote> &serialNotes = serial.getNotes();
+    bool sameOnOneThread = notes.size() == serialNotes.size();
+    for (size_t i = 0; i < notes.size() && sameOnOneThread; i++)
+    {
+        const TranscribedNote &a = notes[i];
+        const TranscribedNote &b = serialNotes[i];
+        sameOnOneThread = a.time == b.time && a.duration == b.duration && a.note == b.note &&
+                          a.stringIndex == b.stringIndex && a.fret == b.fret && a.velocity == b.velocity;
+    }
+
+    // Note for note against the melody: pitch, then the string and fret it was placed on, then the onset
+    const int expected = passes * melodyLength;
+    int wrongNote = 0;
+    int wrongPlace = 0;
+    int lateOnsets = 0;
+    int firstWrong = -1;
+    double worstOnset = 0.0;
+    for (int i = 0; i < std::min(expected, (int)notes.size()); i++)
+    {
+        const MelodyNote &played = TEST_MELODY[i % melodyLength];
+        const TranscribedNote &heard = notes[i];
+        double onsetError = std::fabs(heard.time - ((i / melodyLength) * MELODY_SECONDS + played.time));
+        bool noteOk = heard.note == Tuning::STANDARD_NOTES[played.stringIndex] + played.fret;
+        bool placeOk = heard.stringIndex == played.stringIndex && heard.fret == played.fret;
+        wrongNote += noteOk ? 0 : 1;
+        wrongPlace += noteOk && !placeOk ? 1 : 0;
+        lateOnsets += onsetError > ONSET_TOLERANCE_SECONDS ? 1 : 0;
+        worstOnset = std::max(worstOnset, onsetError);
+        if (firstWrong < 0 && (!noteOk || !placeOk || onsetError > ONSET_TOLERANCE_SECONDS))
+            firstWrong = i;
+    }
+    if (firstWrong < 0 && (int)notes.size() != expected)
+        firstWrong = std::min(expected, (int)notes.size());
+
+    const double audioSeconds = (double)frames / sampleRate;
+    const double parallelSpeed = parallelSeconds > 0.0 ? audioSeconds / parallelSeconds : 0.0;
+    const double serialSpeed = serialSeconds > 0.0 ? audioSeconds / serialSeconds : 0.0;
+    bool passed = transcribed && (int)notes.size() == expected && wrongNote == 0 && wrongPlace == 0 &&
+                  lateOnsets == 0 && transcriber.getDroppedNotes() == 0 && sameOnOneThread;
+
+    if (json)
+    {
+        std::cout << "{\"suite\":\"transcribe\",\"rate\":" << sampleRate << ",\"seconds\":" << audioSeconds
+                  << ",\"threads\":" << threads << ",\"passed\":" << (passed ? "true" : "false")
+                  << ",\"expected_notes\":" << expected << ",\"transcribed_notes\":" << notes.size()
+                  << ",\"wrong_notes\":" << wrongNote << ",\"wrong_places\":" << wrongPlace
+                  << ",\"late_onsets\":" << lateOnsets << ",\"worst_onset_ms\":" << worstOnset * 1000.0
+                  << ",\"same_on_one_thread\":" << (sameOnOneThread ? "true" : "false")
+                  << ",\"realtime_factor\":" << parallelSpeed << ",\"realtime_factor_one_thread\":" << serialSpeed
+                  << "}" << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    std::cout << "Transcription of a " << melodyLength << "-note melody rendered by SynthEngine, " << passes
+              << " passes in " << audioSeconds << " s at " << sampleRate << " Hz (" << Transcriber::CHUNK_SECONDS
+              << " s chunks):" << std::endl;
+    std::cout << "  notes " << notes.size() << " of " << expected << ", wrong pitch " << wrongNote
+              << ", wrong string or fret " << wrongPlace << ", onsets off by more than "
+              << ONSET_TOLERANCE_SECONDS * 1000.0 << " ms " << lateOnsets << " (worst " << std::fixed
+              << std::setprecision(1) << worstOnset * 1000.0 << " ms)" << std::endl;
+    if (firstWrong >= 0)
+    {
+        const MelodyNote &played = TEST_MELODY[firstWrong % melodyLength];
+        std::cout << "  first difference at note " << firstWrong << ": played string " << played.stringIndex
+                  << " fret " << played.fret;
+        if (firstWrong < (int)notes.size())
+            std::cout << ", heard note " << notes[firstWrong].note << " on string " << notes[firstWrong].stringIndex
+                      << " fret " << notes[firstWrong].fret << " at " << std::setprecision(3)
+                      << notes[firstWrong].time << " s";
+        else
+            std::cout << ", not heard";
+        std::cout << std::endl;
+    }
+    std::cout << std::setprecision(0) << "  " << threads << (threads == 1 ? " thread: " : " threads: ") << parallelSpeed
+              << "x real time; again on 1 thread: "
+              << serialSpeed << "x real time, " << (sameOnOneThread ? "same notes" : "different notes") << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
+    std::cout << (passed ? "PASS" : "FAIL")
+              << ": the melody comes back note for note, on its strings and frets, whatever the thread count"
+              << std::endl;
+    return passed ? 0 : 1;
+}
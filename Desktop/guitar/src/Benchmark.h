@@ -0,0 +1,77 @@
+#pragma once
+
+// Headless DSP benchmarks, run without a window or an audio device.
+
+// ElectricGuitar3D --bench-fx [--frames N] [--voices N] [--seconds S] [--rate N]
+// Checks the amp chain's SIMD paths against the scalar one, measures how much aliasing the
+// oversampling removes, and times synth + amp per audio callback against the buffer deadline.
+int runEffectBenchmark(int argc, char *argv[]);
+
+// ElectricGuitar3D --bench-conv [--ir cabinet.wav] [--frames N] [--seconds S] [--rate N]
+// Checks the partitioned convolver against direct convolution, then reports latency and
+// per-callback CPU for each partition size, with a file IR or synthetic short and long ones.
+int runConvolutionBenchmark(int argc, char *argv[]);
+
+// ElectricGuitar3D --bench-notes [--voices N] [--frames N] [--seconds S] [--rate N]
+// Compares the mono note bank panned at mix with the old interleaved-stereo int16 chunks:
+// memory of the whole fretboard, output parity, and the cost of mixing N playing notes.
+int runNoteBankBenchmark(int argc, char *argv[]);
+
+// GuitarBench dsp [--frames N] [--voices N] [--seconds S] [--rate N] [--json]
+// Times the synthesis building blocks one at a time: the tone kernel on each SIMD path, string
+// voices sustained and re-plucked (note-on plus choke fade), live ADSR tones, strings and tones
+// gliding under a moving whammy, panned sample mixing, the float to int16/float device conversion,
+// and AudioManager's note-bank miss and lookup.
+int runDspBenchmark(int argc, char *argv[]);
+
+// GuitarBench stress [--frames N]... [--kind string|sample|both] [--seconds S] [--retries N]
+//                    [--max-voices N] [--rate N] [--json]
+// Adds voices to one engine, up to its VOICE_CAPACITY pool or --max-voices, until one callback
+// (engine mix + int16 output) takes longer than its buffer lasts. Reports the most voices that
+// still fit for each buffer size, the CPU each one costs, and how many times over a full pool
+// would fit in the deadline.
+int runVoiceStressTest(int argc, char *argv[]);
+
+// GuitarBench resample [--frames N] [--seconds S] [--json]
+// The polyphase resampler against SDL_AudioStream for the common device rate pairs: streaming cost per
+// output frame at the callback's block size, SNR of converted tones, and how much of a tone between the
+// two Nyquist frequencies survives a downsample.
+int runResamplerBenchmark(int argc, char *argv[]);
+
+// GuitarBench onset [--frames N] [--clicks N] [--interval MS] [--jitter MS] [--rate N] [--json]
+// Evenly spaced clicks through a simulated device schedule, 60 Hz event polling and the engine:
+// how far each onset's spacing drifts from the clicks' when notes start at the next block and when
+// they are scheduled from the event timestamp. Fails when scheduled onsets are off by more than the
+// millisecond stamps explain.
+int runOnsetJitterTest(int argc, char *argv[]);
+
+// GuitarBench embed [--seconds S] [--rate N] [--json]
+// Plays the same strums through the C API (GuitarSynth.h) in uneven host blocks, interleaved and
+// planar, and through SynthEngine directly. Fails unless all three match sample for sample and
+// nothing touches the heap between guitar_synth_create and guitar_synth_destroy.
+int runEmbedTest(int argc, char *argv[]);
+
+// GuitarBench jam [--seconds S] [--delay MS] [--jitter MS] [--loss PCT] [--drift PPM] [--late PCT] [--frames N]
+//                 [--rate N] [--json]
+// Two jam sessions on loopback, each with an engine rendering in real time, through a relay that
+// delays and drops packets; one side's clock is offset and drifting. Both play strums and bends.
+// Reports one-way latency, late and lost events and the clock sync against the true skew, and fails
+// when single drops lose notes, more notes are late than the target allows, or the clocks are off.
+// Runs shorter than the 8 s the drift fit takes to settle are refused.
+int runJamTest(int argc, char *argv[]);
+
+// GuitarBench stream [--seconds S] [--head-ms MS] [--frames N] [--speed X] [--rate N] [--json]
+// Encodes FLAC fixtures covering every subframe type, wasted bits, the stereo modes and both Rice
+// codings, and checks that FlacReader decodes them to the PCM they came from. Then streams them
+// all at once as library zones through DiskStreamer, head first, and fails on any gap or repeat at
+// the seam or later. Underruns are reported, not failed: they depend on the machine.
+int runStreamTest(int argc, char *argv[]);
+
+// GuitarBench transcribe [--seconds S] [--threads N] [--rate N] [--json]
+// Renders a 12-note melody on SynthEngine, played damped as a monophonic line, pass after pass
+// past the 30 s chunk boundaries, and transcribes the WAV. Fails unless every note comes back with its pitch, string, fret and
+// onset, and the same notes come out on one thread as on many.
+int runTranscribeTest(int argc, char *argv[]);
+
+// Heap allocations made so far by any thread; GuitarBench counts them, elsewhere it is null
+extern long (*benchAllocationCount)();
@@ -0,0 +1,87 @@
+#pragma once
+#include "Tuning.h"
+
+// A fretting for every string, low E to high E; -1 leaves the string out of the strum
+struct ChordShape
+{
+    const char *name;
+    int frets[Tuning::STRING_COUNT];
+};
+
+// A shape resolved against a tuning: the MIDI note each string plays, -1 for strings left out
+struct ChordVoicing
+{
+    const char *name;
+    int notes[Tuning::STRING_COUNT];
+};
+
+// Which end of the neck a strum starts from
+enum class StrumDirection
+{
+    Down, // low E first
+    Up    // high E first
+};
+
+// Named open-position chords. Everything here is constexpr, so Chords::named("G") in a
+// constant expression costs nothing at run time and a misspelt name fails to compile.
+struct Chords
+{
+    static constexpr ChordShape SHAPES[] = {
+        {"C", {-1, 3, 2, 0, 1, 0}},
+        {"D", {-1, -1, 0, 2, 3, 2}},
+        {"E", {0, 2, 2, 1, 0, 0}},
+        {"F", {1, 3, 3, 2, 1, 1}},
+        {"G", {3, 2, 0, 0, 0, 3}},
+        {"A", {-1, 0, 2, 2, 2, 0}},
+        {"Am", {-1, 0, 2, 2, 1, 0}},
+        {"Dm", {-1, -1, 0, 2, 3, 1}},
+        {"Em", {0, 2, 2, 0, 0, 0}},
+        {"C7", {-1, 3, 2, 3, 1, 0}},
+        {"D7", {-1, -1, 0, 2, 1, 2}},
+        {"E7", {0, 2, 0, 1, 0, 0}},
+        {"G7", {3, 2, 0, 0, 0, 1}},
+        {"A7", {-1, 0, 2, 0, 2, 0}},
+        {"B7", {-1, 2, 1, 2, 0, 2}},
+    };
+    static constexpr int SHAPE_COUNT = (int)(sizeof(SHAPES) / sizeof(SHAPES[0]));
+
+    static constexpr bool sameName(const char *a, const char *b)
+    {
+        while (*a && *a == *b)
+        {
+            a++;
+            b++;
+        }
+        return *a == *b;
+    }
+
+    // Index into SHAPES, -1 when there is no such chord
+    static constexpr int find(const char *name)
+    {
+        for (int i = 0; i < SHAPE_COUNT; i++)
+        {
+            if (sameName(SHAPES[i].name, name))
+                return i;
+        }
+        return -1;
+    }
+
+    static constexpr ChordVoicing resolve(const ChordShape &shape,
+                                          const int (&openNotes)[Tuning::STRING_COUNT] = Tuning::STANDARD_NOTES)
+    {
+        ChordVoicing voicing = {shape.name, {}};
+        for (int s = 0; s < Tuning::STRING_COUNT; s++)
+            voicing.notes[s] = shape.frets[s] < 0 ? -1 : openNotes[s] + shape.frets[s];
+        return voicing;
+    }
+
+    // Shape by name in standard tuning; only usable with names that exist
+    static constexpr ChordVoicing named(const char *name)
+    {
+        return find(name) >= 0 ? resolve(SHAPES[find(name)]) : throw "unknown chord name";
+    }
+};
+
+static_assert(Chords::named("C").notes[1] == 48 && Chords::named("C").notes[5] == 64, "C major resolves to C3..E4");
+static_assert(Chords::named("G").notes[0] == 43 && Chords::named("G").notes[5] == 67, "G major resolves to G2..G4");
+static_assert(Chords::find("H") < 0, "unknown names are not found");
@@ -0,0 +1,277 @@
+#include "Convolver.h"
+#include "CpuFeatures.h"
+#include "Resampler.h"
+#include "WavFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// acc += x * h over split complex arrays
+static void multiplyAccumulateScalar(float *accRe, float *accIm, const float *xRe, const float *xIm,
+                                     const float *hRe, const float *hIm, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+        accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+    }
+}
+
+#if defined(GUITAR_SIMD_X86)
+
+GUITAR_TARGET_SSE2 static void multiplyAccumulateSSE2(float *accRe, float *accIm, const float *xRe, const float *xIm,
+                                                      const float *hRe, const float *hIm, int count)
+{
+    // count is a multiple of 8
+    for (int k = 0; k < count; k += 4)
+    {
+        __m128 xr = _mm_loadu_ps(xRe + k);
+        __m128 xi = _mm_loadu_ps(xIm + k);
+        __m128 hr = _mm_loadu_ps(hRe + k);
+        __m128 hi = _mm_loadu_ps(hIm + k);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+        __m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+        _mm_storeu_ps(accRe + k, _mm_add_ps(_mm_loadu_ps(accRe + k), re));
+        _mm_storeu_ps(accIm + k, _mm_add_ps(_mm_loadu_ps(accIm + k), im));
+    }
+}
+
+GUITAR_TARGET_AVX2 static void multiplyAccumulateAVX2(float *accRe, float *accIm, const float *xRe, const float *xIm,
+                                                      const float *hRe, const float *hIm, int count)
+{
+    for (int k = 0; k < count; k += 8)
+    {
+        __m256 xr = _mm256_loadu_ps(xRe + k);
+        __m256 xi = _mm256_loadu_ps(xIm + k);
+        __m256 hr = _mm256_loadu_ps(hRe + k);
+        __m256 hi = _mm256_loadu_ps(hIm + k);
+        __m256 re = _mm256_fnmadd_ps(xi, hi, _mm256_fmadd_ps(xr, hr, _mm256_loadu_ps(accRe + k)));
+        __m256 im = _mm256_fmadd_ps(xi, hr, _mm256_fmadd_ps(xr, hi, _mm256_loadu_ps(accIm + k)));
+        _mm256_storeu_ps(accRe + k, re);
+        _mm256_storeu_ps(accIm + k, im);
+    }
+}
+
+#endif
+
+static void multiplyAccumulate(float *accRe, float *accIm, const float *xRe, const float *xIm,
+                               const float *hRe, const float *hIm, int count)
+{
+#if defined(GUITAR_SIMD_X86)
+    static const bool useAVX2 = cpuHasAVX2();
+    static const bool useSSE2 = cpuHasSSE2();
+    if (useAVX2)
+        multiplyAccumulateAVX2(accRe, accIm, xRe, xIm, hRe, hIm, count);
+    else if (useSSE2)
+        multiplyAccumulateSSE2(accRe, accIm, xRe, xIm, hRe, hIm, count);
+    else
+        multiplyAccumulateScalar(accRe, accIm, xRe, xIm, hRe, hIm, count);
+#else
+    multiplyAccumulateScalar(accRe, accIm, xRe, xIm, hRe, hIm, count);
+#endif
+}
+
+static int clampPartition(int size)
+{
+    int partition = PartitionedConvolver::MIN_PARTITION;
+    while (partition < size && partition < PartitionedConvolver::MAX_PARTITION)
+        partition *= 2;
+    return partition;
+}
+
+PartitionedConvolver::PartitionedConvolver(int partitionSize)
+    : partition_(clampPartition(partitionSize)), binStride_((partition_ + 1 + 7) & ~7),
+      partitionCount_(0), length_(0), fft_(2 * partition_), newest_(0), fill_(0)
+{
+    for (auto &channel : channels_)
+    {
+        channel.input.assign(2 * partition_, 0.0f);
+        channel.output.assign(partition_, 0.0f);
+    }
+    time_.assign(2 * partition_, 0.0f);
+    accRe_.assign(binStride_, 0.0f);
+    accIm_.assign(binStride_, 0.0f);
+}
+
+bool PartitionedConvolver::setImpulseResponse(const float *ir, int length)
+{
+    if (!ir || length < 1)
+        return false;
+
+    length_ = length;
+    partitionCount_ = (length + partition_ - 1) / partition_;
+
+    irRe_.assign((size_t)partitionCount_ * binStride_, 0.0f);
+    irIm_.assign((size_t)partitionCount_ * binStride_, 0.0f);
+    for (auto &channel : channels_)
+    {
+        channel.delayRe.assign((size_t)partitionCount_ * binStride_, 0.0f);
+        channel.delayIm.assign((size_t)partitionCount_ * binStride_, 0.0f);
+    }
+
+    // Each partition is zero-padded to the FFT size, so the circular products don't wrap
+    std::vector<float> padded(2 * partition_);
+    for (int p = 0; p < partitionCount_; p++)
+    {
+        std::fill(padded.begin(), padded.end(), 0.0f);
+        int count = std::min(partition_, length - p * partition_);
+        std::copy(ir + p * partition_, ir + p * partition_ + count, padded.begin());
+        fft_.forward(padded.data(), &irRe_[(size_t)p * binStride_], &irIm_[(size_t)p * binStride_]);
+    }
+
+    reset();
+    return true;
+}
+
+bool PartitionedConvolver::loadImpulseResponse(const std::string &path, int sampleRate)
+{
+    std::vector<float> samples;
+    int channels = 0;
+    int fileRate = 0;
+    if (!WavFile::read(path, samples, channels, fileRate))
+        return false;
+
+    int frames = (int)samples.size() / channels;
+    if (frames < 1)
+    {
+        std::cerr << "Impulse response is empty: " << path << std::endl;
+        return false;
+    }
+
+    // Cabinets are mono; stereo IRs are averaged
+    std::vector<float> mono(frames);
+    for (int i = 0; i < frames; i++)
+    {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++)
+            sum += samples[i * channels + c];
+        mono[i] = sum / channels;
+    }
+
+    // The same sinc converter as the output stage, so a 48 kHz cabinet at 44.1 kHz keeps its top octave
+    // instead of picking up linear interpolation's aliasing; level is set by the normalization below
+    if (fileRate != sampleRate)
+    {
+        std::vector<float> resampled;
+        if (!Resampler::convert(mono, 1, fileRate, sampleRate, resampled))
+        {
+            std::cerr << "Can't resample impulse response from " << fileRate << " Hz: " << path << std::endl;
+            return false;
+        }
+        mono.swap(resampled);
+    }
+
+    // Unit energy keeps a broadband signal at the same level whichever cabinet is loaded
+    double energy = 0.0;
+    for (float value : mono)
+        energy += (double)value * value;
+    if (energy <= 0.0)
+    {
+        std::cerr << "Impulse response is silent: " << path << std::endl;
+        return false;
+    }
+    float gain = (float)(1.0 / std::sqrt(energy));
+    for (float &value : mono)
+        value *= gain;
+
+    return setImpulseResponse(mono.data(), (int)mono.size());
+}
+
+void PartitionedConvolver::reset()
+{
+    for (auto &channel : channels_)
+    {
+        std::fill(channel.delayRe.begin(), channel.delayRe.end(), 0.0f);
+        std::fill(channel.delayIm.begin(), channel.delayIm.end(), 0.0f);
+        std::fill(channel.input.begin(), channel.input.end(), 0.0f);
+        std::fill(channel.output.begin(), channel.output.end(), 0.0f);
+    }
+    newest_ = 0;
+    fill_ = 0;
+}
+
+void PartitionedConvolver::processPartition(Channel &channel)
+{
+    // The newest input spectrum goes into the delay line slot the oldest one leaves;
+    // newest_ has already moved on for this partition
+    fft_.forward(channel.input.data(), &channel.delayRe[(size_t)newest_ * binStride_],
+                 &channel.delayIm[(size_t)newest_ * binStride_]);
+
+    std::fill(accRe_.begin(), accRe_.end(), 0.0f);
+    std::fill(accIm_.begin(), accIm_.end(), 0.0f);
+
+    // Y = sum over p of X[now - p] * H[p]
+    int slot = newest_;
+    for (int p = 0; p < partitionCount_; p++)
+    {
+        size_t x = (size_t)slot * binStride_;
+        size_t h = (size_t)p * binStride_;
+        multiplyAccumulate(accRe_.data(), accIm_.data(), &channel.delayRe[x], &channel.delayIm[x], &irRe_[h],
+                           &irIm_[h], binStride_);
+        slot = (slot == 0) ? partitionCount_ - 1 : slot - 1;
+    }
+
+    // Overlap-save: only the second half of the circular result is the linear convolution
+    fft_.inverse(accRe_.data(), accIm_.data(), time_.data());
+    std::memcpy(channel.output.data(), time_.data() + partition_, partition_ * sizeof(float));
+    std::memmove(channel.input.data(), channel.input.data() + partition_, partition_ * sizeof(float));
+}
+
+void PartitionedConvolver::process(float *samples, int frames)
+{
+    if (partitionCount_ == 0)
+        return;
+
+    Channel &channel = channels_[0];
+    int offset = 0;
+    while (offset < frames)
+    {
+        int count = std::min(frames - offset, partition_ - fill_);
+        std::memcpy(channel.input.data() + partition_ + fill_, samples + offset, count * sizeof(float));
+        std::memcpy(samples + offset, channel.output.data() + fill_, count * sizeof(float));
+        fill_ += count;
+        offset += count;
+
+        if (fill_ == partition_)
+        {
+            newest_ = (newest_ + 1) % partitionCount_;
+            processPartition(channel);
+            fill_ = 0;
+        }
+    }
+}
+
+void PartitionedConvolver::processStereo(float *interleaved, int frames)
+{
+    if (partitionCount_ == 0)
+        return;
+
+    int offset = 0;
+    while (offset < frames)
+    {
+        int count = std::min(frames - offset, partition_ - fill_);
+        float *block = interleaved + offset * 2;
+        for (int c = 0; c < 2; c++)
+        {
+            Channel &channel = channels_[c];
+            float *input = channel.input.data() + partition_ + fill_;
+            const float *output = channel.output.data() + fill_;
+            for (int i = 0; i < count; i++)
+            {
+                input[i] = block[i * 2 + c];
+                block[i * 2 + c] = output[i];
+            }
+        }
+        fill_ += count;
+        offset += count;
+
+        if (fill_ == partition_)
+        {
+            newest_ = (newest_ + 1) % partitionCount_;
+            processPartition(channels_[0]);
+            processPartition(channels_[1]);
+            fill_ = 0;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Fft.h"
+
+// Uniformly partitioned FFT convolution (overlap-save) for long impulse responses such as
+// speaker cabinets. The IR is cut into partitions of the block size, each one transformed
+// once up front; every block then costs one forward FFT, one inverse FFT and a spectral
+// multiply-accumulate against the frequency-domain delay line.
+// Output is delayed by exactly one partition.
+class PartitionedConvolver
+{
+public:
+    static constexpr int DEFAULT_PARTITION = 256;
+    static constexpr int MIN_PARTITION = 32;
+    static constexpr int MAX_PARTITION = 8192;
+
+private:
+    int partition_;
+    int binStride_; // partition + 1 spectral bins, rounded up to whole SIMD registers
+    int partitionCount_;
+    int length_;
+    Fft fft_;
+
+    // One side's signal path; stereo runs both against the same IR spectra, in step
+    struct Channel
+    {
+        std::vector<float> delayRe; // delay line of input spectra, partition after partition
+        std::vector<float> delayIm;
+        std::vector<float> input;   // previous block followed by the block being filled
+        std::vector<float> output;  // last finished block, played out while the next one fills
+    };
+
+    // IR spectra, partition after partition
+    std::vector<float> irRe_;
+    std::vector<float> irIm_;
+    Channel channels_[2];
+    int newest_; // delay line slot of the latest input spectrum
+
+    std::vector<float> time_;
+    std::vector<float> accRe_;
+    std::vector<float> accIm_;
+    int fill_;
+
+    void processPartition(Channel &channel);
+
+public:
+    explicit PartitionedConvolver(int partitionSize = DEFAULT_PARTITION);
+
+    // Not real-time safe: allocates and transforms every partition
+    bool setImpulseResponse(const float *ir, int length);
+
+    // WAV file mixed to mono, resampled to the engine rate and normalized to unit energy
+    bool loadImpulseResponse(const std::string &path, int sampleRate);
+
+    // Audio thread: mono in place, or interleaved stereo with each side through the cabinet
+    void process(float *samples, int frames);
+    void processStereo(float *interleaved, int frames);
+
+    void reset();
+
+    bool isLoaded() const { return partitionCount_ > 0; }
+    int getPartitionSize() const { return partition_; }
+    int getPartitionCount() const { return partitionCount_; }
+    int getLength() const { return length_; }
+    int getLatencyFrames() const { return partition_; }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+// Runtime CPU feature detection for the SIMD audio kernels.
+// Kernels are compiled with per-function target attributes so the rest of
+// the program keeps building for the baseline instruction set.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GUITAR_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(GUITAR_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define GUITAR_TARGET_SSE2 __attribute__((target("sse2")))
+#define GUITAR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define GUITAR_TARGET_SSE2
+#define GUITAR_TARGET_AVX2
+#endif
+
+inline bool cpuHasSSE2()
+{
+#if defined(GUITAR_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_cpu_supports("sse2");
+#elif defined(_M_X64)
+    return true;
+#elif defined(GUITAR_SIMD_X86)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return false;
+#endif
+}
+
+inline bool cpuHasAVX2()
+{
+#if defined(GUITAR_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(GUITAR_SIMD_X86)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    bool hasFma = (info[2] & (1 << 12)) != 0;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && hasFma && (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,158 @@
+#include "DiskStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+DiskStreamer::DiskStreamer(int engineRate)
+    : engineRate_(engineRate), slots_(new Slot[SLOTS]), nextSlot_(0), running_(true), streamsStarted_(0),
+      underruns_(0), starvedFrames_(0), noFreeSlot_(0), openFailures_(0), framesDecoded_(0)
+{
+    for (int i = 0; i < SLOTS; i++)
+    {
+        Slot &slot = slots_[i];
+        slot.busy.store(false);
+        slot.finished.store(false);
+        slot.written.store(0);
+        slot.consumed.store(0);
+        slot.ring.assign((size_t)RING_FRAMES * 2, 0.0f);
+        slot.channels = 1;
+    }
+    thread_ = std::thread(&DiskStreamer::run, this);
+}
+
+DiskStreamer::~DiskStreamer()
+{
+    running_.store(false, std::memory_order_release);
+    if (thread_.joinable())
+        thread_.join();
+}
+
+int DiskStreamer::start(const SampleZone *zone)
+{
+    for (int n = 0; n < SLOTS; n++)
+    {
+        int index = (nextSlot_ + n) % SLOTS;
+        Slot &slot = slots_[index];
+        if (slot.busy.load(std::memory_order_acquire))
+            continue;
+
+        slot.busy.store(true, std::memory_order_relaxed);
+        slot.channels = zone->channels;
+        if (!commands_.push({CommandType::Start, index, zone}))
+        {
+            slot.busy.store(false, std::memory_order_relaxed);
+            break;
+        }
+        nextSlot_ = (index + 1) % SLOTS;
+        streamsStarted_.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    // Every slot is playing or still being released by the disk thread
+    noFreeSlot_.fetch_add(1, std::memory_order_relaxed);
+    return -1;
+}
+
+int DiskStreamer::read(int index, float *samples, int frames, bool &ended)
+{
+    Slot &slot = slots_[index];
+
+    // finished first: once it is seen, `written` is final
+    bool finished = slot.finished.load(std::memory_order_acquire);
+    uint64_t written = slot.written.load(std::memory_order_acquire);
+    uint64_t consumed = slot.consumed.load(std::memory_order_relaxed);
+
+    int count = (int)std::min<uint64_t>(written - consumed, (uint64_t)std::max(frames, 0));
+    int offset = (int)(consumed % RING_FRAMES);
+    int first = std::min(count, RING_FRAMES - offset);
+    std::memcpy(samples, slot.ring.data() + (size_t)offset * slot.channels, (size_t)first * slot.channels * sizeof(float));
+    std::memcpy(samples + (size_t)first * slot.channels, slot.ring.data(),
+                (size_t)(count - first) * slot.channels * sizeof(float));
+    slot.consumed.store(consumed + count, std::memory_order_release);
+
+    ended = finished && consumed + count == written;
+    if (count < frames && !ended)
+    {
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+        starvedFrames_.fetch_add((uint64_t)(frames - count), std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void DiskStreamer::stop(int index)
+{
+    // Can't fail: a slot has at most one start and one stop queued, and the queue holds all of them
+    commands_.push({CommandType::Stop, index, nullptr});
+}
+
+void DiskStreamer::handle(const Command &command)
+{
+    Slot &slot = slots_[command.slot];
+    if (command.type == CommandType::Start)
+    {
+        // The voice is already playing the head, so the stream picks up right after it
+        slot.source = std::make_unique<SampleSource>();
+        if (!slot.source->open(command.zone->path, engineRate_) || slot.source->getChannels() != slot.channels ||
+            !slot.source->skip((uint64_t)command.zone->headFrames))
+        {
+            openFailures_.fetch_add(1, std::memory_order_relaxed);
+            slot.source.reset();
+            slot.finished.store(true, std::memory_order_release);
+        }
+        return;
+    }
+
+    slot.source.reset();
+    slot.written.store(0, std::memory_order_relaxed);
+    slot.consumed.store(0, std::memory_order_relaxed);
+    slot.finished.store(false, std::memory_order_relaxed);
+    slot.busy.store(false, std::memory_order_release);
+}
+
+bool DiskStreamer::fill(Slot &slot)
+{
+    if (!slot.source)
+        return false;
+
+    uint64_t written = slot.written.load(std::memory_order_relaxed);
+    uint64_t consumed = slot.consumed.load(std::memory_order_acquire);
+    int space = RING_FRAMES - (int)(written - consumed);
+    if (space < CHUNK_FRAMES)
+        return false;
+
+    int offset = (int)(written % RING_FRAMES);
+    int first = std::min(CHUNK_FRAMES, RING_FRAMES - offset);
+    int count = slot.source->read(slot.ring.data() + (size_t)offset * slot.channels, first);
+    if (count == first && first < CHUNK_FRAMES)
+        count += slot.source->read(slot.ring.data(), CHUNK_FRAMES - first);
+
+    if (count > 0)
+    {
+        slot.written.store(written + count, std::memory_order_release);
+        framesDecoded_.fetch_add((uint64_t)count, std::memory_order_relaxed);
+    }
+    if (count < CHUNK_FRAMES)
+    {
+        slot.source.reset();
+        slot.finished.store(true, std::memory_order_release);
+    }
+    return true;
+}
+
+void DiskStreamer::run()
+{
+    while (running_.load(std::memory_order_acquire))
+    {
+        Command command;
+        while (commands_.pop(command))
+            handle(command);
+
+        // One chunk per slot per pass keeps a new note from waiting behind a long refill
+        bool worked = false;
+        for (int i = 0; i < SLOTS; i++)
+            worked = fill(slots_[i]) || worked;
+
+        if (!worked)
+            std::this_thread::sleep_for(std::chrono::microseconds(IDLE_MICROS));
+    }
+}
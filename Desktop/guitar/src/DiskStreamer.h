@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "NoteEventQueue.h"
+#include "SampleLibrary.h"
+
+// Background disk reader for multisample voices. A voice plays its zone's resident head while the
+// disk thread opens the file, skips the head and keeps a per-voice ring ahead of playback.
+// The audio thread only claims and releases slots, reads rings and pushes commands: it never
+// waits, allocates or touches a file. A ring that runs dry plays silence and counts an underrun.
+class DiskStreamer
+{
+public:
+    static constexpr int SLOTS = 64;           // one per engine voice (SynthEngine::VOICE_CAPACITY)
+    static constexpr int RING_FRAMES = 16384;  // per slot; ~0.37 s at 44.1 kHz
+    static constexpr int CHUNK_FRAMES = 2048;  // decoded per visit to a slot
+    static constexpr int IDLE_MICROS = 1000;   // disk thread sleep when every ring is full
+
+private:
+    struct Slot
+    {
+        std::atomic<bool> busy;     // claimed by the audio thread, released by the disk thread after a stop
+        std::atomic<bool> finished; // the disk thread has written the last frame
+        alignas(64) std::atomic<uint64_t> written; // frames pushed by the disk thread
+        alignas(64) std::atomic<uint64_t> consumed; // frames read by the audio thread
+        std::vector<float> ring;    // RING_FRAMES stereo frames, allocated up front
+        int channels;               // the zone's; set by the audio thread before the start command
+        std::unique_ptr<SampleSource> source; // disk thread only
+    };
+
+    enum class CommandType : uint8_t
+    {
+        Start,
+        Stop
+    };
+
+    struct Command
+    {
+        CommandType type;
+        int slot;
+        const SampleZone *zone;
+    };
+
+    int engineRate_;
+    std::unique_ptr<Slot[]> slots_;
+    int nextSlot_; // audio thread: where the search for a free slot starts
+
+    // Audio thread to disk thread; each slot has at most a start and a stop in flight
+    SpscQueue<Command, 256> commands_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+
+    std::atomic<uint32_t> streamsStarted_;
+    std::atomic<uint32_t> underruns_;
+    std::atomic<uint64_t> starvedFrames_;
+    std::atomic<uint32_t> noFreeSlot_;
+    std::atomic<uint32_t> openFailures_;
+    std::atomic<uint64_t> framesDecoded_;
+
+    void run();
+    void handle(const Command &command);
+    bool fill(Slot &slot);
+
+public:
+    explicit DiskStreamer(int engineRate);
+    ~DiskStreamer();
+
+    // Audio thread. start() returns a slot, or -1 when none is free (the voice plays its head only).
+    int start(const SampleZone *zone);
+    // Copies up to `frames` frames; `ended` is set once the zone has nothing more to give.
+    // Fewer than asked for without `ended` is an underrun.
+    int read(int slot, float *samples, int frames, bool &ended);
+    void stop(int slot);
+
+    uint32_t getStreamsStarted() const { return streamsStarted_.load(std::memory_order_relaxed); }
+    uint32_t getUnderruns() const { return underruns_.load(std::memory_order_relaxed); }
+    uint64_t getStarvedFrames() const { return starvedFrames_.load(std::memory_order_relaxed); }
+    uint32_t getNoFreeSlot() const { return noFreeSlot_.load(std::memory_order_relaxed); }
+    uint32_t getOpenFailures() const { return openFailures_.load(std::memory_order_relaxed); }
+    uint64_t getFramesDecoded() const { return framesDecoded_.load(std::memory_order_relaxed); }
+};
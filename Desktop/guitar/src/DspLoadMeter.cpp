@@ -0,0 +1,182 @@
+#include "DspLoadMeter.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+DspLoadMeter::DspLoadMeter()
+    : sequence_(0), droppedOverloads_(0), threshold_(DEFAULT_THRESHOLD), current_(), callbackTicks_(0),
+      windowStart_(0), windowBusy_(0), windowTicks_(0), windowBudget_(0.0), windowMin_(0.0), windowMax_(0.0),
+      windowCallbacks_(0), stageTicks_(), voiceTicks_(), voiceFrames_(), blockFrames_(0), sampleRate_(44100)
+{
+    for (auto &word : words_)
+        word.store(0, std::memory_order_relaxed);
+}
+
+void DspLoadMeter::beginCallback(int sampleRate)
+{
+    sampleRate_ = sampleRate;
+    callbackTicks_ = ticks();
+}
+
+void DspLoadMeter::endCallback(int64_t start, int64_t end, int frames, int deviceRate, int activeVoices)
+{
+    uint64_t spent = ticks() - callbackTicks_;
+    double budget = (double)frames * 1e9 / deviceRate;
+    double load = budget > 0.0 ? (end - start) / budget : 0.0;
+
+    if (windowCallbacks_ == 0)
+    {
+        windowMin_ = load;
+        windowMax_ = load;
+        if (windowStart_ == 0)
+            windowStart_ = start;
+    }
+    windowMin_ = std::min(windowMin_, load);
+    windowMax_ = std::max(windowMax_, load);
+    windowBusy_ += end - start;
+    windowTicks_ += spent;
+    windowBudget_ += budget;
+    windowCallbacks_++;
+
+    current_.callbacks++;
+    current_.time = end;
+    current_.last = load;
+    current_.peak = std::max(current_.peak, load);
+    if (load > threshold_.load(std::memory_order_relaxed))
+    {
+        current_.overloads++;
+        if (!overloads_.push({end, (float)load, frames, activeVoices}))
+            droppedOverloads_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (end - windowStart_ >= WINDOW_NS)
+        closeWindow(end);
+    publish();
+}
+
+void DspLoadMeter::closeWindow(int64_t now)
+{
+    // Ticks only count relative to one another; the callbacks' wall time gives them a scale
+    double nsPerTick = windowTicks_ > 0 ? (double)windowBusy_ / windowTicks_ : 0.0;
+    current_.windowMin = windowMin_;
+    current_.windowAvg = windowBudget_ > 0.0 ? windowBusy_ / windowBudget_ : 0.0;
+    current_.windowMax = windowMax_;
+    for (int s = 0; s < STAGES; s++)
+        current_.stageLoad[s] = windowBudget_ > 0.0 ? stageTicks_[s] * nsPerTick / windowBudget_ : 0.0;
+    for (int k = 0; k < KINDS; k++)
+    {
+        current_.voiceLoad[k] = windowBudget_ > 0.0 ? voiceTicks_[k] * nsPerTick / windowBudget_ : 0.0;
+        current_.voiceCost[k] = voiceFrames_[k] > 0 ? voiceTicks_[k] * nsPerTick * sampleRate_ / (voiceFrames_[k] * 1e9) : 0.0;
+        current_.voices[k] = blockFrames_ > 0 ? (double)voiceFrames_[k] / blockFrames_ : 0.0;
+    }
+
+    windowStart_ = now;
+    windowBusy_ = 0;
+    windowTicks_ = 0;
+    windowBudget_ = 0.0;
+    windowCallbacks_ = 0;
+    std::fill(stageTicks_, stageTicks_ + STAGES, 0);
+    std::fill(voiceTicks_, voiceTicks_ + KINDS, 0);
+    std::fill(voiceFrames_, voiceFrames_ + KINDS, 0);
+    blockFrames_ = 0;
+}
+
+void DspLoadMeter::publish()
+{
+    uint64_t words[WORDS];
+    std::memcpy(words, &current_, sizeof(current_));
+
+    // Odd while writing; a reader that sees the same even value before and after has a whole copy
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < WORDS; i++)
+        words_[i].store(words[i], std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+bool DspLoadMeter::read(DspLoadSnapshot &snapshot) const
+{
+    uint64_t words[WORDS];
+    for (int attempt = 0; attempt < 8; attempt++)
+    {
+        uint32_t before = sequence_.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        for (int i = 0; i < WORDS; i++)
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == before)
+        {
+            std::memcpy(&snapshot, words, sizeof(snapshot));
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *DspLoadMeter::stageName(DspStage stage)
+{
+    switch (stage)
+    {
+    case DspStage::Synth:
+        return "synth";
+    case DspStage::Amp:
+        return "amp";
+    case DspStage::Cabinet:
+        return "cabinet";
+    case DspStage::Resample:
+        return "resample";
+    case DspStage::Output:
+        return "output";
+    default:
+        return "?";
+    }
+}
+
+const char *DspLoadMeter::voiceKindName(VoiceKind kind)
+{
+    switch (kind)
+    {
+    case VoiceKind::String:
+        return "string";
+    case VoiceKind::Sample:
+        return "sample";
+    case VoiceKind::Tone:
+        return "tone";
+    case VoiceKind::Stream:
+        return "stream";
+    default:
+        return "?";
+    }
+}
+
+void DspLoadMeter::report(std::ostream &out) const
+{
+    DspLoadSnapshot snapshot;
+    if (!read(snapshot) || snapshot.callbacks == 0)
+        return;
+
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << "DSP load: " << snapshot.callbacks << " callbacks, peak " << 100.0 * snapshot.peak << "%, "
+        << snapshot.overloads << " over " << 100.0f * getThreshold() << "%; last second min "
+        << 100.0 * snapshot.windowMin << "% avg " << 100.0 * snapshot.windowAvg << "% max "
+        << 100.0 * snapshot.windowMax << "%" << std::endl;
+
+    out << "  stages:";
+    for (int s = 0; s < STAGES; s++)
+        out << " " << stageName((DspStage)s) << " " << 100.0 * snapshot.stageLoad[s] << "%";
+    out << std::endl;
+
+    out << std::setprecision(2);
+    for (int k = 0; k < KINDS; k++)
+    {
+        if (snapshot.voiceCost[k] <= 0.0)
+            continue;
+        out << "  " << std::left << std::setw(7) << voiceKindName((VoiceKind)k) << std::right << " voices: "
+            << snapshot.voices[k] << " playing, " << 100.0 * snapshot.voiceLoad[k] << "% of the budget, "
+            << 100.0 * snapshot.voiceCost[k] << "% of a core each" << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(precision);
+}
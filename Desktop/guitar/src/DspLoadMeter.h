@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
+#include "CpuFeatures.h"
+#include "LatencyProbe.h"
+#include "NoteEventQueue.h"
+#include "SynthEngine.h"
+
+// Work done in the audio callback, in the order it runs. Synth includes every voice.
+enum class DspStage
+{
+    Synth,
+    Amp,
+    Cabinet,
+    Resample,
+    Output,
+    COUNT
+};
+
+// What the UI or a log sees; loads are time spent over the buffer's playing time (1 = deadline)
+struct DspLoadSnapshot
+{
+    uint64_t callbacks;
+    uint64_t overloads; // callbacks above the threshold
+    int64_t time;       // steady-clock time of the last callback's end
+    double last;
+    double peak; // since start
+
+    // Over the last completed window
+    double windowMin;
+    double windowAvg;
+    double windowMax;
+    double stageLoad[(int)DspStage::COUNT];
+    double voiceLoad[(int)VoiceKind::COUNT];
+    double voiceCost[(int)VoiceKind::COUNT]; // one voice playing for a second, in seconds of CPU
+    double voices[(int)VoiceKind::COUNT];    // average voices playing
+};
+
+// A callback that went over the threshold
+struct DspOverload
+{
+    int64_t time;
+    float load;
+    int frames;
+    int voices;
+};
+
+// Times every audio callback against its budget and attributes the time to voice kinds and
+// processing stages. Stages and voices are counted in cheap CPU ticks, converted with the ratio
+// of ticks to nanoseconds over each window. The audio thread publishes a snapshot after every
+// callback through a sequence lock and queues overloads; readers never block it.
+class DspLoadMeter
+{
+public:
+    static constexpr int64_t WINDOW_NS = 1000000000; // min/avg/max and shares cover one second
+    static constexpr float DEFAULT_THRESHOLD = 0.8f;
+
+private:
+    static_assert(std::is_trivially_copyable<DspLoadSnapshot>::value && sizeof(DspLoadSnapshot) % 8 == 0,
+                  "snapshot is published as 64-bit words");
+    static constexpr int WORDS = (int)(sizeof(DspLoadSnapshot) / 8);
+    static constexpr int STAGES = (int)DspStage::COUNT;
+    static constexpr int KINDS = (int)VoiceKind::COUNT;
+
+    std::atomic<uint32_t> sequence_;
+    std::atomic<uint64_t> words_[WORDS];
+    SpscQueue<DspOverload, 64> overloads_;
+    std::atomic<uint32_t> droppedOverloads_;
+    std::atomic<float> threshold_;
+
+    // Audio thread
+    DspLoadSnapshot current_;
+    uint64_t callbackTicks_;
+    int64_t windowStart_;
+    int64_t windowBusy_;
+    uint64_t windowTicks_;
+    double windowBudget_; // ns of audio the window's callbacks produced
+    double windowMin_;
+    double windowMax_;
+    uint32_t windowCallbacks_;
+    uint64_t stageTicks_[STAGES];
+    uint64_t voiceTicks_[KINDS];
+    uint64_t voiceFrames_[KINDS]; // voice-frames rendered, for the cost of one voice
+    uint64_t blockFrames_;        // engine frames in the window, for the average voice count
+    int sampleRate_;
+
+    void closeWindow(int64_t now);
+    void publish();
+
+public:
+    DspLoadMeter();
+
+    static uint64_t ticks()
+    {
+#if defined(GUITAR_SIMD_X86)
+        return __rdtsc();
+#else
+        return (uint64_t)LatencyProbe::now();
+#endif
+    }
+
+    // Callbacks above this load are recorded as overloads; any thread
+    void setThreshold(float load) { threshold_.store(load, std::memory_order_relaxed); }
+    float getThreshold() const { return threshold_.load(std::memory_order_relaxed); }
+
+    // Audio thread. sampleRate is the engine's, which voice frames are counted at.
+    void beginCallback(int sampleRate);
+    void addStage(DspStage stage, uint64_t ticks) { stageTicks_[(int)stage] += ticks; }
+    void addVoice(VoiceKind kind, uint64_t ticks, int frames)
+    {
+        voiceTicks_[(int)kind] += ticks;
+        voiceFrames_[(int)kind] += (uint64_t)frames;
+    }
+    void addEngineFrames(int frames) { blockFrames_ += (uint64_t)frames; }
+    // start and end on the LatencyProbe::now() clock; frames and deviceRate give the budget
+    void endCallback(int64_t start, int64_t end, int frames, int deviceRate, int activeVoices);
+
+    // Any thread; false only while the audio thread keeps overwriting it
+    bool read(DspLoadSnapshot &snapshot) const;
+
+    // One consumer thread
+    bool popOverload(DspOverload &overload) { return overloads_.pop(overload); }
+    uint32_t getDroppedOverloads() const { return droppedOverloads_.load(std::memory_order_relaxed); }
+
+    static const char *stageName(DspStage stage);
+    static const char *voiceKindName(VoiceKind kind);
+
+    // The latest snapshot as a table
+    void report(std::ostream &out) const;
+};
@@ -0,0 +1,678 @@
+#include "EffectChain.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Keeps the tone stack's decaying filter states out of the denormal range
+static const float DENORMAL_GUARD = 1e-20f;
+
+// Soft clipper range: the rational tanh approximation reaches +-1 at +-3
+static const float SHAPER_LIMIT = 3.0f;
+
+static float dbToGain(float db)
+{
+    return std::pow(10.0f, db / 20.0f);
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// ---- Scalar kernels (reference behaviour, and the tail of every SIMD loop) ----
+
+static float maxAbsScalar(const float *x, int count)
+{
+    float peak = 0.0f;
+    for (int i = 0; i < count; i++)
+        peak = std::max(peak, std::fabs(x[i]));
+    return peak;
+}
+
+static void applyRampScalar(float *x, int count, float from, float step)
+{
+    for (int i = 0; i < count; i++)
+        x[i] *= from + step * (i + 1);
+}
+
+static void shapeScalar(float *x, int start, int count)
+{
+    for (int i = start; i < count; i++)
+    {
+        float c = std::max(-SHAPER_LIMIT, std::min(SHAPER_LIMIT, x[i]));
+        float c2 = c * c;
+        x[i] = c * (27.0f + c2) / (27.0f + 9.0f * c2);
+    }
+}
+
+static void upsampleScalar(const float (*coeffs)[EffectChain::MAX_OVERSAMPLING], const float *input,
+                           float *output, int frames, int factor)
+{
+    for (int n = 0; n < frames; n++)
+    {
+        const float *x = input + n; // x[-k] is the input k samples back
+        for (int p = 0; p < factor; p++)
+        {
+            float acc = 0.0f;
+            for (int k = 0; k < EffectChain::TAPS_PER_PHASE; k++)
+                acc += coeffs[k][p] * x[-k];
+            output[n * factor + p] = acc;
+        }
+    }
+}
+
+static void downsampleScalar(const float *coeffs, const float *upsampled, float *output,
+                             int frames, int factor, int taps)
+{
+    for (int m = 0; m < frames; m++)
+    {
+        const float *u = upsampled + m * factor + factor - 1;
+        float acc = 0.0f;
+        for (int j = 0; j < taps; j++)
+            acc += coeffs[j] * u[j];
+        output[m] = acc;
+    }
+}
+
+static void toneStackScalar(float *x, int frames, const float *b0, const float *b1, const float *b2,
+                            const float *a1, const float *a2, float *s1, float *s2, float *out, float level)
+{
+    const int stages = 4;
+    for (int i = 0; i < frames; i++)
+    {
+        // Each stage takes what the stage before it produced on the previous sample
+        float in[stages] = {x[i] + DENORMAL_GUARD, out[0], out[1], out[2]};
+        for (int l = 0; l < stages; l++)
+        {
+            float y = b0[l] * in[l] + s1[l];
+            s1[l] = b1[l] * in[l] - a1[l] * y + s2[l];
+            s2[l] = b2[l] * in[l] - a2[l] * y;
+            out[l] = y;
+        }
+        x[i] = out[stages - 1] * level;
+    }
+}
+
+#if defined(GUITAR_SIMD_X86)
+
+GUITAR_TARGET_SSE2 static float maxAbsSSE2(const float *x, int count)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(x + i), absMask));
+
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+    return std::max(_mm_cvtss_f32(peak), maxAbsScalar(x + i, count - i));
+}
+
+GUITAR_TARGET_SSE2 static void applyRampSSE2(float *x, int count, float from, float step)
+{
+    __m128 gain = _mm_add_ps(_mm_set1_ps(from), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(1.0f, 2.0f, 3.0f, 4.0f)));
+    const __m128 gainStep = _mm_set1_ps(step * 4.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), gain));
+        gain = _mm_add_ps(gain, gainStep);
+    }
+    applyRampScalar(x + i, count - i, from + step * i, step);
+}
+
+GUITAR_TARGET_SSE2 static int shapeSSE2(float *x, int count)
+{
+    const __m128 limit = _mm_set1_ps(SHAPER_LIMIT);
+    const __m128 negLimit = _mm_set1_ps(-SHAPER_LIMIT);
+    const __m128 k27 = _mm_set1_ps(27.0f);
+    const __m128 k9 = _mm_set1_ps(9.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 c = _mm_max_ps(negLimit, _mm_min_ps(limit, _mm_loadu_ps(x + i)));
+        __m128 c2 = _mm_mul_ps(c, c);
+        __m128 numerator = _mm_mul_ps(c, _mm_add_ps(k27, c2));
+        __m128 denominator = _mm_add_ps(k27, _mm_mul_ps(k9, c2));
+        _mm_storeu_ps(x + i, _mm_div_ps(numerator, denominator));
+    }
+    return i;
+}
+
+GUITAR_TARGET_SSE2 static void upsampleSSE2(const float (*coeffs)[EffectChain::MAX_OVERSAMPLING], const float *input,
+                                            float *output, int frames, int factor)
+{
+    if (factor == 4)
+    {
+        // All four output phases of one input sample in a single register
+        for (int n = 0; n < frames; n++)
+        {
+            const float *x = input + n;
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < EffectChain::TAPS_PER_PHASE; k++)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(coeffs[k]), _mm_set1_ps(x[-k])));
+            _mm_storeu_ps(output + n * 4, acc);
+        }
+    }
+    else if (factor == 8)
+    {
+        for (int n = 0; n < frames; n++)
+        {
+            const float *x = input + n;
+            __m128 lo = _mm_setzero_ps();
+            __m128 hi = _mm_setzero_ps();
+            for (int k = 0; k < EffectChain::TAPS_PER_PHASE; k++)
+            {
+                __m128 sample = _mm_set1_ps(x[-k]);
+                lo = _mm_add_ps(lo, _mm_mul_ps(_mm_load_ps(coeffs[k]), sample));
+                hi = _mm_add_ps(hi, _mm_mul_ps(_mm_load_ps(coeffs[k] + 4), sample));
+            }
+            _mm_storeu_ps(output + n * 8, lo);
+            _mm_storeu_ps(output + n * 8 + 4, hi);
+        }
+    }
+    else
+    {
+        upsampleScalar(coeffs, input, output, frames, factor);
+    }
+}
+
+GUITAR_TARGET_SSE2 static void downsampleSSE2(const float *coeffs, const float *upsampled, float *output,
+                                              int frames, int factor, int taps)
+{
+    // taps is always a multiple of 8
+    for (int m = 0; m < frames; m++)
+    {
+        const float *u = upsampled + m * factor + factor - 1;
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (int j = 0; j < taps; j += 8)
+        {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(coeffs + j), _mm_loadu_ps(u + j)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(coeffs + j + 4), _mm_loadu_ps(u + j + 4)));
+        }
+        __m128 acc = _mm_add_ps(acc0, acc1);
+        acc = _mm_add_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        output[m] = _mm_cvtss_f32(acc);
+    }
+}
+
+GUITAR_TARGET_SSE2 static void toneStackSSE2(float *x, int frames, const float *b0, const float *b1, const float *b2,
+                                             const float *a1, const float *a2, float *s1, float *s2, float *out, float level)
+{
+    const __m128 vb0 = _mm_load_ps(b0);
+    const __m128 vb1 = _mm_load_ps(b1);
+    const __m128 vb2 = _mm_load_ps(b2);
+    const __m128 va1 = _mm_load_ps(a1);
+    const __m128 va2 = _mm_load_ps(a2);
+    __m128 vs1 = _mm_load_ps(s1);
+    __m128 vs2 = _mm_load_ps(s2);
+    __m128 y = _mm_load_ps(out);
+
+    for (int i = 0; i < frames; i++)
+    {
+        // Shift last sample's stage outputs up one lane and feed the new input into lane 0
+        __m128 shifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 4));
+        __m128 in = _mm_move_ss(shifted, _mm_set_ss(x[i] + DENORMAL_GUARD));
+
+        y = _mm_add_ps(_mm_mul_ps(vb0, in), vs1);
+        vs1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(vb1, in), _mm_mul_ps(va1, y)), vs2);
+        vs2 = _mm_sub_ps(_mm_mul_ps(vb2, in), _mm_mul_ps(va2, y));
+
+        x[i] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3))) * level;
+    }
+
+    _mm_store_ps(s1, vs1);
+    _mm_store_ps(s2, vs2);
+    _mm_store_ps(out, y);
+}
+
+GUITAR_TARGET_AVX2 static int shapeAVX2(float *x, int count)
+{
+    const __m256 limit = _mm256_set1_ps(SHAPER_LIMIT);
+    const __m256 negLimit = _mm256_set1_ps(-SHAPER_LIMIT);
+    const __m256 k27 = _mm256_set1_ps(27.0f);
+    const __m256 k9 = _mm256_set1_ps(9.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 c = _mm256_max_ps(negLimit, _mm256_min_ps(limit, _mm256_loadu_ps(x + i)));
+        __m256 c2 = _mm256_mul_ps(c, c);
+        __m256 numerator = _mm256_mul_ps(c, _mm256_add_ps(k27, c2));
+        __m256 denominator = _mm256_fmadd_ps(k9, c2, k27);
+        _mm256_storeu_ps(x + i, _mm256_div_ps(numerator, denominator));
+    }
+    return i;
+}
+
+GUITAR_TARGET_AVX2 static void upsampleAVX2(const float (*coeffs)[EffectChain::MAX_OVERSAMPLING], const float *input,
+                                            float *output, int frames, int factor)
+{
+    if (factor == 8)
+    {
+        for (int n = 0; n < frames; n++)
+        {
+            const float *x = input + n;
+            __m256 acc = _mm256_setzero_ps();
+            for (int k = 0; k < EffectChain::TAPS_PER_PHASE; k++)
+                acc = _mm256_fmadd_ps(_mm256_load_ps(coeffs[k]), _mm256_set1_ps(x[-k]), acc);
+            _mm256_storeu_ps(output + n * 8, acc);
+        }
+    }
+    else if (factor == 4)
+    {
+        for (int n = 0; n < frames; n++)
+        {
+            const float *x = input + n;
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < EffectChain::TAPS_PER_PHASE; k++)
+                acc = _mm_fmadd_ps(_mm_load_ps(coeffs[k]), _mm_set1_ps(x[-k]), acc);
+            _mm_storeu_ps(output + n * 4, acc);
+        }
+    }
+    else
+    {
+        upsampleScalar(coeffs, input, output, frames, factor);
+    }
+}
+
+GUITAR_TARGET_AVX2 static void downsampleAVX2(const float *coeffs, const float *upsampled, float *output,
+                                              int frames, int factor, int taps)
+{
+    // taps is always a multiple of 16
+    for (int m = 0; m < frames; m++)
+    {
+        const float *u = upsampled + m * factor + factor - 1;
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (int j = 0; j < taps; j += 16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_load_ps(coeffs + j), _mm256_loadu_ps(u + j), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_load_ps(coeffs + j + 8), _mm256_loadu_ps(u + j + 8), acc1);
+        }
+        __m256 sum = _mm256_add_ps(acc0, acc1);
+        __m128 acc = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        acc = _mm_add_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        output[m] = _mm_cvtss_f32(acc);
+    }
+}
+
+#endif
+
+EffectChain::EffectChain(int sampleRate)
+    : sampleRate_(sampleRate), path_(bestPath()), factor_(0), taps_(0)
+{
+    // Gate timing, expressed per GATE_BLOCK update
+    gateEnvelopeDecay_ = std::exp(-(float)GATE_BLOCK / (0.1f * sampleRate_));   // 100 ms peak release
+    gateAttackStep_ = std::min(1.0f, (float)GATE_BLOCK / (0.001f * sampleRate_)); // opens in 1 ms
+    gateReleaseStep_ = (float)GATE_BLOCK / (0.05f * sampleRate_);                  // closes in 50 ms
+
+    requested_ = AmpSettings();
+    applySettings(requested_);
+    reset();
+}
+
+void EffectChain::setSettings(const AmpSettings &settings)
+{
+    requested_ = settings;
+
+    // Never wait on the audio thread; if it has fallen behind, the next change carries the full state
+    updates_.push(settings);
+}
+
+void EffectChain::applySettings(const AmpSettings &settings)
+{
+    bool wasEnabled = settings_.enabled;
+    settings_ = settings;
+
+    int factor = settings.oversampling <= 1 ? 1 : (settings.oversampling <= 4 ? 4 : MAX_OVERSAMPLING);
+    if (factor != factor_)
+    {
+        factor_ = factor;
+        taps_ = factor_ * TAPS_PER_PHASE;
+        designOversampling();
+        for (auto &channel : channels_)
+        {
+            std::fill(std::begin(channel.input), std::end(channel.input), 0.0f);
+            std::fill(std::begin(channel.upsampled), std::end(channel.upsampled), 0.0f);
+        }
+    }
+
+    driveGain_ = dbToGain(settings.drive);
+    levelGain_ = dbToGain(settings.level);
+    gateOpenLevel_ = dbToGain(settings.gateThreshold);
+    gateCloseLevel_ = gateOpenLevel_ * 0.5f; // 6 dB of hysteresis so the gate doesn't chatter
+    designToneStack();
+
+    // Don't let stale filter state from the last time the amp was on leak into the new sound
+    if (settings.enabled && !wasEnabled)
+        reset();
+}
+
+void EffectChain::designOversampling()
+{
+    std::fill(&upCoeffs_[0][0], &upCoeffs_[0][0] + TAPS_PER_PHASE * MAX_OVERSAMPLING, 0.0f);
+    std::fill(std::begin(downCoeffs_), std::end(downCoeffs_), 0.0f);
+    if (factor_ == 1)
+        return;
+
+    // Kaiser-windowed sinc lowpass at the original Nyquist frequency, at the oversampled rate
+    const double beta = 7.0;
+    const double cutoff = 0.5 / factor_;
+    const double center = (taps_ - 1) * 0.5;
+
+    double prototype[MAX_TAPS];
+    double sum = 0.0;
+    for (int j = 0; j < taps_; j++)
+    {
+        double t = j - center;
+        double sinc = (t == 0.0) ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        double r = 2.0 * j / (taps_ - 1) - 1.0;
+        double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+        prototype[j] = sinc * window;
+        sum += prototype[j];
+    }
+
+    for (int j = 0; j < taps_; j++)
+    {
+        // Unity gain for decimation; zero-stuffing loses a factor of `factor_`, so the upsampler makes it back
+        downCoeffs_[j] = (float)(prototype[j] / sum);
+        upCoeffs_[j / factor_][j % factor_] = (float)(prototype[j] / sum * factor_);
+    }
+}
+
+void EffectChain::designToneStack()
+{
+    struct Biquad
+    {
+        double b0, b1, b2, a0, a1, a2;
+    };
+
+    const double rate = sampleRate_;
+    Biquad stages[TONE_STAGES];
+
+    // RBJ cookbook filters: low shelf (bass), peak (mid), high shelf (treble)
+    {
+        double A = std::pow(10.0, settings_.bass / 40.0);
+        double w = 2.0 * M_PI * 120.0 / rate;
+        double cw = std::cos(w);
+        double alpha = std::sin(w) / 2.0 * std::sqrt(2.0);
+        double sa = 2.0 * std::sqrt(A) * alpha;
+        stages[0] = {A * ((A + 1) - (A - 1) * cw + sa), 2 * A * ((A - 1) - (A + 1) * cw), A * ((A + 1) - (A - 1) * cw - sa),
+                     (A + 1) + (A - 1) * cw + sa, -2 * ((A - 1) + (A + 1) * cw), (A + 1) + (A - 1) * cw - sa};
+    }
+    {
+        double A = std::pow(10.0, settings_.mid / 40.0);
+        double w = 2.0 * M_PI * 700.0 / rate;
+        double cw = std::cos(w);
+        double alpha = std::sin(w) / (2.0 * 0.7);
+        stages[1] = {1 + alpha * A, -2 * cw, 1 - alpha * A, 1 + alpha / A, -2 * cw, 1 - alpha / A};
+    }
+    {
+        double A = std::pow(10.0, settings_.treble / 40.0);
+        double w = 2.0 * M_PI * std::min(3200.0, 0.4 * rate) / rate;
+        double cw = std::cos(w);
+        double alpha = std::sin(w) / 2.0 * std::sqrt(2.0);
+        double sa = 2.0 * std::sqrt(A) * alpha;
+        stages[2] = {A * ((A + 1) + (A - 1) * cw + sa), -2 * A * ((A - 1) + (A + 1) * cw), A * ((A + 1) + (A - 1) * cw - sa),
+                     (A + 1) - (A - 1) * cw + sa, 2 * ((A - 1) - (A + 1) * cw), (A + 1) - (A - 1) * cw - sa};
+    }
+    {
+        // Speaker roll-off: takes the fizz off the top of the distortion
+        double w = 2.0 * M_PI * std::min(6500.0, 0.45 * rate) / rate;
+        double cw = std::cos(w);
+        double alpha = std::sin(w) / (2.0 * 0.707);
+        stages[3] = {(1 - cw) / 2, 1 - cw, (1 - cw) / 2, 1 + alpha, -2 * cw, 1 - alpha};
+    }
+
+    for (int l = 0; l < TONE_STAGES; l++)
+    {
+        toneB0_[l] = (float)(stages[l].b0 / stages[l].a0);
+        toneB1_[l] = (float)(stages[l].b1 / stages[l].a0);
+        toneB2_[l] = (float)(stages[l].b2 / stages[l].a0);
+        toneA1_[l] = (float)(stages[l].a1 / stages[l].a0);
+        toneA2_[l] = (float)(stages[l].a2 / stages[l].a0);
+    }
+}
+
+void EffectChain::clearChannel(Channel &channel)
+{
+    std::fill(std::begin(channel.input), std::end(channel.input), 0.0f);
+    std::fill(std::begin(channel.upsampled), std::end(channel.upsampled), 0.0f);
+    std::fill(std::begin(channel.toneS1), std::end(channel.toneS1), 0.0f);
+    std::fill(std::begin(channel.toneS2), std::end(channel.toneS2), 0.0f);
+    std::fill(std::begin(channel.toneOut), std::end(channel.toneOut), 0.0f);
+}
+
+void EffectChain::reset()
+{
+    for (auto &channel : channels_)
+        clearChannel(channel);
+    gateEnvelope_ = 0.0f;
+    gateGain_ = 0.0f;
+    gateOpen_ = false;
+}
+
+int EffectChain::getLatencyFrames() const
+{
+    // Each linear-phase FIR delays by half its length; the tone pipeline adds a sample per stage
+    int filters = (factor_ > 1) ? (taps_ - 1) / factor_ : 0;
+    return filters + TONE_STAGES - 1;
+}
+
+void EffectChain::gate(float *left, float *right, int frames)
+{
+    // Both sides open and close together on the louder of them; right is null for mono
+    float *sides[2] = {left, right};
+    for (int i = 0; i < frames; i += GATE_BLOCK)
+    {
+        int count = std::min(GATE_BLOCK, frames - i);
+
+        float peak = 0.0f;
+        for (float *side : sides)
+        {
+            if (!side)
+                continue;
+#if defined(GUITAR_SIMD_X86)
+            peak = std::max(peak, (path_ != Path::Scalar) ? maxAbsSSE2(side + i, count) : maxAbsScalar(side + i, count));
+#else
+            peak = std::max(peak, maxAbsScalar(side + i, count));
+#endif
+        }
+
+        gateEnvelope_ = std::max(peak, gateEnvelope_ * gateEnvelopeDecay_);
+        if (gateOpen_ && gateEnvelope_ < gateCloseLevel_)
+            gateOpen_ = false;
+        else if (!gateOpen_ && gateEnvelope_ > gateOpenLevel_)
+            gateOpen_ = true;
+
+        float target = gateOpen_ ? 1.0f : 0.0f;
+        float gain = (target > gateGain_) ? std::min(target, gateGain_ + gateAttackStep_)
+                                          : std::max(target, gateGain_ - gateReleaseStep_);
+
+        // Ramp the gate across the sub-block, with the drive folded into the same multiply
+        float from = gateGain_ * driveGain_;
+        float step = (gain - gateGain_) * driveGain_ / count;
+        for (float *side : sides)
+        {
+            if (!side)
+                continue;
+#if defined(GUITAR_SIMD_X86)
+            if (path_ != Path::Scalar)
+                applyRampSSE2(side + i, count, from, step);
+            else
+                applyRampScalar(side + i, count, from, step);
+#else
+            applyRampScalar(side + i, count, from, step);
+#endif
+        }
+        gateGain_ = gain;
+    }
+}
+
+void EffectChain::processBlock(Channel &channel, float *samples, int frames)
+{
+    const int history = TAPS_PER_PHASE - 1;
+    const int upHistory = taps_ - 1;
+    float *shaped = samples;
+    int shapedCount = frames;
+
+    if (factor_ > 1)
+    {
+        // Upsample behind the history of the previous block
+        std::memcpy(channel.input + history, samples, frames * sizeof(float));
+        shaped = channel.upsampled + upHistory;
+        shapedCount = frames * factor_;
+
+#if defined(GUITAR_SIMD_X86)
+        if (path_ == Path::AVX2)
+            upsampleAVX2(upCoeffs_, channel.input + history, shaped, frames, factor_);
+        else if (path_ == Path::SSE2)
+            upsampleSSE2(upCoeffs_, channel.input + history, shaped, frames, factor_);
+        else
+            upsampleScalar(upCoeffs_, channel.input + history, shaped, frames, factor_);
+#else
+        upsampleScalar(upCoeffs_, channel.input + history, shaped, frames, factor_);
+#endif
+    }
+
+    // Waveshaping is the only nonlinear stage, so it is the only one that runs oversampled
+    int done = 0;
+#if defined(GUITAR_SIMD_X86)
+    if (path_ == Path::AVX2)
+        done = shapeAVX2(shaped, shapedCount);
+    else if (path_ == Path::SSE2)
+        done = shapeSSE2(shaped, shapedCount);
+#endif
+    shapeScalar(shaped, done, shapedCount);
+
+    if (factor_ > 1)
+    {
+#if defined(GUITAR_SIMD_X86)
+        if (path_ == Path::AVX2)
+            downsampleAVX2(downCoeffs_, channel.upsampled, samples, frames, factor_, taps_);
+        else if (path_ == Path::SSE2)
+            downsampleSSE2(downCoeffs_, channel.upsampled, samples, frames, factor_, taps_);
+        else
+            downsampleScalar(downCoeffs_, channel.upsampled, samples, frames, factor_, taps_);
+#else
+        downsampleScalar(downCoeffs_, channel.upsampled, samples, frames, factor_, taps_);
+#endif
+
+        // Keep the tail of both buffers as the next block's filter history
+        std::memmove(channel.input, channel.input + frames, history * sizeof(float));
+        std::memmove(channel.upsampled, channel.upsampled + frames * factor_, upHistory * sizeof(float));
+    }
+
+#if defined(GUITAR_SIMD_X86)
+    if (path_ != Path::Scalar)
+    {
+        toneStackSSE2(samples, frames, toneB0_, toneB1_, toneB2_, toneA1_, toneA2_, channel.toneS1, channel.toneS2, channel.toneOut, levelGain_);
+        return;
+    }
+#endif
+    toneStackScalar(samples, frames, toneB0_, toneB1_, toneB2_, toneA1_, toneA2_, channel.toneS1, channel.toneS2, channel.toneOut, levelGain_);
+}
+
+bool EffectChain::takeSettings()
+{
+    AmpSettings update;
+    bool changed = false;
+    while (updates_.pop(update))
+        changed = true;
+    if (changed)
+        applySettings(update);
+    return settings_.enabled;
+}
+
+void EffectChain::process(float *samples, int frames)
+{
+    if (!takeSettings())
+        return;
+
+    for (int offset = 0; offset < frames; offset += MAX_BLOCK_FRAMES)
+    {
+        int count = std::min(MAX_BLOCK_FRAMES, frames - offset);
+        gate(samples + offset, nullptr, count);
+        processBlock(channels_[0], samples + offset, count);
+    }
+}
+
+void EffectChain::processStereo(float *interleaved, int frames)
+{
+    if (!takeSettings())
+        return;
+
+    for (int offset = 0; offset < frames; offset += MAX_BLOCK_FRAMES)
+    {
+        int count = std::min(MAX_BLOCK_FRAMES, frames - offset);
+        float *block = interleaved + offset * 2;
+
+        for (int i = 0; i < count; i++)
+        {
+            split_[0][i] = block[i * 2];
+            split_[1][i] = block[i * 2 + 1];
+        }
+
+        gate(split_[0], split_[1], count);
+        processBlock(channels_[0], split_[0], count);
+        processBlock(channels_[1], split_[1], count);
+
+        for (int i = 0; i < count; i++)
+        {
+            block[i * 2] = split_[0][i];
+            block[i * 2 + 1] = split_[1][i];
+        }
+    }
+}
+
+EffectChain::Path EffectChain::bestPath()
+{
+    if (isPathSupported(Path::AVX2))
+        return Path::AVX2;
+    if (isPathSupported(Path::SSE2))
+        return Path::SSE2;
+    return Path::Scalar;
+}
+
+bool EffectChain::isPathSupported(Path path)
+{
+    switch (path)
+    {
+    case Path::AVX2:
+        return cpuHasAVX2();
+    case Path::SSE2:
+        return cpuHasSSE2();
+    default:
+        return true;
+    }
+}
+
+const char *EffectChain::pathName(Path path)
+{
+    switch (path)
+    {
+    case Path::AVX2:
+        return "AVX2";
+    case Path::SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
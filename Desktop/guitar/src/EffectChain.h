@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include "NoteEventQueue.h"
+
+// Amp controls; levels are in dB
+struct AmpSettings
+{
+    bool enabled = false;
+    float drive = 18.0f;          // gain into the waveshaper
+    float bass = 2.0f;            // tone stack, -12..+12
+    float mid = 0.0f;
+    float treble = 3.0f;
+    float level = -8.0f;          // output gain
+    float gateThreshold = -60.0f; // gate opens above this input level (dBFS)
+    int oversampling = 8;         // 1 (off), 4 or 8
+};
+
+// Electric guitar amp after the voice mix: noise gate and drive, oversampled waveshaping
+// overdrive, tone stack EQ and output level. Works on fixed-size float blocks; every stage
+// is a plain function picked once per block, with SSE2/AVX2 kernels where the CPU has them.
+class EffectChain
+{
+public:
+    enum class Path
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    static constexpr int MAX_OVERSAMPLING = 8;
+    static constexpr int TAPS_PER_PHASE = 16; // anti-imaging/anti-aliasing FIR length per polyphase branch
+    static constexpr int MAX_BLOCK_FRAMES = 256;
+
+private:
+    static constexpr int MAX_TAPS = MAX_OVERSAMPLING * TAPS_PER_PHASE;
+    static constexpr int GATE_BLOCK = 16; // gate gain is updated once per this many frames
+    static constexpr int TONE_STAGES = 4; // low shelf, mid peak, high shelf, speaker roll-off
+
+    int sampleRate_;
+    Path path_;
+
+    // Settings travel to the audio thread through a queue; requested_ is the producer's copy
+    SpscQueue<AmpSettings, 8> updates_;
+    AmpSettings requested_;
+    AmpSettings settings_;
+
+    // Derived from settings_
+    int factor_;
+    int taps_;
+    float driveGain_;
+    float levelGain_;
+    float gateOpenLevel_;
+    float gateCloseLevel_;
+
+    // Polyphase upsampler [tap][phase] and the decimation filter, from one windowed-sinc prototype
+    alignas(32) float upCoeffs_[TAPS_PER_PHASE][MAX_OVERSAMPLING];
+    alignas(32) float downCoeffs_[MAX_TAPS];
+
+    // Gate state
+    float gateEnvelope_;
+    float gateGain_;
+    bool gateOpen_;
+    float gateEnvelopeDecay_;
+    float gateAttackStep_;
+    float gateReleaseStep_;
+
+    // Tone stack biquads (transposed direct form II), one per SIMD lane.
+    // The cascade runs as a pipeline: lane n filters what lane n-1 produced one sample earlier.
+    alignas(16) float toneB0_[TONE_STAGES];
+    alignas(16) float toneB1_[TONE_STAGES];
+    alignas(16) float toneB2_[TONE_STAGES];
+    alignas(16) float toneA1_[TONE_STAGES];
+    alignas(16) float toneA2_[TONE_STAGES];
+
+    // Filter state of one side; stereo runs two of these behind one gate
+    struct Channel
+    {
+        alignas(16) float toneS1[TONE_STAGES];
+        alignas(16) float toneS2[TONE_STAGES];
+        alignas(16) float toneOut[TONE_STAGES];
+
+        // Work buffers with filter history in front, so nothing is allocated on the audio thread
+        alignas(32) float input[TAPS_PER_PHASE - 1 + MAX_BLOCK_FRAMES];
+        alignas(32) float upsampled[MAX_TAPS - 1 + MAX_BLOCK_FRAMES * MAX_OVERSAMPLING];
+    };
+    Channel channels_[2];
+    alignas(32) float split_[2][MAX_BLOCK_FRAMES];
+
+    void applySettings(const AmpSettings &settings);
+    bool takeSettings();
+    void designOversampling();
+    void designToneStack();
+    void clearChannel(Channel &channel);
+    void processBlock(Channel &channel, float *samples, int frames);
+    void gate(float *left, float *right, int frames);
+
+public:
+    explicit EffectChain(int sampleRate);
+
+    // Producer side, wait-free; only one thread may change settings
+    void setSettings(const AmpSettings &settings);
+    const AmpSettings &getSettings() const { return requested_; }
+
+    // Audio thread: mono in place, or interleaved stereo as two amps behind one linked gate, so
+    // the strings keep their pan
+    void process(float *samples, int frames);
+    void processStereo(float *interleaved, int frames);
+
+    // Clear all filter and gate state
+    void reset();
+
+    void setPath(Path path) { path_ = isPathSupported(path) ? path : Path::Scalar; }
+    Path getPath() const { return path_; }
+
+    // Delay added by the oversampling filters and the tone stack pipeline, in frames
+    int getLatencyFrames() const;
+
+    static Path bestPath();
+    static bool isPathSupported(Path path);
+    static const char *pathName(Path path);
+};
@@ -0,0 +1,229 @@
+#include "Fft.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <utility>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// One radix-2 stage over the whole array: `h` butterflies per group, groups of 2h
+static void stageScalar(float *re, float *im, const float *wRe, const float *wIm, int n, int h)
+{
+    for (int start = 0; start < n; start += 2 * h)
+    {
+        for (int j = 0; j < h; j++)
+        {
+            int a = start + j;
+            int b = a + h;
+            float tr = wRe[j] * re[b] - wIm[j] * im[b];
+            float ti = wRe[j] * im[b] + wIm[j] * re[b];
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+    }
+}
+
+#if defined(GUITAR_SIMD_X86)
+
+GUITAR_TARGET_SSE2 static void stageSSE2(float *re, float *im, const float *wRe, const float *wIm, int n, int h)
+{
+    // h >= 4: four butterflies per iteration
+    for (int start = 0; start < n; start += 2 * h)
+    {
+        float *aRe = re + start;
+        float *aIm = im + start;
+        float *bRe = aRe + h;
+        float *bIm = aIm + h;
+        for (int j = 0; j < h; j += 4)
+        {
+            __m128 wr = _mm_loadu_ps(wRe + j);
+            __m128 wi = _mm_loadu_ps(wIm + j);
+            __m128 br = _mm_loadu_ps(bRe + j);
+            __m128 bi = _mm_loadu_ps(bIm + j);
+            __m128 ar = _mm_loadu_ps(aRe + j);
+            __m128 ai = _mm_loadu_ps(aIm + j);
+
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, br), _mm_mul_ps(wi, bi));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(wr, bi), _mm_mul_ps(wi, br));
+
+            _mm_storeu_ps(bRe + j, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(bIm + j, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(aRe + j, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(aIm + j, _mm_add_ps(ai, ti));
+        }
+    }
+}
+
+GUITAR_TARGET_AVX2 static void stageAVX2(float *re, float *im, const float *wRe, const float *wIm, int n, int h)
+{
+    // h >= 8: eight butterflies per iteration
+    for (int start = 0; start < n; start += 2 * h)
+    {
+        float *aRe = re + start;
+        float *aIm = im + start;
+        float *bRe = aRe + h;
+        float *bIm = aIm + h;
+        for (int j = 0; j < h; j += 8)
+        {
+            __m256 wr = _mm256_loadu_ps(wRe + j);
+            __m256 wi = _mm256_loadu_ps(wIm + j);
+            __m256 br = _mm256_loadu_ps(bRe + j);
+            __m256 bi = _mm256_loadu_ps(bIm + j);
+            __m256 ar = _mm256_loadu_ps(aRe + j);
+            __m256 ai = _mm256_loadu_ps(aIm + j);
+
+            __m256 tr = _mm256_fmsub_ps(wr, br, _mm256_mul_ps(wi, bi));
+            __m256 ti = _mm256_fmadd_ps(wr, bi, _mm256_mul_ps(wi, br));
+
+            _mm256_storeu_ps(bRe + j, _mm256_sub_ps(ar, tr));
+            _mm256_storeu_ps(bIm + j, _mm256_sub_ps(ai, ti));
+            _mm256_storeu_ps(aRe + j, _mm256_add_ps(ar, tr));
+            _mm256_storeu_ps(aIm + j, _mm256_add_ps(ai, ti));
+        }
+    }
+}
+
+#endif
+
+Fft::Fft(int size) : size_(size), half_(size / 2)
+{
+    if (!isPowerOfTwo(size) || size < 4)
+    {
+        size_ = 4;
+        half_ = 2;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half_)
+        bits++;
+
+    bitReverse_.resize(half_);
+    for (int i = 0; i < half_; i++)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        bitReverse_[i] = reversed;
+    }
+
+    twiddleRe_.resize(half_);
+    twiddleIm_.resize(half_);
+    for (int h = 1; h < half_; h *= 2)
+    {
+        for (int j = 0; j < h; j++)
+        {
+            double angle = -M_PI * j / h;
+            twiddleRe_[h - 1 + j] = (float)std::cos(angle);
+            twiddleIm_[h - 1 + j] = (float)std::sin(angle);
+        }
+    }
+
+    realRe_.resize(half_ + 1);
+    realIm_.resize(half_ + 1);
+    for (int k = 0; k <= half_; k++)
+    {
+        double angle = -2.0 * M_PI * k / size_;
+        realRe_[k] = (float)std::cos(angle);
+        realIm_[k] = (float)std::sin(angle);
+    }
+
+    workRe_.resize(half_);
+    workIm_.resize(half_);
+}
+
+void Fft::complexForward(float *re, float *im) const
+{
+    static const bool useAVX2 = cpuHasAVX2();
+    static const bool useSSE2 = cpuHasSSE2();
+
+    for (int i = 0; i < half_; i++)
+    {
+        int j = bitReverse_[i];
+        if (j > i)
+        {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    for (int h = 1; h < half_; h *= 2)
+    {
+        const float *wRe = twiddleRe_.data() + h - 1;
+        const float *wIm = twiddleIm_.data() + h - 1;
+
+        // The first two stages are too narrow for a register and stay scalar
+#if defined(GUITAR_SIMD_X86)
+        if (h >= 8 && useAVX2)
+            stageAVX2(re, im, wRe, wIm, half_, h);
+        else if (h >= 4 && useSSE2)
+            stageSSE2(re, im, wRe, wIm, half_, h);
+        else
+            stageScalar(re, im, wRe, wIm, half_, h);
+#else
+        (void)useAVX2;
+        (void)useSSE2;
+        stageScalar(re, im, wRe, wIm, half_, h);
+#endif
+    }
+}
+
+void Fft::forward(const float *input, float *re, float *im)
+{
+    // Pack even samples into the real part and odd samples into the imaginary part
+    for (int n = 0; n < half_; n++)
+    {
+        workRe_[n] = input[2 * n];
+        workIm_[n] = input[2 * n + 1];
+    }
+    complexForward(workRe_.data(), workIm_.data());
+
+    // Untangle the two half-length spectra: X[k] = E[k] + W^k O[k]
+    for (int k = 0; k <= half_; k++)
+    {
+        int a = k % half_;
+        int b = (half_ - k) % half_;
+        float zr = workRe_[a], zi = workIm_[a];
+        float cr = workRe_[b], ci = -workIm_[b]; // conj(Z[M - k])
+
+        float er = 0.5f * (zr + cr);
+        float ei = 0.5f * (zi + ci);
+        float orr = 0.5f * (zi - ci);
+        float oi = -0.5f * (zr - cr);
+
+        re[k] = er + realRe_[k] * orr - realIm_[k] * oi;
+        im[k] = ei + realRe_[k] * oi + realIm_[k] * orr;
+    }
+}
+
+void Fft::inverse(const float *re, const float *im, float *output)
+{
+    for (int k = 0; k < half_; k++)
+    {
+        float xr = re[k], xi = im[k];
+        float cr = re[half_ - k], ci = -im[half_ - k]; // conj(X[M - k])
+
+        float er = 0.5f * (xr + cr);
+        float ei = 0.5f * (xi + ci);
+        float dr = 0.5f * (xr - cr);
+        float di = 0.5f * (xi - ci);
+
+        // O = D * W^-k
+        float orr = dr * realRe_[k] + di * realIm_[k];
+        float oi = di * realRe_[k] - dr * realIm_[k];
+
+        // Z = E + iO, conjugated so the forward transform computes the inverse
+        workRe_[k] = er - oi;
+        workIm_[k] = -(ei + orr);
+    }
+    complexForward(workRe_.data(), workIm_.data());
+
+    const float scale = 1.0f / half_;
+    for (int n = 0; n < half_; n++)
+    {
+        output[2 * n] = workRe_[n] * scale;
+        output[2 * n + 1] = -workIm_[n] * scale;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+
+// Self-contained real FFT for power-of-two sizes.
+// A real transform of length N runs as an N/2-point complex FFT on split real/imaginary
+// arrays, so every radix-2 stage wide enough for a SIMD register is vectorized.
+class Fft
+{
+private:
+    int size_; // real transform length N
+    int half_; // complex FFT length N/2
+
+    std::vector<int> bitReverse_;
+    std::vector<float> twiddleRe_; // every stage's twiddles back to back: stage with h butterflies starts at h - 1
+    std::vector<float> twiddleIm_;
+    std::vector<float> realRe_;    // exp(-2*pi*i*k/N) for splitting the packed result, k = 0..N/2
+    std::vector<float> realIm_;
+    std::vector<float> workRe_;
+    std::vector<float> workIm_;
+
+    void complexForward(float *re, float *im) const;
+
+public:
+    explicit Fft(int size);
+
+    int getSize() const { return size_; }
+    int getBinCount() const { return half_ + 1; }
+
+    // N real samples -> N/2 + 1 bins
+    void forward(const float *input, float *re, float *im);
+
+    // N/2 + 1 bins -> N real samples, including the 1/N scale
+    void inverse(const float *re, const float *im, float *output);
+
+    static bool isPowerOfTwo(int value) { return value > 0 && (value & (value - 1)) == 0; }
+};
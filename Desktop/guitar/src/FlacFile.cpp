@@ -0,0 +1,524 @@
+#include "FlacFile.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static constexpr int MAX_BITS_PER_SAMPLE = 24; // keeps the side channel (one bit wider) in 32 bits
+
+// MSB-first bit reader over a byte range. Reading past the end returns zeros; pastEnd() says
+// whether that happened, so a frame cut short by the buffer can be retried with more input.
+struct BitReader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t bytePos;  // next byte to load into the cache
+    uint64_t cache;  // unread bits, left-aligned
+    int cacheBits;
+
+    BitReader(const uint8_t *bytes, size_t length) : data(bytes), size(length), bytePos(0), cache(0), cacheBits(0) {}
+
+    void refill()
+    {
+        while (cacheBits <= 56)
+        {
+            uint64_t byte = bytePos < size ? data[bytePos] : 0;
+            bytePos++;
+            cache |= byte << (56 - cacheBits);
+            cacheBits += 8;
+        }
+    }
+
+    uint32_t bits(int count)
+    {
+        if (count == 0)
+            return 0;
+        if (cacheBits < count)
+            refill();
+        uint32_t value = (uint32_t)(cache >> (64 - count));
+        cache <<= count;
+        cacheBits -= count;
+        return value;
+    }
+
+    int32_t signedBits(int count)
+    {
+        if (count == 0)
+            return 0;
+        uint32_t value = bits(count);
+        if (count < 32 && (value & (1u << (count - 1))))
+            value |= ~0u << count;
+        return (int32_t)value;
+    }
+
+    // Zeros before the next one bit, which is consumed too
+    uint32_t unary()
+    {
+        uint32_t count = 0;
+        for (;;)
+        {
+            if (cacheBits == 0 || cache == 0)
+            {
+                count += cacheBits;
+                cache = 0;
+                cacheBits = 0;
+                if (bytePos > size + 8)
+                    return count; // ran off the end; pastEnd() reports it
+                refill();
+                continue;
+            }
+            int zeros = 0;
+            while (!(cache & (1ull << 63)))
+            {
+                cache <<= 1;
+                zeros++;
+            }
+            cache <<= 1;
+            cacheBits -= zeros + 1;
+            return count + zeros;
+        }
+    }
+
+    void alignToByte()
+    {
+        int drop = cacheBits & 7;
+        cache <<= drop;
+        cacheBits -= drop;
+    }
+
+    size_t bytesConsumed() const { return bytePos - cacheBits / 8; }
+    bool pastEnd() const { return bytePos * 8 - cacheBits > size * 8; }
+};
+
+// Residual plus prediction. Valid streams never overflow; corrupt ones wrap instead of being undefined.
+static inline int32_t addWrapped(int32_t a, int64_t b)
+{
+    return (int32_t)((uint32_t)a + (uint32_t)b);
+}
+
+// Partitioned Rice residual after the warm-up samples; false on a malformed partition layout
+static bool decodeResidual(BitReader &bits, int32_t *residual, int blockSize, int order)
+{
+    int method = (int)bits.bits(2);
+    if (method > 1)
+        return false;
+    const int parameterBits = method == 0 ? 4 : 5;
+    const uint32_t escape = method == 0 ? 15 : 31;
+
+    int partitionOrder = (int)bits.bits(4);
+    int partitionSize = blockSize >> partitionOrder;
+    if ((partitionSize << partitionOrder) != blockSize || partitionSize < order)
+        return false;
+
+    int32_t *out = residual;
+    for (int p = 0; p < (1 << partitionOrder); p++)
+    {
+        int count = p == 0 ? partitionSize - order : partitionSize;
+        uint32_t parameter = bits.bits(parameterBits);
+        if (parameter == escape)
+        {
+            int raw = (int)bits.bits(5);
+            for (int i = 0; i < count; i++)
+                out[i] = bits.signedBits(raw);
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                uint32_t value = (bits.unary() << parameter) | bits.bits((int)parameter);
+                out[i] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+            }
+        }
+        out += count;
+
+        // A frame cut off by the read-ahead buffer stops here rather than predicting from zeros
+        if (bits.pastEnd())
+            return false;
+    }
+    return true;
+}
+
+// One channel's subframe into `samples`; bps already includes the side channel's extra bit
+static bool decodeSubframe(BitReader &bits, int32_t *samples, int blockSize, int bps)
+{
+    if (bits.bits(1) != 0)
+        return false;
+    int type = (int)bits.bits(6);
+
+    int wasted = 0;
+    if (bits.bits(1))
+    {
+        wasted = (int)bits.unary() + 1;
+        if (wasted >= bps)
+            return false;
+        bps -= wasted;
+    }
+
+    if (type == 0)
+    {
+        int32_t value = bits.signedBits(bps);
+        std::fill(samples, samples + blockSize, value);
+    }
+    else if (type == 1)
+    {
+        for (int i = 0; i < blockSize; i++)
+            samples[i] = bits.signedBits(bps);
+    }
+    else if (type >= 8 && type <= 12)
+    {
+        // Fixed polynomial predictors of order 0 to 4
+        int order = type - 8;
+        if (order > blockSize)
+            return false;
+        for (int i = 0; i < order; i++)
+            samples[i] = bits.signedBits(bps);
+        if (!decodeResidual(bits, samples + order, blockSize, order))
+            return false;
+
+        int32_t *s = samples;
+        switch (order)
+        {
+        case 1:
+            for (int i = 1; i < blockSize; i++)
+                s[i] = addWrapped(s[i], s[i - 1]);
+            break;
+        case 2:
+            for (int i = 2; i < blockSize; i++)
+                s[i] = addWrapped(s[i], 2 * (int64_t)s[i - 1] - s[i - 2]);
+            break;
+        case 3:
+            for (int i = 3; i < blockSize; i++)
+                s[i] = addWrapped(s[i], 3 * ((int64_t)s[i - 1] - s[i - 2]) + s[i - 3]);
+            break;
+        case 4:
+            for (int i = 4; i < blockSize; i++)
+                s[i] = addWrapped(s[i], 4 * ((int64_t)s[i - 1] + s[i - 3]) - 6 * (int64_t)s[i - 2] - s[i - 4]);
+            break;
+        default:
+            break;
+        }
+    }
+    else if (type >= 32)
+    {
+        // Linear prediction with quantized coefficients
+        int order = (type & 31) + 1;
+        if (order > blockSize)
+            return false;
+        for (int i = 0; i < order; i++)
+            samples[i] = bits.signedBits(bps);
+
+        int precision = (int)bits.bits(4) + 1;
+        int shift = bits.signedBits(5);
+        if (precision == 16 || shift < 0)
+            return false;
+        int32_t coefficients[32];
+        for (int i = 0; i < order; i++)
+            coefficients[i] = bits.signedBits(precision);
+        if (!decodeResidual(bits, samples + order, blockSize, order))
+            return false;
+
+        for (int i = order; i < blockSize; i++)
+        {
+            int64_t sum = 0;
+            for (int j = 0; j < order; j++)
+                sum += (int64_t)coefficients[j] * samples[i - 1 - j];
+            samples[i] = addWrapped(samples[i], sum >> shift);
+        }
+    }
+    else
+    {
+        return false; // reserved subframe type
+    }
+
+    if (wasted > 0)
+    {
+        for (int i = 0; i < blockSize; i++)
+            samples[i] = (int32_t)((uint32_t)samples[i] << wasted);
+    }
+    return true;
+}
+
+FlacReader::FlacReader()
+    : audioStart_(0), channels_(0), sampleRate_(0), bitsPerSample_(0), maxBlockSize_(0), frameCount_(0),
+      position_(0), inputPos_(0), inputEnd_(0), fileDone_(false), blockFrames_(0), blockPos_(0), ended_(false)
+{
+}
+
+bool FlacReader::open(const std::string &path)
+{
+    file_.close();
+    file_.clear();
+    file_.open(path, std::ios::binary);
+    if (!file_)
+    {
+        std::cerr << "Failed to open FLAC file: " << path << std::endl;
+        return false;
+    }
+
+    // Some taggers put an ID3v2 block in front of the stream
+    uint8_t header[10];
+    if (!file_.read(reinterpret_cast<char *>(header), 4))
+    {
+        std::cerr << "Not a FLAC file: " << path << std::endl;
+        return false;
+    }
+    if (std::memcmp(header, "ID3", 3) == 0 && file_.read(reinterpret_cast<char *>(header + 4), 6))
+    {
+        uint32_t size = ((header[6] & 0x7F) << 21) | ((header[7] & 0x7F) << 14) | ((header[8] & 0x7F) << 7) |
+                        (header[9] & 0x7F);
+        file_.seekg(10 + (std::streamoff)size, std::ios::beg);
+        file_.read(reinterpret_cast<char *>(header), 4);
+    }
+    if (!file_ || std::memcmp(header, "fLaC", 4) != 0)
+    {
+        std::cerr << "Not a FLAC file: " << path << std::endl;
+        return false;
+    }
+
+    channels_ = 0;
+    size_t maxFrameSize = 0;
+
+    // Metadata blocks; only STREAMINFO matters for playback
+    bool last = false;
+    while (!last)
+    {
+        uint8_t block[4];
+        if (!file_.read(reinterpret_cast<char *>(block), 4))
+            break;
+        last = (block[0] & 0x80) != 0;
+        int type = block[0] & 0x7F;
+        uint32_t length = ((uint32_t)block[1] << 16) | ((uint32_t)block[2] << 8) | block[3];
+
+        if (type == 0 && length >= 34)
+        {
+            uint8_t info[34];
+            if (!file_.read(reinterpret_cast<char *>(info), sizeof(info)))
+                break;
+            file_.seekg(length - 34, std::ios::cur);
+
+            BitReader bits(info, sizeof(info));
+            bits.bits(16); // minimum block size
+            maxBlockSize_ = (int)bits.bits(16);
+            bits.bits(24); // minimum frame size
+            maxFrameSize = bits.bits(24);
+            sampleRate_ = (int)bits.bits(20);
+            channels_ = (int)bits.bits(3) + 1;
+            bitsPerSample_ = (int)bits.bits(5) + 1;
+            frameCount_ = ((uint64_t)bits.bits(4) << 32) | bits.bits(32);
+        }
+        else
+        {
+            file_.seekg(length, std::ios::cur);
+        }
+    }
+
+    if (!file_ || channels_ == 0)
+    {
+        std::cerr << "No STREAMINFO in FLAC file: " << path << std::endl;
+        return false;
+    }
+    if (bitsPerSample_ < 4 || bitsPerSample_ > MAX_BITS_PER_SAMPLE || sampleRate_ < 1 || maxBlockSize_ < 16)
+    {
+        std::cerr << "Unsupported FLAC stream (" << bitsPerSample_ << " bits, " << sampleRate_
+                  << " Hz): " << path << std::endl;
+        return false;
+    }
+
+    // Room for the largest frame: a verbatim block with every side bit, or what the encoder says it wrote
+    size_t verbatim = (size_t)maxBlockSize_ * channels_ * (bitsPerSample_ + 1) / 8 + 256;
+    input_.assign(std::max(verbatim, maxFrameSize + 256) * 2, 0);
+    channelData_.assign((size_t)maxBlockSize_ * channels_, 0);
+    block_.assign((size_t)maxBlockSize_ * channels_, 0.0f);
+
+    audioStart_ = file_.tellg();
+    return seek(0);
+}
+
+bool FlacReader::fillInput(size_t wanted)
+{
+    if (inputPos_ > 0)
+    {
+        std::memmove(input_.data(), input_.data() + inputPos_, inputEnd_ - inputPos_);
+        inputEnd_ -= inputPos_;
+        inputPos_ = 0;
+    }
+    if (input_.size() < wanted)
+        input_.resize(wanted);
+
+    while (!fileDone_ && inputEnd_ < wanted)
+    {
+        file_.read(reinterpret_cast<char *>(input_.data() + inputEnd_), (std::streamsize)(input_.size() - inputEnd_));
+        std::streamsize got = file_.gcount();
+        inputEnd_ += (size_t)got;
+        if (got <= 0 || !file_)
+            fileDone_ = true;
+    }
+    return inputEnd_ > inputPos_;
+}
+
+bool FlacReader::decodeFrame()
+{
+    // Try with what one frame normally needs; a frame cut off by the buffer is retried with more
+    for (size_t wanted = input_.size() / 2;; wanted *= 2)
+    {
+        if (!fillInput(wanted))
+            return false;
+        size_t available = inputEnd_ - inputPos_;
+        BitReader bits(input_.data() + inputPos_, available);
+
+        if (bits.bits(14) != 0x3FFE || bits.bits(1) != 0)
+            return false; // no frame here: trailing tags or damage
+        bits.bits(1); // blocking strategy; frame numbers aren't needed to play in order
+
+        int blockCode = (int)bits.bits(4);
+        int rateCode = (int)bits.bits(4);
+        int assignment = (int)bits.bits(4);
+        int sizeCode = (int)bits.bits(3);
+        bits.bits(1);
+
+        // Frame or sample number, UTF-8 style: the leading ones give the extra bytes
+        uint32_t lead = bits.bits(8);
+        int extra = 0;
+        while (extra < 7 && (lead & (0x80 >> extra)))
+            extra++;
+        if (extra == 1 || extra == 7)
+            return false;
+        for (int i = 1; i < extra; i++)
+            bits.bits(8);
+
+        int blockSize = 0;
+        if (blockCode == 1)
+            blockSize = 192;
+        else if (blockCode >= 2 && blockCode <= 5)
+            blockSize = 576 << (blockCode - 2);
+        else if (blockCode == 6)
+            blockSize = (int)bits.bits(8) + 1;
+        else if (blockCode == 7)
+            blockSize = (int)bits.bits(16) + 1;
+        else if (blockCode >= 8)
+            blockSize = 256 << (blockCode - 8);
+
+        if (rateCode == 12)
+            bits.bits(8);
+        else if (rateCode == 13 || rateCode == 14)
+            bits.bits(16);
+        else if (rateCode == 15)
+            return false;
+
+        static const int SIZE_BITS[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+        int bps = sizeCode == 0 ? bitsPerSample_ : SIZE_BITS[sizeCode];
+        int frameChannels = assignment < 8 ? assignment + 1 : 2;
+        bits.bits(8); // header CRC-8
+
+        if (blockSize == 0 || blockSize > maxBlockSize_ || bps == 0 || bps > MAX_BITS_PER_SAMPLE ||
+            assignment > 10 || frameChannels != channels_)
+            return false;
+
+        bool decoded = true;
+        for (int c = 0; c < channels_ && decoded; c++)
+        {
+            // The side channel carries one more bit
+            bool side = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+            decoded = decodeSubframe(bits, channelData_.data() + (size_t)c * blockSize, blockSize, bps + (side ? 1 : 0));
+        }
+        bits.alignToByte();
+        bits.bits(16); // frame CRC-16
+
+        if (bits.pastEnd())
+        {
+            if (fileDone_ || wanted > (size_t)64 << 20)
+                return false;
+            continue;
+        }
+        if (!decoded)
+            return false;
+        inputPos_ += bits.bytesConsumed();
+
+        // Undo the stereo decorrelation
+        int32_t *a = channelData_.data();
+        int32_t *b = channelData_.data() + blockSize;
+        if (assignment == 8)
+        {
+            for (int i = 0; i < blockSize; i++)
+                b[i] = addWrapped(a[i], -(int64_t)b[i]);
+        }
+        else if (assignment == 9)
+        {
+            for (int i = 0; i < blockSize; i++)
+                a[i] = addWrapped(a[i], b[i]);
+        }
+        else if (assignment == 10)
+        {
+            for (int i = 0; i < blockSize; i++)
+            {
+                int32_t mid = (int32_t)((uint32_t)a[i] << 1) | (b[i] & 1);
+                int32_t side = b[i];
+                a[i] = (int32_t)(((int64_t)mid + side) >> 1);
+                b[i] = (int32_t)(((int64_t)mid - side) >> 1);
+            }
+        }
+
+        const float scale = 1.0f / (float)(1u << (bps - 1));
+        for (int c = 0; c < channels_; c++)
+        {
+            const int32_t *source = channelData_.data() + (size_t)c * blockSize;
+            for (int i = 0; i < blockSize; i++)
+                block_[(size_t)i * channels_ + c] = source[i] * scale;
+        }
+        blockFrames_ = blockSize;
+        blockPos_ = 0;
+        return true;
+    }
+}
+
+bool FlacReader::seek(uint64_t frame)
+{
+    if (frameCount_ > 0 && frame > frameCount_)
+        return false;
+
+    file_.clear();
+    file_.seekg(audioStart_, std::ios::beg);
+    inputPos_ = inputEnd_ = 0;
+    fileDone_ = false;
+    blockFrames_ = blockPos_ = 0;
+    ended_ = false;
+    position_ = 0;
+
+    while (position_ < frame)
+    {
+        if (blockPos_ == blockFrames_ && !decodeFrame())
+        {
+            ended_ = true;
+            return false;
+        }
+        int skip = (int)std::min<uint64_t>(blockFrames_ - blockPos_, frame - position_);
+        blockPos_ += skip;
+        position_ += skip;
+    }
+    return (bool)file_ || fileDone_;
+}
+
+int FlacReader::read(float *samples, int frames)
+{
+    if (frameCount_ > 0)
+        frames = (int)std::min<uint64_t>((uint64_t)std::max(frames, 0), frameCount_ - position_);
+
+    int done = 0;
+    while (done < frames)
+    {
+        if (blockPos_ == blockFrames_)
+        {
+            if (ended_ || !decodeFrame())
+            {
+                ended_ = true;
+                break;
+            }
+        }
+        int count = std::min(frames - done, blockFrames_ - blockPos_);
+        std::memcpy(samples + (size_t)done * channels_, block_.data() + (size_t)blockPos_ * channels_,
+                    (size_t)count * channels_ * sizeof(float));
+        blockPos_ += count;
+        done += count;
+    }
+    position_ += done;
+    return done;
+}
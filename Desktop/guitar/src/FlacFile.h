@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Streaming FLAC decoder with the same interface as WavReader, for sample libraries that are
+// too big to keep uncompressed. Handles every subframe type (constant, verbatim, fixed and LPC
+// prediction), both Rice codings with escapes, wasted bits and the three stereo decorrelation
+// modes, at 4 to 24 bits per sample. Frame CRCs are not checked; a damaged frame that still
+// parses plays as noise, one that doesn't ends the stream.
+class FlacReader
+{
+private:
+    std::ifstream file_;
+    std::streamoff audioStart_; // first frame, just after the metadata blocks
+    int channels_;
+    int sampleRate_;
+    int bitsPerSample_;
+    int maxBlockSize_;
+    uint64_t frameCount_; // 0 when the encoder didn't know the length
+    uint64_t position_;
+
+    // Compressed bytes read ahead of the decoder; refilled before each frame so a whole frame fits
+    std::vector<uint8_t> input_;
+    size_t inputPos_;
+    size_t inputEnd_;
+    bool fileDone_;
+
+    // The current frame, decoded to interleaved floats, and how much of it has been read
+    std::vector<int32_t> channelData_; // one block per channel
+    std::vector<float> block_;
+    int blockFrames_;
+    int blockPos_;
+    bool ended_;
+
+    bool fillInput(size_t wanted);
+    bool decodeFrame();
+
+public:
+    FlacReader();
+
+    // Fails with a message on anything that isn't a FLAC stream this decoder can play
+    bool open(const std::string &path);
+
+    // Up to `frames` interleaved frames in [-1, 1]; returns how many were read, 0 at the end
+    int read(float *samples, int frames);
+
+    // Decodes forward from the start to reach the frame; cheap near the start, slow far into a long file
+    bool seek(uint64_t frame);
+
+    int getChannels() const { return channels_; }
+    int getSampleRate() const { return sampleRate_; }
+    int getBitsPerSample() const { return bitsPerSample_; }
+    uint64_t getFrameCount() const { return frameCount_; }
+};
@@ -1,5 +1,6 @@
 #include "Guitar.h"
 #include "AudioManager.h"
+#include "Tuning.h"
 #include <cmath>
 #include <iostream>
 
@@ -12,14 +13,14 @@ Guitar::Guitar(SDL_Renderer *renderer, AudioManager *audioManager)
 
 void Guitar::initializeStrings()
 {
-    // Standard guitar tuning (from low E to high E)
+    // Standard guitar tuning (from low E to high E), shared with the synth and the transcriber
     strings = {
-        {0, {}, "E", 82.41f},  // Low E (6th string)
-        {1, {}, "A", 110.0f},  // A (5th string)
-        {2, {}, "D", 146.83f}, // D (4th string)
-        {3, {}, "G", 196.0f},  // G (3rd string)
-        {4, {}, "B", 246.94f}, // B (2nd string)
-        {5, {}, "E", 329.63f}  // High E (1st string)
+        {0, {}, "E", Tuning::STANDARD_FREQUENCIES[0]}, // Low E (6th string)
+        {1, {}, "A", Tuning::STANDARD_FREQUENCIES[1]}, // A (5th string)
+        {2, {}, "D", Tuning::STANDARD_FREQUENCIES[2]}, // D (4th string)
+        {3, {}, "G", Tuning::STANDARD_FREQUENCIES[3]}, // G (3rd string)
+        {4, {}, "B", Tuning::STANDARD_FREQUENCIES[4]}, // B (2nd string)
+        {5, {}, "E", Tuning::STANDARD_FREQUENCIES[5]}  // High E (1st string)
     };
 
     // Calculate frequencies for each fret on each string
@@ -31,6 +32,13 @@ void Guitar::initializeStrings()
             guitarString.fretFrequencies.push_back(frequency);
         }
     }
+
+    std::vector<float> baseFrequencies;
+    for (const auto &guitarString : strings)
+    {
+        baseFrequencies.push_back(guitarString.baseFrequency);
+    }
+    audioManager->setTuning(baseFrequencies, FRET_COUNT);
 }
 
 void Guitar::initializeFrets()
@@ -203,7 +211,7 @@ void Guitar::handleClick(int x, int y)
         {
 
             std::cout << "Playing: " << fret.noteName << " (" << fret.frequency << " Hz)" << std::endl;
-            audioManager->playNote(fret.frequency);
+            audioManager->playNote(fret.frequency, fret.stringIndex);
 
             // Visual feedback - highlight the played fret
             SDL_SetRenderDrawColor(renderer, 255, 255, 0, 128); // Yellow highlight
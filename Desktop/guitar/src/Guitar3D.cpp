@@ -1,14 +1,16 @@
 #include "Guitar3D.h"
+#include "Tuning.h"
 #include <GL/glew.h>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <iterator>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 Guitar3D::Guitar3D(int windowWidth, int windowHeight, AudioManager *audioManager)
-    : audioManager_(audioManager), shaderProgram_(0), lightPos_(2.0f, 2.0f, 2.0f), lightColor_(1.0f, 1.0f, 1.0f)
+    : audioManager_(audioManager), shaderProgram_(0), heldString_(-1), lightPos_(2.0f, 2.0f, 2.0f), lightColor_(1.0f, 1.0f, 1.0f)
 {
 
     // Initialize camera
@@ -16,15 +18,9 @@ Guitar3D::Guitar3D(int windowWidth, int windowHeight, AudioManager *audioManager
     camera_->setPosition(glm::vec3(0.0f, 2.0f, 3.0f)); // Position camera to look at the guitar from an angle
     camera_->setTarget(glm::vec3(0.0f, 0.0f, 0.0f));
 
-    // Initialize string frequencies (same as before)
-    stringBaseFrequencies_ = {
-        82.41f,  // Low E (6th string)
-        110.0f,  // A (5th string)
-        146.83f, // D (4th string)
-        196.0f,  // G (3rd string)
-        246.94f, // B (2nd string)
-        329.63f  // High E (1st string)
-    };
+    // Initialize string frequencies from the shared standard tuning
+    stringBaseFrequencies_.assign(std::begin(Tuning::STANDARD_FREQUENCIES), std::end(Tuning::STANDARD_FREQUENCIES));
+    audioManager_->setTuning(stringBaseFrequencies_, Tuning::FRET_COUNT);
 
     // Initialize model loader
     modelLoader_ = std::make_unique<GLBLoader>();
@@ -104,7 +100,7 @@ void Guitar3D::render()
     modelLoader_->render();
 }
 
-void Guitar3D::handleClick(int x, int y, int windowWidth, int windowHeight)
+void Guitar3D::handleClick(int x, int y, int windowWidth, int windowHeight, int64_t eventTime)
 {
     // Get ray from camera through click position
     glm::vec3 rayDir = camera_->screenToWorldRay(x, y, windowWidth, windowHeight);
@@ -117,7 +113,9 @@ void Guitar3D::handleClick(int x, int y, int windowWidth, int windowHeight)
 
     // Check for intersection with guitar
     glm::vec3 hitPoint;
-    if (modelLoader_->checkGuitarHit(glm::vec3(rayOriginModelSpace), glm::vec3(rayDirModelSpace), hitPoint))
+    bool hit = modelLoader_->checkGuitarHit(glm::vec3(rayOriginModelSpace), glm::vec3(rayDirModelSpace), hitPoint);
+    audioManager_->getLatencyProbe().markPending(LatencyStage::Picked);
+    if (hit)
     {
         int stringIndex = modelLoader_->getStringFromHit(hitPoint);
         int fretNumber = modelLoader_->getFretFromHit(hitPoint);
@@ -136,8 +134,58 @@ void Guitar3D::handleClick(int x, int y, int windowWidth, int windowHeight)
                   << ", Note: " << noteName
                   << " (" << frequency << " Hz)" << std::endl;
 
-        // Play the note
-        audioManager_->playNote(frequency);
+        // Play the note; it sustains until the button comes up. A new pick lets go of the last bend.
+        audioManager_->setBend(stringIndex, 0.0f);
+        audioManager_->setVibrato(stringIndex, 0.0f);
+        audioManager_->playNote(frequency, stringIndex, 1.0f, eventTime);
+        heldString_ = stringIndex;
+    }
+}
+
+void Guitar3D::handleRelease(int64_t eventTime)
+{
+    if (heldString_ >= 0)
+    {
+        audioManager_->releaseNote(heldString_, eventTime);
+        heldString_ = -1;
+    }
+
+    // The bar springs back; a bend stays on the note while it rings out
+    audioManager_->setWhammy(0.0f);
+}
+
+void Guitar3D::handleDrag(int offsetX, int offsetY, bool whammy)
+{
+    // Screen y grows downwards
+    if (whammy)
+    {
+        float cents = -offsetY * WHAMMY_CENTS_PER_PIXEL;
+        audioManager_->setWhammy(std::max(MIN_WHAMMY_CENTS, std::min(cents, MAX_WHAMMY_CENTS)));
+        return;
+    }
+
+    if (heldString_ < 0)
+        return;
+    float bend = -offsetY * BEND_CENTS_PER_PIXEL;
+    float vibrato = std::abs(offsetX) * VIBRATO_CENTS_PER_PIXEL;
+    audioManager_->setBend(heldString_, std::max(0.0f, std::min(bend, MAX_BEND_CENTS)));
+    audioManager_->setVibrato(heldString_, std::min(vibrato, MAX_VIBRATO_CENTS));
+}
+
+void Guitar3D::strumChord(const ChordVoicing &chord, StrumDirection direction, int64_t eventTime)
+{
+    std::cout << "Strum " << chord.name << (direction == StrumDirection::Down ? " (down)" : " (up)") << std::endl;
+
+    // One batch for all strings; no picking or per-note work on this thread
+    audioManager_->strum(chord, direction, AudioManager::DEFAULT_STRUM_SECONDS, 1.0f, eventTime);
+}
+
+void Guitar3D::releaseChord(const ChordVoicing &chord, int64_t eventTime)
+{
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        if (chord.notes[s] >= 0 && s != heldString_)
+            audioManager_->releaseNote(s, eventTime);
     }
 }
 
@@ -16,6 +16,9 @@ private:
     // Guitar string frequencies (same as before)
     std::vector<float> stringBaseFrequencies_;
 
+    // String picked by the mouse button that is still down, -1 when none
+    int heldString_;
+
     // Lighting
     glm::vec3 lightPos_;
     glm::vec3 lightColor_;
@@ -31,12 +34,28 @@ private:
     std::string getNoteName(float frequency);
 
 public:
+    // Left-drag after a click, measured from where the button went down
+    static constexpr float BEND_CENTS_PER_PIXEL = 2.0f; // upwards
+    static constexpr float MAX_BEND_CENTS = 300.0f;
+    static constexpr float VIBRATO_CENTS_PER_PIXEL = 0.5f; // sideways, either way
+    static constexpr float MAX_VIBRATO_CENTS = 50.0f;
+    static constexpr float WHAMMY_CENTS_PER_PIXEL = 4.0f; // with Shift: down dips, up pulls
+    static constexpr float MIN_WHAMMY_CENTS = -1200.0f;
+    static constexpr float MAX_WHAMMY_CENTS = 300.0f;
+
     Guitar3D(int windowWidth, int windowHeight, AudioManager *audioManager);
     ~Guitar3D();
 
     bool initialize();
     void render();
-    void handleClick(int x, int y, int windowWidth, int windowHeight);
+    // eventTime: when the input happened, on the LatencyProbe::now() clock (0 = now)
+    void handleClick(int x, int y, int windowWidth, int windowHeight, int64_t eventTime = 0);
+    void handleRelease(int64_t eventTime = 0);
+    // Bends the held string and sets its vibrato, or with whammy set works the bar on everything ringing
+    void handleDrag(int offsetX, int offsetY, bool whammy);
+    void strumChord(const ChordVoicing &chord, StrumDirection direction, int64_t eventTime = 0);
+    // Note-off for the chord's strings, except one picked since
+    void releaseChord(const ChordVoicing &chord, int64_t eventTime = 0);
     void handleMouseMotion(int deltaX, int deltaY);
     void handleMouseWheel(int delta);
     void resize(int width, int height);
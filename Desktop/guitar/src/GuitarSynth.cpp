@@ -0,0 +1,153 @@
+#include "GuitarSynth.h"
+#include "SynthEngine.h"
+#include <algorithm>
+#include <new>
+
+// Strings that get their own pan, bend and vibrato in the engine
+static const int MAX_STRINGS = 12;
+
+// Planar output is rendered interleaved into the handle's scratch first
+static const int CHUNK_FRAMES = 256;
+
+struct GuitarSynth
+{
+    SynthEngine engine;
+    float scratch[CHUNK_FRAMES * 2];
+
+    GuitarSynth(int sampleRate, int stringCount, int maxVoices) : engine(sampleRate, stringCount, maxVoices), scratch() {}
+};
+
+static VoiceKind voiceKind(GuitarSynthVoice voice)
+{
+    return voice == GUITAR_SYNTH_VOICE_TONE ? VoiceKind::Tone : VoiceKind::String;
+}
+
+extern "C" {
+
+int guitar_synth_abi_version(void)
+{
+    return GUITAR_SYNTH_ABI_VERSION;
+}
+
+GuitarSynth *guitar_synth_create(int sampleRate, int stringCount, int maxVoices)
+{
+    if (sampleRate < 8000 || sampleRate > 384000 || stringCount < 1 || stringCount > MAX_STRINGS)
+        return nullptr;
+
+    // Nothing may throw across the C boundary; the engine allocates its whole voice pool here
+    try
+    {
+        return new GuitarSynth(sampleRate, stringCount, maxVoices);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void guitar_synth_destroy(GuitarSynth *synth)
+{
+    delete synth;
+}
+
+uint64_t guitar_synth_sample_time(const GuitarSynth *synth)
+{
+    return synth->engine.getSampleTime();
+}
+
+int guitar_synth_note_on(GuitarSynth *synth, int stringIndex, float note, float velocity, GuitarSynthVoice voice,
+                         uint64_t sampleTime)
+{
+    NoteEvent event = {};
+    event.type = NoteEventType::NoteOn;
+    event.note = note;
+    event.velocity = std::max(0.0f, std::min(1.0f, velocity));
+    event.stringIndex = stringIndex;
+    event.timestamp = sampleTime;
+    event.tone = voice == GUITAR_SYNTH_VOICE_TONE;
+    return synth->engine.queueEvent(event) ? 1 : 0;
+}
+
+int guitar_synth_note_off(GuitarSynth *synth, int stringIndex, uint64_t sampleTime)
+{
+    NoteEvent event = {};
+    event.type = NoteEventType::NoteOff;
+    event.stringIndex = stringIndex;
+    event.timestamp = sampleTime;
+    return synth->engine.queueEvent(event) ? 1 : 0;
+}
+
+void guitar_synth_set_bend(GuitarSynth *synth, int stringIndex, float cents)
+{
+    synth->engine.setBend(stringIndex, cents);
+}
+
+void guitar_synth_set_vibrato(GuitarSynth *synth, int stringIndex, float depthCents, float rateHz)
+{
+    synth->engine.setVibrato(stringIndex, depthCents, rateHz);
+}
+
+void guitar_synth_set_whammy(GuitarSynth *synth, float cents)
+{
+    synth->engine.setWhammy(cents);
+}
+
+void guitar_synth_process(GuitarSynth *synth, float *interleaved, int frames)
+{
+    if (frames > 0)
+        synth->engine.render(interleaved, frames);
+}
+
+void guitar_synth_process_planar(GuitarSynth *synth, float *left, float *right, int frames)
+{
+    while (frames > 0)
+    {
+        int count = std::min(frames, CHUNK_FRAMES);
+        synth->engine.render(synth->scratch, count);
+        for (int i = 0; i < count; i++)
+        {
+            left[i] = synth->scratch[i * 2];
+            right[i] = synth->scratch[i * 2 + 1];
+        }
+        left += count;
+        right += count;
+        frames -= count;
+    }
+}
+
+void guitar_synth_set_max_voices(GuitarSynth *synth, int maxVoices)
+{
+    synth->engine.setMaxVoices(maxVoices);
+}
+
+void guitar_synth_set_string_pan(GuitarSynth *synth, int stringIndex, float pan)
+{
+    synth->engine.setStringPan(stringIndex, pan);
+}
+
+void guitar_synth_set_envelope(GuitarSynth *synth, GuitarSynthVoice voice, float attack, float decay, float sustain,
+                               float release)
+{
+    EnvelopeSettings settings;
+    settings.attack = attack;
+    settings.decay = decay;
+    settings.sustain = sustain;
+    settings.release = release;
+    synth->engine.setEnvelope(voiceKind(voice), settings);
+}
+
+void guitar_synth_set_seed(GuitarSynth *synth, unsigned int seed)
+{
+    synth->engine.setNoiseSeed(seed);
+}
+
+int guitar_synth_active_voices(const GuitarSynth *synth)
+{
+    return synth->engine.getActiveVoices();
+}
+
+uint32_t guitar_synth_dropped_events(const GuitarSynth *synth)
+{
+    return synth->engine.getDroppedEvents();
+}
+}
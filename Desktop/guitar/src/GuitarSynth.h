@@ -0,0 +1,87 @@
+#pragma once
+
+// Plain C interface to the synth engine for hosts that bring their own audio I/O: plugins, other
+// languages, offline tools. No SDL, and nothing is allocated after guitar_synth_create, so every
+// other call is safe on a real-time thread.
+//
+// Threads: one thread renders. Notes and modulation may come from that thread or from one other;
+// they travel through a wait-free queue and start on their exact sample. Create, destroy and the
+// configuration calls belong to the rendering thread, or to any thread while nothing renders.
+
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(GUITAR_SYNTH_EXPORTS)
+#define GUITAR_SYNTH_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(GUITAR_SYNTH_DLL)
+#define GUITAR_SYNTH_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define GUITAR_SYNTH_API __attribute__((visibility("default")))
+#else
+#define GUITAR_SYNTH_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GUITAR_SYNTH_ABI_VERSION 1
+
+// Sample time 0 (or any time already rendered) starts an event at the next processed frame
+#define GUITAR_SYNTH_NOW 0
+
+typedef struct GuitarSynth GuitarSynth;
+
+// What a note-on plays
+typedef enum GuitarSynthVoice
+{
+    GUITAR_SYNTH_VOICE_STRING = 0, // Karplus-Strong plucked string
+    GUITAR_SYNTH_VOICE_TONE = 1    // band-limited harmonic tone with an ADSR envelope
+} GuitarSynthVoice;
+
+// Bumped when a call changes in a way old callers would notice
+GUITAR_SYNTH_API int guitar_synth_abi_version(void);
+
+// NULL when the arguments are out of range (8-384 kHz, 1-12 strings) or memory runs out.
+// maxVoices is clamped to 1..64; each string plays one note at a time on top of that.
+GUITAR_SYNTH_API GuitarSynth *guitar_synth_create(int sampleRate, int stringCount, int maxVoices);
+GUITAR_SYNTH_API void guitar_synth_destroy(GuitarSynth *synth);
+
+// Engine sample time of the next frame guitar_synth_process renders. A host that gets events with a
+// frame offset into its next block queues them at this time plus the offset.
+GUITAR_SYNTH_API uint64_t guitar_synth_sample_time(const GuitarSynth *synth);
+
+// note is a MIDI note number, fractional values allowed, held to the range from 40 Hz up to Nyquist;
+// a note that is not finite is dropped. velocity 0..1. stringIndex -1 plays on no string, which
+// nothing chokes or releases; a tone there fades out over its decay and release. Returns 0 when the
+// queue was full and the note is lost.
+GUITAR_SYNTH_API int guitar_synth_note_on(GuitarSynth *synth, int stringIndex, float note, float velocity,
+                                          GuitarSynthVoice voice, uint64_t sampleTime);
+// Releases whatever the string is playing over its envelope's release
+GUITAR_SYNTH_API int guitar_synth_note_off(GuitarSynth *synth, int stringIndex, uint64_t sampleTime);
+
+// Pitch modulation in cents of voices already playing; glided in the engine, so it can be called
+// as often as the host likes. Bend and whammy are clamped to -2400..1200 cents.
+GUITAR_SYNTH_API void guitar_synth_set_bend(GuitarSynth *synth, int stringIndex, float cents);
+GUITAR_SYNTH_API void guitar_synth_set_vibrato(GuitarSynth *synth, int stringIndex, float depthCents, float rateHz);
+GUITAR_SYNTH_API void guitar_synth_set_whammy(GuitarSynth *synth, float cents);
+
+// Renders frames of stereo, interleaved left/right or one buffer per side. Any frame count works;
+// the buffers are overwritten, not mixed into.
+GUITAR_SYNTH_API void guitar_synth_process(GuitarSynth *synth, float *interleaved, int frames);
+GUITAR_SYNTH_API void guitar_synth_process_planar(GuitarSynth *synth, float *left, float *right, int frames);
+
+// Configuration
+GUITAR_SYNTH_API void guitar_synth_set_max_voices(GuitarSynth *synth, int maxVoices);
+GUITAR_SYNTH_API void guitar_synth_set_string_pan(GuitarSynth *synth, int stringIndex, float pan);
+// Times in seconds, sustain 0..1; applies to notes of that kind started afterwards
+GUITAR_SYNTH_API void guitar_synth_set_envelope(GuitarSynth *synth, GuitarSynthVoice voice, float attack, float decay,
+                                                float sustain, float release);
+GUITAR_SYNTH_API void guitar_synth_set_seed(GuitarSynth *synth, unsigned int seed);
+
+// Counters
+GUITAR_SYNTH_API int guitar_synth_active_voices(const GuitarSynth *synth);
+GUITAR_SYNTH_API uint32_t guitar_synth_dropped_events(const GuitarSynth *synth);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,892 @@
+#include "JamSession.h"
+#include "LatencyProbe.h"
+#include "NoteEventQueue.h"
+#include "SampleClock.h"
+#include "SynthEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Winsock has to be started once before any socket call; elsewhere there is nothing to do
+static bool startNetworking()
+{
+#ifdef _WIN32
+    static const bool started = []
+    {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+#else
+    return true;
+#endif
+}
+
+UdpSocket::UdpSocket() : handle_(-1)
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+    close();
+}
+
+bool UdpSocket::open(uint16_t port)
+{
+    close();
+    if (!startNetworking())
+        return false;
+
+#ifdef _WIN32
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET)
+        return false;
+    handle_ = (intptr_t)s;
+#else
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0)
+        return false;
+    handle_ = s;
+#endif
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(s, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        close();
+        return false;
+    }
+
+    // Never wait in sendto or recvfrom; receive() waits in select with a timeout instead
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(s, FIONBIO, &nonBlocking);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    return true;
+}
+
+void UdpSocket::close()
+{
+    if (handle_ == -1)
+        return;
+#ifdef _WIN32
+    closesocket((SOCKET)handle_);
+#else
+    ::close((int)handle_);
+#endif
+    handle_ = -1;
+}
+
+uint16_t UdpSocket::getPort() const
+{
+    if (handle_ == -1)
+        return 0;
+
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+#ifdef _WIN32
+    SOCKET s = (SOCKET)handle_;
+#else
+    int s = (int)handle_;
+#endif
+    if (getsockname(s, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+bool UdpSocket::resolve(const std::string &address, uint32_t &host, uint16_t &port)
+{
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || !startNetworking())
+        return false;
+
+    int number = std::atoi(address.c_str() + colon + 1);
+    if (number <= 0 || number > 65535)
+        return false;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(address.substr(0, colon).c_str(), nullptr, &hints, &found) != 0 || !found)
+        return false;
+
+    host = ntohl(reinterpret_cast<sockaddr_in *>(found->ai_addr)->sin_addr.s_addr);
+    port = (uint16_t)number;
+    freeaddrinfo(found);
+    return true;
+}
+
+bool UdpSocket::sendTo(const void *data, int size, uint32_t host, uint16_t port)
+{
+    if (handle_ == -1)
+        return false;
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(host);
+    address.sin_port = htons(port);
+#ifdef _WIN32
+    return sendto((SOCKET)handle_, static_cast<const char *>(data), size, 0, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) == size;
+#else
+    return sendto((int)handle_, data, size, 0, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == size;
+#endif
+}
+
+int UdpSocket::receive(void *data, int size, int64_t timeoutNs, uint32_t *host, uint16_t *port)
+{
+    if (handle_ == -1)
+        return -1;
+
+#ifdef _WIN32
+    SOCKET s = (SOCKET)handle_;
+#else
+    int s = (int)handle_;
+#endif
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(s, &readable);
+    timeval timeout;
+    timeoutNs = std::max<int64_t>(0, timeoutNs);
+    timeout.tv_sec = (long)(timeoutNs / 1000000000);
+    timeout.tv_usec = (long)(timeoutNs % 1000000000 / 1000);
+    int ready = select((int)s + 1, &readable, nullptr, nullptr, &timeout);
+    if (ready <= 0)
+        return ready == 0 ? 0 : -1;
+
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+#ifdef _WIN32
+    // A port-unreachable reply to an earlier send shows up here as WSAECONNRESET; nothing was lost
+    int received = recvfrom(s, static_cast<char *>(data), size, 0, reinterpret_cast<sockaddr *>(&address), &length);
+    if (received < 0)
+        return WSAGetLastError() == WSAECONNRESET || WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+#else
+    int received = (int)recvfrom(s, data, size, 0, reinterpret_cast<sockaddr *>(&address), &length);
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+#endif
+    if (host)
+        *host = ntohl(address.sin_addr.s_addr);
+    if (port)
+        *port = ntohs(address.sin_port);
+    return received;
+}
+
+// Wire format, little-endian throughout. Every packet starts with a 16-byte header:
+// magic "GJAM", version, type, event count, 0, sender session, first event's sequence number.
+// Events follow the sender's send time (8 bytes), 16 bytes each: type, string, flags (1 = tone),
+// velocity 0-255, time before or after the send in microseconds, value and rate as floats.
+// A ping carries its send time; the pong echoes it with the reply's receive and send times.
+static const uint32_t PACKET_MAGIC = 0x4D414A47;
+static const uint8_t PACKET_VERSION = 1;
+static const uint8_t PACKET_EVENTS = 1;
+static const uint8_t PACKET_PING = 2;
+static const uint8_t PACKET_PONG = 3;
+static const int HEADER_BYTES = 16;
+static const int EVENT_BYTES = 16;
+static const int MAX_PACKET_BYTES = 256;
+
+static void put32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void put64(uint8_t *p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void putFloat(uint8_t *p, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    put32(p, bits);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get64(const uint8_t *p)
+{
+    return (uint64_t)get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+static float getFloat(const uint8_t *p)
+{
+    uint32_t bits = get32(p);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+static void putHeader(uint8_t *p, uint8_t type, int count, uint32_t session, uint32_t sequence)
+{
+    put32(p, PACKET_MAGIC);
+    p[4] = PACKET_VERSION;
+    p[5] = type;
+    p[6] = (uint8_t)count;
+    p[7] = 0;
+    put32(p + 8, session);
+    put32(p + 12, sequence);
+}
+
+JamSession::JamSession()
+    : peerHost_(0), peerPort_(0), session_(0), engine_(nullptr), sampleClock_(nullptr), stringOffset_(0),
+      running_(false), outputDelay_(0), lateTarget_(DEFAULT_LATE_TARGET), skewBase_(0), skewOffset_(0), skewPpm_(0.0),
+      nextSequence_(0), recentCount_(0), lastSend_(0), repeatAt_(0), stats_(), latencyHistogram_()
+{
+}
+
+JamSession::~JamSession()
+{
+    stop();
+}
+
+int64_t JamSession::toSession(int64_t realTime) const
+{
+    return realTime + skewOffset_ + (int64_t)((realTime - skewBase_) * skewPpm_ * 1e-6);
+}
+
+int64_t JamSession::toReal(int64_t sessionTime) const
+{
+    // First order is plenty for the few hundred ppm a crystal is off
+    int64_t shifted = sessionTime - skewOffset_;
+    return shifted - (int64_t)((shifted - skewBase_) * skewPpm_ * 1e-6);
+}
+
+int64_t JamSession::now() const
+{
+    return toSession(LatencyProbe::now());
+}
+
+void JamSession::setClockSkew(int64_t offsetNs, double ppm)
+{
+    skewBase_ = LatencyProbe::now();
+    skewOffset_ = offsetNs;
+    skewPpm_ = ppm;
+}
+
+void JamSession::setLateTarget(float fraction)
+{
+    lateTarget_.store(std::max(0.0f, std::min(0.5f, fraction)), std::memory_order_relaxed);
+}
+
+bool JamSession::start(uint16_t localPort, const std::string &peer, SynthEngine *engine, const SampleClock *sampleClock,
+                       int stringOffset)
+{
+    stop();
+
+    if (!UdpSocket::resolve(peer, peerHost_, peerPort_))
+    {
+        std::cerr << "JamSession: can't resolve " << peer << " (expected host:port)" << std::endl;
+        return false;
+    }
+    if (!socket_.open(localPort))
+    {
+        std::cerr << "JamSession: can't listen on UDP port " << localPort << std::endl;
+        return false;
+    }
+
+    engine_ = engine;
+    sampleClock_ = sampleClock;
+    stringOffset_ = stringOffset;
+    session_ = (uint32_t)std::random_device()() ^ (uint32_t)LatencyProbe::now();
+    nextSequence_ = 0;
+    recentCount_ = 0;
+    repeatAt_ = 0;
+
+    remoteSession_ = 0;
+    expectedSequence_ = 0;
+    receivedAny_ = false;
+    bucketCount_ = 0;
+    bucketStart_ = 0;
+    firstOffset_ = 0;
+    firstSync_ = 0;
+    packetOffset_ = 0;
+    driftSlope_ = 0.0;
+    fitTime_ = 0;
+    fitOffset_ = 0.0;
+    transitHead_ = 0;
+    transitCount_ = 0;
+    playout_ = MIN_PLAYOUT_NS;
+    lastPlayoutUpdate_ = 0;
+    heldCount_ = 0;
+    std::fill(remoteBend_, remoteBend_ + Tuning::STRING_COUNT, 0.0f);
+    remoteWhammy_ = 0.0f;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_ = JamStats();
+        stats_.playoutDelay = playout_ / 1e6;
+        std::fill(latencyHistogram_, latencyHistogram_ + LATENCY_BINS, 0u);
+    }
+
+    running_.store(true);
+    thread_ = std::thread(&JamSession::run, this);
+    std::cout << "Jam session: listening on UDP port " << getPort() << ", playing with " << peer << std::endl;
+    return true;
+}
+
+void JamSession::stop()
+{
+    if (!running_.exchange(false))
+        return;
+    if (thread_.joinable())
+        thread_.join();
+    socket_.close();
+
+    // Let go of whatever the partner left sounding, and of their bends
+    releaseRemoteNotes();
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        engine_->setBend(stringOffset_ + s, 0.0f);
+        engine_->setVibrato(stringOffset_ + s, 0.0f);
+    }
+}
+
+void JamSession::releaseRemoteNotes()
+{
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        NoteEvent event = {};
+        event.type = NoteEventType::NoteOff;
+        event.stringIndex = stringOffset_ + s;
+        engine_->queueEvent(event, SynthEngine::NETWORK_PORT);
+    }
+}
+
+void JamSession::send(const JamEvent &event)
+{
+    if (!running_.load(std::memory_order_relaxed))
+        return;
+
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (recentCount_ == REDUNDANCY)
+    {
+        std::copy(recent_ + 1, recent_ + REDUNDANCY, recent_);
+        recentCount_--;
+    }
+    JamEvent &added = recent_[recentCount_++];
+    added = event;
+    added.time = event.time != 0 ? toSession(event.time) : now();
+    nextSequence_++;
+    sendRecent(now());
+    repeatAt_ = lastSend_ + REPEAT_NS;
+    {
+        std::lock_guard<std::mutex> statsLock(statsMutex_);
+        stats_.eventsSent++;
+    }
+}
+
+void JamSession::sendRecent(int64_t sendTime)
+{
+    uint8_t packet[HEADER_BYTES + 8 + REDUNDANCY * EVENT_BYTES];
+    putHeader(packet, PACKET_EVENTS, recentCount_, session_, nextSequence_ - recentCount_);
+    put64(packet + HEADER_BYTES, (uint64_t)sendTime);
+    for (int i = 0; i < recentCount_; i++)
+    {
+        const JamEvent &e = recent_[i];
+        uint8_t *p = packet + HEADER_BYTES + 8 + i * EVENT_BYTES;
+        int64_t offset = std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, (e.time - sendTime) / 1000));
+        p[0] = (uint8_t)e.type;
+        p[1] = (uint8_t)(int8_t)e.stringIndex;
+        p[2] = e.tone ? 1 : 0;
+        p[3] = (uint8_t)std::lround(std::max(0.0f, std::min(1.0f, e.velocity)) * 255.0f);
+        put32(p + 4, (uint32_t)(int32_t)offset);
+        putFloat(p + 8, e.value);
+        putFloat(p + 12, e.rate);
+    }
+
+    bool sent = socket_.sendTo(packet, HEADER_BYTES + 8 + recentCount_ * EVENT_BYTES, peerHost_, peerPort_);
+    lastSend_ = sendTime;
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.packetsSent += sent ? 1 : 0;
+}
+
+void JamSession::repeatLast(int64_t time)
+{
+    // The last events have no later packet to repeat them, so the session sends them once more
+    std::lock_guard<std::mutex> lock(sendMutex_);
+    if (repeatAt_ == 0 || time < repeatAt_)
+        return;
+    repeatAt_ = 0;
+    sendRecent(time);
+}
+
+void JamSession::run()
+{
+    uint8_t packet[MAX_PACKET_BYTES];
+    nextPing_ = now();
+    while (running_.load(std::memory_order_relaxed))
+    {
+        int64_t time = now();
+        if (time >= nextPing_)
+        {
+            sendPing(time);
+            nextPing_ = std::max(nextPing_ + PING_INTERVAL_NS, time);
+        }
+        repeatLast(time);
+
+        // Sleep in select until a packet, the next ping or the next held bend, and look at
+        // running_ at least every 50 ms
+        int64_t wait = std::min<int64_t>(nextPing_ - time, 50000000);
+        int64_t repeatAt = repeatAt_.load(std::memory_order_relaxed);
+        if (repeatAt != 0)
+            wait = std::min(wait, repeatAt - time);
+        if (heldCount_ > 0)
+            wait = std::min(wait, held_[0].due - LatencyProbe::now());
+
+        // The port listens on every address; only the partner gets to play notes or move the clock fit
+        uint32_t fromHost = 0;
+        uint16_t fromPort = 0;
+        int size = socket_.receive(packet, sizeof(packet), wait, &fromHost, &fromPort);
+        int64_t arrival = now();
+        if (size > 0 && (fromHost != peerHost_ || fromPort != peerPort_))
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.foreign++;
+        }
+        else if (size > 0)
+        {
+            handlePacket(packet, size, arrival);
+        }
+        applyHeld(LatencyProbe::now());
+    }
+}
+
+void JamSession::sendPing(int64_t time)
+{
+    uint8_t packet[HEADER_BYTES + 8];
+    putHeader(packet, PACKET_PING, 0, session_, 0);
+    put64(packet + HEADER_BYTES, (uint64_t)time);
+    socket_.sendTo(packet, sizeof(packet), peerHost_, peerPort_);
+}
+
+void JamSession::handlePacket(const uint8_t *data, int size, int64_t arrival)
+{
+    if (size < HEADER_BYTES || get32(data) != PACKET_MAGIC || data[4] != PACKET_VERSION)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.malformed++;
+        return;
+    }
+
+    uint8_t type = data[5];
+    int count = data[6];
+    uint32_t session = get32(data + 8);
+    uint32_t sequence = get32(data + 12);
+    const uint8_t *body = data + HEADER_BYTES;
+
+    if (type == PACKET_PING && size == HEADER_BYTES + 8)
+    {
+        uint8_t reply[HEADER_BYTES + 24];
+        putHeader(reply, PACKET_PONG, 0, session_, 0);
+        std::memcpy(reply + HEADER_BYTES, body, 8);
+        put64(reply + HEADER_BYTES + 8, (uint64_t)arrival);
+        put64(reply + HEADER_BYTES + 16, (uint64_t)now());
+        socket_.sendTo(reply, sizeof(reply), peerHost_, peerPort_);
+        return;
+    }
+    if (type == PACKET_PONG && size == HEADER_BYTES + 24)
+    {
+        handlePong((int64_t)get64(body), (int64_t)get64(body + 8), (int64_t)get64(body + 16), arrival);
+        return;
+    }
+    if (type != PACKET_EVENTS || count < 1 || count > REDUNDANCY || size != HEADER_BYTES + 8 + count * EVENT_BYTES)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.malformed++;
+        return;
+    }
+
+    // A new session from the partner starts counting again; the old one's notes won't get their note-offs
+    if (!receivedAny_ || session != remoteSession_)
+    {
+        if (receivedAny_)
+            releaseRemoteNotes();
+        remoteSession_ = session;
+        expectedSequence_ = sequence;
+        receivedAny_ = true;
+    }
+
+    int64_t sendTime = (int64_t)get64(body);
+    if (bucketCount_ == 0)
+        packetOffset_ = sendTime - arrival;
+    int64_t transit = arrival - (sendTime - remoteOffset(arrival));
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.packetsReceived++;
+        if (stats_.synced)
+            latencyHistogram_[std::min<int64_t>(LATENCY_BINS - 1, std::max<int64_t>(0, transit / 100000))]++;
+    }
+
+    // The jitter buffer follows how long packets take, not how old their events are, so a note
+    // recovered from a later packet does not stretch it
+    addTransit(arrival, transit);
+
+    for (int i = 0; i < count; i++)
+    {
+        // Earlier sequence numbers are repeats of events already played
+        uint32_t eventSequence = sequence + (uint32_t)i;
+        int32_t ahead = (int32_t)(eventSequence - expectedSequence_);
+        if (ahead < 0)
+            continue;
+
+        uint64_t lost = (uint64_t)ahead;
+        expectedSequence_ = eventSequence + 1;
+
+        // One of the lost events may have been a note-off, and a tone would hold until the next
+        // note on its string: let the partner's strings go rather than risk a drone
+        if (lost > 0)
+            releaseRemoteNotes();
+
+        const uint8_t *p = body + 8 + i * EVENT_BYTES;
+        JamEvent event;
+        event.type = (JamEventType)p[0];
+        event.stringIndex = (int8_t)p[1];
+        event.tone = (p[2] & 1) != 0;
+        event.velocity = p[3] / 255.0f;
+        event.time = sendTime + (int64_t)(int32_t)get32(p + 4) * 1000;
+        event.value = getFloat(p + 8);
+        event.rate = getFloat(p + 12);
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_.lost += lost;
+            stats_.eventsReceived++;
+        }
+        handleEvent(event, arrival);
+    }
+}
+
+void JamSession::handlePong(int64_t sent, int64_t received, int64_t replied, int64_t arrival)
+{
+    int64_t roundTrip = std::max<int64_t>(0, (arrival - sent) - (replied - received));
+    int64_t ahead = received - sent;
+    int64_t behind = replied - arrival;
+    int64_t offset = (ahead + behind) / 2;
+
+    // The quickest exchange of each bucket has the least room for an uneven path
+    if (bucketCount_ == 0 || arrival - bucketStart_ >= SYNC_BUCKET_NS)
+    {
+        if (bucketCount_ == 0)
+        {
+            firstOffset_ = offset;
+            firstSync_ = arrival;
+        }
+        if (bucketCount_ == SYNC_BUCKETS)
+        {
+            std::copy(buckets_ + 1, buckets_ + SYNC_BUCKETS, buckets_);
+            bucketCount_--;
+        }
+        buckets_[bucketCount_++] = {arrival, offset, roundTrip, sent, ahead, arrival, behind};
+        bucketStart_ = arrival;
+    }
+    else
+    {
+        SyncSample &bucket = buckets_[bucketCount_ - 1];
+        if (roundTrip < bucket.roundTrip)
+        {
+            bucket.time = arrival;
+            bucket.offset = offset;
+            bucket.roundTrip = roundTrip;
+        }
+        if (ahead < bucket.ahead)
+        {
+            bucket.aheadTime = sent;
+            bucket.ahead = ahead;
+        }
+        if (behind > bucket.behind)
+        {
+            bucket.behindTime = arrival;
+            bucket.behind = behind;
+        }
+    }
+
+    // Least-squares lines through the buckets' one-way bounds once there are enough to see a slope;
+    // the offset runs midway between them. Buckets whose best ping was still slow went through a
+    // queue, one way more than the other, so they sit out.
+    const SyncSample &latest = buckets_[bucketCount_ - 1];
+    int64_t quickest = latest.roundTrip;
+    for (int b = 0; b < bucketCount_; b++)
+        quickest = std::min(quickest, buckets_[b].roundTrip);
+    int64_t slowest = quickest * 2 + SYNC_RTT_SLACK_NS;
+    int used = 0;
+    for (int b = 0; b < bucketCount_; b++)
+        used += buckets_[b].roundTrip <= slowest ? 1 : 0;
+    if (used >= 3)
+    {
+        double meanTime = 0.0, meanOffset = 0.0;
+        for (int b = 0; b < bucketCount_; b++)
+        {
+            if (buckets_[b].roundTrip > slowest)
+                continue;
+            meanTime += (double)(buckets_[b].time - latest.time);
+            meanOffset += (double)(buckets_[b].offset - firstOffset_);
+        }
+        meanTime /= used;
+        meanOffset /= used;
+
+        auto slope = [&](int64_t SyncSample::*time, int64_t SyncSample::*value)
+        {
+            double meanT = 0.0, meanV = 0.0;
+            for (int b = 0; b < bucketCount_; b++)
+            {
+                if (buckets_[b].roundTrip > slowest)
+                    continue;
+                meanT += (double)(buckets_[b].*time - latest.time) / used;
+                meanV += (double)(buckets_[b].*value - firstOffset_) / used;
+            }
+            double covariance = 0.0, variance = 0.0;
+            for (int b = 0; b < bucketCount_; b++)
+            {
+                if (buckets_[b].roundTrip > slowest)
+                    continue;
+                double t = (double)(buckets_[b].*time - latest.time) - meanT;
+                covariance += t * ((double)(buckets_[b].*value - firstOffset_) - meanV);
+                variance += t * t;
+            }
+            return variance > 0.0 ? covariance / variance : 0.0;
+        };
+        driftSlope_ = (slope(&SyncSample::aheadTime, &SyncSample::ahead) +
+                       slope(&SyncSample::behindTime, &SyncSample::behind)) /
+                      2.0;
+        fitTime_ = latest.time + (int64_t)meanTime;
+        fitOffset_ = firstOffset_ + meanOffset;
+    }
+    else
+    {
+        driftSlope_ = 0.0;
+        fitTime_ = latest.time;
+        fitOffset_ = (double)latest.offset;
+    }
+
+    int64_t estimate = remoteOffset(arrival);
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.synced = true;
+    stats_.time = toReal(arrival);
+    stats_.clockOffset = estimate / 1e6;
+    stats_.driftPpm = driftSlope_ * 1e6;
+    stats_.driftFollowed = driftSlope_ * (double)(arrival - firstSync_) / 1e6;
+    stats_.roundTrip = latest.roundTrip / 1e6;
+}
+
+int64_t JamSession::remoteOffset(int64_t time) const
+{
+    if (bucketCount_ == 0)
+        return packetOffset_;
+    return (int64_t)(fitOffset_ + driftSlope_ * (double)(time - fitTime_));
+}
+
+void JamSession::addTransit(int64_t time, int64_t transit)
+{
+    transits_[transitHead_] = {time, transit};
+    transitHead_ = (transitHead_ + 1) % TRANSIT_CAPACITY;
+    transitCount_ = std::min(transitCount_ + 1, TRANSIT_CAPACITY);
+
+    // The delay that would have left lateTarget of the recent notes late, and a little more
+    int count = 0;
+    for (int i = 0; i < transitCount_; i++)
+    {
+        const Transit &t = transits_[(transitHead_ - 1 - i + TRANSIT_CAPACITY) % TRANSIT_CAPACITY];
+        if (time - t.time > TRANSIT_WINDOW_NS)
+            break;
+        sortScratch_[count++] = t.transit;
+    }
+    double covered = 1.0 - lateTarget_.load(std::memory_order_relaxed);
+    int64_t *nth = sortScratch_ + std::min(count - 1, (int)(covered * count));
+    std::nth_element(sortScratch_, nth, sortScratch_ + count);
+    int64_t target = std::max(MIN_PLAYOUT_NS, std::min(MAX_PLAYOUT_NS, *nth + PLAYOUT_MARGIN_NS));
+
+    // Up at once; down slowly, so notes already scheduled keep their order
+    if (target >= playout_ || lastPlayoutUpdate_ == 0)
+        playout_ = target;
+    else
+        playout_ = std::max(target, playout_ - (int64_t)((time - lastPlayoutUpdate_) * PLAYOUT_FALL));
+    lastPlayoutUpdate_ = time;
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.playoutDelay = playout_ / 1e6;
+}
+
+void JamSession::handleEvent(const JamEvent &event, int64_t arrival)
+{
+    if (event.stringIndex < 0 || event.stringIndex >= Tuning::STRING_COUNT)
+        return;
+
+    // Values come straight off the network: nothing that isn't a number, and no note off the MIDI range
+    bool playable = std::isfinite(event.value) && std::isfinite(event.rate);
+    if (event.type == JamEventType::NoteOn)
+        playable = playable && event.value >= 0.0f && event.value <= 127.0f;
+    if (!playable)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.malformed++;
+        return;
+    }
+
+    // When the partner played it, on our clock, and when it should play here
+    int64_t played = event.time - remoteOffset(arrival);
+    int64_t playAt = played + playout_;
+    bool late = arrival > playAt;
+    bool stale = arrival - playAt > STALE_NS;
+    if (late)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.late++;
+        playAt = arrival;
+    }
+
+    int64_t due = toReal(playAt) + outputDelay_.load(std::memory_order_relaxed);
+    if (event.type == JamEventType::NoteOn || event.type == JamEventType::NoteOff)
+    {
+        if (stale && event.type == JamEventType::NoteOn)
+            return;
+
+        NoteEvent note = {};
+        note.type = event.type == JamEventType::NoteOn ? NoteEventType::NoteOn : NoteEventType::NoteOff;
+        note.note = event.value;
+        note.velocity = event.velocity;
+        note.stringIndex = stringOffset_ + event.stringIndex;
+        note.tone = event.tone;
+        if (!sampleClock_ || !sampleClock_->toSampleTime(due, note.timestamp))
+            note.timestamp = 0;
+        engine_->queueEvent(note, SynthEngine::NETWORK_PORT);
+        return;
+    }
+
+    // Modulation is a plain store in the engine, so it waits here until it is due
+    if (heldCount_ == HELD_CAPACITY)
+    {
+        applyModulation(held_[0].event);
+        std::copy(held_ + 1, held_ + heldCount_, held_);
+        heldCount_--;
+    }
+    int index = heldCount_;
+    while (index > 0 && held_[index - 1].due > due)
+    {
+        held_[index] = held_[index - 1];
+        index--;
+    }
+    held_[index] = {due, event};
+    heldCount_++;
+}
+
+void JamSession::applyHeld(int64_t realNow)
+{
+    int applied = 0;
+    while (applied < heldCount_ && held_[applied].due <= realNow)
+        applyModulation(held_[applied++].event);
+    if (applied > 0)
+    {
+        std::copy(held_ + applied, held_ + heldCount_, held_);
+        heldCount_ -= applied;
+    }
+}
+
+void JamSession::applyModulation(const JamEvent &event)
+{
+    int s = event.stringIndex;
+    switch (event.type)
+    {
+    case JamEventType::Bend:
+        remoteBend_[s] = event.value;
+        engine_->setBend(stringOffset_ + s, remoteBend_[s] + remoteWhammy_);
+        break;
+    case JamEventType::Vibrato:
+        engine_->setVibrato(stringOffset_ + s, event.value, event.rate);
+        break;
+    case JamEventType::Whammy:
+        // The engine's whammy would move our strings too; the partner's bar bends only theirs
+        remoteWhammy_ = event.value;
+        for (int i = 0; i < Tuning::STRING_COUNT; i++)
+            engine_->setBend(stringOffset_ + i, remoteBend_[i] + remoteWhammy_);
+        break;
+    default:
+        break;
+    }
+}
+
+JamStats JamSession::getStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    JamStats stats = stats_;
+
+    uint64_t total = 0;
+    for (int b = 0; b < LATENCY_BINS; b++)
+        total += latencyHistogram_[b];
+    if (total == 0)
+        return stats;
+
+    // Bin upper edges; the histogram is 0.1 ms wide
+    double *targets[] = {&stats.latencyP50, &stats.latencyP95, &stats.latencyP99, &stats.latencyMax};
+    const double fractions[] = {0.50, 0.95, 0.99, 1.0};
+    uint64_t seen = 0;
+    int next = 0;
+    for (int b = 0; b < LATENCY_BINS && next < 4; b++)
+    {
+        seen += latencyHistogram_[b];
+        while (next < 4 && seen > 0 && seen >= fractions[next] * total)
+            *targets[next++] = (b + 1) * 0.1;
+    }
+    return stats;
+}
+
+void JamSession::report(std::ostream &out) const
+{
+    JamStats stats = getStats();
+    if (stats.packetsSent == 0 && stats.packetsReceived == 0)
+        return;
+
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+    out << "Jam session: sent " << stats.eventsSent << " events in " << stats.packetsSent << " packets, received "
+        << stats.eventsReceived << " events in " << stats.packetsReceived << " packets" << std::endl;
+    double played = (double)std::max<uint64_t>(1, stats.eventsReceived);
+    out << "  late " << stats.late << " (" << 100.0 * stats.late / played << "%), lost " << stats.lost
+        << ", malformed " << stats.malformed << ", from elsewhere " << stats.foreign << std::endl;
+    if (stats.synced)
+    {
+        out << "  one-way latency (ms)   p50 " << std::setw(7) << stats.latencyP50 << "  p95 " << std::setw(7)
+            << stats.latencyP95 << "  p99 " << std::setw(7) << stats.latencyP99 << "  max " << std::setw(7)
+            << stats.latencyMax << std::endl;
+        out << "  playout delay " << stats.playoutDelay << " ms, round trip " << stats.roundTrip << " ms" << std::endl;
+        out << "  partner clock " << stats.clockOffset << " ms ahead, drift " << stats.driftPpm << " ppm, "
+            << stats.driftFollowed << " ms followed since the first ping" << std::endl;
+    }
+    else
+    {
+        out << "  no reply to pings; the partner's clock is unknown" << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(precision);
+}
@@ -0,0 +1,258 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include "Tuning.h"
+
+class SynthEngine;
+class SampleClock;
+
+// Non-blocking IPv4 UDP socket over BSD sockets or Winsock. Addresses and ports are in host byte order.
+class UdpSocket
+{
+private:
+    intptr_t handle_; // SOCKET on Windows, a file descriptor elsewhere; -1 when closed
+
+public:
+    UdpSocket();
+    ~UdpSocket();
+    UdpSocket(const UdpSocket &) = delete;
+    UdpSocket &operator=(const UdpSocket &) = delete;
+
+    // Port 0 binds any free port
+    bool open(uint16_t port);
+    void close();
+    bool isOpen() const { return handle_ != -1; }
+    uint16_t getPort() const;
+
+    // "host:port", where host is a dotted address or a name to look up
+    static bool resolve(const std::string &address, uint32_t &host, uint16_t &port);
+
+    bool sendTo(const void *data, int size, uint32_t host, uint16_t port);
+
+    // Waits up to timeoutNs for a datagram; its size, 0 when none came, -1 on error
+    int receive(void *data, int size, int64_t timeoutNs, uint32_t *host = nullptr, uint16_t *port = nullptr);
+};
+
+enum class JamEventType : uint8_t
+{
+    NoteOn,
+    NoteOff,
+    Bend,
+    Vibrato,
+    Whammy
+};
+
+// One thing a player did, as it goes over the wire
+struct JamEvent
+{
+    JamEventType type;
+    int stringIndex; // the player's own string, 0 to Tuning::STRING_COUNT - 1
+    bool tone;       // play the live tone instead of a string
+    float velocity;  // 0..1
+    float value;     // MIDI note, or cents for bends, the whammy and vibrato depth
+    float rate;      // vibrato rate in Hz
+    int64_t time;    // when it was played, LatencyProbe::now() clock; 0 for now
+};
+
+// What getStats() returns; times in milliseconds
+struct JamStats
+{
+    uint64_t packetsSent;
+    uint64_t packetsReceived;
+    uint64_t eventsSent;
+    uint64_t eventsReceived; // first copies only; repeats are discarded
+    uint64_t late;           // arrived after their playout time and played on arrival
+    uint64_t lost;           // never arrived, in this packet or the ones repeating it
+    uint64_t malformed;      // not a jam packet, or an event no guitar could play
+    uint64_t foreign;        // datagrams from anyone but the partner, dropped unread
+
+    // Network transit of each note packet, sender's send to our receive, on the synced clocks
+    double latencyP50;
+    double latencyP95;
+    double latencyP99;
+    double latencyMax;
+
+    double playoutDelay; // jitter buffer: how long after the partner played a note it is played here
+    double roundTrip;    // best ping of the last second
+
+    // Partner's clock minus ours at `time`, from the ping exchange, and how fast it moves
+    bool synced;
+    int64_t time;
+    double clockOffset;
+    double driftPpm;
+    double driftFollowed; // how far the fitted drift has moved the offset since the first ping
+};
+
+// Two instances hear each other's playing: local events are sent as small timestamped UDP packets,
+// and the partner's events are played on the engine through an adaptive jitter buffer.
+//
+// Each packet repeats the last few events, so a lost packet costs nothing unless its neighbours go
+// too, and the last packet is sent again shortly after. Events lost even so let go of the partner's
+// strings, since one of them may have been a note-off. Pings twenty times a second keep an NTP-style
+// estimate of the partner's clock. Its drift is fitted over the last quarter minute to the quickest
+// trip each way, which sits far closer to the true delay than the best round trip does to an even
+// split, so the fit settles within seconds. A remote note
+// plays at the time it was played on the partner's clock, moved onto ours, plus the playout delay,
+// plus the same output delay local notes get.
+// The playout delay follows the recent transit times: it covers all but lateTarget of them, rises at
+// once when they spread and falls back slowly, so the spacing of a strum survives the network.
+//
+// Partner notes start on the engine's network port from the session's thread, on strings offset past
+// the local ones; modulation is held until it is due. Like the sequencer, the session plays strings
+// and live tones only.
+class JamSession
+{
+public:
+    static constexpr uint16_t DEFAULT_PORT = 47000;
+    static constexpr float DEFAULT_LATE_TARGET = 0.01f;
+    static constexpr int64_t MIN_PLAYOUT_NS = 1000000;
+    static constexpr int64_t MAX_PLAYOUT_NS = 250000000;
+
+private:
+    static constexpr int REDUNDANCY = 4;                    // events repeated in every packet
+    static constexpr int64_t PING_INTERVAL_NS = 50000000;
+    static constexpr int64_t REPEAT_NS = 10000000;          // the last packet goes again this long after
+    static constexpr int64_t SYNC_BUCKET_NS = 1000000000;   // best ping per bucket feeds the drift fit
+    static constexpr int SYNC_BUCKETS = 16;
+    static constexpr int64_t SYNC_RTT_SLACK_NS = 100000;   // over twice the quickest round trip, a bucket is left out
+    static constexpr int64_t TRANSIT_WINDOW_NS = 2000000000; // transit times the playout delay covers
+    static constexpr int TRANSIT_CAPACITY = 512;
+    static constexpr int64_t PLAYOUT_MARGIN_NS = 500000;
+    static constexpr double PLAYOUT_FALL = 0.002;           // seconds of delay shed per second
+    static constexpr int64_t STALE_NS = 500000000;          // later than this a note is dropped, not played
+    static constexpr int HELD_CAPACITY = 64;
+    static constexpr int LATENCY_BINS = 1000;               // 0.1 ms each, the last one open-ended
+
+    // One bucket of pings: the quickest exchange, and the one-way bounds on the offset over all of them
+    struct SyncSample
+    {
+        int64_t time; // our clock
+        int64_t offset;
+        int64_t roundTrip;
+        int64_t aheadTime;
+        int64_t ahead; // least of their receive less our send: the offset plus the quickest trip out
+        int64_t behindTime;
+        int64_t behind; // most of their reply less our receive: the offset less the quickest trip back
+    };
+
+    struct Transit
+    {
+        int64_t time;
+        int64_t transit;
+    };
+
+    // Modulation waiting for its playout time (LatencyProbe::now() clock)
+    struct HeldEvent
+    {
+        int64_t due;
+        JamEvent event;
+    };
+
+    UdpSocket socket_;
+    uint32_t peerHost_;
+    uint16_t peerPort_;
+    uint32_t session_; // random per start, so the partner notices a restart
+
+    SynthEngine *engine_;
+    const SampleClock *sampleClock_;
+    int stringOffset_;
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<int64_t> outputDelay_;
+    std::atomic<float> lateTarget_;
+
+    // Loopback tests: the session's idea of the time, off from the real clock by a skew
+    int64_t skewBase_;
+    int64_t skewOffset_;
+    double skewPpm_;
+
+    // Sender, under sendMutex_: sequence of the next event and the last few, for repeating
+    std::mutex sendMutex_;
+    uint32_t nextSequence_;
+    JamEvent recent_[REDUNDANCY];
+    int recentCount_;
+    int64_t lastSend_;
+    std::atomic<int64_t> repeatAt_; // session clock; 0 once repeated
+
+    // Session thread
+    uint32_t remoteSession_;
+    uint32_t expectedSequence_;
+    bool receivedAny_;
+    int64_t nextPing_;
+    SyncSample buckets_[SYNC_BUCKETS]; // oldest first, the last one still filling
+    int bucketCount_;
+    int64_t bucketStart_;
+    int64_t firstOffset_;
+    int64_t firstSync_;
+    int64_t packetOffset_; // before the first pong: the last packet's send time less its arrival
+    double driftSlope_; // offset change per ns of our clock
+    int64_t fitTime_;
+    double fitOffset_;
+    Transit transits_[TRANSIT_CAPACITY];
+    int transitHead_;
+    int transitCount_;
+    int64_t sortScratch_[TRANSIT_CAPACITY];
+    int64_t playout_;
+    int64_t lastPlayoutUpdate_;
+    HeldEvent held_[HELD_CAPACITY];
+    int heldCount_;
+    float remoteBend_[Tuning::STRING_COUNT];
+    float remoteWhammy_;
+
+    // Shared with readers
+    mutable std::mutex statsMutex_;
+    JamStats stats_;
+    uint32_t latencyHistogram_[LATENCY_BINS];
+
+    int64_t now() const;
+    int64_t toSession(int64_t realTime) const;
+    int64_t toReal(int64_t sessionTime) const;
+
+    void run();
+    void sendRecent(int64_t sendTime);
+    void repeatLast(int64_t time);
+    void sendPing(int64_t time);
+    void handlePacket(const uint8_t *data, int size, int64_t arrival);
+    void handlePong(int64_t sent, int64_t received, int64_t replied, int64_t arrival);
+    void handleEvent(const JamEvent &event, int64_t arrival);
+    int64_t remoteOffset(int64_t time) const;
+    void addTransit(int64_t time, int64_t transit);
+    void applyHeld(int64_t realNow);
+    void applyModulation(const JamEvent &event);
+    void releaseRemoteNotes(); // note-off on every partner string, now
+
+public:
+    JamSession();
+    ~JamSession();
+
+    // Listens on localPort (0 picks one) and plays with the partner at peer ("host:port"). The
+    // partner's strings map onto the engine's from stringOffset up; sampleClock schedules them.
+    // Datagrams from any other address are counted and dropped.
+    bool start(uint16_t localPort, const std::string &peer, SynthEngine *engine, const SampleClock *sampleClock,
+               int stringOffset);
+    void stop();
+    bool isRunning() const { return running_.load(); }
+    uint16_t getPort() const { return socket_.getPort(); }
+
+    // One sending thread: a local event goes out at once, with the last few repeated
+    void send(const JamEvent &event);
+
+    // Any thread. The delay local notes get from their event to the sample they start on, so remote
+    // ones sound the same time after they were played; and the share of notes allowed to be late.
+    void setOutputDelay(int64_t ns) { outputDelay_.store(ns, std::memory_order_relaxed); }
+    void setLateTarget(float fraction);
+
+    // Before start: this session's clock runs offsetNs away from the real one and gains ppm, as a
+    // second machine's would, so drift correction can be measured on one machine
+    void setClockSkew(int64_t offsetNs, double ppm);
+    int64_t sessionTime(int64_t realTime) const { return toSession(realTime); }
+
+    // Any thread
+    JamStats getStats() const;
+    void report(std::ostream &out) const;
+};
@@ -0,0 +1,159 @@
+#include "LatencyProbe.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+LatencyProbe::LatencyProbe() : clicks_(new Click[MAX_CLICKS]), count_(0), pending_(0)
+{
+    for (int i = 0; i < MAX_CLICKS; i++)
+    {
+        for (auto &stamp : clicks_[i].stamps)
+            stamp.store(0, std::memory_order_relaxed);
+    }
+}
+
+int64_t LatencyProbe::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+LatencyProbe::Click *LatencyProbe::find(uint32_t tag) const
+{
+    if (tag == 0 || tag > (uint32_t)MAX_CLICKS)
+        return nullptr;
+    return &clicks_[tag - 1];
+}
+
+uint32_t LatencyProbe::beginClick(int64_t eventTime)
+{
+    // A click that missed the guitar never gets a note; the next one replaces it
+    pending_ = 0;
+    if (count_ >= MAX_CLICKS)
+        return 0;
+
+    uint32_t tag = (uint32_t)++count_;
+    Click *click = find(tag);
+    click->stamps[(int)LatencyStage::Event].store(eventTime, std::memory_order_relaxed);
+    click->stamps[(int)LatencyStage::Polled].store(now(), std::memory_order_relaxed);
+    pending_ = tag;
+    return tag;
+}
+
+void LatencyProbe::markPending(LatencyStage stage)
+{
+    mark(pending_, stage, now());
+}
+
+uint32_t LatencyProbe::takePending()
+{
+    uint32_t tag = pending_;
+    pending_ = 0;
+    return tag;
+}
+
+void LatencyProbe::mark(uint32_t tag, LatencyStage stage, int64_t time)
+{
+    Click *click = find(tag);
+    if (click)
+        click->stamps[(int)stage].store(time, std::memory_order_release);
+}
+
+struct Percentiles
+{
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+static Percentiles percentiles(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    auto at = [&values](double fraction)
+    { return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))]; };
+    return {at(0.50), at(0.95), at(0.99), values.back()};
+}
+
+void LatencyProbe::report(std::ostream &out) const
+{
+    struct Step
+    {
+        const char *name;
+        LatencyStage from;
+        LatencyStage to;
+    };
+    const Step steps[] = {
+        {"event -> polled (queue + frame)", LatencyStage::Event, LatencyStage::Polled},
+        {"polled -> picked", LatencyStage::Polled, LatencyStage::Picked},
+        {"picked -> queued", LatencyStage::Picked, LatencyStage::Queued},
+        {"queued -> first sample mixed", LatencyStage::Queued, LatencyStage::Mixed},
+        {"mixed -> handed to device", LatencyStage::Mixed, LatencyStage::HandedOff},
+        {"handed -> output (est.)", LatencyStage::HandedOff, LatencyStage::Output},
+        {"click -> handed to device", LatencyStage::Event, LatencyStage::HandedOff},
+        {"click -> output (est.)", LatencyStage::Event, LatencyStage::Output},
+    };
+    const int stepCount = (int)(sizeof(steps) / sizeof(steps[0]));
+
+    // Only clicks that made it all the way to the device count
+    std::vector<std::vector<double>> samples(stepCount);
+    int complete = 0;
+    for (int i = 0; i < count_; i++)
+    {
+        int64_t stamps[STAGE_COUNT];
+        bool reached = true;
+        for (int s = 0; s < STAGE_COUNT; s++)
+        {
+            stamps[s] = clicks_[i].stamps[s].load(std::memory_order_acquire);
+            reached = reached && stamps[s] != 0;
+        }
+        if (!reached)
+            continue;
+
+        complete++;
+        for (int s = 0; s < stepCount; s++)
+            samples[s].push_back((stamps[(int)steps[s].to] - stamps[(int)steps[s].from]) / 1e6);
+    }
+
+    if (complete == 0)
+        return;
+
+    std::streamsize precision = out.precision();
+    out << "Click-to-sound latency, " << complete << " of " << count_ << " clicks played a note (ms):" << std::endl;
+    out << std::fixed << std::setprecision(2);
+    for (int s = 0; s < stepCount; s++)
+    {
+        Percentiles p = percentiles(samples[s]);
+        out << "  " << std::left << std::setw(34) << steps[s].name << std::right << " p50 " << std::setw(7) << p.p50
+            << "  p95 " << std::setw(7) << p.p95 << "  p99 " << std::setw(7) << p.p99 << "  max " << std::setw(7)
+            << p.max << std::endl;
+    }
+
+    // Histogram of the whole path in 5 ms buckets, the last one open-ended
+    const double bucketMs = 5.0;
+    const int bucketCount = 30;
+    std::vector<int> buckets(bucketCount, 0);
+    for (double value : samples[stepCount - 1])
+        buckets[std::min(bucketCount - 1, std::max(0, (int)(value / bucketMs)))]++;
+
+    int first = 0;
+    while (buckets[first] == 0)
+        first++;
+    int last = bucketCount - 1;
+    while (buckets[last] == 0)
+        last--;
+    int peak = *std::max_element(buckets.begin(), buckets.end());
+
+    out << "  click -> output (est.) histogram:" << std::endl;
+    for (int b = first; b <= last; b++)
+    {
+        std::string label = std::to_string((int)(b * bucketMs)) +
+                            (b == bucketCount - 1 ? "+" : "-" + std::to_string((int)((b + 1) * bucketMs)));
+        out << "  " << std::setw(8) << label << " ms " << std::setw(5) << buckets[b] << " "
+            << std::string((buckets[b] * 40 + peak - 1) / peak, '#') << std::endl;
+    }
+    out << std::defaultfloat << std::setprecision(precision);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+// Points along the click-to-sound path, in the order a click passes them
+enum class LatencyStage
+{
+    Event,     // SDL stamped the mouse event (millisecond resolution)
+    Polled,    // main loop took the event off the SDL queue
+    Picked,    // ray pick against the guitar model finished
+    Queued,    // note event handed to the synth engine
+    Mixed,     // audio thread rendered the block holding the note's first sample
+    HandedOff, // callback returned the buffer to the device
+    Output,    // estimate: first sample leaves the device, one buffer after hand-off
+    COUNT
+};
+
+// Timestamps each click as it travels from the mouse to the sound card and prints
+// percentile histograms of every step. Clicks are recorded by the main thread and
+// finished by the audio thread; stamps are plain atomics, so neither side waits.
+class LatencyProbe
+{
+public:
+    static constexpr int MAX_CLICKS = 4096;
+    static constexpr int STAGE_COUNT = (int)LatencyStage::COUNT;
+
+private:
+    struct Click
+    {
+        std::atomic<int64_t> stamps[STAGE_COUNT]; // steady-clock nanoseconds, 0 = not reached
+    };
+
+    std::unique_ptr<Click[]> clicks_;
+    int count_;        // main thread only
+    uint32_t pending_; // click still waiting for its note, 0 = none (main thread only)
+
+    Click *find(uint32_t tag) const;
+
+public:
+    LatencyProbe();
+
+    static int64_t now();
+
+    // Main thread: start a click at the time SDL stamped it; returns its tag (0 once full)
+    uint32_t beginClick(int64_t eventTime);
+
+    // Main thread: stamp the click that has not produced a note yet
+    void markPending(LatencyStage stage);
+
+    // Main thread: hand the pending click's tag to the note it produced
+    uint32_t takePending();
+
+    // Any thread
+    void mark(uint32_t tag, LatencyStage stage, int64_t time);
+
+    // p50/p95/p99 of every step and a histogram of the whole path, for clicks that made a sound
+    void report(std::ostream &out) const;
+};
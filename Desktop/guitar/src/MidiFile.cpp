@@ -0,0 +1,281 @@
+#include "MidiFile.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static uint32_t readBE32(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static uint16_t readBE16(const uint8_t *bytes)
+{
+    return (uint16_t)((bytes[0] << 8) | bytes[1]);
+}
+
+MidiFile::MidiFile() : format_(0), division_(480), tempo_(500000), tempoTick_(0), tempoSeconds_(0.0)
+{
+}
+
+bool MidiFile::open(const std::string &path)
+{
+    close();
+
+    file_.open(path, std::ios::binary);
+    if (!file_.is_open())
+    {
+        std::cerr << "Failed to open MIDI file: " << path << std::endl;
+        return false;
+    }
+
+    uint8_t header[14];
+    if (!file_.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        std::memcmp(header, "MThd", 4) != 0 || readBE32(header + 4) < 6)
+    {
+        std::cerr << "Not a Standard MIDI File: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    format_ = readBE16(header + 8);
+    uint16_t trackCount = readBE16(header + 10);
+    division_ = (int16_t)readBE16(header + 12);
+    if (format_ > 1 || division_ == 0)
+    {
+        std::cerr << "Unsupported MIDI format " << format_ << ": " << path << std::endl;
+        close();
+        return false;
+    }
+
+    // Find every track chunk; only the chunk headers are read here
+    std::streamoff offset = 8 + readBE32(header + 4);
+    while ((int)tracks_.size() < trackCount)
+    {
+        uint8_t chunk[8];
+        file_.seekg(offset);
+        if (!file_.read(reinterpret_cast<char *>(chunk), sizeof(chunk)))
+            break;
+
+        uint32_t length = readBE32(chunk + 4);
+        if (std::memcmp(chunk, "MTrk", 4) == 0)
+        {
+            TrackReader track;
+            track.position = offset + 8;
+            track.end = track.position + length;
+            track.bufferPos = 0;
+            track.bufferLength = 0;
+            track.tick = 0;
+            track.runningStatus = 0;
+            track.finished = false;
+            tracks_.push_back(track);
+        }
+        offset += 8 + (std::streamoff)length;
+    }
+
+    file_.clear();
+
+    // Read the delta time of each track's first event
+    for (auto &track : tracks_)
+    {
+        uint32_t delta = 0;
+        if (readVarLen(track, delta))
+            track.tick = delta;
+        else
+            track.finished = true;
+    }
+
+    return !tracks_.empty();
+}
+
+void MidiFile::close()
+{
+    if (file_.is_open())
+        file_.close();
+    file_.clear();
+    tracks_.clear();
+    tempo_ = 500000; // 120 BPM until the file says otherwise
+    tempoTick_ = 0;
+    tempoSeconds_ = 0.0;
+}
+
+bool MidiFile::readByte(TrackReader &track, uint8_t &value)
+{
+    if (track.bufferPos >= track.bufferLength)
+    {
+        if (track.position >= track.end)
+            return false;
+
+        // Tracks share one file handle, so every refill seeks to this track's position
+        int count = (int)std::min<std::streamoff>(TRACK_BUFFER_SIZE, track.end - track.position);
+        file_.clear();
+        file_.seekg(track.position);
+        if (!file_.read(reinterpret_cast<char *>(track.buffer), count))
+            return false;
+
+        track.position += count;
+        track.bufferPos = 0;
+        track.bufferLength = count;
+    }
+
+    value = track.buffer[track.bufferPos++];
+    return true;
+}
+
+bool MidiFile::readVarLen(TrackReader &track, uint32_t &value)
+{
+    value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t byte;
+        if (!readByte(track, byte))
+            return false;
+        value = (value << 7) | (byte & 0x7F);
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool MidiFile::skip(TrackReader &track, uint32_t count)
+{
+    int buffered = track.bufferLength - track.bufferPos;
+    if ((int64_t)count <= buffered)
+    {
+        track.bufferPos += (int)count;
+        return true;
+    }
+
+    // Jump over large sysex/meta payloads without reading them
+    track.position += count - buffered;
+    track.bufferPos = track.bufferLength;
+    return track.position <= track.end;
+}
+
+double MidiFile::tickToSeconds(uint64_t tick) const
+{
+    if (division_ < 0)
+    {
+        // SMPTE time: frames per second in the high byte, ticks per frame in the low byte
+        int framesPerSecond = -(division_ >> 8);
+        int ticksPerFrame = division_ & 0xFF;
+        double fps = (framesPerSecond == 29) ? 29.97 : framesPerSecond;
+        return tick / (fps * ticksPerFrame);
+    }
+
+    return tempoSeconds_ + (double)(tick - tempoTick_) * tempo_ / 1000000.0 / division_;
+}
+
+bool MidiFile::next(MidiEvent &event)
+{
+    for (;;)
+    {
+        // The track with the earliest pending event goes next (lower index wins ties,
+        // so a format 1 tempo track is applied before notes at the same tick)
+        TrackReader *track = nullptr;
+        for (auto &candidate : tracks_)
+        {
+            if (!candidate.finished && (!track || candidate.tick < track->tick))
+                track = &candidate;
+        }
+        if (!track)
+            return false;
+
+        uint8_t status;
+        if (!readByte(*track, status))
+        {
+            track->finished = true;
+            continue;
+        }
+
+        uint8_t data1 = 0;
+        bool haveData1 = false;
+        if (status < 0x80)
+        {
+            // Running status: this byte is already the first data byte
+            data1 = status;
+            haveData1 = true;
+            status = track->runningStatus;
+            if (status < 0x80)
+            {
+                track->finished = true; // corrupt track
+                continue;
+            }
+        }
+
+        bool ok = true;
+        bool isNote = false;
+        uint8_t data2 = 0;
+
+        if (status < 0xF0)
+        {
+            track->runningStatus = status;
+            if (!haveData1)
+                ok = readByte(*track, data1);
+
+            uint8_t kind = status & 0xF0;
+            if (kind != 0xC0 && kind != 0xD0)
+                ok = ok && readByte(*track, data2);
+
+            isNote = (kind == 0x80 || kind == 0x90);
+        }
+        else if (status == 0xF0 || status == 0xF7)
+        {
+            uint32_t length = 0;
+            ok = readVarLen(*track, length) && skip(*track, length);
+            track->runningStatus = 0;
+        }
+        else if (status == 0xFF)
+        {
+            uint8_t type = 0;
+            uint32_t length = 0;
+            ok = readByte(*track, type) && readVarLen(*track, length);
+
+            if (ok && type == 0x51 && length == 3)
+            {
+                // Set tempo: rebase the tempo map at this tick
+                uint8_t bytes[3];
+                ok = readByte(*track, bytes[0]) && readByte(*track, bytes[1]) && readByte(*track, bytes[2]);
+                if (ok && division_ > 0)
+                {
+                    tempoSeconds_ = tickToSeconds(track->tick);
+                    tempoTick_ = track->tick;
+                    tempo_ = ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | bytes[2];
+                    if (tempo_ == 0)
+                        tempo_ = 500000;
+                }
+            }
+            else if (ok && type == 0x2F)
+            {
+                track->finished = true; // end of track
+                continue;
+            }
+            else if (ok)
+            {
+                ok = skip(*track, length);
+            }
+        }
+        else
+        {
+            ok = false; // system common messages are not valid in a file
+        }
+
+        uint64_t eventTick = track->tick;
+
+        // Read ahead to the next event's delta time
+        uint32_t delta = 0;
+        if (!ok || !readVarLen(*track, delta))
+            track->finished = true;
+        else
+            track->tick += delta;
+
+        if (ok && isNote)
+        {
+            event.seconds = tickToSeconds(eventTick);
+            event.channel = status & 0x0F;
+            event.note = data1 & 0x7F;
+            event.velocity = data2 & 0x7F;
+            event.noteOn = (status & 0xF0) == 0x90 && event.velocity > 0;
+            return true;
+        }
+    }
+}
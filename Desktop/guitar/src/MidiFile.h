@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A note message from a Standard MIDI File with the tempo map already applied
+struct MidiEvent
+{
+    double seconds; // from the start of the file
+    bool noteOn;    // note-on with velocity 0 is reported as a note-off
+    uint8_t channel;
+    uint8_t note;
+    uint8_t velocity;
+};
+
+// Streaming Standard MIDI File reader (formats 0 and 1).
+// Only a small buffer per track is held in memory, so files of any length can be played;
+// tracks are merged on the fly in time order.
+class MidiFile
+{
+private:
+    static const int TRACK_BUFFER_SIZE = 4096;
+
+    struct TrackReader
+    {
+        std::streamoff position; // next file offset to buffer
+        std::streamoff end;
+        uint8_t buffer[TRACK_BUFFER_SIZE];
+        int bufferPos;
+        int bufferLength;
+        uint64_t tick; // absolute tick of the next event
+        uint8_t runningStatus;
+        bool finished;
+    };
+
+    std::ifstream file_;
+    std::vector<TrackReader> tracks_;
+    uint16_t format_;
+    int16_t division_;
+
+    // Tempo map state: time of the last tempo change and the tempo since then
+    uint32_t tempo_; // microseconds per quarter note
+    uint64_t tempoTick_;
+    double tempoSeconds_;
+
+    bool readByte(TrackReader &track, uint8_t &value);
+    bool readVarLen(TrackReader &track, uint32_t &value);
+    bool skip(TrackReader &track, uint32_t count);
+    double tickToSeconds(uint64_t tick) const;
+
+public:
+    MidiFile();
+
+    bool open(const std::string &path);
+    void close();
+
+    // Next note-on/off across all tracks, in time order; false at the end of the file
+    bool next(MidiEvent &event);
+
+    int getTrackCount() const { return (int)tracks_.size(); }
+    int getFormat() const { return format_; }
+};
@@ -0,0 +1,286 @@
+#include "NoteBankCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char BANK_MAGIC[8] = {'G', 'T', 'R', 'B', 'A', 'N', 'K', 0};
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+static const uint64_t SLAB_ALIGNMENT = 64;
+
+struct NoteBankHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // written in the producer's byte order
+    uint32_t noteCount;
+    uint32_t reserved;
+    uint64_t slabOffset; // from the start of the file
+    uint64_t slabBytes;
+    NoteBankParams params;
+};
+
+struct NoteBankEntry
+{
+    int32_t slot;
+    uint32_t frames;
+    uint64_t offset; // from the start of the slab
+};
+
+NoteBankCache::NoteBankCache() : mapping_(nullptr), mappingSize_(0), noteCount_(0)
+{
+#ifdef _WIN32
+    fileHandle_ = nullptr;
+    mappingHandle_ = nullptr;
+#endif
+    for (int i = 0; i < MAX_SLOTS; i++)
+    {
+        samples_[i] = nullptr;
+        frames_[i] = 0;
+    }
+}
+
+NoteBankCache::~NoteBankCache()
+{
+    close();
+}
+
+bool NoteBankCache::open(const std::string &path, const NoteBankParams &expected)
+{
+    close();
+    if (!mapFile(path))
+        return false;
+
+    const uint8_t *base = static_cast<const uint8_t *>(mapping_);
+    const NoteBankHeader *header = reinterpret_cast<const NoteBankHeader *>(base);
+
+    bool valid = mappingSize_ >= sizeof(NoteBankHeader) &&
+                 std::memcmp(header->magic, BANK_MAGIC, sizeof(BANK_MAGIC)) == 0 &&
+                 header->version == FORMAT_VERSION &&
+                 header->byteOrder == BYTE_ORDER_MARK &&
+                 header->noteCount <= (uint32_t)MAX_SLOTS &&
+                 std::memcmp(&header->params, &expected, sizeof(NoteBankParams)) == 0 &&
+                 header->slabOffset >= sizeof(NoteBankHeader) + header->noteCount * sizeof(NoteBankEntry) &&
+                 header->slabOffset + header->slabBytes <= mappingSize_;
+
+    if (!valid)
+    {
+        std::cout << "Note bank cache " << path << " is stale, rebuilding" << std::endl;
+        close();
+        return false;
+    }
+
+    const NoteBankEntry *entries = reinterpret_cast<const NoteBankEntry *>(base + sizeof(NoteBankHeader));
+    const uint8_t *slab = base + header->slabOffset;
+    uint64_t frameBytes = (uint64_t)expected.channels * sizeof(int16_t);
+
+    for (uint32_t i = 0; i < header->noteCount; i++)
+    {
+        const NoteBankEntry &entry = entries[i];
+        if (entry.slot < 0 || entry.slot >= MAX_SLOTS ||
+            entry.offset + entry.frames * frameBytes > header->slabBytes)
+        {
+            std::cout << "Note bank cache " << path << " is corrupt, rebuilding" << std::endl;
+            close();
+            return false;
+        }
+
+        samples_[entry.slot] = reinterpret_cast<const int16_t *>(slab + entry.offset);
+        frames_[entry.slot] = (int)entry.frames;
+    }
+
+    noteCount_ = (int)header->noteCount;
+    return true;
+}
+
+void NoteBankCache::close()
+{
+    unmapFile();
+    for (int i = 0; i < MAX_SLOTS; i++)
+    {
+        samples_[i] = nullptr;
+        frames_[i] = 0;
+    }
+    noteCount_ = 0;
+}
+
+const int16_t *NoteBankCache::getSamples(int slot, int &frames) const
+{
+    if (slot < 0 || slot >= MAX_SLOTS || !samples_[slot])
+    {
+        frames = 0;
+        return nullptr;
+    }
+    frames = frames_[slot];
+    return samples_[slot];
+}
+
+bool NoteBankCache::write(const std::string &path, const NoteBankParams &params,
+                          const NoteBankNote *notes, int count)
+{
+    if (count > MAX_SLOTS)
+        return false;
+
+    NoteBankHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BANK_MAGIC, sizeof(BANK_MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.noteCount = (uint32_t)count;
+    header.params = params;
+
+    // Lay the notes out back to back, each starting on a cache line
+    std::vector<NoteBankEntry> entries(count);
+    uint64_t frameBytes = (uint64_t)params.channels * sizeof(int16_t);
+    uint64_t slabBytes = 0;
+    for (int i = 0; i < count; i++)
+    {
+        entries[i].slot = notes[i].slot;
+        entries[i].frames = (uint32_t)notes[i].frames;
+        entries[i].offset = slabBytes;
+        slabBytes += (notes[i].frames * frameBytes + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+    }
+
+    uint64_t tableEnd = sizeof(NoteBankHeader) + count * sizeof(NoteBankEntry);
+    header.slabOffset = (tableEnd + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+    header.slabBytes = slabBytes;
+
+    // Write to a temporary file first so a crash never leaves a half-written bank behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "Failed to write note bank cache: " << tempPath << std::endl;
+            return false;
+        }
+
+        std::vector<char> padding(SLAB_ALIGNMENT, 0);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(entries.data()), count * sizeof(NoteBankEntry));
+        file.write(padding.data(), (std::streamsize)(header.slabOffset - tableEnd));
+
+        for (int i = 0; i < count; i++)
+        {
+            uint64_t bytes = notes[i].frames * frameBytes;
+            uint64_t padded = (bytes + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+            file.write(reinterpret_cast<const char *>(notes[i].samples), (std::streamsize)bytes);
+            file.write(padding.data(), (std::streamsize)(padded - bytes));
+        }
+
+        if (!file)
+        {
+            std::cerr << "Failed to write note bank cache: " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Failed to replace note bank cache: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+bool NoteBankCache::mapFile(const std::string &path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle_ = file;
+    mappingHandle_ = mapping;
+    mapping_ = view;
+    mappingSize_ = (size_t)size.QuadPart;
+    return true;
+}
+
+void NoteBankCache::unmapFile()
+{
+    if (mapping_)
+        UnmapViewOfFile(mapping_);
+    if (mappingHandle_)
+        CloseHandle((HANDLE)mappingHandle_);
+    if (fileHandle_)
+        CloseHandle((HANDLE)fileHandle_);
+
+    mapping_ = nullptr;
+    mappingHandle_ = nullptr;
+    fileHandle_ = nullptr;
+    mappingSize_ = 0;
+}
+
+#else
+
+bool NoteBankCache::mapFile(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (view == MAP_FAILED)
+        return false;
+
+    mapping_ = view;
+    mappingSize_ = (size_t)info.st_size;
+    return true;
+}
+
+void NoteBankCache::unmapFile()
+{
+    if (mapping_)
+        munmap(const_cast<void *>(mapping_), mappingSize_);
+
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "ToneKernel.h"
+
+// Everything that affects the rendered samples. A cache file whose parameters
+// differ from the running configuration is stale and gets rebuilt.
+// All fields are 4 bytes wide so the struct has no padding and compares with memcmp.
+struct NoteBankParams
+{
+    static const int MAX_STRINGS = 12;
+
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t velocityLayers;
+    uint32_t kernelRevision;
+    float duration;
+    float volume;
+    float fadeStart;
+    float harmonicWeights[ToneKernel::HARMONIC_COUNT];
+    uint32_t stringCount;
+    uint32_t fretCount;
+    float tuning[MAX_STRINGS];
+};
+
+// One rendered note handed to NoteBankCache::write
+struct NoteBankNote
+{
+    int slot; // MIDI key * velocity layers + layer
+    const int16_t *samples;
+    int frames;
+};
+
+// Versioned on-disk note bank: header, note table, then one contiguous sample slab.
+// open() memory-maps the file so note buffers point straight into the mapping.
+class NoteBankCache
+{
+public:
+    static const uint32_t FORMAT_VERSION = 3;
+    static const int MAX_SLOTS = 128 * 4; // every MIDI key, up to four velocity layers
+
+    NoteBankCache();
+    ~NoteBankCache();
+
+    // Map `path` if it exists and was built with `expected`; false means it must be rebuilt
+    bool open(const std::string &path, const NoteBankParams &expected);
+    void close();
+    bool isOpen() const { return mapping_ != nullptr; }
+
+    // Samples for a bank slot inside the mapping, or null when the bank has no such note
+    const int16_t *getSamples(int slot, int &frames) const;
+    int getNoteCount() const { return noteCount_; }
+
+    static bool write(const std::string &path, const NoteBankParams &params,
+                      const NoteBankNote *notes, int count);
+
+private:
+    const void *mapping_;
+    size_t mappingSize_;
+#ifdef _WIN32
+    void *fileHandle_;
+    void *mappingHandle_;
+#endif
+
+    const int16_t *samples_[MAX_SLOTS];
+    int frames_[MAX_SLOTS];
+    int noteCount_;
+
+    bool mapFile(const std::string &path);
+    void unmapFile();
+};
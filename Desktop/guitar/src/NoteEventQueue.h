@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct SampleZone;
+
+enum class NoteEventType : uint8_t
+{
+    NoteOn,
+    NoteOff
+};
+
+// A note event as it travels from an input thread to the audio thread
+struct NoteEvent
+{
+    NoteEventType type;
+    float note;         // MIDI note number, fractional values are allowed
+    float velocity;     // 0..1
+    int stringIndex;    // -1 lets the engine pick a voice
+    uint64_t timestamp; // engine sample time to start at; times already past start at the next block
+
+    // Optional pre-rendered note-bank buffer; null means synthesize the string
+    const int16_t *samples;
+    int sampleFrames;
+    int sampleChannels;
+
+    // Synthesize the note-bank harmonic tone while it plays instead of a string (ignored with samples)
+    bool tone;
+
+    // Recorded multisample zone streamed from disk; takes priority over samples and tone
+    const SampleZone *zone;
+
+    // Cents the samples or zone are played above the pitch they were recorded at
+    float detune;
+
+    // Nonzero tags are reported back by the engine when the note starts (latency probe)
+    uint32_t tag;
+};
+
+// Wait-free single-producer/single-consumer ring buffer.
+// One thread may push and one other thread may pop; neither ever blocks.
+template <typename T, size_t CAPACITY>
+class SpscQueue
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+private:
+    static const size_t MASK = CAPACITY - 1;
+
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> head_; // next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail_; // next slot to push, written by the producer
+    alignas(64) T items_[CAPACITY];
+
+public:
+    SpscQueue() : head_(0), tail_(0) {}
+
+    // Producer side; returns false instead of waiting when the queue is full
+    bool push(const T &item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == CAPACITY)
+        {
+            return false;
+        }
+        items_[tail & MASK] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; returns false when there is nothing to read
+    bool pop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = items_[head & MASK];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    static size_t capacity() { return CAPACITY; }
+};
@@ -0,0 +1,395 @@
+#include "OfflineRenderer.h"
+#include "Sequencer.h"
+#include "SynthEngine.h"
+#include "ToneKernel.h"
+#include "Tuning.h"
+#include "WavFile.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+
+// Per-string render state that persists across segments
+struct StringTrack
+{
+    std::unique_ptr<SynthEngine> engine;
+    std::deque<std::pair<uint64_t, NoteEvent>> events; // (start frame, event) not yet queued, sorted
+    uint64_t position;
+    std::vector<float> segment;
+
+    bool finished() const { return events.empty() && engine->getActiveVoices() == 0; }
+};
+
+static void renderTrackSegment(StringTrack &track, uint64_t segmentStart, int segmentFrames)
+{
+    track.segment.assign(segmentFrames * 2, 0.0f);
+    uint64_t segmentEnd = segmentStart + segmentFrames;
+
+    while (track.position < segmentEnd)
+    {
+        // Queue every event due now; the engine starts them at the top of the next render call
+        while (!track.events.empty() && track.events.front().first <= track.position)
+        {
+            track.engine->queueEvent(track.events.front().second);
+            track.events.pop_front();
+        }
+
+        uint64_t until = segmentEnd;
+        if (!track.events.empty())
+            until = std::min(until, track.events.front().first);
+
+        int frames = (int)(until - track.position);
+        track.engine->render(track.segment.data() + (track.position - segmentStart) * 2, frames);
+        track.position = until;
+    }
+}
+
+OfflineRenderer::OfflineRenderer(int sampleRate)
+    : sampleRate_(sampleRate), useNoteBank_(false), threadCount_(0), maxTailSeconds_(10.0)
+{
+    tuning_.assign(std::begin(Tuning::STANDARD_FREQUENCIES), std::end(Tuning::STANDARD_FREQUENCIES));
+}
+
+float OfflineRenderer::fretFrequency(int stringIndex, int fret) const
+{
+    return tuning_[stringIndex] * std::pow(2.0f, fret / 12.0f);
+}
+
+bool OfflineRenderer::loadEventList(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open event list: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream fields(line);
+        OfflineNote note;
+        if (!(fields >> note.time))
+            continue; // blank line
+
+        if (!(fields >> note.stringIndex >> note.fret))
+        {
+            std::cerr << path << ":" << lineNumber << ": expected \"time string fret [velocity [duration]]\"" << std::endl;
+            return false;
+        }
+        if (!(fields >> note.velocity))
+            note.velocity = 1.0f;
+        if (!(fields >> note.duration))
+            note.duration = 0.0;
+
+        if (note.stringIndex < 0 || note.stringIndex >= (int)tuning_.size() || note.fret < 0 || note.time < 0.0)
+        {
+            std::cerr << path << ":" << lineNumber << ": string or fret out of range" << std::endl;
+            return false;
+        }
+
+        notes_.push_back(note);
+    }
+
+    return true;
+}
+
+bool OfflineRenderer::loadMidiFile(const std::string &path)
+{
+    // Only check that the file parses here; render() streams it from disk
+    Sequencer sequencer;
+    if (!sequencer.open(path))
+        return false;
+
+    midiPath_ = path;
+    return true;
+}
+
+bool OfflineRenderer::loadCabinetIR(const std::string &path, int partitionSize)
+{
+    auto convolver = std::make_unique<PartitionedConvolver>(partitionSize);
+    if (!convolver->loadImpulseResponse(path, sampleRate_))
+        return false;
+
+    cabinet_ = std::move(convolver);
+    return true;
+}
+
+const std::vector<int16_t> &OfflineRenderer::bankSamples(float frequency)
+{
+    auto found = bank_.find(frequency);
+    if (found != bank_.end())
+        return found->second;
+
+    int frames = (int)(sampleRate_ * 0.8f);
+    std::vector<int16_t> &samples = bank_[frequency];
+    samples.resize(frames);
+    ToneKernel::render(samples.data(), frames, 1, frequency, 0.8f, 0.5f, sampleRate_);
+    return samples;
+}
+
+bool OfflineRenderer::render(std::vector<float> &output)
+{
+    output.clear();
+
+    // Notes arrive in time order, either from the event list or streamed from the MIDI file
+    Sequencer sequencer;
+    std::vector<SequencedNote> listNotes;
+    size_t listIndex = 0;
+    bool fromMidi = !midiPath_.empty();
+
+    if (fromMidi)
+    {
+        if (!sequencer.open(midiPath_))
+            return false;
+    }
+    else
+    {
+        std::vector<OfflineNote> sorted = notes_;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const OfflineNote &a, const OfflineNote &b)
+                         { return a.time < b.time; });
+
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            const OfflineNote &note = sorted[i];
+            listNotes.push_back({note.time, NoteEventType::NoteOn, note.stringIndex, note.fret, note.velocity});
+            if (note.duration <= 0.0)
+                continue;
+
+            // No note-off if the string is plucked again before it would arrive
+            double offTime = note.time + note.duration;
+            bool replucked = false;
+            for (size_t j = i + 1; j < sorted.size() && sorted[j].time < offTime; j++)
+                replucked = replucked || sorted[j].stringIndex == note.stringIndex;
+            if (!replucked)
+                listNotes.push_back({offTime, NoteEventType::NoteOff, note.stringIndex, note.fret, 0.0f});
+        }
+
+        std::stable_sort(listNotes.begin(), listNotes.end(),
+                         [](const SequencedNote &a, const SequencedNote &b)
+                         { return a.seconds < b.seconds; });
+    }
+
+    auto pull = [&](SequencedNote &note)
+    {
+        if (fromMidi)
+            return sequencer.next(note);
+        if (listIndex >= listNotes.size())
+            return false;
+        note = listNotes[listIndex++];
+        return true;
+    };
+
+    SequencedNote note;
+    bool haveNote = pull(note);
+    if (!haveNote)
+        return false;
+
+    // Each string becomes an independent track. Every track runs from frame 0 so its engine
+    // clock stays equal to the output frame, even for strings first used late in the song.
+    int stringCount = (int)tuning_.size();
+    std::vector<StringTrack> tracks(stringCount);
+
+    for (int s = 0; s < stringCount; s++)
+    {
+        tracks[s].engine = std::make_unique<SynthEngine>(sampleRate_, stringCount);
+        tracks[s].engine->setNoiseSeed(22222u + 7919u * s);
+        tracks[s].position = 0;
+    }
+
+    int threads = threadCount_ > 0 ? threadCount_ : std::min(stringCount, (int)std::thread::hardware_concurrency());
+    WorkerPool pool(std::max(1, threads));
+
+    // The amp sees the full mix, so it runs after the strings are summed
+    EffectChain effects(sampleRate_);
+    effects.setSettings(amp_);
+
+    const uint64_t tailFrames = (uint64_t)(maxTailSeconds_ * sampleRate_);
+    const int segmentFrames = SEGMENT_SECONDS * sampleRate_;
+    uint64_t lastEventFrame = 0;
+
+    // Render one segment of every string in parallel, then mix it, until everything has rung out
+    for (uint64_t segmentStart = 0;; segmentStart += segmentFrames)
+    {
+        // Pull only the notes that start in this segment
+        uint64_t segmentEnd = segmentStart + segmentFrames;
+        while (haveNote)
+        {
+            uint64_t frame = (uint64_t)std::llround(note.seconds * sampleRate_);
+            if (frame >= segmentEnd)
+                break;
+
+            if (note.stringIndex >= 0 && note.stringIndex < stringCount)
+            {
+                float frequency = fretFrequency(note.stringIndex, note.fret);
+
+                NoteEvent event = {};
+                event.type = note.type;
+                event.note = SynthEngine::frequencyToNote(frequency);
+                event.velocity = note.velocity;
+                event.stringIndex = note.stringIndex;
+                event.timestamp = frame;
+
+                if (useNoteBank_ && note.type == NoteEventType::NoteOn)
+                {
+                    const std::vector<int16_t> &samples = bankSamples(frequency);
+                    event.samples = samples.data();
+                    event.sampleFrames = (int)samples.size();
+                    event.sampleChannels = 1;
+                }
+
+                tracks[note.stringIndex].events.emplace_back(frame, event);
+                lastEventFrame = std::max(lastEventFrame, frame);
+            }
+
+            haveNote = pull(note);
+        }
+
+        const uint64_t maxFrames = lastEventFrame + tailFrames;
+        if (!haveNote && segmentStart >= maxFrames)
+            break;
+
+        int frames = haveNote ? segmentFrames : (int)std::min<uint64_t>(segmentFrames, maxFrames - segmentStart);
+        for (StringTrack &track : tracks)
+        {
+            StringTrack *target = &track;
+            pool.submit([target, segmentStart, frames]
+                        { renderTrackSegment(*target, segmentStart, frames); });
+        }
+        pool.waitIdle();
+
+        size_t base = output.size();
+        output.resize(base + frames * 2, 0.0f);
+        for (const StringTrack &track : tracks)
+        {
+            for (int i = 0; i < frames * 2; i++)
+            {
+                output[base + i] += track.segment[i];
+            }
+        }
+        effects.processStereo(output.data() + base, frames);
+        if (cabinet_)
+            cabinet_->processStereo(output.data() + base, frames);
+
+        bool allFinished = !haveNote;
+        for (const StringTrack &track : tracks)
+            allFinished = allFinished && track.finished();
+        if (allFinished && segmentStart + frames > lastEventFrame)
+            break;
+    }
+
+    if (cabinet_)
+    {
+        // Let the IR ring out, then shift everything back by the convolver's partition delay
+        const int latency = cabinet_->getLatencyFrames();
+        size_t base = output.size();
+        int tail = cabinet_->getLength() + latency;
+        output.resize(base + (size_t)tail * 2, 0.0f);
+        effects.processStereo(output.data() + base, tail);
+        cabinet_->processStereo(output.data() + base, tail);
+        output.erase(output.begin(), output.begin() + (size_t)latency * 2);
+        cabinet_->reset();
+    }
+
+    // Drop the silent tail of the last segment
+    size_t end = output.size();
+    while (end > 2 && std::fabs(output[end - 1]) < 1e-5f && std::fabs(output[end - 2]) < 1e-5f)
+        end -= 2;
+    output.resize(std::max<size_t>(end, (lastEventFrame + 1) * 2));
+
+    return true;
+}
+
+int OfflineRenderer::runCommandLine(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " --render <events.txt|song.mid> <out.wav> [--rate N] [--threads N] [--note-bank]"
+                  << " [--amp] [--drive dB] [--oversample N] [--cab ir.wav] [--cab-partition N]" << std::endl;
+        return 1;
+    }
+
+    std::string eventPath = argv[2];
+    std::string outputPath = argv[3];
+    int sampleRate = 44100;
+    int threads = 0;
+    bool noteBank = false;
+    AmpSettings amp;
+    std::string cabinetPath;
+    int cabinetPartition = PartitionedConvolver::DEFAULT_PARTITION;
+
+    for (int i = 4; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc)
+            sampleRate = std::atoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--note-bank")
+            noteBank = true;
+        else if (arg == "--amp")
+            amp.enabled = true;
+        else if (arg == "--drive" && i + 1 < argc)
+        {
+            amp.enabled = true;
+            amp.drive = (float)std::atof(argv[++i]);
+        }
+        else if (arg == "--oversample" && i + 1 < argc)
+            amp.oversampling = std::atoi(argv[++i]);
+        else if (arg == "--cab" && i + 1 < argc)
+            cabinetPath = argv[++i];
+        else if (arg == "--cab-partition" && i + 1 < argc)
+            cabinetPartition = std::atoi(argv[++i]);
+    }
+
+    if (sampleRate < 8000)
+    {
+        std::cerr << "Sample rate too low: " << sampleRate << std::endl;
+        return 1;
+    }
+
+    OfflineRenderer renderer(sampleRate);
+    renderer.setNoteBank(noteBank);
+    renderer.setThreadCount(threads);
+    renderer.setAmpSettings(amp);
+    if (!cabinetPath.empty() && !renderer.loadCabinetIR(cabinetPath, cabinetPartition))
+        return 1;
+
+    std::string extension = eventPath.substr(eventPath.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    bool isMidi = (extension == "mid" || extension == "midi");
+    if (!(isMidi ? renderer.loadMidiFile(eventPath) : renderer.loadEventList(eventPath)))
+        return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<float> output;
+    if (!renderer.render(output))
+    {
+        std::cerr << "Nothing to render in " << eventPath << std::endl;
+        return 1;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!WavFile::write16(outputPath, output.data(), (int)(output.size() / 2), 2, sampleRate))
+        return 1;
+
+    double seconds = (double)output.size() / 2 / sampleRate;
+    std::cout << "Rendered " << seconds << " s of audio in " << elapsed * 1000.0 << " ms ("
+              << (elapsed > 0.0 ? seconds / elapsed : 0.0) << "x realtime) to " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "EffectChain.h"
+#include "Convolver.h"
+
+// One note of an offline render
+struct OfflineNote
+{
+    double time;     // seconds from the start of the render
+    int stringIndex; // 0 = low E ... 5 = high E
+    int fret;
+    float velocity;
+    double duration; // seconds until note-off, 0 lets the string ring
+};
+
+// Headless renderer: drives the same SynthEngine as AudioManager, with no audio
+// device or window, as fast as the CPU allows. Strings are independent voices
+// (each one is monophonic), so every string is rendered on its own core.
+class OfflineRenderer
+{
+private:
+    int sampleRate_;
+    std::vector<float> tuning_;
+    std::vector<OfflineNote> notes_;
+    std::string midiPath_;
+    bool useNoteBank_;
+    int threadCount_;
+    double maxTailSeconds_;
+    AmpSettings amp_;
+    std::unique_ptr<PartitionedConvolver> cabinet_;
+
+    // Mono note-bank tones, rendered the first time each pitch is used; keyed by exact frequency
+    // so notes between semitones don't share a buffer
+    std::map<float, std::vector<int16_t>> bank_;
+
+    float fretFrequency(int stringIndex, int fret) const;
+    const std::vector<int16_t> &bankSamples(float frequency);
+
+public:
+    static const int SEGMENT_SECONDS = 1;
+
+    explicit OfflineRenderer(int sampleRate = 44100);
+
+    void setTuning(const std::vector<float> &baseFrequencies) { tuning_ = baseFrequencies; }
+    void setNoteBank(bool enabled) { useNoteBank_ = enabled; }
+    void setThreadCount(int threads) { threadCount_ = threads; }
+    void setAmpSettings(const AmpSettings &settings) { amp_ = settings; }
+
+    // Cabinet IR after the amp; its partition delay is removed from the rendered file
+    bool loadCabinetIR(const std::string &path, int partitionSize = PartitionedConvolver::DEFAULT_PARTITION);
+
+    void addNote(const OfflineNote &note) { notes_.push_back(note); }
+
+    // Text event list: one "time string fret [velocity [duration]]" per line, '#' starts a comment
+    bool loadEventList(const std::string &path);
+
+    // Standard MIDI File, streamed through the Sequencer while rendering
+    bool loadMidiFile(const std::string &path);
+
+    // Render every note plus its ring-out into interleaved stereo floats
+    bool render(std::vector<float> &output);
+
+    int getSampleRate() const { return sampleRate_; }
+
+    // ElectricGuitar3D --render <events.txt|song.mid> <out.wav> [--rate N] [--threads N] [--note-bank]
+    //                  [--amp] [--drive dB] [--oversample N] [--cab ir.wav] [--cab-partition N]
+    static int runCommandLine(int argc, char *argv[]);
+};
@@ -0,0 +1,278 @@
+#include "PitchTracker.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+
+static constexpr float PI = 3.14159265358979f;
+
+static int roundUp(int value, int multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// a = conj(a) * b over split complex arrays, the spectrum of the cross-correlation
+static void crossSpectrumScalar(float *aRe, float *aIm, const float *bRe, const float *bIm, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        float re = aRe[k] * bRe[k] + aIm[k] * bIm[k];
+        float im = aRe[k] * bIm[k] - aIm[k] * bRe[k];
+        aRe[k] = re;
+        aIm[k] = im;
+    }
+}
+
+// Sum of max(0, m - previous) with m = |X|^(1/2), then previous = m.
+// The square root compresses the range so soft notes still register next to loud ones.
+static float fluxScalar(const float *re, const float *im, float *previous, int count)
+{
+    float flux = 0.0f;
+    for (int k = 0; k < count; k++)
+    {
+        float magnitude = std::sqrt(std::sqrt(re[k] * re[k] + im[k] * im[k]));
+        flux += std::max(0.0f, magnitude - previous[k]);
+        previous[k] = magnitude;
+    }
+    return flux;
+}
+
+#if defined(GUITAR_SIMD_X86)
+
+GUITAR_TARGET_SSE2 static void crossSpectrumSSE2(float *aRe, float *aIm, const float *bRe, const float *bIm, int count)
+{
+    // count is a multiple of 8
+    for (int k = 0; k < count; k += 4)
+    {
+        __m128 ar = _mm_loadu_ps(aRe + k);
+        __m128 ai = _mm_loadu_ps(aIm + k);
+        __m128 br = _mm_loadu_ps(bRe + k);
+        __m128 bi = _mm_loadu_ps(bIm + k);
+        _mm_storeu_ps(aRe + k, _mm_add_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi)));
+        _mm_storeu_ps(aIm + k, _mm_sub_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br)));
+    }
+}
+
+GUITAR_TARGET_AVX2 static void crossSpectrumAVX2(float *aRe, float *aIm, const float *bRe, const float *bIm, int count)
+{
+    for (int k = 0; k < count; k += 8)
+    {
+        __m256 ar = _mm256_loadu_ps(aRe + k);
+        __m256 ai = _mm256_loadu_ps(aIm + k);
+        __m256 br = _mm256_loadu_ps(bRe + k);
+        __m256 bi = _mm256_loadu_ps(bIm + k);
+        _mm256_storeu_ps(aRe + k, _mm256_fmadd_ps(ar, br, _mm256_mul_ps(ai, bi)));
+        _mm256_storeu_ps(aIm + k, _mm256_fmsub_ps(ar, bi, _mm256_mul_ps(ai, br)));
+    }
+}
+
+GUITAR_TARGET_SSE2 static float fluxSSE2(const float *re, const float *im, float *previous, int count)
+{
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < count; k += 4)
+    {
+        __m128 r = _mm_loadu_ps(re + k);
+        __m128 i = _mm_loadu_ps(im + k);
+        __m128 magnitude = _mm_sqrt_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i))));
+        sum = _mm_add_ps(sum, _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(magnitude, _mm_loadu_ps(previous + k))));
+        _mm_storeu_ps(previous + k, magnitude);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+GUITAR_TARGET_AVX2 static float fluxAVX2(const float *re, const float *im, float *previous, int count)
+{
+    __m256 sum = _mm256_setzero_ps();
+    for (int k = 0; k < count; k += 8)
+    {
+        __m256 r = _mm256_loadu_ps(re + k);
+        __m256 i = _mm256_loadu_ps(im + k);
+        __m256 magnitude = _mm256_sqrt_ps(_mm256_sqrt_ps(_mm256_fmadd_ps(r, r, _mm256_mul_ps(i, i))));
+        sum = _mm256_add_ps(sum, _mm256_max_ps(_mm256_setzero_ps(), _mm256_sub_ps(magnitude, _mm256_loadu_ps(previous + k))));
+        _mm256_storeu_ps(previous + k, magnitude);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, sum);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+#endif
+
+static void crossSpectrum(float *aRe, float *aIm, const float *bRe, const float *bIm, int count)
+{
+#if defined(GUITAR_SIMD_X86)
+    static const bool useAVX2 = cpuHasAVX2();
+    static const bool useSSE2 = cpuHasSSE2();
+    if (useAVX2)
+        crossSpectrumAVX2(aRe, aIm, bRe, bIm, count);
+    else if (useSSE2)
+        crossSpectrumSSE2(aRe, aIm, bRe, bIm, count);
+    else
+        crossSpectrumScalar(aRe, aIm, bRe, bIm, count);
+#else
+    crossSpectrumScalar(aRe, aIm, bRe, bIm, count);
+#endif
+}
+
+static float spectralFlux(const float *re, const float *im, float *previous, int count)
+{
+#if defined(GUITAR_SIMD_X86)
+    static const bool useAVX2 = cpuHasAVX2();
+    static const bool useSSE2 = cpuHasSSE2();
+    if (useAVX2)
+        return fluxAVX2(re, im, previous, count);
+    if (useSSE2)
+        return fluxSSE2(re, im, previous, count);
+#endif
+    return fluxScalar(re, im, previous, count);
+}
+
+static int windowFor(int sampleRate)
+{
+    // Longest lag must fit inside the integration window
+    int maxLag = (int)std::ceil(sampleRate / PitchTracker::MIN_FREQUENCY);
+    int window = 64;
+    while (window <= maxLag)
+        window *= 2;
+    return window;
+}
+
+PitchTracker::PitchTracker(int sampleRate)
+    : sampleRate_(sampleRate),
+      window_(windowFor(sampleRate)),
+      frameSize_(2 * window_),
+      minLag_(std::max(2, (int)(sampleRate / MAX_FREQUENCY))),
+      maxLag_((int)std::ceil(sampleRate / MIN_FREQUENCY)),
+      fft_(frameSize_),
+      onsetFft_(window_ / 2)
+{
+    // Bin arrays are padded to whole AVX registers; the padding stays zero
+    int bins = roundUp(fft_.getBinCount(), 8);
+    padded_.assign(frameSize_, 0.0f);
+    windowRe_.assign(bins, 0.0f);
+    windowIm_.assign(bins, 0.0f);
+    frameRe_.assign(bins, 0.0f);
+    frameIm_.assign(bins, 0.0f);
+    correlation_.assign(frameSize_, 0.0f);
+    energy_.assign(frameSize_ + 1, 0.0);
+    nsdf_.assign(window_ + 1, 0.0f);
+    keyMaxima_.assign(window_, 0);
+
+    int onsetSize = onsetFft_.getSize();
+    int onsetBins = roundUp(onsetFft_.getBinCount(), 8);
+    hann_.resize(onsetSize);
+    for (int i = 0; i < onsetSize; i++)
+        hann_[i] = 0.5f - 0.5f * std::cos(2.0f * PI * i / onsetSize);
+    onsetInput_.assign(onsetSize, 0.0f);
+    onsetRe_.assign(onsetBins, 0.0f);
+    onsetIm_.assign(onsetBins, 0.0f);
+    previousMagnitude_.assign(onsetBins, 0.0f);
+}
+
+void PitchTracker::resetOnset()
+{
+    std::fill(previousMagnitude_.begin(), previousMagnitude_.end(), 0.0f);
+}
+
+PitchFrame PitchTracker::analyze(const float *frame)
+{
+    PitchFrame result;
+
+    double sum = 0.0;
+    energy_[0] = 0.0;
+    for (int i = 0; i < frameSize_; i++)
+    {
+        sum += (double)frame[i] * frame[i];
+        energy_[i + 1] = sum;
+    }
+    result.rms = (float)std::sqrt(sum / frameSize_);
+
+    // r(tau) = sum over j < window of x[j] * x[j + tau]. With the first window zero-padded to the
+    // frame length, j + tau never wraps for tau < window, so the circular correlation is exact.
+    std::copy(frame, frame + window_, padded_.begin());
+    fft_.forward(padded_.data(), windowRe_.data(), windowIm_.data());
+    fft_.forward(frame, frameRe_.data(), frameIm_.data());
+    crossSpectrum(windowRe_.data(), windowIm_.data(), frameRe_.data(), frameIm_.data(), (int)windowRe_.size());
+    fft_.inverse(windowRe_.data(), windowIm_.data(), correlation_.data());
+
+    result.frequency = findPeriod(result.aperiodicity);
+    result.flux = onsetFlux(frame);
+    return result;
+}
+
+float PitchTracker::findPeriod(float &aperiodicity)
+{
+    // McLeod's normalized square difference n(tau) = 2 r(tau) / (e(0) + e(tau)), which is 1 - d(tau) / m(tau)
+    // in YIN's terms: +1 for a perfect repeat, independent of level
+    const double first = energy_[window_];
+    for (int tau = 0; tau <= maxLag_; tau++)
+    {
+        double total = first + energy_[tau + window_] - energy_[tau];
+        nsdf_[tau] = total > 0.0 ? (float)(2.0 * correlation_[tau] / total) : 0.0f;
+    }
+
+    // Key maxima: the highest point of each positive lobe after the lobe around lag 0
+    int keyCount = 0;
+    float highest = 0.0f;
+    int tau = 1;
+    while (tau <= maxLag_ && nsdf_[tau] > 0.0f)
+        tau++;
+    while (tau <= maxLag_)
+    {
+        while (tau <= maxLag_ && nsdf_[tau] <= 0.0f)
+            tau++;
+
+        int peak = -1;
+        while (tau <= maxLag_ && nsdf_[tau] > 0.0f)
+        {
+            if (peak < 0 || nsdf_[tau] > nsdf_[peak])
+                peak = tau;
+            tau++;
+        }
+
+        // A lobe cut off by the end of the search range has no reliable peak
+        if (peak >= minLag_ && tau <= maxLag_)
+        {
+            keyMaxima_[keyCount++] = peak;
+            highest = std::max(highest, nsdf_[peak]);
+        }
+    }
+
+    // The first key maximum close to the highest one is the period; later ones are its multiples,
+    // and an octave-down error needs a whole repeat to be clearly better than the true period
+    int best = -1;
+    for (int k = 0; k < keyCount && best < 0; k++)
+    {
+        if (nsdf_[keyMaxima_[k]] >= CUTOFF * highest)
+            best = keyMaxima_[k];
+    }
+
+    if (best < 0)
+    {
+        aperiodicity = 1.0f;
+        return 0.0f;
+    }
+
+    // Parabolic interpolation for the sub-sample period and peak height
+    float left = nsdf_[best - 1];
+    float centre = nsdf_[best];
+    float right = nsdf_[best + 1];
+    float denominator = left - 2.0f * centre + right;
+    float offset = denominator < 0.0f ? 0.5f * (left - right) / denominator : 0.0f;
+    offset = std::max(-0.5f, std::min(0.5f, offset));
+
+    aperiodicity = 1.0f - std::min(1.0f, centre - 0.25f * (left - right) * offset);
+    return sampleRate_ / (best + offset);
+}
+
+float PitchTracker::onsetFlux(const float *frame)
+{
+    int size = onsetFft_.getSize();
+    const float *centre = frame + frameSize_ / 2 - size / 2;
+    for (int i = 0; i < size; i++)
+        onsetInput_[i] = centre[i] * hann_[i];
+
+    onsetFft_.forward(onsetInput_.data(), onsetRe_.data(), onsetIm_.data());
+    return spectralFlux(onsetRe_.data(), onsetIm_.data(), previousMagnitude_.data(), (int)onsetRe_.size());
+}
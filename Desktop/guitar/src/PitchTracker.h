@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include "Fft.h"
+
+// Pitch and onset features of one analysis frame
+struct PitchFrame
+{
+    float frequency;    // Hz, 0 when no period was found in range
+    float aperiodicity; // 1 - the normalized correlation at the chosen lag: 0 = perfectly periodic
+    float rms;
+    float flux;         // rectified spectral flux against the previous frame
+};
+
+// McLeod pitch method (MPM) with spectral-flux onset features.
+// The normalized square difference comes from an FFT cross-correlation plus running
+// energies (the same terms as YIN's difference function), so a frame costs three real
+// FFTs of twice the integration window instead of window * lags multiplies. One tracker
+// per thread: it keeps scratch buffers and the previous frame's spectrum for the flux.
+class PitchTracker
+{
+public:
+    static constexpr float MIN_FREQUENCY = 70.0f;   // a little below a flat low E
+    static constexpr float MAX_FREQUENCY = 1400.0f; // above the 2nd harmonic of the 12th-fret high E
+    static constexpr float CUTOFF = 0.9f;           // first peak within this fraction of the highest one wins
+
+private:
+    int sampleRate_;
+    int window_;    // YIN integration window, a power of two above the longest lag
+    int frameSize_; // samples read per frame: window plus the longest lag, rounded to 2 * window
+    int minLag_;
+    int maxLag_;
+
+    Fft fft_;
+    std::vector<float> padded_;
+    std::vector<float> windowRe_;
+    std::vector<float> windowIm_;
+    std::vector<float> frameRe_;
+    std::vector<float> frameIm_;
+    std::vector<float> correlation_;
+    std::vector<double> energy_; // running sum of squares, energy_[k] = x[0]^2 + ... + x[k-1]^2
+    std::vector<float> nsdf_;
+    std::vector<int> keyMaxima_;
+
+    // Onsets use a short Hann window centred on the frame, so their timing does not smear
+    // across the whole pitch window
+    Fft onsetFft_;
+    std::vector<float> hann_;
+    std::vector<float> onsetInput_;
+    std::vector<float> onsetRe_;
+    std::vector<float> onsetIm_;
+    std::vector<float> previousMagnitude_;
+
+    float findPeriod(float &aperiodicity);
+    float onsetFlux(const float *frame);
+
+public:
+    explicit PitchTracker(int sampleRate);
+
+    int getFrameSize() const { return frameSize_; }
+    int getHop() const { return window_ / 4; }
+    int getSampleRate() const { return sampleRate_; }
+
+    // `frame` holds getFrameSize() mono samples; features describe its centre
+    PitchFrame analyze(const float *frame);
+
+    // Forget the previous spectrum, e.g. when jumping to another part of the file
+    void resetOnset();
+};
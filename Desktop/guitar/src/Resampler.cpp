@@ -0,0 +1,320 @@
+#include "Resampler.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+static constexpr double PI = 3.14159265358979323846;
+static constexpr double KAISER_BETA = 9.0; // about 90 dB of stopband
+static constexpr double ROLLOFF = 0.95;    // passband edge as a fraction of the lower Nyquist
+
+// One call's worth of output: every frame is a dot product of a filter phase against each
+// channel's history line, starting where the output's position falls
+struct FilterBlock
+{
+    const float *coefficients;
+    const float *history;
+    int stride;
+    int channels;
+    int taps; // a multiple of 8
+    int up;
+    int index; // first history frame of the first output
+    int phase; // its filter phase, 0 .. up - 1
+    int step;  // down / up: whole frames per output
+    int stepPhase; // down % up
+    float *output;
+    int frames;
+};
+
+// Moves to the next output without a 64-bit division per frame
+static inline void advance(const FilterBlock &block, int &index, int &phase)
+{
+    index += block.step;
+    phase += block.stepPhase;
+    if (phase >= block.up)
+    {
+        phase -= block.up;
+        index++;
+    }
+}
+
+static void filterScalar(const FilterBlock &block)
+{
+    int index = block.index;
+    int offset = block.phase;
+    for (int n = 0; n < block.frames; n++)
+    {
+        const float *phase = block.coefficients + (size_t)offset * block.taps;
+        const float *start = block.history + index;
+        for (int c = 0; c < block.channels; c++)
+        {
+            const float *line = start + (size_t)c * block.stride;
+            float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+            for (int i = 0; i < block.taps; i += 4)
+            {
+                sum0 += phase[i] * line[i];
+                sum1 += phase[i + 1] * line[i + 1];
+                sum2 += phase[i + 2] * line[i + 2];
+                sum3 += phase[i + 3] * line[i + 3];
+            }
+            block.output[n * block.channels + c] = (sum0 + sum1) + (sum2 + sum3);
+        }
+        advance(block, index, offset);
+    }
+}
+
+#if defined(GUITAR_SIMD_X86)
+
+GUITAR_TARGET_SSE2 static void filterSSE2(const FilterBlock &block)
+{
+    int index = block.index;
+    int offset = block.phase;
+    for (int n = 0; n < block.frames; n++)
+    {
+        const float *phase = block.coefficients + (size_t)offset * block.taps;
+        const float *start = block.history + index;
+        for (int c = 0; c < block.channels; c++)
+        {
+            const float *line = start + (size_t)c * block.stride;
+            __m128 sum0 = _mm_setzero_ps();
+            __m128 sum1 = _mm_setzero_ps();
+            for (int i = 0; i < block.taps; i += 8)
+            {
+                sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(phase + i), _mm_loadu_ps(line + i)));
+                sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(phase + i + 4), _mm_loadu_ps(line + i + 4)));
+            }
+            float lanes[4];
+            _mm_storeu_ps(lanes, _mm_add_ps(sum0, sum1));
+            block.output[n * block.channels + c] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+        advance(block, index, offset);
+    }
+}
+
+GUITAR_TARGET_AVX2 static float horizontalSumAVX2(__m256 sum)
+{
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+GUITAR_TARGET_AVX2 static void filterAVX2(const FilterBlock &block)
+{
+    int index = block.index;
+    int offset = block.phase;
+    for (int n = 0; n < block.frames; n++)
+    {
+        const float *phase = block.coefficients + (size_t)offset * block.taps;
+        const float *start = block.history + index;
+
+        if (block.channels == 2)
+        {
+            // Stereo shares each coefficient load between both lines; two sums per line keep
+            // four FMA chains in flight
+            const float *left = start;
+            const float *right = start + block.stride;
+            __m256 left0 = _mm256_setzero_ps(), left1 = _mm256_setzero_ps();
+            __m256 right0 = _mm256_setzero_ps(), right1 = _mm256_setzero_ps();
+            int i = 0;
+            for (; i + 16 <= block.taps; i += 16)
+            {
+                __m256 h0 = _mm256_loadu_ps(phase + i);
+                __m256 h1 = _mm256_loadu_ps(phase + i + 8);
+                left0 = _mm256_fmadd_ps(h0, _mm256_loadu_ps(left + i), left0);
+                right0 = _mm256_fmadd_ps(h0, _mm256_loadu_ps(right + i), right0);
+                left1 = _mm256_fmadd_ps(h1, _mm256_loadu_ps(left + i + 8), left1);
+                right1 = _mm256_fmadd_ps(h1, _mm256_loadu_ps(right + i + 8), right1);
+            }
+            if (i < block.taps)
+            {
+                __m256 h = _mm256_loadu_ps(phase + i);
+                left0 = _mm256_fmadd_ps(h, _mm256_loadu_ps(left + i), left0);
+                right0 = _mm256_fmadd_ps(h, _mm256_loadu_ps(right + i), right0);
+            }
+            block.output[n * 2] = horizontalSumAVX2(_mm256_add_ps(left0, left1));
+            block.output[n * 2 + 1] = horizontalSumAVX2(_mm256_add_ps(right0, right1));
+        }
+        else
+        {
+            for (int c = 0; c < block.channels; c++)
+            {
+                const float *line = start + (size_t)c * block.stride;
+                __m256 sum = _mm256_setzero_ps();
+                for (int i = 0; i < block.taps; i += 8)
+                    sum = _mm256_fmadd_ps(_mm256_loadu_ps(phase + i), _mm256_loadu_ps(line + i), sum);
+                block.output[n * block.channels + c] = horizontalSumAVX2(sum);
+            }
+        }
+        advance(block, index, offset);
+    }
+}
+
+#endif
+
+static void filter(const FilterBlock &block)
+{
+#if defined(GUITAR_SIMD_X86)
+    static const bool useAVX2 = cpuHasAVX2();
+    static const bool useSSE2 = cpuHasSSE2();
+    if (useAVX2)
+        filterAVX2(block);
+    else if (useSSE2)
+        filterSSE2(block);
+    else
+        filterScalar(block);
+#else
+    filterScalar(block);
+#endif
+}
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+Resampler::Resampler(int inputRate, int outputRate, int channels, int maxOutputFrames, int taps)
+    : inputRate_(inputRate), outputRate_(outputRate), channels_(std::max(1, channels)), up_(1), down_(1), taps_(0),
+      maxOutput_(std::max(1, maxOutputFrames)), stride_(0), time_(0)
+{
+    if (inputRate <= 0 || outputRate <= 0)
+        return;
+
+    int divisor = std::gcd(inputRate, outputRate);
+    up_ = outputRate / divisor;
+    down_ = inputRate / divisor;
+    if (up_ > MAX_PHASES)
+        return;
+
+    // Downsampling cuts lower, so the filter needs proportionally more input frames for the same transition
+    double stretch = std::max(1.0, (double)inputRate / outputRate);
+    taps_ = ((int)std::ceil(std::max(8, taps) * stretch) + 7) / 8 * 8;
+
+    // Worst case input for one call: the next output sits up to one step past the block start,
+    // plus the group delay that convert() skips up front
+    int maxInput = (int)(((long long)maxOutput_ * down_ + up_ + down_) / up_) + 1 + taps_;
+    stride_ = taps_ + maxInput;
+    history_.assign((size_t)stride_ * channels_, 0.0f);
+
+    designFilter();
+    reset();
+}
+
+void Resampler::designFilter()
+{
+    // Prototype low-pass at up_ * inputRate, cut below the lower of the two Nyquist frequencies.
+    // Its centre sits exactly taps_ / 2 input frames in, so the delay is a whole number of frames.
+    const int length = up_ * taps_;
+    const double centre = length / 2.0;
+    const double cutoff = ROLLOFF * 0.5 * std::min(inputRate_, outputRate_) / ((double)up_ * inputRate_);
+    const double windowScale = 1.0 / besselI0(KAISER_BETA);
+
+    coefficients_.assign((size_t)length, 0.0f);
+    for (int p = 0; p < up_; p++)
+    {
+        float *phase = coefficients_.data() + (size_t)p * taps_;
+        double sum = 0.0;
+        for (int j = 0; j < taps_; j++)
+        {
+            double x = p + (double)j * up_ - centre;
+            double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * PI * cutoff * x) / (PI * x * 2.0 * cutoff);
+            double position = x / centre;
+            double window = std::fabs(position) < 1.0 ? besselI0(KAISER_BETA * std::sqrt(1.0 - position * position)) * windowScale : 0.0;
+            double value = sinc * window;
+            phase[taps_ - 1 - j] = (float)value;
+            sum += value;
+        }
+
+        // Every phase passes DC at exactly unity, so a constant input has no phase-to-phase ripple
+        if (sum != 0.0)
+        {
+            for (int j = 0; j < taps_; j++)
+                phase[j] = (float)(phase[j] / sum);
+        }
+    }
+}
+
+void Resampler::reset()
+{
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    time_ = up_; // first output lands on the first input frame of the next block
+}
+
+int Resampler::inputNeeded(int outputFrames) const
+{
+    if (outputFrames <= 0)
+        return 0;
+    return (int)((time_ + (long long)(outputFrames - 1) * down_) / up_);
+}
+
+void Resampler::process(const float *input, float *output, int outputFrames)
+{
+    if (!isValid())
+        return;
+
+    outputFrames = std::min(outputFrames, maxOutput_);
+    const int count = inputNeeded(outputFrames);
+
+    // New input goes in after the kept history, one contiguous run per channel
+    for (int c = 0; c < channels_; c++)
+    {
+        float *line = history_.data() + (size_t)c * stride_ + taps_;
+        for (int i = 0; i < count; i++)
+            line[i] = input[i * channels_ + c];
+    }
+
+    FilterBlock block = {coefficients_.data(), history_.data(), stride_, channels_, taps_, up_,
+                         (int)(time_ / up_), (int)(time_ % up_), down_ / up_, down_ % up_, output, outputFrames};
+    filter(block);
+    time_ += (long long)outputFrames * down_ - (long long)count * up_;
+
+    // Keep the newest taps_ frames as history for the next call
+    for (int c = 0; c < channels_; c++)
+    {
+        float *line = history_.data() + (size_t)c * stride_;
+        std::copy(line + count, line + count + taps_, line);
+    }
+}
+
+bool Resampler::convert(const std::vector<float> &input, int channels, int inputRate, int outputRate,
+                        std::vector<float> &output)
+{
+    const int block = 4096;
+    Resampler resampler(inputRate, outputRate, channels, block);
+    if (!resampler.isValid())
+        return false;
+
+    resampler.skipLatency();
+
+    const long long inputFrames = (long long)input.size() / channels;
+    const long long outputFrames = std::max(1LL, (inputFrames * outputRate + inputRate / 2) / inputRate);
+    output.assign((size_t)(outputFrames * channels), 0.0f);
+
+    std::vector<float> chunk;
+    long long position = 0;
+    for (long long done = 0; done < outputFrames; done += block)
+    {
+        int frames = (int)std::min<long long>(block, outputFrames - done);
+        int needed = resampler.inputNeeded(frames);
+
+        // Past the end of the input reads as silence, which flushes the filter tail
+        chunk.assign((size_t)needed * channels, 0.0f);
+        long long from = std::min(position, inputFrames);
+        long long available = std::min<long long>(needed, inputFrames - from);
+        std::copy(input.begin() + from * channels, input.begin() + (from + available) * channels, chunk.begin());
+
+        resampler.process(chunk.data(), output.data() + done * channels, frames);
+        position += needed;
+    }
+    return true;
+}
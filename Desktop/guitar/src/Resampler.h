@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+
+// Polyphase windowed-sinc sample rate converter for a fixed rational ratio.
+// The rate pair is reduced to up/down (44100 -> 48000 is 160/147); each output frame is
+// one dot product of `taps` input frames against the filter phase it falls on, so the
+// cost does not depend on how awkward the ratio is. The Kaiser-windowed prototype cuts
+// at 95% of the lower Nyquist with roughly 90 dB of stopband.
+//
+// Streaming use pulls a fixed number of output frames: ask inputNeeded() how many input
+// frames that takes, then hand exactly that many to process(). Nothing allocates after
+// construction, so both calls are safe on the audio thread.
+class Resampler
+{
+public:
+    static constexpr int DEFAULT_TAPS = 64; // per phase when neither rate is lower than the other
+    static constexpr int MAX_PHASES = 4096; // rate pairs that reduce to more phases are refused
+
+private:
+    int inputRate_;
+    int outputRate_;
+    int channels_;
+    int up_;
+    int down_;
+    int taps_;      // per phase, a multiple of 8
+    int maxOutput_; // output frames one process() call can produce
+
+    // Phase p holds taps_ coefficients, reversed so a phase lines up with ascending history
+    std::vector<float> coefficients_;
+
+    // Per channel: the last taps_ input frames followed by room for one call's input
+    std::vector<float> history_;
+    int stride_;
+
+    // Next output's position in 1/up_ input frames, from one frame before the current input block
+    long long time_;
+
+    void designFilter();
+
+public:
+    Resampler(int inputRate, int outputRate, int channels = 2, int maxOutputFrames = 1024, int taps = DEFAULT_TAPS);
+
+    bool isValid() const { return !coefficients_.empty(); }
+
+    int getInputRate() const { return inputRate_; }
+    int getOutputRate() const { return outputRate_; }
+    int getTaps() const { return taps_; }
+    int getMaxOutputFrames() const { return maxOutput_; }
+
+    // Group delay, in input frames
+    int getLatencyFrames() const { return taps_ / 2; }
+
+    // Input frames process() consumes to produce outputFrames
+    int inputNeeded(int outputFrames) const;
+
+    // Interleaved in and out; `input` holds exactly inputNeeded(outputFrames) frames
+    void process(const float *input, float *output, int outputFrames);
+
+    void reset();
+
+    // Drops the group delay before the first process(), so output frame k lines up with input
+    // time k * inputRate / outputRate. Only right after construction or reset().
+    void skipLatency() { time_ += (long long)getLatencyFrames() * up_; }
+
+    // Whole-buffer conversion with the group delay removed, for offline use (IR loading, tests)
+    static bool convert(const std::vector<float> &input, int channels, int inputRate, int outputRate,
+                        std::vector<float> &output);
+};
@@ -0,0 +1,64 @@
+#include "SampleClock.h"
+#include "LatencyProbe.h"
+#include <algorithm>
+
+int64_t WindowedMinimum::add(int64_t time, int64_t value)
+{
+    if (empty)
+    {
+        bucketStart = time;
+        current = previous = value;
+        empty = false;
+    }
+    else if (time - bucketStart >= window / 2)
+    {
+        // A long gap (no readings for a whole window) forgets the old bucket too
+        previous = time - bucketStart >= window ? value : current;
+        current = value;
+        bucketStart = time;
+    }
+    else
+    {
+        current = std::min(current, value);
+    }
+    return std::min(current, previous);
+}
+
+SampleClock::SampleClock(int sampleRate) : sampleRate_(sampleRate), origin_(WINDOW_NS), publishedOrigin_(0)
+{
+}
+
+void SampleClock::update(int64_t callbackTime, uint64_t sampleTime)
+{
+    int64_t origin = callbackTime - (int64_t)(sampleTime * 1e9 / sampleRate_);
+    publishedOrigin_.store(origin_.add(callbackTime, origin), std::memory_order_release);
+}
+
+void SampleClock::restart()
+{
+    // The audio thread is stopped while the device reopens, so its state can be touched here
+    origin_.reset();
+    publishedOrigin_.store(0, std::memory_order_release);
+}
+
+bool SampleClock::toSampleTime(int64_t time, uint64_t &sampleTime) const
+{
+    int64_t origin = publishedOrigin_.load(std::memory_order_acquire);
+    if (origin == 0)
+        return false;
+    sampleTime = (uint64_t)std::max<int64_t>(0, (int64_t)((time - origin) * 1e-9 * sampleRate_));
+    return true;
+}
+
+TickClock::TickClock() : origin_(10000000000LL)
+{
+}
+
+int64_t TickClock::toTime(uint32_t eventTicks, uint32_t currentTicks)
+{
+    // now - ticks lies within a tick after the counter's true origin; the lowest reading is closest
+    int64_t now = LatencyProbe::now();
+    int64_t origin = origin_.add(now, now - (int64_t)currentTicks * 1000000);
+    int64_t age = (int64_t)(uint32_t)(currentTicks - eventTicks) * 1000000;
+    return origin + ((int64_t)currentTicks * 1000000 - age);
+}
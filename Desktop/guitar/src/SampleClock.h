@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Smallest value seen over roughly the last window of time, in two half-window buckets.
+// Late readings are scheduling noise; the early edge is the clock being tracked.
+struct WindowedMinimum
+{
+    int64_t window;
+    int64_t bucketStart;
+    int64_t current;
+    int64_t previous;
+    bool empty;
+
+    explicit WindowedMinimum(int64_t windowNs) : window(windowNs), bucketStart(0), current(0), previous(0), empty(true) {}
+
+    int64_t add(int64_t time, int64_t value);
+    void reset() { empty = true; }
+};
+
+// Steady-clock time (LatencyProbe::now()) onto engine sample time, so a note can start on the sample
+// that matches when its input event happened instead of whenever the audio thread next looks.
+// Each callback reports when it started and which sample it is about to render; the earliest
+// callbacks of the last half second or so trace the device's schedule.
+class SampleClock
+{
+public:
+    static constexpr int64_t WINDOW_NS = 500000000;
+
+private:
+    int sampleRate_;
+    WindowedMinimum origin_;             // audio thread
+    std::atomic<int64_t> publishedOrigin_; // steady-clock time of engine sample 0; 0 = no callback yet
+
+public:
+    explicit SampleClock(int sampleRate = 44100);
+
+    // Before the first callback, or while the audio is stopped
+    void setSampleRate(int sampleRate) { sampleRate_ = sampleRate; }
+
+    // Audio thread, at the start of each callback with the engine sample it is about to render
+    void update(int64_t callbackTime, uint64_t sampleTime);
+
+    // Main thread, after the device was reopened: the old schedule no longer applies
+    void restart();
+
+    // Any thread: the engine sample playing at that time; false before the first callback
+    bool toSampleTime(int64_t time, uint64_t &sampleTime) const;
+};
+
+// SDL's millisecond event stamps onto the steady clock. The tick counter's phase is tracked
+// across calls, so two stamps keep their spacing to within one tick instead of also picking
+// up the rounding of the tick count read at conversion time.
+class TickClock
+{
+private:
+    WindowedMinimum origin_;
+
+public:
+    TickClock();
+
+    // Main thread, with SDL_GetTicks() read just now
+    int64_t toTime(uint32_t eventTicks, uint32_t currentTicks);
+};
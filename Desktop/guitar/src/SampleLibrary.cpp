@@ -0,0 +1,252 @@
+#include "SampleLibrary.h"
+#include "Tuning.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+SampleSource::SampleSource()
+    : isFlac_(false), channels_(0), fileRate_(0), fileFrames_(0), remaining_(0)
+{
+}
+
+bool SampleSource::open(const std::string &path, int engineRate)
+{
+    // The format comes from the file's first bytes, not its name
+    char magic[4] = {};
+    {
+        std::ifstream probe(path, std::ios::binary);
+        probe.read(magic, sizeof(magic));
+    }
+    isFlac_ = std::memcmp(magic, "fLaC", 4) == 0 || std::memcmp(magic, "ID3", 3) == 0;
+
+    if (isFlac_)
+    {
+        if (!flac_.open(path))
+            return false;
+        channels_ = flac_.getChannels();
+        fileRate_ = flac_.getSampleRate();
+        fileFrames_ = flac_.getFrameCount();
+        if (fileFrames_ == 0)
+        {
+            std::cerr << "FLAC file doesn't give its length: " << path << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        if (!wav_.open(path))
+            return false;
+        channels_ = wav_.getChannels();
+        fileRate_ = wav_.getSampleRate();
+        fileFrames_ = wav_.getFrameCount();
+    }
+
+    resampler_.reset();
+    remaining_ = fileFrames_;
+    if (fileRate_ != engineRate)
+    {
+        resampler_ = std::make_unique<Resampler>(fileRate_, engineRate, channels_, MAX_CONVERT_FRAMES);
+        if (!resampler_->isValid())
+        {
+            std::cerr << "Can't convert " << fileRate_ << " Hz to " << engineRate << " Hz: " << path << std::endl;
+            return false;
+        }
+        resampler_->skipLatency();
+        remaining_ = (fileFrames_ * engineRate + fileRate_ / 2) / fileRate_;
+    }
+    return true;
+}
+
+int SampleSource::readFile(float *samples, int frames)
+{
+    return isFlac_ ? flac_.read(samples, frames) : wav_.read(samples, frames);
+}
+
+int SampleSource::read(float *samples, int frames)
+{
+    frames = (int)std::min<uint64_t>((uint64_t)std::max(frames, 0), remaining_);
+    if (!resampler_)
+    {
+        int count = readFile(samples, frames);
+        remaining_ = count < frames ? 0 : remaining_ - count; // a short file ends where its data does
+        return count;
+    }
+
+    // Past the end of the file reads as silence, which flushes the filter tail
+    int done = 0;
+    while (done < frames)
+    {
+        int count = std::min(frames - done, MAX_CONVERT_FRAMES);
+        int needed = resampler_->inputNeeded(count);
+        input_.assign((size_t)needed * channels_, 0.0f);
+        readFile(input_.data(), needed);
+        resampler_->process(input_.data(), samples + (size_t)done * channels_, count);
+        done += count;
+    }
+    remaining_ -= done;
+    return done;
+}
+
+bool SampleSource::skip(uint64_t frames)
+{
+    frames = std::min(frames, remaining_);
+    if (!resampler_)
+    {
+        uint64_t position = fileFrames_ - remaining_;
+        remaining_ -= frames;
+        return isFlac_ ? flac_.seek(position + frames) : wav_.seek(position + frames);
+    }
+
+    // The filter has to see the skipped input, so it is converted and dropped
+    std::vector<float> scratch((size_t)MAX_CONVERT_FRAMES * channels_);
+    while (frames > 0)
+    {
+        int count = read(scratch.data(), (int)std::min<uint64_t>(frames, MAX_CONVERT_FRAMES));
+        if (count <= 0)
+            return false;
+        frames -= count;
+    }
+    return true;
+}
+
+SampleLibrary::SampleLibrary() : engineRate_(0), residentBytes_(0), totalFrames_(0)
+{
+}
+
+bool SampleLibrary::load(const std::string &manifestPath, const std::vector<float> &tuning, int engineRate,
+                         float headSeconds)
+{
+    std::ifstream manifest(manifestPath);
+    if (!manifest)
+    {
+        std::cerr << "Failed to open sample library: " << manifestPath << std::endl;
+        return false;
+    }
+
+    std::vector<float> strings = tuning;
+    if (strings.empty())
+        strings.assign(Tuning::STANDARD_FREQUENCIES, Tuning::STANDARD_FREQUENCIES + Tuning::STRING_COUNT);
+
+    std::string directory;
+    size_t slash = manifestPath.find_last_of("/\\");
+    if (slash != std::string::npos)
+        directory = manifestPath.substr(0, slash + 1);
+
+    zones_.clear();
+    byNote_.clear();
+    engineRate_ = engineRate;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(manifest, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream fields(line);
+        int stringIndex = 0, fret = 0;
+        float velocity = 0.0f;
+        std::string file;
+        if (!(fields >> stringIndex))
+            continue; // blank or comment-only
+        if (!(fields >> fret >> velocity) || !std::getline(fields >> std::ws, file) || file.empty() ||
+            stringIndex < 0 || stringIndex >= (int)strings.size() || fret < 0 || velocity <= 0.0f)
+        {
+            std::cerr << manifestPath << ":" << lineNumber << ": expected 'string fret velocity file'" << std::endl;
+            continue;
+        }
+        file.erase(file.find_last_not_of(" \t\r") + 1);
+
+        auto zone = std::make_unique<SampleZone>();
+        zone->stringIndex = stringIndex;
+        zone->note = (int)std::lround(12.0 * std::log2(strings[stringIndex] / 440.0) + 69.0) + fret;
+        zone->velocity = std::min(1.0f, velocity);
+        bool absolute = file[0] == '/' || file[0] == '\\' || (file.size() > 1 && file[1] == ':');
+        zone->path = absolute ? file : directory + file;
+        zone->channels = 0;
+        zone->frames = 0;
+        zone->headFrames = 0;
+        zones_.push_back(std::move(zone));
+    }
+
+    // Opening and decoding heads is file I/O bound, so the zones load side by side
+    auto start = std::chrono::steady_clock::now();
+    const int headLimit = std::max(1, (int)(headSeconds * engineRate));
+    {
+        WorkerPool pool;
+        for (auto &zone : zones_)
+        {
+            SampleZone *target = zone.get();
+            pool.submit([target, engineRate, headLimit]() {
+                SampleSource source;
+                if (!source.open(target->path, engineRate))
+                    return;
+                if (source.getChannels() > 2)
+                {
+                    std::cerr << "Only mono and stereo samples can be played: " << target->path << std::endl;
+                    return;
+                }
+                target->channels = source.getChannels();
+                target->frames = source.getFrames();
+                target->head.resize((size_t)std::min<uint64_t>(target->frames, headLimit) * target->channels);
+                target->headFrames = source.read(target->head.data(), (int)(target->head.size() / target->channels));
+            });
+        }
+        pool.waitIdle();
+    }
+
+    // Zones that failed to open are left out
+    zones_.erase(std::remove_if(zones_.begin(), zones_.end(),
+                                [](const std::unique_ptr<SampleZone> &zone) { return zone->frames == 0; }),
+                 zones_.end());
+
+    residentBytes_ = 0;
+    totalFrames_ = 0;
+    for (auto &zone : zones_)
+    {
+        byNote_[noteKey(zone->stringIndex, zone->note)].push_back(zone.get());
+        residentBytes_ += zone->head.size() * sizeof(float);
+        totalFrames_ += zone->frames;
+    }
+    for (auto &entry : byNote_)
+    {
+        std::sort(entry.second.begin(), entry.second.end(),
+                  [](const SampleZone *a, const SampleZone *b) { return a->velocity < b->velocity; });
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Sample library: " << zones_.size() << " zones, " << residentBytes_ / 1024 << " KiB resident ("
+              << 1000.0f * headSeconds << " ms heads), " << totalFrames_ / engineRate << " s streamed from disk, loaded in "
+              << seconds * 1000.0 << " ms" << std::endl;
+    return !zones_.empty();
+}
+
+const SampleZone *SampleLibrary::find(int stringIndex, int note, float velocity) const
+{
+    auto layers = byNote_.end();
+    if (stringIndex >= 0)
+        layers = byNote_.find(noteKey(stringIndex, note));
+
+    // Another string with the same note sounds closer than a resampled neighbour
+    for (auto it = byNote_.begin(); layers == byNote_.end() && it != byNote_.end(); ++it)
+    {
+        if (it->first % 128 == note)
+            layers = it;
+    }
+    if (layers == byNote_.end())
+        return nullptr;
+
+    for (const SampleZone *zone : layers->second)
+    {
+        if (zone->velocity >= velocity)
+            return zone;
+    }
+    return layers->second.back();
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FlacFile.h"
+#include "Resampler.h"
+#include "WavFile.h"
+
+// One recording of a multisample library: a string, a fret and a velocity layer.
+// Only the head stays in memory; the rest is streamed from the file while the note plays.
+struct SampleZone
+{
+    int stringIndex;
+    int note;       // MIDI note of the string and fret
+    float velocity; // top of the layer, 0..1
+    std::string path;
+    int channels;        // 1 (panned with the string) or 2
+    uint64_t frames;     // whole length at the engine rate
+    int headFrames;      // frames held in `head`, at most `frames`
+    std::vector<float> head; // interleaved, at the engine rate
+};
+
+// A zone's file decoded at the engine rate: FLAC or WAV, through a Resampler when the file was
+// recorded at another rate. Used on the loader's threads for heads and on the disk thread for the rest.
+class SampleSource
+{
+private:
+    FlacReader flac_;
+    WavReader wav_;
+    bool isFlac_;
+    int channels_;
+    int fileRate_;
+    uint64_t fileFrames_;
+    uint64_t remaining_; // frames left at the engine rate
+    std::unique_ptr<Resampler> resampler_;
+    std::vector<float> input_; // file frames for one resampler call
+
+    int readFile(float *samples, int frames);
+
+public:
+    static constexpr int MAX_CONVERT_FRAMES = 1024; // output frames per resampler call
+
+    SampleSource();
+
+    bool open(const std::string &path, int engineRate);
+
+    // Up to `frames` interleaved frames; 0 at the end
+    int read(float *samples, int frames);
+    // Reads and drops frames, to resume after the head
+    bool skip(uint64_t frames);
+
+    int getChannels() const { return channels_; }
+    int getFileRate() const { return fileRate_; }
+    uint64_t getFrames() const { return remaining_; } // right after open: the whole length
+};
+
+// Multisample library described by a text manifest, one zone per line:
+//     string fret velocity file     # string 0 = low E, velocity 0..1 = top of the layer
+// Paths are relative to the manifest. Notes come from the tuning, so a drop-D library only needs
+// a different tuning, not different note numbers.
+class SampleLibrary
+{
+public:
+    static constexpr float DEFAULT_HEAD_SECONDS = 0.1f; // resident per zone; covers the disk thread's first read
+
+private:
+    std::vector<std::unique_ptr<SampleZone>> zones_;
+    std::map<int, std::vector<const SampleZone *>> byNote_; // (string, note) -> layers, quietest first
+    int engineRate_;
+    size_t residentBytes_;
+    uint64_t totalFrames_;
+
+    static int noteKey(int stringIndex, int note) { return stringIndex * 128 + note; }
+
+public:
+    SampleLibrary();
+
+    // Reads the manifest and decodes every zone's head on a worker pool
+    bool load(const std::string &manifestPath, const std::vector<float> &tuning, int engineRate,
+              float headSeconds = DEFAULT_HEAD_SECONDS);
+
+    // Layer for the note on that string, or on any string when it has none; null when the library lacks the note.
+    // The lowest layer at or above the velocity wins, the loudest past the top.
+    const SampleZone *find(int stringIndex, int note, float velocity) const;
+
+    int getZoneCount() const { return (int)zones_.size(); }
+    int getEngineRate() const { return engineRate_; }
+    size_t getResidentBytes() const { return residentBytes_; }
+    uint64_t getTotalFrames() const { return totalFrames_; }
+};
@@ -0,0 +1,209 @@
+#include "Sequencer.h"
+#include "SynthEngine.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+Sequencer::Sequencer() : running_(false), engine_(nullptr), lastFrame_(0)
+{
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        stringOwner_[s] = -1;
+        stringStart_[s] = 0.0;
+    }
+    std::memset(heldString_, -1, sizeof(heldString_));
+}
+
+Sequencer::~Sequencer()
+{
+    stop();
+}
+
+bool Sequencer::open(const std::string &path)
+{
+    stop();
+
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+        stringOwner_[s] = -1;
+    std::memset(heldString_, -1, sizeof(heldString_));
+
+    return midi_.open(path);
+}
+
+bool Sequencer::assignString(int note, int &stringIndex, int &fret) const
+{
+    // Prefer a free string where the note sits lowest on the neck,
+    // otherwise take over the string that has been ringing the longest
+    int best = -1;
+    bool bestFree = false;
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        int f = note - Tuning::STANDARD_NOTES[s];
+        if (f < 0 || f > Tuning::FRET_COUNT)
+            continue;
+
+        bool free = stringOwner_[s] < 0;
+        if (best < 0 || (free && !bestFree))
+        {
+            best = s;
+            bestFree = free;
+        }
+        else if (free == bestFree)
+        {
+            int bestFret = note - Tuning::STANDARD_NOTES[best];
+            if (free ? f < bestFret : stringStart_[s] < stringStart_[best])
+                best = s;
+        }
+    }
+
+    if (best < 0)
+        return false;
+
+    stringIndex = best;
+    fret = note - Tuning::STANDARD_NOTES[best];
+    return true;
+}
+
+bool Sequencer::next(SequencedNote &note)
+{
+    const int lowest = Tuning::STANDARD_NOTES[0];
+    const int highest = Tuning::STANDARD_NOTES[Tuning::STRING_COUNT - 1] + Tuning::FRET_COUNT;
+
+    MidiEvent event;
+    while (midi_.next(event))
+    {
+        if (event.channel == DRUM_CHANNEL)
+            continue;
+
+        int owner = (event.channel << 8) | event.note;
+
+        if (!event.noteOn)
+        {
+            // Only release the string if it is still playing this note
+            int s = heldString_[event.channel][event.note];
+            heldString_[event.channel][event.note] = -1;
+            if (s < 0 || stringOwner_[s] != owner)
+                continue;
+
+            stringOwner_[s] = -1;
+            note.seconds = event.seconds;
+            note.type = NoteEventType::NoteOff;
+            note.stringIndex = s;
+            note.fret = 0;
+            note.velocity = 0.0f;
+            return true;
+        }
+
+        // Fold notes outside the fretboard into range by octaves
+        int pitch = event.note;
+        while (pitch < lowest)
+            pitch += 12;
+        while (pitch > highest)
+            pitch -= 12;
+
+        int stringIndex, fret;
+        if (!assignString(pitch, stringIndex, fret))
+            continue;
+
+        stringOwner_[stringIndex] = owner;
+        stringStart_[stringIndex] = event.seconds;
+        heldString_[event.channel][event.note] = (int8_t)stringIndex;
+
+        note.seconds = event.seconds;
+        note.type = NoteEventType::NoteOn;
+        note.stringIndex = stringIndex;
+        note.fret = fret;
+        note.velocity = event.velocity / 127.0f;
+        return true;
+    }
+
+    return false;
+}
+
+bool Sequencer::start(SynthEngine *engine, double lookaheadSeconds)
+{
+    stop();
+    if (!engine)
+        return false;
+
+    engine_ = engine;
+    lastFrame_.store(0);
+    running_.store(true);
+    thread_ = std::thread(&Sequencer::playbackLoop, this, engine, lookaheadSeconds);
+    return true;
+}
+
+void Sequencer::stop()
+{
+    running_.store(false);
+    if (thread_.joinable())
+        thread_.join();
+
+    // Stopping releases the strings at once; there is no tail left to wait for
+    lastFrame_.store(0);
+}
+
+bool Sequencer::isPlaying() const
+{
+    return running_.load() || (engine_ && engine_->getSampleTime() <= lastFrame_.load());
+}
+
+void Sequencer::playbackLoop(SynthEngine *engine, double lookaheadSeconds)
+{
+    const int sampleRate = engine->getSampleRate();
+    const uint64_t lookahead = (uint64_t)(lookaheadSeconds * sampleRate);
+
+    // Song time zero is one lookahead from now, so the first notes are not late
+    const uint64_t songStart = engine->getSampleTime() + lookahead;
+
+    SequencedNote note;
+    bool haveNote = next(note);
+
+    while (running_.load() && haveNote)
+    {
+        uint64_t horizon = engine->getSampleTime() + lookahead;
+
+        while (haveNote)
+        {
+            uint64_t frame = songStart + (uint64_t)std::llround(note.seconds * sampleRate);
+            if (frame > horizon)
+                break;
+
+            // A full queue is not a lost note here: hold on to it and retry after the audio thread drains
+            if (!engine->hasQueueSpace(SynthEngine::SEQUENCER_PORT))
+                break;
+
+            NoteEvent event = {};
+            event.type = note.type;
+            event.note = (float)(Tuning::STANDARD_NOTES[note.stringIndex] + note.fret);
+            event.velocity = note.velocity;
+            event.stringIndex = note.stringIndex;
+            event.timestamp = frame;
+            engine->queueEvent(event, SynthEngine::SEQUENCER_PORT);
+            lastFrame_.store(frame);
+
+            haveNote = next(note);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    // Stopped early: release anything still ringing from the song
+    if (haveNote)
+    {
+        for (int s = 0; s < Tuning::STRING_COUNT; s++)
+        {
+            if (stringOwner_[s] < 0 || !engine->hasQueueSpace(SynthEngine::SEQUENCER_PORT))
+                continue;
+
+            NoteEvent event = {};
+            event.type = NoteEventType::NoteOff;
+            event.stringIndex = s;
+            event.timestamp = engine->getSampleTime();
+            engine->queueEvent(event, SynthEngine::SEQUENCER_PORT);
+            stringOwner_[s] = -1;
+        }
+    }
+
+    running_.store(false);
+}
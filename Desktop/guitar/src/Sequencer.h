@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "MidiFile.h"
+#include "NoteEventQueue.h"
+#include "Tuning.h"
+
+class SynthEngine;
+
+// A MIDI note placed on the fretboard
+struct SequencedNote
+{
+    double seconds; // from the start of the song
+    NoteEventType type;
+    int stringIndex;
+    int fret;
+    float velocity; // 0..1
+};
+
+// Plays a Standard MIDI File on the six strings.
+// Notes are pulled from the file as they are needed, so memory use does not grow with song length.
+// The same note stream feeds both live playback (a feeder thread queues events ahead of the
+// audio clock on the engine's sequencer port) and the offline renderer.
+class Sequencer
+{
+private:
+    static const int DRUM_CHANNEL = 9; // General MIDI channel 10
+
+    MidiFile midi_;
+
+    // Which MIDI note (channel << 8 | note) each string is sounding, -1 when the string is free
+    int stringOwner_[Tuning::STRING_COUNT];
+    double stringStart_[Tuning::STRING_COUNT];
+    int8_t heldString_[16][128]; // string each held note was given, -1 if none
+
+    std::thread thread_;
+    std::atomic<bool> running_;
+    SynthEngine *engine_;
+    std::atomic<uint64_t> lastFrame_; // engine sample time of the last queued event
+
+    bool assignString(int note, int &stringIndex, int &fret) const;
+    void playbackLoop(SynthEngine *engine, double lookaheadSeconds);
+
+public:
+    Sequencer();
+    ~Sequencer();
+
+    bool open(const std::string &path);
+
+    // Next fretboard note in time order; false once the song has ended
+    bool next(SequencedNote &note);
+
+    // Live playback on the engine's sequencer port. Events are queued lookaheadSeconds
+    // before they are due and started sample-accurately by the audio thread.
+    bool start(SynthEngine *engine, double lookaheadSeconds = 0.25);
+    void stop();
+    // True until the engine has rendered the last queued event, not just until it is queued
+    bool isPlaying() const;
+};
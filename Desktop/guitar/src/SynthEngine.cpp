@@ -0,0 +1,1121 @@
+#include "SynthEngine.h"
+#include "DiskStreamer.h"
+#include "DspLoadMeter.h"
+#include "ToneKernel.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Constant-power pan law, scaled so a centred string keeps unity gain on both sides
+static void panGains(float pan, float &left, float &right)
+{
+    float angle = (std::max(-1.0f, std::min(1.0f, pan)) + 1.0f) * (float)M_PI / 4.0f;
+    left = std::sqrt(2.0f) * std::cos(angle);
+    right = std::sqrt(2.0f) * std::sin(angle);
+}
+
+// Strings and note-bank buffers decay by themselves and only need a release; the live tone
+// gets the attack and decay its pre-rendered buffer had baked in, then holds
+static EnvelopeSettings defaultEnvelope(VoiceKind kind)
+{
+    EnvelopeSettings settings;
+    if (kind == VoiceKind::String)
+        settings.release = 0.5f;
+    else if (kind == VoiceKind::Tone)
+        settings = {0.005f, 0.6f, 0.4f, 0.3f};
+    return settings;
+}
+
+SynthEngine::SynthEngine(int sampleRate, int stringCount, int maxVoices)
+    : sampleRate_(sampleRate), stringCount_(stringCount), maxVoices_(DEFAULT_MAX_VOICES),
+      stealPolicy_((int)VoiceStealPolicy::Quietest), appliedMaxVoices_(DEFAULT_MAX_VOICES), pendingCount_(0), startedTagCount_(0), sampleTime_(0),
+      droppedEvents_(0), voicesStolen_(0), voicesDropped_(0), activeVoices_(0), whammy_(0.0f),
+      dcIn_{0.0f, 0.0f}, dcOut_{0.0f, 0.0f}, streamer_(nullptr), loadMeter_(nullptr),
+      noiseState_(22222)
+{
+    for (int s = 0; s < MAX_PANNED_STRINGS; s++)
+    {
+        float spread = stringCount > 1 ? 2.0f * s / (stringCount - 1) - 1.0f : 0.0f;
+        stringPan_[s].store(s < stringCount ? 0.3f * spread : 0.0f, std::memory_order_relaxed);
+        stringBend_[s].store(0.0f, std::memory_order_relaxed);
+        vibratoDepth_[s].store(0.0f, std::memory_order_relaxed);
+        vibratoRate_[s].store(DEFAULT_VIBRATO_RATE, std::memory_order_relaxed);
+    }
+
+    for (int k = 0; k < VOICE_KINDS; k++)
+    {
+        requestedEnvelopes_[k] = defaultEnvelope((VoiceKind)k);
+        envelopes_[k] = requestedEnvelopes_[k];
+        envelopePending_[k] = false;
+    }
+
+    voices_.resize(VOICE_CAPACITY);
+    for (auto &voice : voices_)
+    {
+        voice.kind = VoiceKind::String;
+        voice.active = false;
+        voice.choked = false;
+        voice.stringIndex = -1;
+        voice.startTime = 0;
+        voice.level = 0.0f;
+        voice.envelope = {EnvelopeStage::Done, 0.0f, 0.0f, 0, 0.0f, 0};
+        voice.panLeft = 1.0f;
+        voice.panRight = 1.0f;
+        voice.pitch = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, DEFAULT_VIBRATO_RATE, 0.0f, 1.0f, 0.0f, 1.0f, false};
+        voice.stream = {nullptr, -1, 0, 0.0f, false, 0.0f, {{0.0f, 0.0f}, {0.0f, 0.0f}}};
+
+        // Allocate the delay line up front so a pluck never allocates
+        voice.string.delayLine.assign(sampleRate / MIN_FREQUENCY + 2, 0.0f);
+        voice.string.length = 1;
+        voice.string.position = 0;
+        voice.string.period = 1.0f;
+        voice.string.delay = 1.0f;
+        voice.string.decay = 0.0f;
+        voice.string.allpassCoeff = 0.0f;
+        voice.string.allpassIn = 0.0f;
+        voice.string.allpassOut = 0.0f;
+        voice.string.lastSample = 0.0f;
+        voice.string.quietSamples = 0;
+
+        voice.sample = {nullptr, 0, 0, 0, 0.0f, 0.0f};
+        voice.tone = {nullptr, 0, 0, 0.0f};
+    }
+
+    setMaxVoices(maxVoices);
+}
+
+void SynthEngine::setStringPan(int stringIndex, float pan)
+{
+    if (stringIndex >= 0 && stringIndex < MAX_PANNED_STRINGS)
+        stringPan_[stringIndex].store(std::max(-1.0f, std::min(1.0f, pan)), std::memory_order_relaxed);
+}
+
+float SynthEngine::getStringPan(int stringIndex) const
+{
+    if (stringIndex < 0 || stringIndex >= MAX_PANNED_STRINGS)
+        return 0.0f;
+    return stringPan_[stringIndex].load(std::memory_order_relaxed);
+}
+
+// Pitch offsets come from the C API unchecked
+static float clampCents(float cents)
+{
+    if (!std::isfinite(cents))
+        return 0.0f;
+    return std::max(SynthEngine::MIN_PITCH_CENTS, std::min(SynthEngine::MAX_PITCH_CENTS, cents));
+}
+
+void SynthEngine::setBend(int stringIndex, float cents)
+{
+    if (stringIndex >= 0 && stringIndex < MAX_PANNED_STRINGS)
+        stringBend_[stringIndex].store(clampCents(cents), std::memory_order_relaxed);
+}
+
+void SynthEngine::setWhammy(float cents)
+{
+    whammy_.store(clampCents(cents), std::memory_order_relaxed);
+}
+
+void SynthEngine::setVibrato(int stringIndex, float depthCents, float rateHz)
+{
+    if (stringIndex < 0 || stringIndex >= MAX_PANNED_STRINGS)
+        return;
+    vibratoDepth_[stringIndex].store(std::max(0.0f, depthCents), std::memory_order_relaxed);
+    vibratoRate_[stringIndex].store(std::max(0.0f, rateHz), std::memory_order_relaxed);
+}
+
+float SynthEngine::getBend(int stringIndex) const
+{
+    if (stringIndex < 0 || stringIndex >= MAX_PANNED_STRINGS)
+        return 0.0f;
+    return stringBend_[stringIndex].load(std::memory_order_relaxed);
+}
+
+void SynthEngine::setEnvelope(VoiceKind kind, const EnvelopeSettings &settings)
+{
+    if (kind == VoiceKind::COUNT)
+        return;
+
+    EnvelopeSettings clamped = settings;
+    clamped.attack = std::max(0.0f, settings.attack);
+    clamped.decay = std::max(0.0f, settings.decay);
+    clamped.sustain = std::max(0.0f, std::min(1.0f, settings.sustain));
+    clamped.release = std::max(CHOKE_SECONDS, settings.release);
+    requestedEnvelopes_[(int)kind] = clamped;
+    envelopePending_[(int)kind] = true;
+
+    // Never wait on the audio thread; a change that doesn't fit is queued again with the next one
+    for (int k = 0; k < VOICE_KINDS; k++)
+    {
+        if (envelopePending_[k] && envelopeUpdates_.push({(VoiceKind)k, requestedEnvelopes_[k]}))
+            envelopePending_[k] = false;
+    }
+}
+
+void SynthEngine::setMaxVoices(int maxVoices)
+{
+    maxVoices_.store(std::max(1, std::min(maxVoices, VOICE_CAPACITY)));
+}
+
+bool SynthEngine::queueEvent(const NoteEvent &event, int port)
+{
+    if (port < 0 || port >= MAX_PORTS || !events_[port].push(event))
+    {
+        // Never wait on the audio thread; a full queue means the note is lost
+        droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool SynthEngine::noteOn(int stringIndex, float frequency, float velocity)
+{
+    NoteEvent event = {};
+    event.note = frequencyToNote(frequency);
+    event.velocity = velocity;
+    event.stringIndex = stringIndex;
+    event.timestamp = getSampleTime();
+    return queueEvent(event);
+}
+
+void SynthEngine::chokeString(int stringIndex)
+{
+    // A string can only ring once: fade out whatever it is still playing
+    for (auto &voice : voices_)
+    {
+        if (voice.active && voice.stringIndex == stringIndex)
+            chokeVoice(voice);
+    }
+}
+
+void SynthEngine::releaseString(int stringIndex)
+{
+    // Note-off: the voice leaves the string and runs its release
+    for (auto &voice : voices_)
+    {
+        if (voice.active && voice.stringIndex == stringIndex)
+        {
+            voice.stringIndex = -1;
+            releaseEnvelope(voice.envelope, envelopes_[(int)voice.kind].release);
+        }
+    }
+}
+
+void SynthEngine::startEnvelope(Envelope &envelope, const EnvelopeSettings &settings) const
+{
+    envelope.sustain = settings.sustain;
+    envelope.decaySamples = (int)std::lround(settings.decay * sampleRate_);
+
+    int attackSamples = (int)std::lround(settings.attack * sampleRate_);
+    envelope.stage = EnvelopeStage::Attack;
+    envelope.level = 0.0f;
+    envelope.step = attackSamples > 0 ? 1.0f / attackSamples : 0.0f;
+    envelope.remaining = attackSamples;
+
+    // With no attack the voice starts at full level
+    if (attackSamples == 0)
+        advanceEnvelope(envelope);
+}
+
+void SynthEngine::releaseEnvelope(Envelope &envelope, float seconds) const
+{
+    int samples = std::max(1, (int)std::lround(seconds * sampleRate_));
+
+    // A release already under way only ever gets shorter
+    if (envelope.stage == EnvelopeStage::Done ||
+        (envelope.stage == EnvelopeStage::Release && envelope.remaining <= samples))
+        return;
+
+    envelope.stage = EnvelopeStage::Release;
+    envelope.step = -envelope.level / samples;
+    envelope.remaining = samples;
+}
+
+void SynthEngine::advanceEnvelope(Envelope &envelope)
+{
+    switch (envelope.stage)
+    {
+    case EnvelopeStage::Attack:
+        envelope.level = 1.0f;
+        if (envelope.decaySamples > 0 && envelope.sustain < 1.0f)
+        {
+            envelope.stage = EnvelopeStage::Decay;
+            envelope.step = (envelope.sustain - 1.0f) / envelope.decaySamples;
+            envelope.remaining = envelope.decaySamples;
+            break;
+        }
+        // No decay: straight to the sustain level
+        [[fallthrough]];
+    case EnvelopeStage::Decay:
+        envelope.level = envelope.sustain;
+        envelope.step = 0.0f;
+        envelope.stage = envelope.sustain > 0.0f ? EnvelopeStage::Sustain : EnvelopeStage::Done;
+        break;
+    default:
+        envelope.level = 0.0f;
+        envelope.step = 0.0f;
+        envelope.stage = EnvelopeStage::Done;
+        break;
+    }
+}
+
+bool SynthEngine::fillEnvelope(Envelope &envelope, float *gains, int frames)
+{
+    // Most blocks of a held note sit at one level; callers then scale by it and skip the gains
+    if (envelope.stage == EnvelopeStage::Sustain || envelope.stage == EnvelopeStage::Done)
+        return false;
+
+    // Linear segments, so the inner loop is a plain ramp with no stage test per sample
+    int i = 0;
+    while (i < frames)
+    {
+        if (envelope.stage == EnvelopeStage::Sustain || envelope.stage == EnvelopeStage::Done)
+        {
+            std::fill(gains + i, gains + frames, envelope.level);
+            return true;
+        }
+
+        int run = std::min(envelope.remaining, frames - i);
+        float level = envelope.level;
+        for (int k = 0; k < run; k++)
+        {
+            level += envelope.step;
+            gains[i + k] = level;
+        }
+        envelope.level = level;
+        envelope.remaining -= run;
+        i += run;
+
+        if (envelope.remaining <= 0)
+            advanceEnvelope(envelope);
+    }
+    return true;
+}
+
+void SynthEngine::chokeVoice(Voice &voice)
+{
+    voice.stringIndex = -1;
+    voice.choked = true;
+    releaseEnvelope(voice.envelope, CHOKE_SECONDS);
+}
+
+Voice *SynthEngine::chooseVictim(VoiceStealPolicy policy, bool preferReleasing)
+{
+    // A voice that is already releasing (note-off) is the cheapest to give up
+    Voice *victim = nullptr;
+    if (preferReleasing)
+    {
+        for (auto &voice : voices_)
+        {
+            if (voice.active && !voice.choked && voice.envelope.stage == EnvelopeStage::Release &&
+                (!victim || voice.envelope.level < victim->envelope.level))
+                victim = &voice;
+        }
+        if (victim)
+            return victim;
+    }
+
+    if (policy == VoiceStealPolicy::None)
+        return nullptr;
+
+    for (auto &voice : voices_)
+    {
+        if (!voice.active || voice.choked)
+            continue;
+        if (!victim || (policy == VoiceStealPolicy::Quietest ? voice.level < victim->level
+                                                              : voice.startTime < victim->startTime))
+            victim = &voice;
+    }
+    return victim;
+}
+
+Voice *SynthEngine::allocateVoice()
+{
+    int limit = maxVoices_.load(std::memory_order_relaxed);
+    int sounding = 0;
+    Voice *spare = nullptr;
+    for (auto &voice : voices_)
+    {
+        if (!voice.active)
+            spare = spare ? spare : &voice;
+        else if (!voice.choked)
+            sounding++;
+    }
+
+    // At the limit one voice gives way; it fades out on its slot while the new note takes a spare one
+    if (sounding >= limit)
+    {
+        Voice *victim = chooseVictim(VoiceStealPolicy::None, true);
+        if (!victim)
+        {
+            VoiceStealPolicy policy = (VoiceStealPolicy)stealPolicy_.load(std::memory_order_relaxed);
+            if (!(victim = chooseVictim(policy, false)))
+                return nullptr;
+            voicesStolen_.fetch_add(1, std::memory_order_relaxed);
+        }
+        chokeVoice(*victim);
+    }
+    if (spare)
+        return spare;
+
+    // Every slot is taken, mostly by fades: the quietest of them is cut short
+    Voice *quietest = nullptr;
+    for (auto &voice : voices_)
+    {
+        if (voice.active && voice.choked && (!quietest || voice.envelope.level < quietest->envelope.level))
+            quietest = &voice;
+    }
+    return quietest;
+}
+
+void SynthEngine::chokeOverLimit(int limit)
+{
+    // A lowered limit fades out the voices above it, the way the steal policy would pick them
+    int sounding = 0;
+    for (const auto &voice : voices_)
+        sounding += voice.active && !voice.choked ? 1 : 0;
+
+    VoiceStealPolicy policy = (VoiceStealPolicy)stealPolicy_.load(std::memory_order_relaxed);
+    if (policy == VoiceStealPolicy::None)
+        policy = VoiceStealPolicy::Quietest;
+    for (; sounding > limit; sounding--)
+        chokeVoice(*chooseVictim(policy, true));
+}
+
+void SynthEngine::startEvent(const NoteEvent &event, uint64_t now)
+{
+    if (event.tag != 0 && startedTagCount_ < MAX_STARTED_TAGS)
+        startedTags_[startedTagCount_++] = {event.tag, now};
+
+    bool ownsString = event.stringIndex >= 0 && event.stringIndex < stringCount_;
+    if (event.type == NoteEventType::NoteOff)
+    {
+        if (ownsString)
+            releaseString(event.stringIndex);
+        return;
+    }
+
+    // Notes reach here unchecked from the C API: one that is not a number is dropped, the rest are
+    // held between MIN_FREQUENCY and Nyquist, so a string never plucks at an infinite frequency
+    if (!std::isfinite(event.note))
+        return;
+    float lowestNote = frequencyToNote((float)MIN_FREQUENCY);
+    float highestNote = frequencyToNote(0.5f * sampleRate_);
+    float frequency = noteToFrequency(std::max(lowestNote, std::min(highestNote, event.note)));
+
+    // A live tone has nothing to play above Nyquist
+    uint32_t phaseIncrement = 0;
+    const float *toneTable = nullptr;
+    bool stream = event.zone && streamer_;
+    bool tone = event.tone && !event.samples && !stream;
+    if (tone && !(toneTable = ToneKernel::streamTable(frequency, sampleRate_, phaseIncrement)))
+        return;
+
+    if (ownsString)
+    {
+        chokeString(event.stringIndex);
+    }
+
+    Voice *voice = allocateVoice();
+    if (!voice)
+    {
+        voicesDropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // A stolen stream hands its disk slot back first
+    if (voice->active && voice->kind == VoiceKind::Stream)
+        endStream(*voice);
+
+    voice->active = true;
+    voice->choked = false;
+    voice->stringIndex = ownsString ? event.stringIndex : -1;
+    voice->startTime = now;
+    voice->level = event.velocity;
+    panGains(ownsString ? getStringPan(event.stringIndex) : 0.0f, voice->panLeft, voice->panRight);
+
+    if (stream)
+    {
+        // Zones no longer than their head never need the disk
+        const SampleZone &zone = *event.zone;
+        voice->kind = VoiceKind::Stream;
+        voice->stream.zone = event.zone;
+        voice->stream.position = 0;
+        voice->stream.gain = event.velocity;
+        voice->stream.varispeed = false;
+        voice->stream.fraction = 0.0f;
+        voice->stream.slot = zone.frames > (uint64_t)zone.headFrames ? streamer_->start(event.zone) : -1;
+    }
+    else if (event.samples)
+    {
+        voice->kind = VoiceKind::Sample;
+        voice->sample.samples = event.samples;
+        voice->sample.frames = event.sampleFrames;
+        voice->sample.channels = event.sampleChannels;
+        voice->sample.position = 0;
+        voice->sample.fraction = 0.0f;
+        voice->sample.gain = event.velocity / 32768.0f;
+    }
+    else if (tone)
+    {
+        voice->kind = VoiceKind::Tone;
+        voice->tone = {toneTable, 0, phaseIncrement, event.velocity * TONE_VOLUME};
+    }
+    else
+    {
+        voice->kind = VoiceKind::String;
+        pluck(voice->string, frequency, event.velocity);
+    }
+
+    // A live tone never ends by itself, and one on no string never gets a note-off: it fades to
+    // silence over its decay and release instead of holding
+    EnvelopeSettings envelope = envelopes_[(int)voice->kind];
+    if (voice->kind == VoiceKind::Tone && voice->stringIndex < 0)
+    {
+        envelope.decay += envelope.release;
+        envelope.sustain = 0.0f;
+    }
+    startEnvelope(voice->envelope, envelope);
+
+    // Synthesized voices start on the exact pitch; recorded ones may sit between the pitches they were made at
+    startPitch(*voice, voice->kind == VoiceKind::Sample || voice->kind == VoiceKind::Stream ? event.detune : 0.0f);
+}
+
+void SynthEngine::startPitch(Voice &voice, float detune)
+{
+    // A note starts where its string's bend and the whammy already are instead of gliding there
+    PitchModulation &pitch = voice.pitch;
+    int s = voice.stringIndex;
+    bool owned = s >= 0 && s < MAX_PANNED_STRINGS;
+    pitch.detune = detune;
+    pitch.bendTarget = owned ? stringBend_[s].load(std::memory_order_relaxed) : 0.0f;
+    pitch.bend = pitch.bendTarget + whammy_.load(std::memory_order_relaxed);
+    pitch.vibratoTarget = owned ? vibratoDepth_[s].load(std::memory_order_relaxed) : 0.0f;
+    pitch.vibratoDepth = pitch.vibratoTarget;
+    pitch.vibratoRate = owned ? vibratoRate_[s].load(std::memory_order_relaxed) : DEFAULT_VIBRATO_RATE;
+    pitch.vibratoPhase = 0.0f;
+
+    float cents = detune + pitch.bend;
+    pitch.ratio = cents == 0.0f ? 1.0f : std::exp2(std::max(MIN_PITCH_CENTS, std::min(MAX_PITCH_CENTS, cents)) / 1200.0f);
+    pitch.nextRatio = pitch.ratio;
+    pitch.ratioStep = 0.0f;
+    pitch.active = pitch.ratio != 1.0f;
+}
+
+void SynthEngine::updatePitch(Voice &voice, int frames, float glide, float whammy)
+{
+    PitchModulation &pitch = voice.pitch;
+    int s = voice.stringIndex;
+    if (s >= 0 && s < MAX_PANNED_STRINGS)
+    {
+        pitch.bendTarget = stringBend_[s].load(std::memory_order_relaxed);
+        pitch.vibratoTarget = vibratoDepth_[s].load(std::memory_order_relaxed);
+        pitch.vibratoRate = vibratoRate_[s].load(std::memory_order_relaxed);
+    }
+
+    // One-pole glide per block; arriving within a hundredth of a cent snaps, so a voice comes back to rest
+    float bend = pitch.bendTarget + whammy;
+    pitch.bend += (bend - pitch.bend) * glide;
+    if (std::fabs(bend - pitch.bend) < 0.01f)
+        pitch.bend = bend;
+    pitch.vibratoDepth += (pitch.vibratoTarget - pitch.vibratoDepth) * glide;
+    if (std::fabs(pitch.vibratoTarget - pitch.vibratoDepth) < 0.01f)
+        pitch.vibratoDepth = pitch.vibratoTarget;
+
+    // The LFO is sampled once per block; the ratio ramp between blocks smooths it
+    float cents = pitch.detune + pitch.bend;
+    if (pitch.vibratoDepth > 0.0f)
+    {
+        pitch.vibratoPhase += pitch.vibratoRate * frames / sampleRate_;
+        pitch.vibratoPhase -= std::floor(pitch.vibratoPhase);
+        cents += pitch.vibratoDepth * std::sin(2.0f * (float)M_PI * pitch.vibratoPhase);
+    }
+    else
+    {
+        pitch.vibratoPhase = 0.0f;
+    }
+
+    // The last block ended exactly on its target, whatever rounding the renderers' ramps picked up
+    pitch.ratio = pitch.nextRatio;
+    pitch.nextRatio =
+        cents == 0.0f ? 1.0f : std::exp2(std::max(MIN_PITCH_CENTS, std::min(MAX_PITCH_CENTS, cents)) / 1200.0f);
+    pitch.ratioStep = (pitch.nextRatio - pitch.ratio) / frames;
+    pitch.active = pitch.ratio != 1.0f || pitch.nextRatio != 1.0f;
+}
+
+void SynthEngine::pluck(StringVoice &voice, float frequency, float velocity)
+{
+    // Above sampleRate / 2.6 the loop is shorter than the two-sample line and the allpass turns unstable
+    frequency = std::max((float)MIN_FREQUENCY, std::min(frequency, sampleRate_ / 2.6f));
+
+    // Loop delay = delay line + half a sample from the averaging filter + allpass
+    float period = (float)sampleRate_ / frequency - 0.5f;
+    int length = (int)std::floor(period - 0.1f);
+    length = std::max(2, std::min(length, (int)voice.delayLine.size()));
+    float fraction = period - length;
+
+    voice.length = length;
+    voice.position = length % (int)voice.delayLine.size();
+    voice.period = period;
+    voice.delay = (float)length;
+    voice.allpassCoeff = (1.0f - fraction) / (1.0f + fraction);
+    voice.allpassIn = 0.0f;
+    voice.allpassOut = 0.0f;
+    voice.lastSample = 0.0f;
+    voice.quietSamples = 0;
+
+    // Lower strings ring longer, like a real guitar
+    float t60 = 1.5f + 3.0f * std::sqrt(82.41f / frequency);
+    voice.decay = std::pow(0.001f, 1.0f / (frequency * t60));
+
+    // Excite the string with a slightly low-passed noise burst, DC removed
+    float previous = 0.0f;
+    float mean = 0.0f;
+    for (int i = 0; i < length; i++)
+    {
+        float noise = nextNoise();
+        previous = previous + 0.6f * (noise - previous);
+        voice.delayLine[i] = previous;
+        mean += previous;
+    }
+    mean /= length;
+    for (int i = 0; i < length; i++)
+    {
+        voice.delayLine[i] = (voice.delayLine[i] - mean) * velocity;
+    }
+}
+
+void SynthEngine::renderString(Voice &voice, float *left, float *right, int frames)
+{
+    StringVoice &string = voice.string;
+    float *delayLine = string.delayLine.data();
+    const int size = (int)string.delayLine.size();
+    const bool ramp = fillEnvelope(voice.envelope, envelopeGain_, frames);
+    const float level = voice.envelope.level;
+    float peak = 0.0f;
+
+    // A bent string reads between samples. The read delay follows the period while the allpass keeps
+    // adding the plucked pitch's fraction; it never moves as fast as the write index, so it can't
+    // overtake it into samples from before the pluck.
+    const bool bent = voice.pitch.active || string.delay != (float)string.length;
+    float delay = string.delay;
+    float delayStep = 0.0f;
+    float target = delay;
+    if (bent)
+    {
+        voice.pitch.ratio += voice.pitch.ratioStep * frames;
+        target = string.length + (string.period + 0.5f) * (1.0f / voice.pitch.ratio - 1.0f);
+        target = std::max(2.0f, std::min(target, size - 2.0f));
+        delayStep = std::max(-0.5f, std::min((target - delay) / frames, 0.5f));
+    }
+    int read = string.position - string.length;
+    if (read < 0)
+        read += size;
+
+    for (int i = 0; i < frames; i++)
+    {
+        float out;
+        if (bent)
+        {
+            float at = (float)string.position - delay;
+            if (at < 0.0f)
+                at += size;
+            int index = (int)at;
+            int next = index + 1 < size ? index + 1 : 0;
+            out = delayLine[index] + (delayLine[next] - delayLine[index]) * (at - index);
+            delay += delayStep;
+        }
+        else
+        {
+            out = delayLine[read];
+            if (++read >= size)
+                read = 0;
+        }
+
+        // Averaging low-pass gives the characteristic string damping
+        float filtered = string.decay * 0.5f * (out + string.lastSample);
+        string.lastSample = out;
+
+        // First-order allpass fine-tunes the loop to a fractional period
+        float tuned = string.allpassCoeff * (filtered - string.allpassOut) + string.allpassIn;
+        string.allpassIn = filtered;
+        string.allpassOut = tuned;
+
+        delayLine[string.position] = tuned;
+        if (++string.position >= size)
+        {
+            string.position = 0;
+        }
+
+        float panned = out * (ramp ? envelopeGain_[i] : level);
+        left[i] += panned * voice.panLeft;
+        right[i] += panned * voice.panRight;
+        peak = std::max(peak, std::fabs(out));
+    }
+
+    voice.level = peak;
+    string.delay = std::fabs(delay - target) < 1e-3f ? target : delay;
+
+    // Free the voice once it has decayed below audibility or its envelope has finished
+    string.quietSamples = (peak < 1e-4f) ? string.quietSamples + frames : 0;
+    if (voice.envelope.stage == EnvelopeStage::Done || string.quietSamples > sampleRate_ / 20)
+    {
+        voice.active = false;
+    }
+}
+
+void SynthEngine::renderSample(Voice &voice, float *output, int frames)
+{
+    SampleVoice &sample = voice.sample;
+    if (voice.pitch.active || sample.fraction != 0.0f)
+    {
+        renderSampleVarispeed(voice, output, frames);
+        return;
+    }
+
+    float peak = 0.0f;
+    int count = std::min(frames, sample.frames - sample.position);
+    const bool ramp = fillEnvelope(voice.envelope, envelopeGain_, count);
+
+    // A flat envelope folds into the pan gains
+    const float level = ramp ? 1.0f : voice.envelope.level;
+    const float leftGain = sample.gain * voice.panLeft * level;
+    const float rightGain = sample.gain * voice.panRight * level;
+
+    if (sample.channels == 1)
+    {
+        // Note-bank tones are mono; the pan turns them into stereo here
+        const int16_t *source = sample.samples + sample.position;
+        if (ramp)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                float value = source[i] * envelopeGain_[i];
+                output[i * 2] += value * leftGain;
+                output[i * 2 + 1] += value * rightGain;
+                peak = std::max(peak, std::fabs((float)source[i]));
+            }
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                float value = source[i];
+                output[i * 2] += value * leftGain;
+                output[i * 2 + 1] += value * rightGain;
+                peak = std::max(peak, std::fabs(value));
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const int16_t *frame = sample.samples + (sample.position + i) * sample.channels;
+            float gain = ramp ? envelopeGain_[i] : 1.0f;
+            output[i * 2] += frame[0] * leftGain * gain;
+            output[i * 2 + 1] += frame[1] * rightGain * gain;
+            peak = std::max(peak, std::fabs((float)frame[0]));
+        }
+    }
+
+    sample.position += count;
+    voice.level = peak * sample.gain;
+
+    if (voice.envelope.stage == EnvelopeStage::Done || sample.position >= sample.frames)
+    {
+        voice.active = false;
+    }
+}
+
+void SynthEngine::renderSampleVarispeed(Voice &voice, float *output, int frames)
+{
+    // Linear interpolation between frames, stepping by the pitch ratio; mono frames read their one channel twice
+    SampleVoice &sample = voice.sample;
+    PitchModulation &pitch = voice.pitch;
+    const int channels = sample.channels;
+    const int last = sample.frames - 1;
+    const bool ramp = fillEnvelope(voice.envelope, envelopeGain_, frames);
+    const float level = ramp ? 1.0f : voice.envelope.level;
+    const float leftGain = sample.gain * voice.panLeft * level;
+    const float rightGain = sample.gain * voice.panRight * level;
+
+    float ratio = pitch.ratio;
+    float fraction = sample.fraction;
+    int position = sample.position;
+    float peak = 0.0f;
+    for (int i = 0; i < frames && position < last; i++)
+    {
+        const int16_t *frame = sample.samples + position * channels;
+        float left = frame[0] + (frame[channels] - frame[0]) * fraction;
+        float right = frame[channels - 1] + (frame[channels * 2 - 1] - frame[channels - 1]) * fraction;
+        float gain = ramp ? envelopeGain_[i] : 1.0f;
+        output[i * 2] += left * leftGain * gain;
+        output[i * 2 + 1] += right * rightGain * gain;
+        peak = std::max(peak, std::fabs(left));
+
+        fraction += ratio;
+        ratio += pitch.ratioStep;
+        int whole = (int)fraction;
+        position += whole;
+        fraction -= whole;
+    }
+
+    pitch.ratio += pitch.ratioStep * frames;
+    sample.position = position;
+    sample.fraction = fraction;
+    voice.level = peak * sample.gain;
+
+    if (voice.envelope.stage == EnvelopeStage::Done || position >= last)
+    {
+        voice.active = false;
+    }
+}
+
+int SynthEngine::readStream(Voice &voice, float *output, int count, bool &ended)
+{
+    StreamVoice &stream = voice.stream;
+    const SampleZone &zone = *stream.zone;
+    const int channels = zone.channels;
+    count = (int)std::min<uint64_t>(count, zone.frames - stream.position);
+
+    // The head comes straight from memory, the rest from the disk thread's ring
+    int got = 0;
+    if (stream.position < (uint64_t)zone.headFrames)
+    {
+        got = (int)std::min<uint64_t>(count, zone.headFrames - stream.position);
+        std::copy(zone.head.data() + stream.position * channels, zone.head.data() + (stream.position + got) * channels,
+                  output);
+    }
+    ended = got < count && stream.slot < 0;
+    if (got < count && stream.slot >= 0)
+        got += streamer_->read(stream.slot, output + got * channels, count - got, ended);
+    if (ended)
+        count = got;
+
+    // A late disk read plays as silence; the sample picks up where it was when the data arrives
+    std::fill(output + got * channels, output + count * channels, 0.0f);
+    stream.position += got;
+    return count;
+}
+
+void SynthEngine::renderStream(Voice &voice, float *output, int frames)
+{
+    StreamVoice &stream = voice.stream;
+    const SampleZone &zone = *stream.zone;
+    const int channels = zone.channels;
+    if (voice.pitch.active || stream.varispeed)
+    {
+        renderStreamVarispeed(voice, output, frames);
+        return;
+    }
+
+    bool ended = false;
+    int count = readStream(voice, streamBuffer_, frames, ended);
+
+    const bool ramp = fillEnvelope(voice.envelope, envelopeGain_, count);
+    const float level = ramp ? 1.0f : voice.envelope.level;
+    const float leftGain = stream.gain * voice.panLeft * level;
+    const float rightGain = stream.gain * voice.panRight * level;
+
+    float peak = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        // Mono zones follow the string's pan; stereo ones keep their own image, weighted by it
+        float gain = ramp ? envelopeGain_[i] : 1.0f;
+        float left = streamBuffer_[i * channels];
+        float right = streamBuffer_[i * channels + channels - 1];
+        output[i * 2] += left * leftGain * gain;
+        output[i * 2 + 1] += right * rightGain * gain;
+        peak = std::max(peak, std::fabs(left));
+    }
+    voice.level = peak * stream.gain;
+
+    if (voice.envelope.stage == EnvelopeStage::Done || ended || stream.position >= zone.frames)
+        endStream(voice);
+}
+
+void SynthEngine::renderStreamVarispeed(Voice &voice, float *output, int frames)
+{
+    StreamVoice &stream = voice.stream;
+    PitchModulation &pitch = voice.pitch;
+    const int channels = stream.zone->channels;
+
+    // Frames the block steps over, with the same arithmetic as the loop below; the first block
+    // off pitch also loads the two frames it starts between
+    float ratio = pitch.ratio;
+    float fraction = stream.fraction;
+    int need = stream.varispeed ? 0 : 2;
+    for (int i = 0; i < frames; i++)
+    {
+        fraction += ratio;
+        ratio += pitch.ratioStep;
+        int whole = (int)fraction;
+        need += whole;
+        fraction -= whole;
+    }
+    need = std::min(need, (int)(sizeof(streamBuffer_) / sizeof(float)) / channels);
+
+    // Past the end of the zone the interpolation runs into silence
+    bool ended = false;
+    int got = readStream(voice, streamBuffer_, need, ended);
+    std::fill(streamBuffer_ + got * channels, streamBuffer_ + need * channels, 0.0f);
+    ended = ended || got < need;
+
+    const float *next = streamBuffer_;
+    const float *end = streamBuffer_ + need * channels;
+    if (!stream.varispeed)
+    {
+        for (int f = 0; f < 2; f++, next += channels)
+        {
+            stream.frames[f][0] = next[0];
+            stream.frames[f][1] = next[channels - 1];
+        }
+        stream.varispeed = true;
+    }
+
+    const bool ramp = fillEnvelope(voice.envelope, envelopeGain_, frames);
+    const float level = ramp ? 1.0f : voice.envelope.level;
+    const float leftGain = stream.gain * voice.panLeft * level;
+    const float rightGain = stream.gain * voice.panRight * level;
+
+    float(&at)[2][2] = stream.frames;
+    ratio = pitch.ratio;
+    fraction = stream.fraction;
+    float peak = 0.0f;
+    for (int i = 0; i < frames; i++)
+    {
+        float gain = ramp ? envelopeGain_[i] : 1.0f;
+        float left = at[0][0] + (at[1][0] - at[0][0]) * fraction;
+        float right = at[0][1] + (at[1][1] - at[0][1]) * fraction;
+        output[i * 2] += left * leftGain * gain;
+        output[i * 2 + 1] += right * rightGain * gain;
+        peak = std::max(peak, std::fabs(left));
+
+        fraction += ratio;
+        ratio += pitch.ratioStep;
+        int whole = (int)fraction;
+        fraction -= whole;
+        for (; whole > 0 && next < end; whole--, next += channels)
+        {
+            at[0][0] = at[1][0];
+            at[0][1] = at[1][1];
+            at[1][0] = next[0];
+            at[1][1] = next[channels - 1];
+        }
+    }
+    pitch.ratio = ratio;
+    stream.fraction = fraction;
+    voice.level = peak * stream.gain;
+
+    if (voice.envelope.stage == EnvelopeStage::Done || ended)
+        endStream(voice);
+}
+
+void SynthEngine::endStream(Voice &voice)
+{
+    if (voice.stream.slot >= 0)
+        streamer_->stop(voice.stream.slot);
+    voice.stream.slot = -1;
+    voice.active = false;
+}
+
+void SynthEngine::renderTone(Voice &voice, float *output, int frames)
+{
+    ToneVoice &tone = voice.tone;
+    if (voice.pitch.active)
+    {
+        ToneKernel::renderSweep(tone.table, tone.phase, tone.phaseIncrement, voice.pitch.ratio, voice.pitch.ratioStep,
+                                toneBuffer_, frames);
+        voice.pitch.ratio += voice.pitch.ratioStep * frames;
+    }
+    else
+    {
+        ToneKernel::renderStream(tone.table, tone.phase, tone.phaseIncrement, toneBuffer_, frames);
+    }
+    const bool ramp = fillEnvelope(voice.envelope, envelopeGain_, frames);
+    if (ramp)
+    {
+        for (int i = 0; i < frames; i++)
+            toneBuffer_[i] *= envelopeGain_[i];
+    }
+
+    // A flat envelope folds into the pan gains
+    const float level = ramp ? 1.0f : voice.envelope.level;
+    const float leftGain = tone.gain * voice.panLeft * level;
+    const float rightGain = tone.gain * voice.panRight * level;
+    for (int i = 0; i < frames; i++)
+    {
+        output[i * 2] += toneBuffer_[i] * leftGain;
+        output[i * 2 + 1] += toneBuffer_[i] * rightGain;
+    }
+
+    // The oscillator never decays by itself; the envelope alone decides when the voice is free
+    voice.level = voice.envelope.level * tone.gain;
+    if (voice.envelope.stage == EnvelopeStage::Done)
+    {
+        voice.active = false;
+    }
+}
+
+float SynthEngine::nextNoise()
+{
+    // xorshift keeps the audio thread away from rand() and its lock
+    noiseState_ ^= noiseState_ << 13;
+    noiseState_ ^= noiseState_ >> 17;
+    noiseState_ ^= noiseState_ << 5;
+    return (float)(noiseState_ & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+void SynthEngine::render(float *output, int frames)
+{
+    startedTagCount_ = 0;
+
+    // Split large requests so the string bus stays a fixed-size member
+    while (frames > 0)
+    {
+        int count = std::min(frames, MAX_BLOCK_FRAMES);
+        renderBlock(output, count);
+        output += count * 2;
+        frames -= count;
+    }
+}
+
+void SynthEngine::drainQueues()
+{
+    // Merge every port into the pending list, keeping it sorted by timestamp.
+    // When the list is full the rest simply stays queued until the next block.
+    for (auto &queue : events_)
+    {
+        NoteEvent event;
+        while (pendingCount_ < PENDING_CAPACITY && queue.pop(event))
+        {
+            int index = pendingCount_;
+            while (index > 0 && pending_[index - 1].timestamp > event.timestamp)
+            {
+                pending_[index] = pending_[index - 1];
+                index--;
+            }
+            pending_[index] = event;
+            pendingCount_++;
+        }
+    }
+}
+
+void SynthEngine::renderBlock(float *output, int frames)
+{
+    uint64_t now = sampleTime_.load(std::memory_order_relaxed);
+    drainQueues();
+
+    EnvelopeUpdate update;
+    while (envelopeUpdates_.pop(update))
+        envelopes_[(int)update.kind] = update.settings;
+
+    int limit = maxVoices_.load(std::memory_order_relaxed);
+    if (limit < appliedMaxVoices_)
+        chokeOverLimit(limit);
+    appliedMaxVoices_ = limit;
+
+    // Pitch modulation runs at block rate; voices starting inside the block begin on their targets
+    const float glide = 1.0f - std::exp(-frames / (PITCH_GLIDE_SECONDS * sampleRate_));
+    const float whammy = whammy_.load(std::memory_order_relaxed);
+    for (auto &voice : voices_)
+    {
+        if (voice.active)
+            updatePitch(voice, frames, glide, whammy);
+    }
+
+    std::fill(output, output + frames * 2, 0.0f);
+    std::fill(stringBus_[0], stringBus_[0] + frames, 0.0f);
+    std::fill(stringBus_[1], stringBus_[1] + frames, 0.0f);
+
+    // Render up to each event's exact sample offset, start it, then carry on
+    int offset = 0;
+    int started = 0;
+    while (offset < frames)
+    {
+        while (started < pendingCount_ && pending_[started].timestamp <= now + offset)
+        {
+            startEvent(pending_[started], now + offset);
+            started++;
+        }
+
+        int end = frames;
+        if (started < pendingCount_)
+            end = (int)std::min<uint64_t>(frames, pending_[started].timestamp - now);
+
+        // One tick read per voice; each voice's end is the next one's start
+        uint64_t ticks = loadMeter_ ? DspLoadMeter::ticks() : 0;
+        for (auto &voice : voices_)
+        {
+            if (!voice.active)
+                continue;
+
+            const VoiceKind kind = voice.kind;
+            if (kind == VoiceKind::String)
+                renderString(voice, stringBus_[0] + offset, stringBus_[1] + offset, end - offset);
+            else if (kind == VoiceKind::Sample)
+                renderSample(voice, output + offset * 2, end - offset);
+            else if (kind == VoiceKind::Stream)
+                renderStream(voice, output + offset * 2, end - offset);
+            else
+                renderTone(voice, output + offset * 2, end - offset);
+
+            if (loadMeter_)
+            {
+                uint64_t done = DspLoadMeter::ticks();
+                loadMeter_->addVoice(kind, done - ticks, end - offset);
+                ticks = done;
+            }
+        }
+        offset = end;
+    }
+
+    // Events due in a later block stay pending
+    if (started > 0)
+    {
+        std::copy(pending_ + started, pending_ + pendingCount_, pending_);
+        pendingCount_ -= started;
+    }
+
+    int active = 0;
+    for (const auto &voice : voices_)
+    {
+        if (voice.active)
+            active++;
+    }
+    activeVoices_.store(active, std::memory_order_relaxed);
+
+    const float gain = 0.35f;
+    for (int c = 0; c < 2; c++)
+    {
+        const float *bus = stringBus_[c];
+        float in = dcIn_[c];
+        float out = dcOut_[c];
+        for (int i = 0; i < frames; i++)
+        {
+            // Remove any DC offset that builds up in the string loops
+            float blocked = bus[i] - in + 0.995f * out;
+            in = bus[i];
+            out = blocked;
+            output[i * 2 + c] += blocked * gain;
+        }
+        dcIn_[c] = in;
+        dcOut_[c] = out;
+    }
+
+    sampleTime_.store(now + frames, std::memory_order_relaxed);
+}
+
+float SynthEngine::frequencyToNote(float frequency)
+{
+    return 12.0f * std::log2(frequency / 440.0f) + 69.0f;
+}
+
+float SynthEngine::noteToFrequency(float note)
+{
+    return 440.0f * std::pow(2.0f, (note - 69.0f) / 12.0f);
+}
@@ -0,0 +1,331 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "NoteEventQueue.h"
+
+class DiskStreamer;
+class DspLoadMeter;
+
+// Karplus-Strong plucked string state
+struct StringVoice
+{
+    std::vector<float> delayLine; // sized once for the lowest playable pitch
+    int length;                   // integer part of the loop delay in samples
+    int position;                 // write index; the loop reads `length` samples behind it
+    float period;                 // loop delay of the plucked pitch, for bends
+    float delay;                  // read delay while bent, equal to length at rest
+    float decay;           // loop gain per period
+    float allpassCoeff;    // fractional delay tuning
+    float allpassIn;
+    float allpassOut;
+    float lastSample;
+    int quietSamples;
+};
+
+// Pre-rendered note-bank buffer playback state; mono buffers are panned at mix
+struct SampleVoice
+{
+    const int16_t *samples;
+    int frames;
+    int channels;
+    int position;
+    float fraction; // between position and the next frame while played off pitch
+    float gain;
+};
+
+// Harmonic tone oscillator, synthesized while the note plays; it only holds a phase
+struct ToneVoice
+{
+    const float *table; // band-limited wavetable for the pitch
+    uint32_t phase;
+    uint32_t phaseIncrement;
+    float gain;
+};
+
+// Multisample zone playback: the resident head first, then the disk thread's ring
+struct StreamVoice
+{
+    const SampleZone *zone;
+    int slot;          // DiskStreamer slot, -1 when the head is all there is to play
+    uint64_t position; // frames read from the zone
+    float gain;
+
+    // Off pitch the voice reads through two frames it interpolates between, once it has started to
+    bool varispeed;
+    float fraction;
+    float frames[2][2];
+};
+
+// Control-rate pitch offset of a voice in cents. Targets are read once per block and glide there;
+// inside the block the frequency ratio moves in a straight line, so there are no steps to hear.
+struct PitchModulation
+{
+    float detune;        // fixed at note-on: buffers played off their own pitch
+    float bend;          // string bend plus whammy, smoothed
+    float bendTarget;    // the string's bend, kept once the voice is cut from it
+    float vibratoDepth;  // smoothed
+    float vibratoTarget;
+    float vibratoRate;   // Hz
+    float vibratoPhase;  // cycles
+    float ratio;         // frequency ratio at the next sample to render
+    float ratioStep;     // per-sample change over the current block
+    float nextRatio;     // ratio the block ends on
+    bool active;         // false at rest; the voice then renders on its plain path
+};
+
+enum class VoiceKind
+{
+    String,
+    Sample,
+    Tone,
+    Stream,
+    COUNT
+};
+
+// Per-kind envelope shape. Times are in seconds; sustain is the level held until note-off.
+struct EnvelopeSettings
+{
+    float attack = 0.0f;
+    float decay = 0.0f;
+    float sustain = 1.0f;
+    float release = 0.3f;
+};
+
+enum class EnvelopeStage : uint8_t
+{
+    Attack,
+    Decay,
+    Sustain,
+    Release,
+    Done
+};
+
+// Linear ADSR evaluated per sample while the voice plays
+struct Envelope
+{
+    EnvelopeStage stage;
+    float level;
+    float step;    // per-sample change in the current stage
+    int remaining; // samples left in the current stage (not used while sustaining)
+    float sustain;
+    int decaySamples;
+};
+
+// When the pool is full, which voice gives way to a new note
+enum class VoiceStealPolicy
+{
+    Quietest,
+    Oldest,
+    None // drop the new note instead
+};
+
+// One slot of the engine's fixed voice pool
+struct Voice
+{
+    VoiceKind kind;
+    bool active;
+    bool choked;        // fading out after a steal or re-pluck; no longer counts against maxVoices_
+    int stringIndex;    // string that owns this voice, -1 once it has been cut
+    uint64_t startTime; // engine sample time of the note-on
+    float level;        // peak follower used to find the quietest voice
+    Envelope envelope;  // gain of the voice; releases on note-off and on a quick fade when re-plucked
+    float panLeft;      // pan gains of the owning string, fixed at note-on
+    float panRight;
+    PitchModulation pitch;
+
+    StringVoice string;
+    SampleVoice sample;
+    ToneVoice tone;
+    StreamVoice stream;
+};
+
+// A tagged note that started during the last render call
+struct StartedTag
+{
+    uint32_t tag;
+    uint64_t sampleTime; // engine sample time of the note's first sample
+};
+
+class SynthEngine
+{
+public:
+    // Event ports: each producer thread gets its own wait-free queue
+    static constexpr int MAX_PORTS = 4;
+    static constexpr int LIVE_PORT = 0;      // mouse / keyboard input
+    static constexpr int SEQUENCER_PORT = 1; // MIDI file playback
+    static constexpr int NETWORK_PORT = 2;   // jam partner's notes
+
+private:
+    static constexpr size_t EVENT_QUEUE_SIZE = 256;
+    static constexpr int MAX_BLOCK_FRAMES = 256;
+    static constexpr int PENDING_CAPACITY = 512;
+    static constexpr int MAX_PANNED_STRINGS = 12;
+    static constexpr int MAX_STARTED_TAGS = 16;
+    static constexpr int VOICE_KINDS = (int)VoiceKind::COUNT;
+    static constexpr int MAX_PITCH_RATIO = 2; // an octave up; streamed zones read this much faster at most
+
+    struct EnvelopeUpdate
+    {
+        VoiceKind kind;
+        EnvelopeSettings settings;
+    };
+
+    int sampleRate_;
+    int stringCount_;
+
+    // All voices are allocated up front; maxVoices_ limits how many may sound at once
+    std::vector<Voice> voices_;
+    std::atomic<int> maxVoices_;
+    std::atomic<int> stealPolicy_;
+    int appliedMaxVoices_; // audio thread: the limit voices were last choked down to
+
+    // One queue per producer thread, drained by the audio thread at the start of each block
+    SpscQueue<NoteEvent, EVENT_QUEUE_SIZE> events_[MAX_PORTS];
+
+    // Drained events waiting for their sample time, sorted by timestamp
+    NoteEvent pending_[PENDING_CAPACITY];
+    int pendingCount_;
+    StartedTag startedTags_[MAX_STARTED_TAGS];
+    int startedTagCount_;
+    std::atomic<uint64_t> sampleTime_;
+    std::atomic<uint32_t> droppedEvents_;
+    std::atomic<uint32_t> voicesStolen_;
+    std::atomic<uint32_t> voicesDropped_;
+    std::atomic<int> activeVoices_;
+
+    // Envelope shape per voice kind; the producer's copy and the audio thread's, joined by a queue
+    SpscQueue<EnvelopeUpdate, 16> envelopeUpdates_;
+    EnvelopeSettings requestedEnvelopes_[VOICE_KINDS];
+    bool envelopePending_[VOICE_KINDS]; // producer: requested but not yet queued
+    EnvelopeSettings envelopes_[VOICE_KINDS];
+
+    // Per-string pan position, -1 (left) to 1 (right); read when a note starts
+    std::atomic<float> stringPan_[MAX_PANNED_STRINGS];
+
+    // Pitch modulation targets in cents, read once per block; the last value written wins
+    std::atomic<float> stringBend_[MAX_PANNED_STRINGS];
+    std::atomic<float> vibratoDepth_[MAX_PANNED_STRINGS];
+    std::atomic<float> vibratoRate_[MAX_PANNED_STRINGS];
+    std::atomic<float> whammy_;
+
+    // Strings are summed here so the DC blockers run once per block
+    float stringBus_[2][MAX_BLOCK_FRAMES];
+    float dcIn_[2];
+    float dcOut_[2];
+
+    // Per-voice scratch: envelope gains, the raw tone oscillator and streamed frames
+    float envelopeGain_[MAX_BLOCK_FRAMES];
+    float toneBuffer_[MAX_BLOCK_FRAMES];
+    float streamBuffer_[(MAX_BLOCK_FRAMES * MAX_PITCH_RATIO + 4) * 2];
+
+    DiskStreamer *streamer_;
+    DspLoadMeter *loadMeter_;
+
+    unsigned int noiseState_;
+
+    void drainQueues();
+    void startEvent(const NoteEvent &event, uint64_t now);
+    Voice *allocateVoice();
+    Voice *chooseVictim(VoiceStealPolicy policy, bool preferReleasing);
+    void chokeVoice(Voice &voice);
+    void chokeOverLimit(int limit);
+    void chokeString(int stringIndex);
+    void releaseString(int stringIndex);
+    void renderBlock(float *output, int frames);
+    void startPitch(Voice &voice, float detune);
+    void updatePitch(Voice &voice, int frames, float glide, float whammy);
+    void renderString(Voice &voice, float *left, float *right, int frames);
+    void renderSample(Voice &voice, float *output, int frames);
+    void renderSampleVarispeed(Voice &voice, float *output, int frames);
+    void renderTone(Voice &voice, float *output, int frames);
+    void renderStream(Voice &voice, float *output, int frames);
+    void renderStreamVarispeed(Voice &voice, float *output, int frames);
+    int readStream(Voice &voice, float *output, int count, bool &ended);
+    void endStream(Voice &voice);
+    void startEnvelope(Envelope &envelope, const EnvelopeSettings &settings) const;
+    void releaseEnvelope(Envelope &envelope, float seconds) const;
+    static void advanceEnvelope(Envelope &envelope);
+    // Writes per-sample gains and returns true, or returns false when the level is flat for the block
+    static bool fillEnvelope(Envelope &envelope, float *gains, int frames);
+    void pluck(StringVoice &voice, float frequency, float velocity);
+    float nextNoise();
+
+public:
+    static constexpr int MIN_FREQUENCY = 40;      // lowest pitch the delay lines can hold
+    static constexpr int DEFAULT_MAX_VOICES = 16; // matches the old 16 mixer channels
+    static constexpr int VOICE_CAPACITY = 64;     // hard upper limit for setMaxVoices
+    static constexpr float TONE_VOLUME = 0.5f;    // live tones play at the note bank's level
+    static constexpr float CHOKE_SECONDS = 0.005f;
+    static constexpr float PITCH_GLIDE_SECONDS = 0.015f; // time constant of bend, vibrato and whammy changes
+    static constexpr float MIN_PITCH_CENTS = -2400.0f;   // range of everything added together
+    static constexpr float MAX_PITCH_CENTS = 1200.0f;
+    static constexpr float MIN_PITCH_RATIO = 0.25f;      // exp2(MIN_PITCH_CENTS / 1200): slowest read of any sample
+    static constexpr float DEFAULT_VIBRATO_RATE = 5.5f;
+
+    SynthEngine(int sampleRate, int stringCount, int maxVoices = DEFAULT_MAX_VOICES);
+
+    // Producer side, wait-free. Only one thread may queue events on each port.
+    // Events are started at their timestamp, sample-accurately inside a block.
+    bool queueEvent(const NoteEvent &event, int port = LIVE_PORT);
+    // True when the port's queue can take another event; a producer can wait on this instead of dropping
+    bool hasQueueSpace(int port) const { return events_[port].size() < EVENT_QUEUE_SIZE; }
+    bool noteOn(int stringIndex, float frequency, float velocity = 1.0f);
+
+    // Render interleaved stereo float samples (called from the audio thread)
+    void render(float *output, int frames);
+
+    // Pool configuration, safe to change while rendering. Voices given up to the limit, stolen or
+    // over a lowered one, fade out in CHOKE_SECONDS on spare slots instead of stopping dead.
+    void setMaxVoices(int maxVoices);
+    void setStealPolicy(VoiceStealPolicy policy) { stealPolicy_.store((int)policy); }
+    int getMaxVoices() const { return maxVoices_.load(); }
+    VoiceStealPolicy getStealPolicy() const { return (VoiceStealPolicy)stealPolicy_.load(); }
+
+    // Stereo placement of each string. Defaults spread the strings slightly from
+    // low E on the left to high E on the right; changes apply from the next note.
+    void setStringPan(int stringIndex, float pan);
+    float getStringPan(int stringIndex) const;
+
+    // Continuous pitch modulation in cents, applied to voices already playing. Wait-free and safe
+    // from any thread; the audio thread glides to the latest values, at no per-sample cost to the caller.
+    // Bend and vibrato follow whatever the string plays; the whammy moves every voice. Bend and
+    // whammy are clamped to MIN_PITCH_CENTS..MAX_PITCH_CENTS, anything not finite to 0.
+    void setBend(int stringIndex, float cents);
+    void setVibrato(int stringIndex, float depthCents, float rateHz = DEFAULT_VIBRATO_RATE);
+    void setWhammy(float cents);
+    float getBend(int stringIndex) const;
+    float getWhammy() const { return whammy_.load(std::memory_order_relaxed); }
+
+    // Envelope for every new voice of a kind. Producer side, wait-free; one thread only. A change
+    // that finds the queue full goes out with the next call. Tones on no string never hold.
+    void setEnvelope(VoiceKind kind, const EnvelopeSettings &settings);
+    const EnvelopeSettings &getEnvelope(VoiceKind kind) const { return requestedEnvelopes_[(int)kind]; }
+
+    // Disk reader for multisample zones. Set it before queueing any zone note and keep it alive
+    // while rendering; without one, zone notes play the synthesized string.
+    void setDiskStreamer(DiskStreamer *streamer) { streamer_ = streamer; }
+
+    // Per-voice CPU accounting; set before rendering starts, null turns it off
+    void setLoadMeter(DspLoadMeter *meter) { loadMeter_ = meter; }
+
+    // Seed for the pluck excitation noise; engines rendered side by side should differ
+    void setNoiseSeed(unsigned int seed) { noiseState_ = seed ? seed : 22222; }
+
+    int getSampleRate() const { return sampleRate_; }
+    int getStringCount() const { return stringCount_; }
+    uint64_t getSampleTime() const { return sampleTime_.load(std::memory_order_relaxed); }
+
+    // Counters for sizing the pool
+    uint32_t getDroppedEvents() const { return droppedEvents_.load(std::memory_order_relaxed); }
+    uint32_t getVoicesStolen() const { return voicesStolen_.load(std::memory_order_relaxed); }
+    uint32_t getVoicesDropped() const { return voicesDropped_.load(std::memory_order_relaxed); }
+    int getActiveVoices() const { return activeVoices_.load(std::memory_order_relaxed); }
+
+    // Audio thread, after render(): tagged notes that started in it
+    int getStartedTagCount() const { return startedTagCount_; }
+    const StartedTag &getStartedTag(int index) const { return startedTags_[index]; }
+
+    static float frequencyToNote(float frequency);
+    static float noteToFrequency(float note);
+};
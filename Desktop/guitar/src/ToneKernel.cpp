@@ -0,0 +1,341 @@
+#include "ToneKernel.h"
+#include "CpuFeatures.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const float ToneKernel::HARMONIC_WEIGHTS[ToneKernel::HARMONIC_COUNT] = {0.6f, 0.2f, 0.1f, 0.05f};
+const float ToneKernel::FADE_START = 0.7f;
+
+// 32-bit phase accumulator: the top bits index the table, the rest interpolate
+static const int TABLE_BITS = 12;
+static const int TABLE_SIZE = 1 << TABLE_BITS;
+static const int FRACTION_BITS = 32 - TABLE_BITS;
+static const uint32_t FRACTION_MASK = (1u << FRACTION_BITS) - 1;
+static const float FRACTION_SCALE = 1.0f / (float)(1u << FRACTION_BITS);
+
+struct Wavetables
+{
+    // tables[n] holds harmonics 1..n+1, so notes near Nyquist drop the overtones that would alias
+    float tables[ToneKernel::HARMONIC_COUNT][TABLE_SIZE + 1];
+
+    Wavetables()
+    {
+        for (int limit = 0; limit < ToneKernel::HARMONIC_COUNT; limit++)
+        {
+            for (int i = 0; i <= TABLE_SIZE; i++)
+            {
+                double phase = 2.0 * M_PI * i / TABLE_SIZE;
+                double value = 0.0;
+                for (int h = 0; h <= limit; h++)
+                {
+                    value += std::sin(phase * (h + 1)) * ToneKernel::HARMONIC_WEIGHTS[h];
+                }
+                tables[limit][i] = (float)value;
+            }
+        }
+    }
+};
+
+static const Wavetables &wavetables()
+{
+    static Wavetables instance;
+    return instance;
+}
+
+struct ToneSetup
+{
+    const float *table;
+    uint32_t phaseIncrement;
+    float volume;
+    float duration;
+    float fadeScale;
+    float rate;
+};
+
+static bool prepareTone(ToneSetup &setup, float frequency, float duration, float volume, int sampleRate)
+{
+    int harmonics = 0;
+    while (harmonics < ToneKernel::HARMONIC_COUNT && frequency * (harmonics + 1) < sampleRate * 0.5f)
+    {
+        harmonics++;
+    }
+    if (harmonics == 0)
+    {
+        return false;
+    }
+
+    setup.table = wavetables().tables[harmonics - 1];
+    setup.phaseIncrement = (uint32_t)std::llround((double)frequency / sampleRate * 4294967296.0);
+    setup.volume = volume;
+    setup.duration = duration;
+    setup.fadeScale = 1.0f / (duration * (1.0f - ToneKernel::FADE_START));
+    setup.rate = (float)sampleRate;
+    return true;
+}
+
+const float *ToneKernel::streamTable(float frequency, int sampleRate, uint32_t &phaseIncrement)
+{
+    ToneSetup setup;
+    if (!prepareTone(setup, frequency, 1.0f, 1.0f, sampleRate))
+        return nullptr;
+    phaseIncrement = setup.phaseIncrement;
+    return setup.table;
+}
+
+void ToneKernel::renderStream(const float *table, uint32_t &phase, uint32_t phaseIncrement, float *output,
+                              int frames)
+{
+    uint32_t p = phase;
+    for (int i = 0; i < frames; i++)
+    {
+        uint32_t index = p >> FRACTION_BITS;
+        float fraction = (float)(p & FRACTION_MASK) * FRACTION_SCALE;
+        float a = table[index];
+        output[i] = a + (table[index + 1] - a) * fraction;
+        p += phaseIncrement;
+    }
+    phase = p;
+}
+
+void ToneKernel::renderSweep(const float *table, uint32_t &phase, uint32_t phaseIncrement, float ratio, float ratioStep,
+                             float *output, int frames)
+{
+    // Bent past Nyquist the table would alias; the increment stops there
+    const float increment = (float)phaseIncrement;
+    uint32_t p = phase;
+    for (int i = 0; i < frames; i++)
+    {
+        uint32_t index = p >> FRACTION_BITS;
+        float fraction = (float)(p & FRACTION_MASK) * FRACTION_SCALE;
+        float a = table[index];
+        output[i] = a + (table[index + 1] - a) * fraction;
+        p += (uint32_t)std::min(increment * ratio, 2147483648.0f);
+        ratio += ratioStep;
+    }
+    phase = p;
+}
+
+static void renderScalar(const ToneSetup &setup, int16_t *output, int start, int frames, int channels)
+{
+    uint32_t phase = setup.phaseIncrement * (uint32_t)start;
+
+    for (int i = start; i < frames; i++)
+    {
+        uint32_t index = phase >> FRACTION_BITS;
+        float fraction = (float)(phase & FRACTION_MASK) * FRACTION_SCALE;
+        float a = setup.table[index];
+        float sample = a + (setup.table[index + 1] - a) * fraction;
+
+        // Same linear fade as before, written without a branch
+        float time = (float)i / setup.rate;
+        float envelope = std::max(0.0f, std::min(1.0f, (setup.duration - time) * setup.fadeScale));
+
+        int16_t value = (int16_t)(sample * setup.volume * envelope * 32767.0f);
+        for (int c = 0; c < channels; c++)
+        {
+            output[i * channels + c] = value;
+        }
+
+        phase += setup.phaseIncrement;
+    }
+}
+
+#if defined(GUITAR_SIMD_X86)
+
+GUITAR_TARGET_SSE2 static int renderStereoSSE2(const ToneSetup &setup, int16_t *output, int frames)
+{
+    const uint32_t inc = setup.phaseIncrement;
+    __m128i phase = _mm_setr_epi32(0, (int)inc, (int)(inc * 2), (int)(inc * 3));
+    const __m128i phaseStep = _mm_set1_epi32((int)(inc * 4));
+    const __m128i fractionMask = _mm_set1_epi32((int)FRACTION_MASK);
+    const __m128 fractionScale = _mm_set1_ps(FRACTION_SCALE);
+
+    __m128 counter = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 counterStep = _mm_set1_ps(4.0f);
+    const __m128 rate = _mm_set1_ps(setup.rate);
+    const __m128 duration = _mm_set1_ps(setup.duration);
+    const __m128 fadeScale = _mm_set1_ps(setup.fadeScale);
+    const __m128 volume = _mm_set1_ps(setup.volume);
+    const __m128 fullScale = _mm_set1_ps(32767.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    alignas(16) int32_t index[4];
+    int i = 0;
+    for (; i + 4 <= frames; i += 4)
+    {
+        // SSE2 has no gather, so the four table reads stay scalar
+        _mm_store_si128((__m128i *)index, _mm_srli_epi32(phase, FRACTION_BITS));
+        __m128 a = _mm_setr_ps(setup.table[index[0]], setup.table[index[1]],
+                               setup.table[index[2]], setup.table[index[3]]);
+        __m128 b = _mm_setr_ps(setup.table[index[0] + 1], setup.table[index[1] + 1],
+                               setup.table[index[2] + 1], setup.table[index[3] + 1]);
+        __m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(phase, fractionMask)), fractionScale);
+        __m128 sample = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction));
+
+        __m128 time = _mm_div_ps(counter, rate);
+        __m128 envelope = _mm_mul_ps(_mm_sub_ps(duration, time), fadeScale);
+        envelope = _mm_max_ps(zero, _mm_min_ps(one, envelope));
+
+        __m128 value = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(sample, volume), envelope), fullScale);
+        __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(value), _mm_setzero_si128());
+
+        // Duplicate each sample into left and right
+        _mm_storeu_si128((__m128i *)(output + i * 2), _mm_unpacklo_epi16(packed, packed));
+
+        phase = _mm_add_epi32(phase, phaseStep);
+        counter = _mm_add_ps(counter, counterStep);
+    }
+    return i;
+}
+
+GUITAR_TARGET_AVX2 static int renderStereoAVX2(const ToneSetup &setup, int16_t *output, int frames)
+{
+    const uint32_t inc = setup.phaseIncrement;
+    __m256i phase = _mm256_setr_epi32(0, (int)inc, (int)(inc * 2), (int)(inc * 3),
+                                      (int)(inc * 4), (int)(inc * 5), (int)(inc * 6), (int)(inc * 7));
+    const __m256i phaseStep = _mm256_set1_epi32((int)(inc * 8));
+    const __m256i fractionMask = _mm256_set1_epi32((int)FRACTION_MASK);
+    const __m256 fractionScale = _mm256_set1_ps(FRACTION_SCALE);
+
+    __m256 counter = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const __m256 counterStep = _mm256_set1_ps(8.0f);
+    const __m256 rate = _mm256_set1_ps(setup.rate);
+    const __m256 duration = _mm256_set1_ps(setup.duration);
+    const __m256 fadeScale = _mm256_set1_ps(setup.fadeScale);
+    const __m256 volume = _mm256_set1_ps(setup.volume);
+    const __m256 fullScale = _mm256_set1_ps(32767.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    int i = 0;
+    for (; i + 8 <= frames; i += 8)
+    {
+        __m256i index = _mm256_srli_epi32(phase, FRACTION_BITS);
+        __m256 a = _mm256_i32gather_ps(setup.table, index, 4);
+        __m256 b = _mm256_i32gather_ps(setup.table + 1, index, 4);
+        __m256 fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(phase, fractionMask)), fractionScale);
+        __m256 sample = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fraction));
+
+        __m256 time = _mm256_div_ps(counter, rate);
+        __m256 envelope = _mm256_mul_ps(_mm256_sub_ps(duration, time), fadeScale);
+        envelope = _mm256_max_ps(zero, _mm256_min_ps(one, envelope));
+
+        __m256 value = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(sample, volume), envelope), fullScale);
+        __m256i ints = _mm256_cvttps_epi32(value);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(ints), _mm256_extracti128_si256(ints, 1));
+
+        _mm_storeu_si128((__m128i *)(output + i * 2), _mm_unpacklo_epi16(packed, packed));
+        _mm_storeu_si128((__m128i *)(output + i * 2 + 8), _mm_unpackhi_epi16(packed, packed));
+
+        phase = _mm256_add_epi32(phase, phaseStep);
+        counter = _mm256_add_ps(counter, counterStep);
+    }
+    return i;
+}
+
+#endif
+
+void ToneKernel::render(int16_t *output, int frames, int channels, float frequency,
+                        float duration, float volume, int sampleRate)
+{
+    static const Path path = bestPath();
+    renderWithPath(path, output, frames, channels, frequency, duration, volume, sampleRate);
+}
+
+void ToneKernel::renderWithPath(Path path, int16_t *output, int frames, int channels, float frequency,
+                                float duration, float volume, int sampleRate)
+{
+    ToneSetup setup;
+    if (!prepareTone(setup, frequency, duration, volume, sampleRate))
+    {
+        std::fill(output, output + frames * channels, (int16_t)0);
+        return;
+    }
+
+    int done = 0;
+#if defined(GUITAR_SIMD_X86)
+    if (channels == 2 && path == Path::AVX2)
+    {
+        done = renderStereoAVX2(setup, output, frames);
+    }
+    else if (channels == 2 && path == Path::SSE2)
+    {
+        done = renderStereoSSE2(setup, output, frames);
+    }
+#endif
+
+    // Odd channel layouts and the tail of the buffer take the scalar path
+    renderScalar(setup, output, done, frames, channels);
+}
+
+void ToneKernel::renderReference(int16_t *output, int frames, int channels, float frequency,
+                                 float duration, float volume, int sampleRate)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        // Generate sine wave with envelope (fade out)
+        float time = (float)i / sampleRate;
+        float envelope = 1.0f;
+
+        // Add fade out to prevent clicking
+        if (time > duration * FADE_START)
+        {
+            envelope = 1.0f - (time - duration * FADE_START) / (duration * (1.0f - FADE_START));
+        }
+
+        // Add some harmonics for more guitar-like sound
+        float sample = sin(2.0f * M_PI * frequency * time) * 0.6f;    // Fundamental
+        sample += sin(2.0f * M_PI * frequency * 2.0f * time) * 0.2f;  // 2nd harmonic
+        sample += sin(2.0f * M_PI * frequency * 3.0f * time) * 0.1f;  // 3rd harmonic
+        sample += sin(2.0f * M_PI * frequency * 4.0f * time) * 0.05f; // 4th harmonic
+
+        sample *= volume * envelope;
+
+        // Convert to 16-bit integer
+        int16_t sampleValue = (int16_t)(sample * 32767);
+        for (int c = 0; c < channels; c++)
+        {
+            output[i * channels + c] = sampleValue;
+        }
+    }
+}
+
+ToneKernel::Path ToneKernel::bestPath()
+{
+    if (isPathSupported(Path::AVX2))
+        return Path::AVX2;
+    if (isPathSupported(Path::SSE2))
+        return Path::SSE2;
+    return Path::Scalar;
+}
+
+bool ToneKernel::isPathSupported(Path path)
+{
+    switch (path)
+    {
+    case Path::AVX2:
+        return cpuHasAVX2();
+    case Path::SSE2:
+        return cpuHasSSE2();
+    default:
+        return true;
+    }
+}
+
+const char *ToneKernel::pathName(Path path)
+{
+    switch (path)
+    {
+    case Path::AVX2:
+        return "AVX2";
+    case Path::SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
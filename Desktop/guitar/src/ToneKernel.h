@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+
+// Band-limited wavetable oscillator for the note bank's harmonic tone.
+// Produces the harmonic stack, fade-out envelope and int16 interleave in one pass.
+class ToneKernel
+{
+public:
+    enum class Path
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Harmonic weights of the tone (fundamental first)
+    static const int HARMONIC_COUNT = 4;
+    static const float HARMONIC_WEIGHTS[HARMONIC_COUNT];
+
+    // Fraction of the note after which the linear fade-out starts
+    static const float FADE_START;
+
+    // Bump whenever the rendered output changes so cached note banks are rebuilt
+    static const uint32_t REVISION = 1;
+
+    // Render `frames` frames into an interleaved int16 buffer with `channels` channels
+    static void render(int16_t *output, int frames, int channels, float frequency,
+                       float duration, float volume, int sampleRate);
+
+    // Same as render() but forces a specific code path (used by the parity check)
+    static void renderWithPath(Path path, int16_t *output, int frames, int channels, float frequency,
+                               float duration, float volume, int sampleRate);
+
+    // The original four-sin() per sample implementation, kept as the parity reference
+    static void renderReference(int16_t *output, int frames, int channels, float frequency,
+                                float duration, float volume, int sampleRate);
+
+    // Streaming form for tones synthesized while they play: the band-limited table for a pitch
+    // (null when even the fundamental is above Nyquist) and its 32-bit phase increment
+    static const float *streamTable(float frequency, int sampleRate, uint32_t &phaseIncrement);
+
+    // Raw harmonic stack at full scale, no envelope; advances the phase
+    static void renderStream(const float *table, uint32_t &phase, uint32_t phaseIncrement, float *output,
+                             int frames);
+
+    // renderStream with the increment scaled by a pitch ratio that moves by ratioStep every sample
+    static void renderSweep(const float *table, uint32_t &phase, uint32_t phaseIncrement, float ratio, float ratioStep,
+                            float *output, int frames);
+
+    static Path bestPath();
+    static bool isPathSupported(Path path);
+    static const char *pathName(Path path);
+};
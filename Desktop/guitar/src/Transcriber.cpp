@@ -0,0 +1,459 @@
+#include "Transcriber.h"
+#include "Tuning.h"
+#include "WavFile.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static std::string noteName(int note)
+{
+    static const char *names[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+    return names[note % 12] + std::to_string(note / 12 - 1);
+}
+
+// Frame counts for durations in seconds, never less than `minimum`
+static int framesFor(double seconds, int sampleRate, int hop, int minimum = 1)
+{
+    return std::max(minimum, (int)std::lround(seconds * sampleRate / hop));
+}
+
+Transcriber::Transcriber(int threadCount)
+    : threadCount_(threadCount), sampleRate_(0), hop_(0), frameSize_(0), audioSeconds_(0.0), droppedNotes_(0)
+{
+    setGate(DEFAULT_GATE_DB);
+}
+
+void Transcriber::setGate(float decibels)
+{
+    gate_ = std::pow(10.0f, decibels / 20.0f);
+}
+
+double Transcriber::frameTime(int frame) const
+{
+    return (double)frame * hop_ / sampleRate_;
+}
+
+bool Transcriber::transcribe(const std::string &wavPath)
+{
+    frames_.clear();
+    notes_.clear();
+    droppedNotes_ = 0;
+
+    if (!analyze(wavPath))
+        return false;
+
+    segmentNotes();
+    placeOnFretboard();
+    return true;
+}
+
+bool Transcriber::analyze(const std::string &path)
+{
+    WavReader header;
+    if (!header.open(path))
+        return false;
+
+    sampleRate_ = header.getSampleRate();
+    if (sampleRate_ < 8000)
+    {
+        std::cerr << "Sample rate too low for pitch tracking: " << sampleRate_ << std::endl;
+        return false;
+    }
+
+    const int channels = header.getChannels();
+    const int64_t totalSamples = (int64_t)header.getFrameCount();
+    audioSeconds_ = (double)totalSamples / sampleRate_;
+
+    PitchTracker sizing(sampleRate_);
+    hop_ = sizing.getHop();
+    frameSize_ = sizing.getFrameSize();
+
+    // Frame f is centred on sample f * hop; samples outside the file read as silence
+    const int frameCount = (int)((totalSamples + hop_ - 1) / hop_);
+    frames_.resize(frameCount);
+
+    const int chunkFrames = framesFor(CHUNK_SECONDS, sampleRate_, hop_);
+    std::atomic<bool> failed(false);
+    WorkerPool pool(threadCount_);
+
+    for (int first = 0; first < frameCount; first += chunkFrames)
+    {
+        const int last = std::min(frameCount, first + chunkFrames);
+        pool.submit([this, &path, &failed, first, last, channels, totalSamples]()
+                    {
+            // One frame before the chunk primes the onset flux, so chunk edges do not read as onsets
+            const int warm = first > 0 ? 1 : 0;
+            const int64_t begin = (int64_t)(first - warm) * hop_ - frameSize_ / 2;
+            const int64_t end = (int64_t)(last - 1) * hop_ + frameSize_ / 2;
+
+            std::vector<float> mono((size_t)(end - begin), 0.0f);
+            const int64_t readBegin = std::max<int64_t>(0, begin);
+            const int64_t readEnd = std::min(totalSamples, end);
+
+            WavReader reader;
+            if (readEnd > readBegin)
+            {
+                if (!reader.open(path) || !reader.seek((uint64_t)readBegin))
+                {
+                    failed.store(true);
+                    return;
+                }
+
+                const int blockFrames = 16384;
+                std::vector<float> interleaved((size_t)blockFrames * channels);
+                int64_t position = readBegin;
+                while (position < readEnd)
+                {
+                    int count = reader.read(interleaved.data(), (int)std::min<int64_t>(blockFrames, readEnd - position));
+                    if (count <= 0)
+                        break;
+
+                    float *out = mono.data() + (position - begin);
+                    for (int i = 0; i < count; i++)
+                    {
+                        float sum = 0.0f;
+                        for (int c = 0; c < channels; c++)
+                            sum += interleaved[(size_t)i * channels + c];
+                        out[i] = sum / channels;
+                    }
+                    position += count;
+                }
+            }
+
+            PitchTracker tracker(sampleRate_);
+            for (int f = first - warm; f < last; f++)
+            {
+                PitchFrame frame = tracker.analyze(mono.data() + ((int64_t)f * hop_ - frameSize_ / 2 - begin));
+                if (f >= first)
+                    frames_[f] = frame;
+            } });
+    }
+
+    pool.waitIdle();
+
+    if (failed.load())
+    {
+        std::cerr << "Failed to read " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<char> Transcriber::findOnsets() const
+{
+    const int count = (int)frames_.size();
+    std::vector<char> onsets(count, 0);
+    if (count == 0)
+        return onsets;
+
+    const int meanSpan = framesFor(0.1, sampleRate_, hop_);  // adaptive threshold over +-100 ms
+    const int peakSpan = framesFor(0.02, sampleRate_, hop_); // must be the largest within +-20 ms
+    const int minGap = framesFor(0.05, sampleRate_, hop_);   // no two onsets closer than 50 ms
+
+    double total = 0.0;
+    for (const PitchFrame &frame : frames_)
+        total += frame.flux;
+    const float floor = (float)(0.5 * total / count);
+
+    // Running sum for the local mean
+    double window = 0.0;
+    for (int f = 0; f < std::min(count, meanSpan + 1); f++)
+        window += frames_[f].flux;
+
+    int lastOnset = -minGap;
+    for (int f = 0; f < count; f++)
+    {
+        if (f > meanSpan)
+            window -= frames_[f - meanSpan - 1].flux;
+        if (f + meanSpan < count && f > 0)
+            window += frames_[f + meanSpan].flux;
+
+        int from = std::max(0, f - meanSpan);
+        int to = std::min(count - 1, f + meanSpan);
+        float threshold = 1.5f * (float)(window / (to - from + 1)) + floor;
+
+        float flux = frames_[f].flux;
+        if (flux <= threshold || f - lastOnset < minGap)
+            continue;
+
+        bool peak = true;
+        for (int g = std::max(0, f - peakSpan); g <= std::min(count - 1, f + peakSpan) && peak; g++)
+            peak = g < f ? frames_[g].flux < flux : frames_[g].flux <= flux;
+        if (!peak)
+            continue;
+
+        // The attack has to become audible shortly after, or it was noise between notes
+        bool audible = false;
+        for (int g = f; g <= std::min(count - 1, f + 2 * peakSpan) && !audible; g++)
+            audible = frames_[g].rms >= gate_;
+        if (!audible)
+            continue;
+
+        onsets[f] = 1;
+        lastOnset = f;
+    }
+
+    return onsets;
+}
+
+void Transcriber::segmentNotes()
+{
+    const int count = (int)frames_.size();
+    const std::vector<char> onsets = findOnsets();
+
+    const int stableFrames = framesFor(0.025, sampleRate_, hop_, 2); // a new pitch must hold this long
+    const int minNoteFrames = framesFor(0.03, sampleRate_, hop_, 2);
+    const int gapFrames = framesFor(0.05, sampleRate_, hop_, 2); // unvoiced this long ends the note
+
+    // The open segment: pitch is the most frequent frame note inside it
+    int start = -1;
+    int lastVoiced = -1;
+    int votes[128] = {};
+    int mode = -1;
+    float peakRms = 0.0f;
+
+    auto open = [&](int frame)
+    {
+        start = frame;
+        lastVoiced = frame - 1;
+        std::fill(std::begin(votes), std::end(votes), 0);
+        mode = -1;
+        peakRms = 0.0f;
+    };
+
+    // Strings left ringing under a new note share its period multiples, so the tracker can drop an
+    // octave (2x), an octave and a fifth (3x) or two octaves (4x) as the note decays. Those frames
+    // count for the note already sounding instead of starting a new one.
+    auto fold = [&](int note)
+    {
+        for (int interval : {12, 19, 24})
+        {
+            if (note + interval < 128 && votes[note + interval] > 0)
+                return note + interval;
+        }
+        return note;
+    };
+
+    auto vote = [&](int note, int weight)
+    {
+        note = fold(note);
+        votes[note] += weight;
+        if (mode < 0 || votes[note] > votes[mode])
+            mode = note;
+    };
+
+    auto close = [&]()
+    {
+        if (start >= 0 && mode >= 0 && votes[mode] >= minNoteFrames)
+        {
+            TranscribedNote note;
+            note.time = frameTime(start);
+            note.duration = frameTime(lastVoiced + 1) - note.time;
+            note.note = mode;
+            note.stringIndex = -1;
+            note.fret = -1;
+            note.velocity = peakRms;
+            notes_.push_back(note);
+        }
+        start = -1;
+    };
+
+    int runNote = -1;
+    int runLength = 0;
+    for (int f = 0; f < count; f++)
+    {
+        const PitchFrame &frame = frames_[f];
+        int note = -1;
+        if (frame.frequency > 0.0f && frame.aperiodicity <= VOICED_APERIODICITY && frame.rms >= gate_)
+            note = std::max(0, std::min(127, (int)std::lround(69.0 + 12.0 * std::log2(frame.frequency / 440.0))));
+
+        if (note >= 0 && note == runNote)
+            runLength++;
+        else
+        {
+            runNote = note;
+            runLength = note >= 0 ? 1 : 0;
+        }
+
+        if (onsets[f])
+        {
+            close();
+            open(f);
+        }
+        else if (runLength == stableFrames &&
+                 (start < 0 || (mode >= 0 && fold(note) == note && note != mode && votes[mode] >= stableFrames)))
+        {
+            // A pitch that settles without an onset: legato after a note, or a note the onset picker missed
+            int runStart = f - stableFrames + 1;
+            if (start >= 0)
+            {
+                votes[note] -= stableFrames - 1;
+                lastVoiced = std::min(lastVoiced, runStart - 1);
+                close();
+            }
+            open(runStart);
+            vote(note, stableFrames - 1);
+            lastVoiced = f - 1;
+        }
+
+        if (start < 0)
+            continue;
+
+        if (note >= 0)
+        {
+            vote(note, 1);
+            lastVoiced = f;
+            peakRms = std::max(peakRms, frame.rms);
+        }
+        else if (f - std::max(lastVoiced, start) >= gapFrames)
+            close();
+    }
+    close();
+
+    // Velocity from each note's peak level against the loudest one, 40 dB of range
+    float loudest = 0.0f;
+    for (const TranscribedNote &note : notes_)
+        loudest = std::max(loudest, note.velocity);
+    for (TranscribedNote &note : notes_)
+    {
+        float decibels = 20.0f * std::log10(std::max(note.velocity, 1e-9f) / loudest);
+        note.velocity = std::max(0.1f, std::min(1.0f, 1.0f + decibels / 40.0f));
+    }
+}
+
+bool Transcriber::placeNote(int note, int handFret, int &stringIndex, int &fret)
+{
+    // Cost is how far the hand has to shift; open strings are free. Ties go to the lower fret.
+    int bestCost = 0;
+    stringIndex = -1;
+    for (int s = 0; s < Tuning::STRING_COUNT; s++)
+    {
+        int f = note - Tuning::STANDARD_NOTES[s];
+        if (f < 0 || f > Tuning::FRET_COUNT)
+            continue;
+
+        int cost = f == 0 ? 0 : std::max(0, handFret - f) + std::max(0, f - (handFret + HAND_SPAN));
+        if (stringIndex < 0 || cost < bestCost || (cost == bestCost && f < fret))
+        {
+            stringIndex = s;
+            fret = f;
+            bestCost = cost;
+        }
+    }
+    return stringIndex >= 0;
+}
+
+void Transcriber::placeOnFretboard()
+{
+    int hand = 1; // first position
+    std::vector<TranscribedNote> placed;
+    placed.reserve(notes_.size());
+
+    for (TranscribedNote note : notes_)
+    {
+        if (!placeNote(note.note, hand, note.stringIndex, note.fret))
+        {
+            droppedNotes_++;
+            continue;
+        }
+
+        if (note.fret > 0 && note.fret < hand)
+            hand = note.fret;
+        else if (note.fret > hand + HAND_SPAN)
+            hand = note.fret - HAND_SPAN;
+        placed.push_back(note);
+    }
+
+    notes_.swap(placed);
+}
+
+bool Transcriber::writeEventList(const std::string &path, const std::string &sourceName) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Failed to open event list for writing: " << path << std::endl;
+        return false;
+    }
+
+    file << "# Transcribed from " << sourceName << "\n";
+    file << "# time string fret velocity duration\n";
+    file << std::fixed;
+    for (const TranscribedNote &note : notes_)
+    {
+        file << std::setprecision(3) << note.time << " " << note.stringIndex << " " << note.fret << " "
+             << std::setprecision(2) << note.velocity << " " << std::setprecision(3) << note.duration
+             << "  # " << noteName(note.note) << "\n";
+    }
+
+    // The same notes as tab, thin string on top, a fixed number of notes per row
+    static const char *stringNames[Tuning::STRING_COUNT] = {"E", "A", "D", "G", "B", "e"};
+    const size_t perRow = 24;
+    for (size_t row = 0; row < notes_.size(); row += perRow)
+    {
+        size_t end = std::min(notes_.size(), row + perRow);
+        file << "#\n";
+        for (int s = Tuning::STRING_COUNT - 1; s >= 0; s--)
+        {
+            file << "# " << stringNames[s] << "|-";
+            for (size_t i = row; i < end; i++)
+            {
+                std::string cell = notes_[i].stringIndex == s ? std::to_string(notes_[i].fret) : "";
+                file << cell << std::string(3 - cell.size(), '-');
+            }
+            file << "|\n";
+        }
+    }
+
+    if (!file)
+    {
+        std::cerr << "Failed to write event list: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int Transcriber::runCommandLine(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " --transcribe <in.wav> <out.txt> [--threads N] [--gate dB]" << std::endl;
+        return 1;
+    }
+
+    std::string inputPath = argv[2];
+    std::string outputPath = argv[3];
+    Transcriber transcriber;
+
+    for (int i = 4; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            transcriber.setThreadCount(std::atoi(argv[++i]));
+        else if (arg == "--gate" && i + 1 < argc)
+            transcriber.setGate((float)std::atof(argv[++i]));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!transcriber.transcribe(inputPath))
+        return 1;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!transcriber.writeEventList(outputPath, inputPath))
+        return 1;
+
+    double seconds = transcriber.getAudioSeconds();
+    std::cout << "Transcribed " << transcriber.getNotes().size() << " notes from " << seconds << " s of audio in "
+              << elapsed * 1000.0 << " ms (" << (elapsed > 0.0 ? seconds / elapsed : 0.0) << "x realtime) to "
+              << outputPath << std::endl;
+    if (transcriber.getDroppedNotes() > 0)
+        std::cout << transcriber.getDroppedNotes() << " notes were off the fretboard and left out" << std::endl;
+    std::cout << "Play it back with: " << argv[0] << " --render " << outputPath << " out.wav" << std::endl;
+    return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "PitchTracker.h"
+
+// One detected note, placed on the fretboard
+struct TranscribedNote
+{
+    double time;     // seconds from the start of the recording
+    double duration; // seconds the pitch was held
+    int note;        // MIDI note number
+    int stringIndex; // 0 = low E ... 5 = high E
+    int fret;
+    float velocity;  // 0..1, relative to the loudest note
+};
+
+// Offline audio-to-tab: a monophonic guitar recording in, fretboard positions out.
+// The recording is streamed from disk in chunks, each chunk analysed by a PitchTracker on
+// its own worker thread, so memory stays flat however long the file is. Onsets and pitch
+// changes then split the frame track into notes, and every note goes to the string and
+// fret closest to the current hand position on the standard tuning (Tuning.h, the same
+// table the fretboard is built from). The result is an --render event list with the tab
+// drawn underneath in comments.
+class Transcriber
+{
+public:
+    static constexpr double CHUNK_SECONDS = 30.0;
+    static constexpr float DEFAULT_GATE_DB = -45.0f;
+    static constexpr float VOICED_APERIODICITY = 0.25f;
+    static constexpr int HAND_SPAN = 3; // frets reachable above the index finger without a shift
+
+private:
+    int threadCount_;
+    float gate_; // linear RMS under which a frame counts as silence
+
+    int sampleRate_;
+    int hop_;
+    int frameSize_;
+    double audioSeconds_;
+    std::vector<PitchFrame> frames_;
+    std::vector<TranscribedNote> notes_;
+    int droppedNotes_;
+
+    bool analyze(const std::string &path);
+    std::vector<char> findOnsets() const;
+    void segmentNotes();
+    void placeOnFretboard();
+    double frameTime(int frame) const;
+
+public:
+    explicit Transcriber(int threadCount = 0);
+
+    void setThreadCount(int threads) { threadCount_ = threads; }
+    void setGate(float decibels);
+
+    // Analyse the whole WAV file; false if it cannot be read
+    bool transcribe(const std::string &wavPath);
+
+    // "time string fret velocity duration" lines for --render, followed by an ASCII tab
+    bool writeEventList(const std::string &path, const std::string &sourceName) const;
+
+    const std::vector<TranscribedNote> &getNotes() const { return notes_; }
+    double getAudioSeconds() const { return audioSeconds_; }
+    int getDroppedNotes() const { return droppedNotes_; }
+
+    // Most playable string and fret for a MIDI note with the index finger at handFret;
+    // false when the note is off the fretboard
+    static bool placeNote(int note, int handFret, int &stringIndex, int &fret);
+
+    // ElectricGuitar3D --transcribe <in.wav> <out.txt> [--threads N] [--gate dB]
+    static int runCommandLine(int argc, char *argv[]);
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+// Standard guitar tuning shared by the renderers, the synth and the offline tools.
+// Strings are indexed from the low E (6th string) to the high E (1st string).
+struct Tuning
+{
+    static constexpr int STRING_COUNT = 6;
+    static constexpr int FRET_COUNT = 12;
+
+    static constexpr float STANDARD_FREQUENCIES[STRING_COUNT] = {
+        82.41f,  // Low E (6th string)
+        110.0f,  // A (5th string)
+        146.83f, // D (4th string)
+        196.0f,  // G (3rd string)
+        246.94f, // B (2nd string)
+        329.63f  // High E (1st string)
+    };
+
+    // MIDI note numbers of the open strings
+    static constexpr int STANDARD_NOTES[STRING_COUNT] = {40, 45, 50, 55, 59, 64};
+};
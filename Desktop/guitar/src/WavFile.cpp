@@ -0,0 +1,234 @@
+#include "WavFile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static void writeLE32(std::ofstream &file, uint32_t value)
+{
+    char bytes[4] = {(char)(value & 0xFF), (char)((value >> 8) & 0xFF), (char)((value >> 16) & 0xFF), (char)(value >> 24)};
+    file.write(bytes, 4);
+}
+
+static void writeLE16(std::ofstream &file, uint16_t value)
+{
+    char bytes[2] = {(char)(value & 0xFF), (char)(value >> 8)};
+    file.write(bytes, 2);
+}
+
+static uint32_t readLE32(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint16_t readLE16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+bool WavFile::write16(const std::string &path, const float *samples, int frames, int channels, int sampleRate)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Failed to open WAV file for writing: " << path << std::endl;
+        return false;
+    }
+
+    uint32_t dataBytes = (uint32_t)frames * channels * sizeof(int16_t);
+
+    file.write("RIFF", 4);
+    writeLE32(file, 36 + dataBytes);
+    file.write("WAVE", 4);
+
+    file.write("fmt ", 4);
+    writeLE32(file, 16);
+    writeLE16(file, 1); // PCM
+    writeLE16(file, (uint16_t)channels);
+    writeLE32(file, (uint32_t)sampleRate);
+    writeLE32(file, (uint32_t)(sampleRate * channels * sizeof(int16_t)));
+    writeLE16(file, (uint16_t)(channels * sizeof(int16_t)));
+    writeLE16(file, 16);
+
+    file.write("data", 4);
+    writeLE32(file, dataBytes);
+
+    // Convert in chunks to keep the temporary buffer small for long renders
+    std::vector<char> buffer;
+    const int chunkSamples = 65536;
+    int total = frames * channels;
+    for (int start = 0; start < total; start += chunkSamples)
+    {
+        int count = std::min(chunkSamples, total - start);
+        buffer.resize(count * 2);
+        for (int i = 0; i < count; i++)
+        {
+            float value = std::max(-1.0f, std::min(1.0f, samples[start + i]));
+            int16_t sample = (int16_t)(value * 32767);
+            buffer[i * 2] = (char)(sample & 0xFF);
+            buffer[i * 2 + 1] = (char)((sample >> 8) & 0xFF);
+        }
+        file.write(buffer.data(), (std::streamsize)buffer.size());
+    }
+
+    if (!file)
+    {
+        std::cerr << "Failed to write WAV file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WavFile::read(const std::string &path, std::vector<float> &samples, int &channels, int &sampleRate)
+{
+    WavReader reader;
+    if (!reader.open(path))
+        return false;
+
+    channels = reader.getChannels();
+    sampleRate = reader.getSampleRate();
+    samples.resize((size_t)reader.getFrameCount() * channels);
+
+    size_t frames = 0;
+    int count;
+    while ((count = reader.read(samples.data() + frames * channels, 65536)) > 0)
+        frames += count;
+    samples.resize(frames * channels);
+    return true;
+}
+
+WavReader::WavReader()
+    : formatTag_(0), bitsPerSample_(0), channels_(0), sampleRate_(0), dataStart_(0), frameCount_(0), position_(0)
+{
+}
+
+bool WavReader::open(const std::string &path)
+{
+    file_.close();
+    file_.clear();
+    file_.open(path, std::ios::binary);
+    if (!file_)
+    {
+        std::cerr << "Failed to open WAV file: " << path << std::endl;
+        return false;
+    }
+
+    file_.seekg(0, std::ios::end);
+    std::streamoff fileSize = file_.tellg();
+    file_.seekg(0, std::ios::beg);
+
+    uint8_t header[12];
+    if (!file_.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+        std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        std::cerr << "Not a WAV file: " << path << std::endl;
+        return false;
+    }
+
+    formatTag_ = 0;
+    bitsPerSample_ = 0;
+    channels_ = 0;
+    sampleRate_ = 0;
+
+    // Walk the chunks until the sample data; anything unknown is skipped
+    uint8_t chunk[8];
+    while (file_.read(reinterpret_cast<char *>(chunk), sizeof(chunk)))
+    {
+        uint32_t size = readLE32(chunk + 4);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0)
+        {
+            std::vector<uint8_t> fmt(std::max<uint32_t>(size, 16));
+            if (!file_.read(reinterpret_cast<char *>(fmt.data()), size) || size < 16)
+                break;
+
+            formatTag_ = readLE16(fmt.data());
+            channels_ = readLE16(fmt.data() + 2);
+            sampleRate_ = (int)readLE32(fmt.data() + 4);
+            bitsPerSample_ = readLE16(fmt.data() + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format tag in the sub-format GUID
+            if (formatTag_ == 0xFFFE && size >= 26)
+                formatTag_ = readLE16(fmt.data() + 24);
+            if (size & 1)
+                file_.seekg(1, std::ios::cur);
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0)
+        {
+            bool isFloat = (formatTag_ == 3 && bitsPerSample_ == 32);
+            bool isPcm = (formatTag_ == 1 && (bitsPerSample_ == 8 || bitsPerSample_ == 16 ||
+                                              bitsPerSample_ == 24 || bitsPerSample_ == 32));
+            if (channels_ < 1 || sampleRate_ < 1 || (!isFloat && !isPcm))
+            {
+                std::cerr << "Unsupported WAV format (tag " << formatTag_ << ", " << bitsPerSample_
+                          << " bits): " << path << std::endl;
+                return false;
+            }
+
+            // Recorders that never patch the header leave the size at 0 or ~4 GB; trust the file length
+            dataStart_ = file_.tellg();
+            uint64_t available = (uint64_t)(fileSize - dataStart_);
+            uint64_t bytes = (size == 0 || size > available) ? available : size;
+            frameCount_ = bytes / ((uint64_t)channels_ * (bitsPerSample_ / 8));
+            position_ = 0;
+            return true;
+        }
+        else
+        {
+            file_.seekg(size + (size & 1), std::ios::cur); // chunks are padded to even sizes
+        }
+    }
+
+    std::cerr << "No sample data in WAV file: " << path << std::endl;
+    return false;
+}
+
+bool WavReader::seek(uint64_t frame)
+{
+    if (frame > frameCount_)
+        return false;
+
+    file_.clear();
+    file_.seekg(dataStart_ + (std::streamoff)(frame * channels_ * (bitsPerSample_ / 8)), std::ios::beg);
+    position_ = frame;
+    return (bool)file_;
+}
+
+int WavReader::read(float *samples, int frames)
+{
+    frames = (int)std::min<uint64_t>((uint64_t)std::max(frames, 0), frameCount_ - position_);
+    if (frames == 0)
+        return 0;
+
+    const int bytesPerSample = bitsPerSample_ / 8;
+    raw_.resize((size_t)frames * channels_ * bytesPerSample);
+    file_.read(reinterpret_cast<char *>(raw_.data()), (std::streamsize)raw_.size());
+    size_t count = (size_t)file_.gcount() / bytesPerSample;
+    count -= count % channels_;
+
+    const bool isFloat = formatTag_ == 3;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *p = raw_.data() + i * bytesPerSample;
+        float value;
+        if (isFloat)
+        {
+            uint32_t bits = readLE32(p);
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        else if (bitsPerSample_ == 8)
+            value = (p[0] - 128) / 128.0f;
+        else if (bitsPerSample_ == 16)
+            value = (int16_t)readLE16(p) / 32768.0f;
+        else if (bitsPerSample_ == 24)
+            value = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f;
+        else
+            value = (int32_t)readLE32(p) / 2147483648.0f;
+        samples[i] = value;
+    }
+
+    int read = (int)(count / channels_);
+    position_ += read;
+    return read;
+}
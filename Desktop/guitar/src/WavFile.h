@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Minimal RIFF/WAVE support for the offline tools
+class WavFile
+{
+public:
+    // Write interleaved float samples as 16-bit PCM, clamping to [-1, 1]
+    static bool write16(const std::string &path, const float *samples, int frames, int channels, int sampleRate);
+
+    // Read 8/16/24/32-bit PCM or 32-bit float into interleaved floats in [-1, 1]
+    static bool read(const std::string &path, std::vector<float> &samples, int &channels, int &sampleRate);
+};
+
+// Streaming reader for recordings too long to load whole; each thread opens its own
+class WavReader
+{
+private:
+    std::ifstream file_;
+    uint16_t formatTag_;
+    int bitsPerSample_;
+    int channels_;
+    int sampleRate_;
+    std::streamoff dataStart_;
+    uint64_t frameCount_;
+    uint64_t position_;
+    std::vector<uint8_t> raw_;
+
+public:
+    WavReader();
+
+    // Same formats as WavFile::read; fails with a message on anything else
+    bool open(const std::string &path);
+
+    // Up to `frames` interleaved frames in [-1, 1]; returns how many were read, 0 at the end
+    int read(float *samples, int frames);
+
+    bool seek(uint64_t frame);
+
+    int getChannels() const { return channels_; }
+    int getSampleRate() const { return sampleRate_; }
+    uint64_t getFrameCount() const { return frameCount_; }
+};
@@ -0,0 +1,84 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threadCount) : busy_(0), stopping_(false)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = (int)std::thread::hardware_concurrency();
+        if (threadCount <= 0)
+            threadCount = 2;
+    }
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    taskReady_.notify_all();
+
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    taskReady_.notify_one();
+}
+
+void WorkerPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]
+               { return tasks_.empty() && busy_ == 0; });
+}
+
+void WorkerPool::cancelPending()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.clear();
+    if (busy_ == 0)
+        idle_.notify_all();
+}
+
+void WorkerPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskReady_.wait(lock, [this]
+                            { return stopping_ || !tasks_.empty(); });
+
+            // Finish queued work before shutting down
+            if (tasks_.empty())
+                return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            busy_++;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_--;
+            if (busy_ == 0 && tasks_.empty())
+                idle_.notify_all();
+        }
+    }
+}
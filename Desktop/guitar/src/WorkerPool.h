@@ -0,0 +1,37 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size thread pool for background audio work (note rendering, offline jobs)
+class WorkerPool
+{
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable taskReady_;
+    std::condition_variable idle_;
+    int busy_;
+    bool stopping_;
+
+    void workerLoop();
+
+public:
+    // threadCount <= 0 uses one thread per hardware core
+    explicit WorkerPool(int threadCount = 0);
+    ~WorkerPool();
+
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task has finished
+    void waitIdle();
+
+    // Drop tasks that have not started yet; running ones still complete
+    void cancelPending();
+
+    int getThreadCount() const { return (int)workers_.size(); }
+};
@@ -3,14 +3,124 @@
 #include <GL/glew.h>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include "Guitar3D.h"
 #include "AudioManager.h"
+#include "ToneKernel.h"
+#include "OfflineRenderer.h"
+#include "Transcriber.h"
+#include "Benchmark.h"
+#include "SampleLibrary.h"
 
 const int WINDOW_WIDTH = 1200;
 const int WINDOW_HEIGHT = 800;
 
+// Chords on the number keys, resolved from the tuning at compile time
+static constexpr ChordVoicing CHORD_KEYS[] = {
+    Chords::named("C"), Chords::named("G"), Chords::named("D"), Chords::named("A"), Chords::named("E"),
+    Chords::named("Am"), Chords::named("Em"), Chords::named("Dm"), Chords::named("F"),
+};
+static_assert(sizeof(CHORD_KEYS) / sizeof(CHORD_KEYS[0]) == 9, "one chord for each of the keys 1-9");
+
+// Compare every SIMD path of the tone kernel against the original sin() loop
+static int runToneParityCheck()
+{
+    const int sampleRate = 44100;
+    const float duration = 0.8f;
+    const int frames = (int)(sampleRate * duration);
+    const int maxAllowedDiff = 8; // the reference itself is off by up to ~7 LSB (float time)
+
+    std::vector<Sint16> reference(frames * 2);
+    std::vector<Sint16> output(frames * 2);
+    bool passed = true;
+
+    const ToneKernel::Path paths[] = {ToneKernel::Path::Scalar, ToneKernel::Path::SSE2, ToneKernel::Path::AVX2};
+    for (ToneKernel::Path path : paths)
+    {
+        if (!ToneKernel::isPathSupported(path))
+        {
+            std::cout << ToneKernel::pathName(path) << ": not supported on this CPU, skipped" << std::endl;
+            continue;
+        }
+
+        int worstDiff = 0;
+        double squaredError = 0.0;
+
+        // Every note from low E up to two octaves above the 12th fret of high E
+        for (int note = 40; note <= 88; note++)
+        {
+            float frequency = 440.0f * std::pow(2.0f, (note - 69) / 12.0f);
+            ToneKernel::renderReference(reference.data(), frames, 2, frequency, duration, 0.5f, sampleRate);
+            ToneKernel::renderWithPath(path, output.data(), frames, 2, frequency, duration, 0.5f, sampleRate);
+
+            for (int i = 0; i < frames * 2; i++)
+            {
+                int diff = std::abs(reference[i] - output[i]);
+                worstDiff = std::max(worstDiff, diff);
+                squaredError += (double)diff * diff;
+            }
+        }
+
+        double rms = std::sqrt(squaredError / ((88 - 40 + 1) * (double)frames * 2));
+        bool ok = worstDiff <= maxAllowedDiff && rms < 1.0;
+        passed = passed && ok;
+
+        std::cout << ToneKernel::pathName(path) << ": max diff " << worstDiff
+                  << " LSB, rms " << rms << " LSB " << (ok ? "OK" : "FAILED") << std::endl;
+    }
+
+    return passed ? 0 : 1;
+}
+
+// Rate the default output device runs at natively, so SDL has nothing to convert; 44100 when
+// this SDL can't tell. Needs the audio subsystem initialized.
+static int nativeSampleRate()
+{
+    SDL_AudioSpec spec;
+    SDL_zero(spec);
+#if SDL_VERSION_ATLEAST(2, 24, 0)
+    if (SDL_GetDefaultAudioInfo(nullptr, &spec, 0) == 0 && spec.freq > 0)
+        return spec.freq;
+#endif
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+    if (SDL_GetNumAudioDevices(0) > 0 && SDL_GetAudioDeviceSpec(0, 0, &spec) == 0 && spec.freq > 0)
+        return spec.freq;
+#endif
+    return 44100;
+}
+
 int main(int argc, char *argv[])
 {
+    // Headless tools that don't need a window or an audio device
+    if (argc > 1 && std::string(argv[1]) == "--check-tone")
+    {
+        return runToneParityCheck();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--render")
+    {
+        return OfflineRenderer::runCommandLine(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--transcribe")
+    {
+        return Transcriber::runCommandLine(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-fx")
+    {
+        return runEffectBenchmark(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-conv")
+    {
+        return runConvolutionBenchmark(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-notes")
+    {
+        return runNoteBankBenchmark(argc, argv);
+    }
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
     {
@@ -25,21 +135,55 @@ int main(int argc, char *argv[])
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
+    // Low-latency mode starts the device on a small buffer and lets AudioManager resize it.
+    // The device opens at its native rate unless --rate says otherwise; --engine-rate pins the
+    // synth to one rate and resamples to the device's.
+    int bufferFrames = 2048;
+    bool lowLatency = false;
+    int deviceRate = 0;
+    int engineRate = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--low-latency")
+        {
+            lowLatency = true;
+            bufferFrames = 128;
+        }
+        else if (arg == "--buffer" && i + 1 < argc)
+        {
+            bufferFrames = AdaptiveBuffer::clampFrames(std::atoi(argv[++i]));
+        }
+        else if (arg == "--rate" && i + 1 < argc)
+        {
+            deviceRate = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--engine-rate" && i + 1 < argc)
+        {
+            engineRate = std::max(0, std::atoi(argv[++i]));
+        }
+    }
+    if (deviceRate == 0)
+        deviceRate = nativeSampleRate();
+
     // Initialize SDL_mixer
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+    if (Mix_OpenAudio(deviceRate, MIX_DEFAULT_FORMAT, 2, bufferFrames) < 0)
     {
         std::cerr << "SDL_mixer init failed: " << Mix_GetError() << std::endl;
         SDL_Quit();
         return -1;
     }
 
-    // Allocate mixing channels
-    Mix_AllocateChannels(16); // 16 channel for simultaneous sounds
+    // Mixing channels are only used as a fallback; polyphony is managed by the synth voice pool
+    Mix_AllocateChannels(16);
 
     std::cout << "SDL_mixer initialized successfully" << std::endl;
     std::cout << "Audio format: " << MIX_DEFAULT_FORMAT << std::endl;
     std::cout << "Audio channels: 2" << std::endl;
-    std::cout << "Audio frequency: 44100" << std::endl;
+    int openedRate = deviceRate;
+    Mix_QuerySpec(&openedRate, nullptr, nullptr);
+    std::cout << "Audio frequency: " << openedRate << std::endl;
+    std::cout << "Audio buffer: " << bufferFrames << " frames" << (lowLatency ? " (adaptive)" : "") << std::endl;
     std::cout << "Mixing channels: " << Mix_AllocateChannels(-1) << std::endl;
 
     // Create window with OpenGL context
@@ -74,9 +218,154 @@ int main(int argc, char *argv[])
     SDL_GL_SetSwapInterval(1);
 
     // Create audio manager and 3D guitar
-    auto audioManager = std::make_unique<AudioManager>();
+    auto audioManager = std::make_unique<AudioManager>(engineRate);
+    bool prewarm = false;
+    std::string noteCachePath;
+    std::string midiPath;
+    AmpSettings amp;
+    std::string cabinetPath;
+    int cabinetPartition = PartitionedConvolver::DEFAULT_PARTITION;
+    std::string samplesPath;
+    float sampleHeadSeconds = SampleLibrary::DEFAULT_HEAD_SECONDS;
+    std::string jamPeer;
+    int jamPort = JamSession::DEFAULT_PORT;
+    float jamLate = JamSession::DEFAULT_LATE_TARGET;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--voices" && i + 1 < argc)
+        {
+            audioManager->setMaxVoices(std::atoi(argv[++i]));
+        }
+        else if (arg == "--note-bank")
+        {
+            audioManager->setSynthMode(SynthMode::NoteBank);
+        }
+        else if (arg == "--tone")
+        {
+            audioManager->setSynthMode(SynthMode::Tone);
+        }
+        else if (arg == "--adsr" && i + 1 < argc)
+        {
+            // attack,decay,sustain,release for the live tone, e.g. 0.01,0.5,0.4,0.3
+            EnvelopeSettings envelope;
+            if (std::sscanf(argv[++i], "%f,%f,%f,%f", &envelope.attack, &envelope.decay, &envelope.sustain,
+                            &envelope.release) == 4)
+                audioManager->setEnvelope(VoiceKind::Tone, envelope);
+            else
+                std::cerr << "--adsr expects attack,decay,sustain,release" << std::endl;
+        }
+        else if (arg == "--release" && i + 1 < argc)
+        {
+            // How long a string keeps sounding after the mouse button comes up
+            EnvelopeSettings envelope;
+            envelope.release = (float)std::atof(argv[++i]);
+            audioManager->setEnvelope(VoiceKind::String, envelope);
+            audioManager->setEnvelope(VoiceKind::Sample, envelope);
+            audioManager->setEnvelope(VoiceKind::Stream, envelope);
+        }
+        else if (arg == "--prewarm")
+        {
+            prewarm = true;
+        }
+        else if (arg == "--note-cache" && i + 1 < argc)
+        {
+            prewarm = true;
+            noteCachePath = argv[++i];
+        }
+        else if (arg == "--note-budget" && i + 1 < argc)
+        {
+            // Megabytes of rendered note-bank layers to keep; least recently played go first
+            audioManager->setNoteBankBudget((size_t)(std::atof(argv[++i]) * 1024 * 1024));
+        }
+        else if (arg == "--midi" && i + 1 < argc)
+        {
+            midiPath = argv[++i];
+        }
+        else if (arg == "--amp")
+        {
+            amp.enabled = true;
+        }
+        else if (arg == "--drive" && i + 1 < argc)
+        {
+            amp.enabled = true;
+            amp.drive = (float)std::atof(argv[++i]);
+        }
+        else if (arg == "--oversample" && i + 1 < argc)
+        {
+            amp.oversampling = std::atoi(argv[++i]);
+        }
+        else if (arg == "--cab" && i + 1 < argc)
+        {
+            cabinetPath = argv[++i];
+        }
+        else if (arg == "--cab-partition" && i + 1 < argc)
+        {
+            cabinetPartition = std::atoi(argv[++i]);
+        }
+        else if (arg == "--onset-delay" && i + 1 < argc)
+        {
+            // Milliseconds past one buffer from input event to note; negative plays at the next block
+            audioManager->setOnsetDelay((float)std::atof(argv[++i]) / 1000.0f);
+        }
+        else if (arg == "--load-threshold" && i + 1 < argc)
+        {
+            // Percent of the buffer's playing time above which a callback is logged as an overload
+            audioManager->setLoadThreshold((float)std::atof(argv[++i]) / 100.0f);
+        }
+        else if (arg == "--samples" && i + 1 < argc)
+        {
+            samplesPath = argv[++i];
+        }
+        else if (arg == "--sample-head" && i + 1 < argc)
+        {
+            // Milliseconds of every zone kept in memory; the rest comes from disk
+            sampleHeadSeconds = (float)std::atof(argv[++i]) / 1000.0f;
+        }
+        else if (arg == "--jam" && i + 1 < argc)
+        {
+            // host:port of the other instance
+            jamPeer = argv[++i];
+        }
+        else if (arg == "--jam-port" && i + 1 < argc)
+        {
+            jamPort = std::atoi(argv[++i]);
+        }
+        else if (arg == "--jam-late" && i + 1 < argc)
+        {
+            // Percent of the partner's notes that may miss the jitter buffer; lower waits longer
+            jamLate = (float)std::atof(argv[++i]) / 100.0f;
+        }
+    }
+    audioManager->setAmpSettings(amp);
+    if (lowLatency)
+    {
+        audioManager->enableAdaptiveBuffer(bufferFrames);
+    }
+    if (!cabinetPath.empty())
+    {
+        audioManager->loadCabinetIR(cabinetPath, cabinetPartition);
+    }
+    std::cout << "Synth voices: " << audioManager->getMaxVoices() << std::endl;
     auto guitar3D = std::make_unique<Guitar3D>(WINDOW_WIDTH, WINDOW_HEIGHT, audioManager.get());
 
+    // Zones are mapped to notes through the tuning, which the guitar has just set
+    if (!samplesPath.empty() && !audioManager->loadSampleLibrary(samplesPath, sampleHeadSeconds))
+    {
+        std::cerr << "Sample library not loaded, playing the string synth" << std::endl;
+    }
+
+    // Fill the note bank in the background while shaders and the model load
+    if (prewarm && audioManager->getSynthMode() == SynthMode::NoteBank)
+    {
+        audioManager->prewarmNoteBank(noteCachePath);
+    }
+    else if (prewarm)
+    {
+        std::cerr << (noteCachePath.empty() ? "--prewarm" : "--note-cache")
+                  << " only applies to the note bank, add --note-bank; ignoring it" << std::endl;
+    }
+
     // Initialize guitar
     if (!guitar3D->initialize())
     {
@@ -88,17 +377,35 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    // Start the song only once loading is done, so its first notes are not late
+    if (!midiPath.empty())
+    {
+        audioManager->playMidiFile(midiPath);
+    }
+    if (!jamPeer.empty())
+    {
+        if (jamPort < 0 || jamPort > 65535 || !audioManager->startJam((uint16_t)jamPort, jamPeer, jamLate))
+            std::cerr << "Jam session not started, playing alone" << std::endl;
+    }
+
     // Main loop
     bool running = true;
     SDL_Event event;
     bool mouseDown = false;
     int lastMouseX = 0, lastMouseY = 0;
+    bool picking = false; // left button down: drags bend, add vibrato or work the whammy
+    int pickX = 0, pickY = 0;
+    SDL_Keycode strumKey = SDLK_UNKNOWN; // its chord rings until the key comes up
+    TickClock tickClock; // SDL event stamps onto the clock the audio side schedules by
+    Uint32 lastTitleUpdate = 0;
 
     std::cout << "3D Guitar Simulator ready!" << std::endl;
     std::cout << "Controls:" << std::endl;
-    std::cout << "- Left click: Play guitar notes" << std::endl;
+    std::cout << "- Left click: Play guitar notes (released with the button)" << std::endl;
+    std::cout << "- Left click + drag: Up bends the string, sideways adds vibrato; with Shift, whammy bar" << std::endl;
     std::cout << "- Right click + drag: Rotate camera" << std::endl;
     std::cout << "- Mouse wheel: Zoom in/out" << std::endl;
+    std::cout << "- Keys 1-9: Strum C G D A E Am Em Dm F, held to let it ring (hold Shift to strum up)" << std::endl;
 
     while (running)
     {
@@ -113,9 +420,16 @@ int main(int argc, char *argv[])
             case SDL_MOUSEBUTTONDOWN:
                 if (event.button.button == SDL_BUTTON_LEFT)
                 {
+                    // SDL stamps events in milliseconds since init; move that onto the probe's clock
+                    int64_t eventTime = tickClock.toTime(event.button.timestamp, SDL_GetTicks());
+                    audioManager->getLatencyProbe().beginClick(eventTime);
+
                     int windowWidth, windowHeight;
                     SDL_GetWindowSize(window, &windowWidth, &windowHeight);
-                    guitar3D->handleClick(event.button.x, event.button.y, windowWidth, windowHeight);
+                    guitar3D->handleClick(event.button.x, event.button.y, windowWidth, windowHeight, eventTime);
+                    picking = true;
+                    pickX = event.button.x;
+                    pickY = event.button.y;
                 }
                 else if (event.button.button == SDL_BUTTON_RIGHT)
                 {
@@ -127,7 +441,12 @@ int main(int argc, char *argv[])
                 break;
 
             case SDL_MOUSEBUTTONUP:
-                if (event.button.button == SDL_BUTTON_RIGHT)
+                if (event.button.button == SDL_BUTTON_LEFT)
+                {
+                    guitar3D->handleRelease(tickClock.toTime(event.button.timestamp, SDL_GetTicks()));
+                    picking = false;
+                }
+                else if (event.button.button == SDL_BUTTON_RIGHT)
                 {
                     mouseDown = false;
                     SDL_SetRelativeMouseMode(SDL_FALSE);
@@ -139,6 +458,32 @@ int main(int argc, char *argv[])
                 {
                     guitar3D->handleMouseMotion(event.motion.xrel, event.motion.yrel);
                 }
+                else if (picking)
+                {
+                    guitar3D->handleDrag(event.motion.x - pickX, event.motion.y - pickY,
+                                         (SDL_GetModState() & KMOD_SHIFT) != 0);
+                }
+                break;
+
+            case SDL_KEYDOWN:
+                if (!event.key.repeat && event.key.keysym.sym >= SDLK_1 && event.key.keysym.sym <= SDLK_9)
+                {
+                    StrumDirection direction = (event.key.keysym.mod & KMOD_SHIFT) ? StrumDirection::Up
+                                                                                   : StrumDirection::Down;
+                    guitar3D->strumChord(CHORD_KEYS[event.key.keysym.sym - SDLK_1], direction,
+                                         tickClock.toTime(event.key.timestamp, SDL_GetTicks()));
+                    strumKey = event.key.keysym.sym;
+                }
+                break;
+
+            case SDL_KEYUP:
+                // Only the last chord's key lets go; an earlier one already gave its strings up
+                if (event.key.keysym.sym == strumKey)
+                {
+                    guitar3D->releaseChord(CHORD_KEYS[strumKey - SDLK_1],
+                                           tickClock.toTime(event.key.timestamp, SDL_GetTicks()));
+                    strumKey = SDLK_UNKNOWN;
+                }
                 break;
 
             case SDL_MOUSEWHEEL:
@@ -156,6 +501,22 @@ int main(int argc, char *argv[])
             }
         }
 
+        // Grow or shrink the audio buffer if the callback has been glitching or clean
+        audioManager->updateBufferSize();
+        audioManager->pollLoadMeter();
+        audioManager->pollJam();
+
+        // DSP load in the title bar, twice a second
+        DspLoadSnapshot load;
+        if (SDL_GetTicks() - lastTitleUpdate >= 500 && audioManager->getLoadMeter().read(load) && load.callbacks > 0)
+        {
+            char title[128];
+            std::snprintf(title, sizeof(title), "Electric Guitar 3D Simulator - DSP %.0f%% (max %.0f%%)",
+                          100.0 * load.windowAvg, 100.0 * load.windowMax);
+            SDL_SetWindowTitle(window, title);
+            lastTitleUpdate = SDL_GetTicks();
+        }
+
         // Render
         guitar3D->render();
 
@@ -163,7 +524,15 @@ int main(int argc, char *argv[])
         SDL_GL_SwapWindow(window);
     }
 
-    // Cleanup
+    audioManager->printVoiceStats();
+    audioManager->printLoadReport();
+    audioManager->printLatencyReport();
+    audioManager->printBufferStats();
+    audioManager->printJamReport();
+
+    // Cleanup (release the synth before the mixer it is hooked into goes away)
+    guitar3D.reset();
+    audioManager.reset();
     SDL_GL_DeleteContext(glContext);
     SDL_DestroyWindow(window);
     Mix_CloseAudio();